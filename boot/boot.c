@@ -6,6 +6,10 @@ typedef struct {
   uint32_t width;
   uint32_t height;
   uint32_t pitch;
+  void *memory_map;               // UEFI memory map (EFI_MEMORY_DESCRIPTOR array)
+  uint64_t memory_map_size;       // Size of the map in bytes
+  uint64_t memory_map_desc_size;  // Stride between descriptors
+  void *acpi_rsdp;                 // ACPI RSDP from the EFI configuration table (or NULL)
 } BootInfo;
 
 /* Simple Boot Splash Functions */
@@ -135,6 +139,15 @@ uint8_t read_cmos(uint8_t addr) {
   return res;
 }
 
+/* Compare two EFI GUIDs */
+static int guid_equal(const EFI_GUID *a, const EFI_GUID *b) {
+  const uint8_t *pa = (const uint8_t *)a, *pb = (const uint8_t *)b;
+  for (int i = 0; i < (int)sizeof(EFI_GUID); i++) {
+    if (pa[i] != pb[i]) return 0;
+  }
+  return 1;
+}
+
 EFI_STATUS EFIAPI EfiMain(EFI_HANDLE ImageHandle,
                           EFI_SYSTEM_TABLE *SystemTable) {
   gST = SystemTable;
@@ -207,6 +220,21 @@ EFI_STATUS EFIAPI EfiMain(EFI_HANDLE ImageHandle,
   info.height = gop->Mode->Info->VR;
   info.pitch = gop->Mode->Info->PPSL;
 
+  // Locate the ACPI RSDP, preferring the ACPI 2.0 entry
+  EFI_GUID acpi20Guid = {0x8868e871, 0xe4f1, 0x11d3, {0xbc, 0x22, 0x00, 0x80, 0xc7, 0x3c, 0x88, 0x81}};
+  EFI_GUID acpi10Guid = {0xeb9d2d30, 0x2d88, 0x11d3, {0x9a, 0x16, 0x00, 0x90, 0x27, 0x3f, 0xc1, 0x4d}};
+  EFI_CONFIGURATION_TABLE *configTable = (EFI_CONFIGURATION_TABLE *)gST->CT;
+  info.acpi_rsdp = NULL;
+  for (UINTN i = 0; i < gST->NTE; i++) {
+    if (guid_equal(&configTable[i].VendorGuid, &acpi20Guid)) {
+      info.acpi_rsdp = configTable[i].VendorTable;
+      break;
+    }
+    if (guid_equal(&configTable[i].VendorGuid, &acpi10Guid)) {
+      info.acpi_rsdp = configTable[i].VendorTable;
+    }
+  }
+
   UINTN mapKey, memMapSize = 0, descSz;
   uint32_t descVer;
   EFI_MEMORY_DESCRIPTOR *memoryMap = NULL;
@@ -220,11 +248,23 @@ EFI_STATUS EFIAPI EfiMain(EFI_HANDLE ImageHandle,
 
   // Get final memory map
   update_boot_progress(gop, "Preparing to exit boot services...", 95);
+  UINTN mapBufferSize = memMapSize;
   gBS->GetMemoryMap(&memMapSize, memoryMap, &mapKey, &descSz, &descVer);
 
   // Exit boot services
   update_boot_progress(gop, "Starting Tiny64 Kernel...", 100);
-  gBS->ExitBootServices(ImageHandle, mapKey);
+  if (EFI_ERROR(gBS->ExitBootServices(ImageHandle, mapKey))) {
+    // Map changed underneath us (e.g. the progress bar allocated); refresh and retry once
+    memMapSize = mapBufferSize;
+    gBS->GetMemoryMap(&memMapSize, memoryMap, &mapKey, &descSz, &descVer);
+    gBS->ExitBootServices(ImageHandle, mapKey);
+  }
+
+  // Hand the map to the kernel so it can manage physical memory.
+  // The buffer is EfiLoaderData, so it survives ExitBootServices.
+  info.memory_map = memoryMap;
+  info.memory_map_size = memMapSize;
+  info.memory_map_desc_size = descSz;
 
   void (*kernel_entry)(BootInfo *) = (void (*)(BootInfo *))kernelBase;
   kernel_entry(&info);
@@ -91,6 +91,8 @@ typedef struct {
     void *SEH; void *SE; void *RS; EFI_BOOT_SERVICES *BootServices; UINTN NTE; void *CT; 
 } EFI_SYSTEM_TABLE;
 
+typedef struct { EFI_GUID VendorGuid; void *VendorTable; } EFI_CONFIGURATION_TABLE;
+
 typedef struct { uint32_t Ver; uint32_t HR; uint32_t VR; uint32_t PF; uint32_t PIM[4]; uint32_t PPSL; } EFI_GOP_MODE_INFO;
 typedef struct { uint32_t MM; uint32_t M; EFI_GOP_MODE_INFO *Info; UINTN IS; uint64_t FBB; UINTN FBS; } EFI_GOP_MODE;
 typedef struct _GOP { 
@@ -71,10 +71,8 @@ static void keyboard_buffer_put(char c) {
 }
 
 void keyboard_enable_interrupt(void) {
-    // Unmask keyboard interrupt (IRQ1)
-    uint8_t mask = inb(0x21);
-    mask &= ~(1 << 1); // Unmask IRQ1
-    outb(0x21, mask);
+    // Unmask keyboard interrupt (IRQ1) on whichever controller routes it
+    irq_unmask(1);
     serial_write_string("[KEYBOARD] Keyboard interrupt enabled\n");
 }
 
@@ -227,9 +225,7 @@ void keyboard_init(void) {
     serial_write_string("[KEYBOARD_INIT] Keyboard marked as initialized\n");
 
     // Mask keyboard interrupt BEFORE re-enabling interrupts globally
-    uint8_t mask = inb(0x21);
-    mask |= (1 << 1); // Mask IRQ1 (keyboard)
-    outb(0x21, mask);
+    irq_mask(1); // Mask IRQ1 (keyboard)
 
     serial_write_string("[KEYBOARD_INIT] Keyboard interrupt masked\n");
 
@@ -9,6 +9,7 @@ uint8_t mouse_left_pressed = 0;
 static uint8_t mouse_cycle = 0;
 static int8_t mouse_byte[3];
 static uint32_t cursor_backbuffer[256];
+static int cursor_shown = 0;
 
 #define CURSOR_SIZE 8
 
@@ -171,10 +172,8 @@ int mouse_init(void) {
   outb(0x64, 0xA8); // Re-enable mouse
   io_wait();
 
-  // Unmask IRQ12 on slave PIC for mouse interrupts
-  uint8_t mask = inb(0xA1);
-  mask &= ~(1 << 4); // IRQ12 = bit 4
-  outb(0xA1, mask);
+  // Unmask IRQ12 (slave PIC or IOAPIC) for mouse interrupts
+  irq_unmask(12);
 
   // Final flush to ensure clean state
   for (int i = 0; i < 100; i++) {
@@ -194,6 +193,7 @@ int mouse_init(void) {
 
 void restore_cursor_bg(BootInfo *info, int x, int y) {
   uint32_t *fb = info->backbuffer ? info->backbuffer : info->framebuffer;
+  cursor_shown = 0;
   for (int cy = 0; cy < CURSOR_SIZE; cy++) {
     if (y + cy >= (int)info->height)
       break;
@@ -204,18 +204,23 @@ void restore_cursor_bg(BootInfo *info, int x, int y) {
           cursor_backbuffer[cy * CURSOR_SIZE + cx];
     }
   }
+  mark_dirty_rect(info, x, y, CURSOR_SIZE, CURSOR_SIZE);
 }
 
-void draw_cursor(BootInfo *info, int x, int y) {
-  mouse_x = x;
-  mouse_y = y;
+// Save the pixels under the part of the cursor at (x,y) that falls in
+// [x0,x1) x [y0,y1), then draw that part
+static void draw_cursor_part(BootInfo *info, int x, int y, int x0, int y0, int x1, int y1) {
   uint32_t *fb = info->backbuffer ? info->backbuffer : info->framebuffer;
   for (int cy = 0; cy < CURSOR_SIZE; cy++) {
     if (y + cy >= (int)info->height)
       break;
+    if (y + cy < y0 || y + cy >= y1)
+      continue;
     for (int cx = 0; cx < CURSOR_SIZE; cx++) {
       if (x + cx >= (int)info->width)
         break;
+      if (x + cx < x0 || x + cx >= x1)
+        continue;
       uint32_t index = (y + cy) * info->pitch + (x + cx);
       cursor_backbuffer[cy * CURSOR_SIZE + cx] = fb[index];
       int draw = 0;
@@ -232,6 +237,24 @@ void draw_cursor(BootInfo *info, int x, int y) {
   }
 }
 
+void draw_cursor(BootInfo *info, int x, int y) {
+  mouse_x = x;
+  mouse_y = y;
+  draw_cursor_part(info, x, y, x, y, x + CURSOR_SIZE, y + CURSOR_SIZE);
+  cursor_shown = 1;
+  mark_dirty_rect(info, x, y, CURSOR_SIZE, CURSOR_SIZE);
+}
+
+// The compositor rewrote this rectangle of the backbuffer, cursor included:
+// what is there now is the new background
+void cursor_refresh(BootInfo *info, int x0, int y0, int x1, int y1) {
+  if (!cursor_shown)
+    return;
+  if (x1 <= mouse_x || x0 >= mouse_x + CURSOR_SIZE || y1 <= mouse_y || y0 >= mouse_y + CURSOR_SIZE)
+    return;
+  draw_cursor_part(info, mouse_x, mouse_y, x0, y0, x1, y1);
+}
+
 void start_mouse_test(void) {
   mouse_test_mode = 1;
   mouse_test_clicks = 0;
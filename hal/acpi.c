@@ -0,0 +1,79 @@
+/* hal/acpi.c */
+#include "../include/kernel.h"
+#include "acpi.h"
+#include "serial.h"
+
+/*
+ * Minimal ACPI table lookup.
+ * The bootloader finds the RSDP in the EFI configuration table; from there
+ * the XSDT (ACPI 2.0+) or RSDT lists every other table. All of it lives in
+ * identity-mapped memory, so the physical addresses are used directly.
+ */
+
+typedef struct {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+    /* ACPI 2.0+ */
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+static acpi_sdt_header_t *root_table = NULL;
+static int root_is_xsdt = 0;
+
+static int acpi_checksum_ok(const void *table, uint32_t length) {
+    const uint8_t *bytes = table;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) sum += bytes[i];
+    return sum == 0;
+}
+
+void acpi_init(BootInfo *info) {
+    acpi_rsdp_t *rsdp = info ? (acpi_rsdp_t *)info->acpi_rsdp : NULL;
+    if (!rsdp || !acpi_checksum_ok(rsdp, 20)) {
+        serial_write_string("[ACPI] No RSDP available\n");
+        return;
+    }
+
+    if (rsdp->revision >= 2 && rsdp->xsdt_address) {
+        root_table = (acpi_sdt_header_t *)(uintptr_t)rsdp->xsdt_address;
+        root_is_xsdt = 1;
+    } else {
+        root_table = (acpi_sdt_header_t *)(uintptr_t)rsdp->rsdt_address;
+        root_is_xsdt = 0;
+    }
+
+    if (!acpi_checksum_ok(root_table, root_table->length)) {
+        serial_write_string("[ACPI] Root table checksum mismatch\n");
+        root_table = NULL;
+        return;
+    }
+
+    serial_write_string(root_is_xsdt ? "[ACPI] Using XSDT\n" : "[ACPI] Using RSDT\n");
+}
+
+void *acpi_find_table(const char *signature) {
+    if (!root_table) return NULL;
+
+    uint32_t entry_size = root_is_xsdt ? 8 : 4;
+    uint32_t count = (root_table->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    uint8_t *entries = (uint8_t *)root_table + sizeof(acpi_sdt_header_t);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t addr = root_is_xsdt ? *(uint64_t *)(entries + i * 8)
+                                     : *(uint32_t *)(entries + i * 4);
+        acpi_sdt_header_t *table = (acpi_sdt_header_t *)(uintptr_t)addr;
+        if (!table) continue;
+
+        if (table->signature[0] == signature[0] && table->signature[1] == signature[1] &&
+            table->signature[2] == signature[2] && table->signature[3] == signature[3]) {
+            return acpi_checksum_ok(table, table->length) ? table : NULL;
+        }
+    }
+    return NULL;
+}
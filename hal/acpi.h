@@ -0,0 +1,45 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+#include "../include/kernel.h"
+
+// Common header of every ACPI system description table
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+// Generic Address Structure
+typedef struct {
+    uint8_t address_space;
+    uint8_t bit_width;
+    uint8_t bit_offset;
+    uint8_t access_size;
+    uint64_t address;
+} __attribute__((packed)) acpi_gas_t;
+
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t event_timer_block_id;
+    acpi_gas_t base_address;
+    uint8_t hpet_number;
+    uint16_t min_tick;
+    uint8_t page_protection;
+} __attribute__((packed)) acpi_hpet_t;
+
+// Remember the RSDP handed over by the bootloader
+void acpi_init(BootInfo *info);
+
+// Find a table by its 4-character signature (e.g. "APIC", "HPET").
+// Returns NULL if ACPI is unavailable or the table fails its checksum.
+void *acpi_find_table(const char *signature);
+
+#endif
@@ -0,0 +1,260 @@
+/* hal/apic.c */
+#include "../include/kernel.h"
+#include "acpi.h"
+#include "apic.h"
+#include "paging.h"
+#include "serial.h"
+
+/*
+ * MADT parsing, local APIC enable and IOAPIC redirection.
+ * EOIs become a single MMIO store instead of one or two port writes, which
+ * matters under virtualization where every port access is a VM exit.
+ */
+
+#define MSR_IA32_APIC_BASE      0x1B
+#define APIC_BASE_ENABLE        (1ULL << 11)
+
+#define MADT_LAPIC              0
+#define MADT_IOAPIC             1
+#define MADT_ISO                2
+#define MADT_LAPIC_OVERRIDE     5
+
+#define IOAPIC_REG_SELECT       0x00
+#define IOAPIC_REG_WINDOW       0x10
+#define IOAPIC_REG_VERSION      0x01
+#define IOAPIC_REG_REDIR        0x10
+
+#define REDIR_LEVEL             (1 << 15)
+#define REDIR_ACTIVE_LOW        (1 << 13)
+#define REDIR_MASKED            (1 << 16)
+#define LVT_MASKED              (1 << 16)
+
+#define MAX_IOAPICS             4
+
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_t;
+
+typedef struct {
+    volatile uint32_t *base;
+    uint32_t gsi_base;
+    uint32_t gsi_count;
+} ioapic_t;
+
+// Where each ISA IRQ ends up on the IOAPIC side
+typedef struct {
+    uint32_t gsi;
+    uint32_t flags;         // REDIR_LEVEL / REDIR_ACTIVE_LOW
+    int masked;
+} isa_route_t;
+
+static volatile uint32_t *lapic = NULL;
+static ioapic_t ioapics[MAX_IOAPICS];
+static int ioapic_count = 0;
+static isa_route_t isa_routes[16];
+static uint32_t cpu_ids[APIC_MAX_CPUS];
+static int cpu_count = 0;
+static int apic_enabled = 0;
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/* --- Register access --- */
+
+uint32_t apic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+void apic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+}
+
+static uint32_t ioapic_read(ioapic_t *io, uint32_t reg) {
+    io->base[IOAPIC_REG_SELECT / 4] = reg;
+    return io->base[IOAPIC_REG_WINDOW / 4];
+}
+
+static void ioapic_write(ioapic_t *io, uint32_t reg, uint32_t value) {
+    io->base[IOAPIC_REG_SELECT / 4] = reg;
+    io->base[IOAPIC_REG_WINDOW / 4] = value;
+}
+
+static ioapic_t *ioapic_for_gsi(uint32_t gsi) {
+    for (int i = 0; i < ioapic_count; i++) {
+        if (gsi >= ioapics[i].gsi_base && gsi < ioapics[i].gsi_base + ioapics[i].gsi_count) {
+            return &ioapics[i];
+        }
+    }
+    return NULL;
+}
+
+static void ioapic_program(int irq) {
+    isa_route_t *route = &isa_routes[irq];
+    ioapic_t *io = ioapic_for_gsi(route->gsi);
+    if (!io) return;
+
+    uint32_t pin = route->gsi - io->gsi_base;
+    uint32_t low = (APIC_VECTOR_IRQ_BASE + irq) | route->flags;
+    if (route->masked) low |= REDIR_MASKED;
+
+    // Fixed delivery, physical destination: the boot CPU
+    ioapic_write(io, IOAPIC_REG_REDIR + pin * 2 + 1, apic_lapic_id() << 24);
+    ioapic_write(io, IOAPIC_REG_REDIR + pin * 2, low);
+}
+
+/* --- MADT --- */
+
+static int parse_madt(void) {
+    acpi_madt_t *madt = acpi_find_table("APIC");
+    if (!madt) return -1;
+
+    uint64_t lapic_phys = madt->lapic_address;
+    uint8_t *entry = (uint8_t *)madt + sizeof(acpi_madt_t);
+    uint8_t *end = (uint8_t *)madt + madt->header.length;
+
+    for (int i = 0; i < 16; i++) {
+        isa_routes[i].gsi = i;
+        isa_routes[i].flags = 0;
+        isa_routes[i].masked = 1;
+    }
+
+    while (entry + 2 <= end && entry[1] >= 2) {
+        switch (entry[0]) {
+        case MADT_LAPIC: {
+            uint32_t flags = *(uint32_t *)(entry + 4);
+            if ((flags & 3) && cpu_count < APIC_MAX_CPUS) cpu_ids[cpu_count++] = entry[3];
+            break;
+        }
+        case MADT_IOAPIC:
+            if (ioapic_count < MAX_IOAPICS) {
+                ioapics[ioapic_count].base = (volatile uint32_t *)(uintptr_t)*(uint32_t *)(entry + 4);
+                ioapics[ioapic_count].gsi_base = *(uint32_t *)(entry + 8);
+                ioapic_count++;
+            }
+            break;
+        case MADT_ISO: {
+            uint8_t source = entry[3];
+            uint16_t flags = *(uint16_t *)(entry + 8);
+            if (source < 16) {
+                isa_routes[source].gsi = *(uint32_t *)(entry + 4);
+                isa_routes[source].flags = 0;
+                if ((flags & 0x3) == 0x3) isa_routes[source].flags |= REDIR_ACTIVE_LOW;
+                if (((flags >> 2) & 0x3) == 0x3) isa_routes[source].flags |= REDIR_LEVEL;
+            }
+            break;
+        }
+        case MADT_LAPIC_OVERRIDE:
+            lapic_phys = *(uint64_t *)(entry + 4);
+            break;
+        }
+        entry += entry[1];
+    }
+
+    if (ioapic_count == 0) return -1;
+
+    paging_map_mmio(lapic_phys, 4096);
+    lapic = (volatile uint32_t *)(uintptr_t)lapic_phys;
+
+    for (int i = 0; i < ioapic_count; i++) {
+        paging_map_mmio((uint64_t)(uintptr_t)ioapics[i].base, 4096);
+        ioapics[i].gsi_count = ((ioapic_read(&ioapics[i], IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+    }
+    return 0;
+}
+
+/* --- Public API --- */
+
+int apic_init(void) {
+    if (apic_enabled) return 0;
+
+    if (parse_madt() != 0) {
+        serial_write_string("[APIC] No MADT/IOAPIC, staying on the 8259 PIC\n");
+        return -1;
+    }
+
+    __asm__ volatile("cli");
+
+    // Carry over whatever the PIC had unmasked, then silence it for good
+    uint16_t pic_mask = inb(0x21) | (inb(0xA1) << 8);
+    outb(0x21, 0xFF);
+    outb(0xA1, 0xFF);
+
+    wrmsr(MSR_IA32_APIC_BASE, rdmsr(MSR_IA32_APIC_BASE) | APIC_BASE_ENABLE);
+    apic_write(LAPIC_REG_SVR, 0x100 | APIC_VECTOR_SPURIOUS);
+    apic_write(LAPIC_REG_LVT_LINT0, LVT_MASKED); // Disconnect the 8259 (ExtINT)
+
+    for (int irq = 0; irq < 16; irq++) {
+        isa_routes[irq].masked = irq == 2 || (pic_mask & (1 << irq));
+        ioapic_program(irq);
+    }
+
+    apic_enabled = 1;
+    __asm__ volatile("sti");
+
+    serial_write_string("[APIC] LAPIC id ");
+    serial_write_dec(apic_lapic_id());
+    serial_write_string(", ");
+    serial_write_dec(ioapic_count);
+    serial_write_string(" IOAPIC(s), ");
+    serial_write_dec(cpu_count);
+    serial_write_string(" CPU(s) in MADT\n");
+    return 0;
+}
+
+void apic_init_cpu(void) {
+    if (!lapic) return;
+    wrmsr(MSR_IA32_APIC_BASE, rdmsr(MSR_IA32_APIC_BASE) | APIC_BASE_ENABLE);
+    apic_write(LAPIC_REG_SVR, 0x100 | APIC_VECTOR_SPURIOUS);
+    apic_write(LAPIC_REG_LVT_LINT0, LVT_MASKED);
+}
+
+void apic_send_ipi(uint32_t lapic_id, uint32_t icr_low) {
+    apic_write(LAPIC_REG_ICR_HIGH, lapic_id << 24);
+    apic_write(LAPIC_REG_ICR_LOW, icr_low);
+    while (apic_read(LAPIC_REG_ICR_LOW) & (1 << 12)) {
+        __asm__ volatile("pause"); // Delivery pending
+    }
+}
+
+int apic_is_enabled(void) {
+    return apic_enabled;
+}
+
+uint32_t apic_lapic_id(void) {
+    return apic_read(LAPIC_REG_ID) >> 24;
+}
+
+void apic_eoi(void) {
+    lapic[LAPIC_REG_EOI / 4] = 0;
+}
+
+void apic_irq_mask(int irq, int masked) {
+    if (irq < 0 || irq >= 16) return;
+    isa_routes[irq].masked = masked;
+    ioapic_program(irq);
+}
+
+void apic_irq_set_pci(int irq) {
+    if (irq < 0 || irq >= 16) return;
+    // An explicit override already describes the line
+    if (isa_routes[irq].gsi != (uint32_t)irq || isa_routes[irq].flags) return;
+    isa_routes[irq].flags = REDIR_LEVEL | REDIR_ACTIVE_LOW;
+    if (apic_enabled) ioapic_program(irq);
+}
+
+int apic_cpu_count(void) {
+    return cpu_count;
+}
+
+uint32_t apic_cpu_lapic_id(int index) {
+    return index >= 0 && index < cpu_count ? cpu_ids[index] : 0;
+}
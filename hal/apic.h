@@ -0,0 +1,56 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+
+// Local APIC + IOAPIC interrupt routing.
+// apic_init() walks the ACPI MADT, enables the boot CPU's local APIC and
+// moves the ISA IRQs from the 8259 pair onto the IOAPIC using the same
+// vectors (0x20 + irq). Without a MADT the legacy PIC stays in charge.
+
+#define APIC_MAX_CPUS           64
+
+#define APIC_VECTOR_IRQ_BASE    0x20
+#define APIC_VECTOR_TIMER       0x30    // LAPIC timer, delivered as IRQ 0
+#define APIC_VECTOR_IPI         0xF0    // Wakeup IPI (handler only EOIs)
+#define APIC_VECTOR_SPURIOUS    0xFF
+
+int apic_init(void);
+int apic_is_enabled(void);
+
+// Enable the local APIC of an application processor (after apic_init on the BSP)
+void apic_init_cpu(void);
+
+// Send an IPI; 'icr_low' holds the delivery mode and vector bits
+void apic_send_ipi(uint32_t lapic_id, uint32_t icr_low);
+
+// Local APIC of the calling CPU
+uint32_t apic_lapic_id(void);
+void apic_eoi(void);
+uint32_t apic_read(uint32_t reg);
+void apic_write(uint32_t reg, uint32_t value);
+
+// IOAPIC redirection for an ISA IRQ (after interrupt source overrides)
+void apic_irq_mask(int irq, int masked);
+
+// PCI INTx lines are level triggered and active low unless the MADT says
+// otherwise; call this before unmasking a PCI device's interrupt line.
+void apic_irq_set_pci(int irq);
+
+// Processors listed in the MADT (enabled or online-capable)
+int apic_cpu_count(void);
+uint32_t apic_cpu_lapic_id(int index);
+
+// Local APIC register offsets
+#define LAPIC_REG_ID            0x020
+#define LAPIC_REG_EOI           0x0B0
+#define LAPIC_REG_SVR           0x0F0
+#define LAPIC_REG_ICR_LOW       0x300
+#define LAPIC_REG_ICR_HIGH      0x310
+#define LAPIC_REG_LVT_TIMER     0x320
+#define LAPIC_REG_LVT_LINT0     0x350
+#define LAPIC_REG_TIMER_INIT    0x380
+#define LAPIC_REG_TIMER_CURRENT 0x390
+#define LAPIC_REG_TIMER_DIVIDE  0x3E0
+
+#endif
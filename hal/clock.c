@@ -0,0 +1,218 @@
+/* hal/clock.c */
+#include "../include/kernel.h"
+#include "acpi.h"
+#include "clock.h"
+#include "serial.h"
+
+/*
+ * TSC-based clock.
+ * The TSC frequency is found once at boot, then every timestamp is a single
+ * rdtsc plus a 64x64->128 multiply: ns = (tsc - base) * mult >> 32.
+ */
+
+#define PIT_HZ              1193182
+#define CALIBRATE_MS        10
+#define FS_PER_NS           1000000ULL
+
+#define HPET_REG_CAP        0x00
+#define HPET_REG_CONFIG     0x10
+#define HPET_REG_COUNTER    0xF0
+
+static uint64_t tsc_hz = 0;
+static uint64_t tsc_base = 0;
+static uint64_t ns_mult = 0;        // (1e9 << 32) / tsc_hz
+static uint64_t tsc_mult = 0;       // (tsc_hz << 30) / 1e9
+static int tsc_invariant = 0;
+static int64_t boot_epoch = 0;
+static const char *clock_source = "none";
+
+static inline void clock_cpuid(uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    __asm__ volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+/* --- Calibration sources --- */
+
+// Leaf 0x15 gives the exact TSC/crystal ratio on newer Intel parts
+static uint64_t calibrate_cpuid(void) {
+    uint32_t a, b, c, d;
+    clock_cpuid(0, &a, &b, &c, &d);
+    if (a < 0x15) return 0;
+
+    clock_cpuid(0x15, &a, &b, &c, &d);
+    if (a == 0 || b == 0 || c == 0) return 0;
+    return (uint64_t)c * b / a;
+}
+
+static uint64_t calibrate_hpet(void) {
+    acpi_hpet_t *table = acpi_find_table("HPET");
+    if (!table || table->base_address.address_space != 0) return 0;
+
+    volatile uint64_t *hpet = (volatile uint64_t *)(uintptr_t)table->base_address.address;
+    uint64_t period_fs = hpet[HPET_REG_CAP / 8] >> 32;
+    if (period_fs == 0 || period_fs > 100000000ULL) return 0; // Spec maximum is 100ns
+
+    // Make sure the main counter runs; leave legacy routing untouched
+    hpet[HPET_REG_CONFIG / 8] |= 1;
+
+    uint64_t ticks = (CALIBRATE_MS * 1000000ULL * FS_PER_NS) / period_fs;
+    uint64_t start = hpet[HPET_REG_COUNTER / 8];
+    uint64_t tsc_start = rdtsc();
+    uint64_t now;
+    do {
+        now = hpet[HPET_REG_COUNTER / 8];
+    } while (now - start < ticks);
+    uint64_t tsc_end = rdtsc();
+
+    uint64_t elapsed_ns = (now - start) * period_fs / FS_PER_NS;
+    if (elapsed_ns == 0) return 0;
+    return (tsc_end - tsc_start) * 1000000000ULL / elapsed_ns;
+}
+
+// One-shot on PIT channel 2; the shortest of a few runs has the least jitter
+static uint64_t calibrate_pit(void) {
+    uint16_t count = PIT_HZ / (1000 / CALIBRATE_MS);
+    uint64_t best = UINT64_MAX;
+
+    for (int run = 0; run < 3; run++) {
+        uint8_t port61 = inb(0x61) & ~0x03;
+        outb(0x61, port61);                 // Gate low, speaker off
+        outb(0x43, 0xB0);                   // Channel 2, lobyte/hibyte, mode 0
+        outb(0x42, count & 0xFF);
+        outb(0x42, count >> 8);
+        outb(0x61, port61 | 0x01);          // Gate high starts the count
+
+        uint64_t start = rdtsc();
+        while (!(inb(0x61) & 0x20));
+        uint64_t cycles = rdtsc() - start;
+        if (cycles < best) best = cycles;
+    }
+
+    return best * (1000 / CALIBRATE_MS);
+}
+
+/* --- RTC --- */
+
+static uint8_t bcd_to_bin(uint8_t value) {
+    return (value & 0x0F) + (value >> 4) * 10;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+static int64_t read_rtc_epoch(void) {
+    // Wait for any update in progress to finish
+    while (read_cmos(0x0A) & 0x80);
+
+    uint8_t sec = read_cmos(0x00), min = read_cmos(0x02), hour = read_cmos(0x04);
+    uint8_t day = read_cmos(0x07), month = read_cmos(0x08), year = read_cmos(0x09);
+    uint8_t status_b = read_cmos(0x0B);
+
+    int pm = hour & 0x80;
+    hour &= 0x7F;
+    if (!(status_b & 0x04)) {
+        sec = bcd_to_bin(sec);
+        min = bcd_to_bin(min);
+        hour = bcd_to_bin(hour);
+        day = bcd_to_bin(day);
+        month = bcd_to_bin(month);
+        year = bcd_to_bin(year);
+    }
+    if (!(status_b & 0x02) && pm) hour = (hour % 12) + 12;
+
+    if (month < 1 || month > 12 || day < 1 || day > 31) return 0;
+    return days_from_civil(2000 + year, month, day) * 86400 + hour * 3600 + min * 60 + sec;
+}
+
+/* --- Public API --- */
+
+void clock_init(void) {
+    if (tsc_hz) return;
+
+    uint32_t a, b, c, d;
+    clock_cpuid(0x80000000, &a, &b, &c, &d);
+    if (a >= 0x80000007) {
+        clock_cpuid(0x80000007, &a, &b, &c, &d);
+        tsc_invariant = (d >> 8) & 1;
+    }
+
+    tsc_hz = calibrate_cpuid();
+    clock_source = "cpuid";
+    if (!tsc_hz) {
+        tsc_hz = calibrate_hpet();
+        clock_source = "hpet";
+    }
+    if (!tsc_hz) {
+        tsc_hz = calibrate_pit();
+        clock_source = "pit";
+    }
+
+    ns_mult = (1000000000ULL << 32) / tsc_hz;
+    tsc_mult = (tsc_hz << 30) / 1000000000ULL;
+    boot_epoch = read_rtc_epoch();
+    tsc_base = rdtsc();
+
+    serial_write_string("[CLOCK] TSC ");
+    serial_write_dec(tsc_hz / 1000);
+    serial_write_string(" kHz via ");
+    serial_write_string(clock_source);
+    serial_write_string(tsc_invariant ? " (invariant)\n" : " (not invariant, may drift with P-states)\n");
+}
+
+int clock_is_calibrated(void) {
+    return tsc_hz != 0;
+}
+
+uint64_t clock_tsc_to_ns(uint64_t ticks) {
+    return (uint64_t)(((unsigned __int128)ticks * ns_mult) >> 32);
+}
+
+uint64_t clock_ns_to_tsc(uint64_t ns) {
+    return tsc_base + (uint64_t)(((unsigned __int128)ns * tsc_mult) >> 30);
+}
+
+uint64_t clock_ns(void) {
+    return clock_tsc_to_ns(rdtsc() - tsc_base);
+}
+
+uint64_t clock_us(void) {
+    return clock_ns() / 1000;
+}
+
+uint64_t clock_ms(void) {
+    return clock_ns() / 1000000;
+}
+
+uint64_t clock_tsc_hz(void) {
+    return tsc_hz;
+}
+
+const char *clock_source_name(void) {
+    return clock_source;
+}
+
+int clock_tsc_invariant(void) {
+    return tsc_invariant;
+}
+
+int64_t clock_wall_seconds(void) {
+    return boot_epoch + (int64_t)(clock_ns() / 1000000000ULL);
+}
+
+void clock_delay_us(uint64_t us) {
+    if (!tsc_hz) return;
+    uint64_t end = rdtsc() + us * (tsc_hz / 1000000);
+    while (rdtsc() < end) {
+        __asm__ volatile("pause");
+    }
+}
+
+void clock_delay_ms(uint64_t ms) {
+    clock_delay_us(ms * 1000);
+}
@@ -0,0 +1,41 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+// Monotonic clock built on the invariant TSC.
+// clock_init() calibrates the TSC against CPUID leaf 0x15, the HPET or the
+// PIT (in that order of preference) and reads the RTC for wall-clock time.
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+void clock_init(void);
+int clock_is_calibrated(void);
+
+// Time since clock_init()
+uint64_t clock_ns(void);
+uint64_t clock_us(void);
+uint64_t clock_ms(void);
+
+// Convert a TSC delta to nanoseconds
+uint64_t clock_tsc_to_ns(uint64_t ticks);
+
+// Absolute TSC value at which clock_ns() reaches 'ns' (for TSC-deadline)
+uint64_t clock_ns_to_tsc(uint64_t ns);
+
+uint64_t clock_tsc_hz(void);
+const char *clock_source_name(void);
+int clock_tsc_invariant(void);
+
+// Seconds since the UNIX epoch (RTC at boot plus elapsed monotonic time)
+int64_t clock_wall_seconds(void);
+
+// Busy-wait delays
+void clock_delay_us(uint64_t us);
+void clock_delay_ms(uint64_t ms);
+
+#endif
@@ -0,0 +1,192 @@
+/* hal/fpu.c */
+#include "../include/kernel.h"
+#include "../include/pmm.h"
+#include "fpu.h"
+#include "serial.h"
+#include "smp.h"
+
+/*
+ * FPU/SIMD state.
+ * The firmware leaves SSE usable but does not promise OSXSAVE or AVX, and
+ * nothing saved more than the legacy XMM registers. Here the enabled XCR0
+ * mask and save-area size are chosen once and exported to the IRQ stubs
+ * (fpu_xsave_enabled/fpu_xsave_mask/fpu_frame_size) and to the scheduler.
+ */
+
+#define CR0_MP              (1ULL << 1)
+#define CR0_EM              (1ULL << 2)
+#define CR0_TS              (1ULL << 3)
+#define CR0_NE              (1ULL << 5)
+#define CR4_OSFXSR          (1ULL << 9)
+#define CR4_OSXMMEXCPT      (1ULL << 10)
+#define CR4_OSXSAVE         (1ULL << 18)
+
+#define MXCSR_DEFAULT       0x1F80  // All exceptions masked, round to nearest
+#define FXSAVE_SIZE         512
+#define XSAVE_HEADER        512     // XSTATE_BV, XCOMP_BV, reserved
+
+// Read by the ISR_HANDLER stubs in idt_asm.S
+uint8_t fpu_xsave_enabled = 0;
+uint64_t fpu_xsave_mask = XCR0_X87 | XCR0_SSE;
+uint64_t fpu_frame_size = FXSAVE_SIZE + FPU_STATE_ALIGN;
+
+static uint32_t state_size = FXSAVE_SIZE;
+static int fpu_ready = 0;
+
+// Nested kernel_fpu_begin() saves; the BSP's slots exist before the PMM does
+static uint8_t bsp_nest_area[FPU_NEST_MAX * FPU_STATE_MAX] __attribute__((aligned(FPU_STATE_ALIGN)));
+static uint8_t *nest_area[SMP_MAX_CPUS];
+static int nest_depth[SMP_MAX_CPUS];
+static uint64_t nest_flags[SMP_MAX_CPUS][FPU_NEST_MAX];
+
+static inline void fpu_cpuid(uint32_t leaf, uint32_t sub, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    __asm__ volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(sub));
+}
+
+static inline void xsetbv(uint32_t reg, uint64_t value) {
+    __asm__ volatile("xsetbv" : : "c"(reg), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+// XCR0 components the CPU supports and whose save area fits FPU_STATE_MAX
+static void pick_components(void) {
+    uint32_t a, b, c, d;
+    fpu_cpuid(0, 0, &a, &b, &c, &d);
+    uint32_t max_leaf = a;
+
+    fpu_cpuid(1, 0, &a, &b, &c, &d);
+    if (!(c & (1u << 26)) || max_leaf < 0xD) return;    // No XSAVE
+
+    fpu_cpuid(0xD, 0, &a, &b, &c, &d);
+    uint64_t supported = ((uint64_t)d << 32) | a;
+
+    uint64_t mask = XCR0_X87 | XCR0_SSE;
+    if (supported & XCR0_AVX) mask |= XCR0_AVX;
+    if ((mask & XCR0_AVX) && (supported & XCR0_AVX512) == XCR0_AVX512) mask |= XCR0_AVX512;
+
+    fpu_xsave_mask = mask;
+    fpu_xsave_enabled = 1;
+}
+
+/* --- Per-CPU setup --- */
+
+void fpu_init_cpu(void) {
+    uint64_t cr0, cr4;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0));
+
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    if (fpu_xsave_enabled) cr4 |= CR4_OSXSAVE;
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4));
+
+    if (fpu_xsave_enabled) xsetbv(0, fpu_xsave_mask);
+
+    uint32_t mxcsr = MXCSR_DEFAULT;
+    __asm__ volatile("fninit; ldmxcsr %0" : : "m"(mxcsr));
+
+    int cpu = smp_this_cpu();
+    if (!nest_area[cpu]) {
+        nest_area[cpu] = cpu == 0 ? bsp_nest_area
+                                  : pmm_alloc_pages(pmm_order_for_size(FPU_NEST_MAX * FPU_STATE_MAX));
+    }
+}
+
+void fpu_init(void) {
+    if (fpu_ready) return;
+
+    pick_components();
+    fpu_init_cpu();
+
+    if (fpu_xsave_enabled) {
+        // With XCR0 written, EBX is the standard-form size for those components
+        uint32_t a, b, c, d;
+        fpu_cpuid(0xD, 0, &a, &b, &c, &d);
+        if (b > FPU_STATE_MAX && (fpu_xsave_mask & XCR0_AVX512)) {
+            fpu_xsave_mask &= ~XCR0_AVX512;
+            xsetbv(0, fpu_xsave_mask);
+            fpu_cpuid(0xD, 0, &a, &b, &c, &d);
+        }
+        state_size = b;
+    }
+    fpu_frame_size = ((state_size + FPU_STATE_ALIGN - 1) & ~(uint64_t)(FPU_STATE_ALIGN - 1)) + FPU_STATE_ALIGN;
+    fpu_ready = 1;
+
+    serial_write_string(fpu_xsave_enabled ? "[FPU] XSAVE, XCR0 " : "[FPU] FXSAVE, components ");
+    serial_write_hex(fpu_xsave_mask);
+    serial_write_string(", ");
+    serial_write_dec(state_size);
+    serial_write_string(" byte save area\n");
+}
+
+int fpu_has_xsave(void) {
+    return fpu_xsave_enabled;
+}
+
+uint64_t fpu_xcr0(void) {
+    return fpu_xsave_mask;
+}
+
+uint32_t fpu_state_size(void) {
+    return state_size;
+}
+
+/* --- Save/restore --- */
+
+void fpu_save(void *area) {
+    if (fpu_xsave_enabled) {
+        // XSAVE only updates the XSTATE_BV bits it saves and never touches
+        // XCOMP_BV/reserved bytes; standard-form XRSTOR faults on stale ones
+        uint64_t *header = (uint64_t *)((uint8_t *)area + XSAVE_HEADER);
+        header[0] = 0;
+        header[1] = 0;
+        header[2] = 0;
+        __asm__ volatile("xsave (%0)"
+                         : : "r"(area), "a"((uint32_t)fpu_xsave_mask), "d"((uint32_t)(fpu_xsave_mask >> 32))
+                         : "memory");
+    } else {
+        __asm__ volatile("fxsave (%0)" : : "r"(area) : "memory");
+    }
+}
+
+void fpu_restore(void *area) {
+    if (fpu_xsave_enabled) {
+        __asm__ volatile("xrstor (%0)"
+                         : : "r"(area), "a"((uint32_t)fpu_xsave_mask), "d"((uint32_t)(fpu_xsave_mask >> 32))
+                         : "memory");
+    } else {
+        __asm__ volatile("fxrstor (%0)" : : "r"(area) : "memory");
+    }
+}
+
+/* --- Kernel vector sections --- */
+
+// Interrupts stay off for the whole section so sections on one CPU can only
+// nest, never interleave
+void kernel_fpu_begin(void) {
+    uint64_t flags = irq_save();
+    int cpu = smp_this_cpu();
+    int depth = nest_depth[cpu];
+
+    if (depth < FPU_NEST_MAX && nest_area[cpu]) {
+        fpu_save(nest_area[cpu] + depth * FPU_STATE_MAX);
+    }
+    if (depth < FPU_NEST_MAX) nest_flags[cpu][depth] = flags;
+    nest_depth[cpu] = depth + 1;
+
+    uint32_t mxcsr = MXCSR_DEFAULT;
+    __asm__ volatile("fninit; ldmxcsr %0" : : "m"(mxcsr));
+}
+
+void kernel_fpu_end(void) {
+    int cpu = smp_this_cpu();
+    int depth = nest_depth[cpu] - 1;
+    if (depth < 0) return;
+
+    nest_depth[cpu] = depth;
+    if (depth < FPU_NEST_MAX) {
+        if (nest_area[cpu]) fpu_restore(nest_area[cpu] + depth * FPU_STATE_MAX);
+        irq_restore(nest_flags[cpu][depth]);
+    }
+}
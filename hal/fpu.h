@@ -0,0 +1,42 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <stdint.h>
+
+// x87/SSE/AVX state management.
+// fpu_init() turns on FXSR/XMM exceptions and, when the CPU has XSAVE, OSXSAVE
+// with every vector component that fits in FPU_STATE_MAX (x87, SSE, AVX and
+// AVX-512). IRQ stubs and thread switches then save the whole enabled state,
+// so interrupt handlers and threads may use any vector width.
+
+#define FPU_STATE_MAX       4096    // Largest save area we accept (bytes)
+#define FPU_STATE_ALIGN     64      // XSAVE requirement
+#define FPU_NEST_MAX        2       // kernel_fpu_begin() depth per CPU
+
+#define XCR0_X87            (1ULL << 0)
+#define XCR0_SSE            (1ULL << 1)
+#define XCR0_AVX            (1ULL << 2)
+#define XCR0_AVX512         (7ULL << 5)     // Opmask, ZMM_Hi256, Hi16_ZMM
+
+// Bootstrap processor: pick the state components, then set up this CPU
+void fpu_init(void);
+
+// Application processors: same CR0/CR4/XCR0 setup as the BSP
+void fpu_init_cpu(void);
+
+int fpu_has_xsave(void);
+uint64_t fpu_xcr0(void);
+uint32_t fpu_state_size(void);     // Bytes needed by fpu_save()
+
+// Save/restore every enabled component; 'area' must be FPU_STATE_ALIGN aligned
+void fpu_save(void *area);
+void fpu_restore(void *area);
+
+// Clean vector section: saves the current state, starts from default
+// x87/MXCSR control and restores everything on end. Needed where nothing
+// else preserves the state (exception handlers) or where code changes the
+// rounding mode/exception masks. Nests up to FPU_NEST_MAX deep per CPU.
+void kernel_fpu_begin(void);
+void kernel_fpu_end(void);
+
+#endif
@@ -6,4 +6,65 @@ extern void tss_flush();
 void init_gdt() {
     gdt_flush();
     tss_flush();
-}
\ No newline at end of file
+}
+
+/* --- Per-CPU GDT/TSS for application processors --- */
+
+// 64-bit TSS layout
+typedef struct {
+    uint32_t reserved0;
+    uint64_t rsp[3];
+    uint64_t reserved1;
+    uint64_t ist[7];
+    uint64_t reserved2;
+    uint16_t reserved3;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss64_t;
+
+// Same selectors as the boot GDT: 0x08 code, 0x10 data, 0x18 TSS
+typedef struct {
+    uint64_t entries[5];
+    tss64_t tss;
+    struct gdt_ptr ptr;
+} __attribute__((aligned(16))) cpu_gdt_t;
+
+static cpu_gdt_t cpu_gdts[GDT_MAX_CPUS];
+
+void gdt_init_cpu(int cpu, uint64_t ist_stack_top) {
+    if (cpu <= 0 || cpu >= GDT_MAX_CPUS) return;
+    cpu_gdt_t *g = &cpu_gdts[cpu];
+
+    g->entries[0] = 0;
+    g->entries[1] = 0x00af9a000000ffffULL;  // Kernel code (64-bit)
+    g->entries[2] = 0x00af92000000ffffULL;  // Kernel data
+
+    uint64_t base = (uint64_t)(uintptr_t)&g->tss;
+    uint64_t limit = sizeof(tss64_t) - 1;
+    g->entries[3] = (limit & 0xFFFF) | ((base & 0xFFFFFF) << 16) | (0x89ULL << 40) |
+                    (((base >> 24) & 0xFF) << 56);
+    g->entries[4] = base >> 32;
+
+    g->tss.rsp[0] = ist_stack_top;
+    g->tss.ist[0] = ist_stack_top;          // IST1: double fault / page fault
+    g->tss.iomap_base = sizeof(tss64_t);
+
+    g->ptr.limit = sizeof(g->entries) - 1;
+    g->ptr.base = (uint64_t)(uintptr_t)g->entries;
+
+    // Load it, reload CS through a far return, then the data segments and TSS.
+    // GS is left alone: its base holds the per-CPU pointer.
+    __asm__ volatile(
+        "lgdt (%0)\n"
+        "pushq $0x08\n"
+        "leaq 1f(%%rip), %%rax\n"
+        "pushq %%rax\n"
+        "lretq\n"
+        "1:\n"
+        "movw $0x10, %%ax\n"
+        "movw %%ax, %%ds\n"
+        "movw %%ax, %%es\n"
+        "movw %%ax, %%ss\n"
+        "movw $0x18, %%ax\n"
+        "ltr %%ax\n"
+        : : "r"(&g->ptr) : "rax", "memory");
+}
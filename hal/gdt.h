@@ -19,8 +19,13 @@ struct gdt_ptr {
     uint64_t base;
 } __attribute__((packed));
 
+#define GDT_MAX_CPUS 16
+
 // Function declarations
 void gdt_set_gate(int num, uint64_t base, uint64_t limit, uint8_t access, uint8_t gran);
 void init_gdt();
 
+// Give an application processor its own GDT and TSS (IST1 = ist_stack_top)
+void gdt_init_cpu(int cpu, uint64_t ist_stack_top);
+
 #endif
@@ -1,5 +1,12 @@
 /* hal/idt.c */
 #include "../include/kernel.h"
+#include "../include/metrics.h"
+#include "../include/prof.h"
+#include "../include/trace.h"
+#include "apic.h"
+#include "paging.h"
+#include "serial.h"
+#include "smp.h"
 
 typedef struct {
     uint16_t low; uint16_t sel; uint8_t ist; uint8_t attr;
@@ -12,10 +19,16 @@ static idt_entry_t idt[256];
 static idt_ptr_t idt_ptr;
 
 extern void load_idt(void* ptr);
+extern void isr_stub_timer(void);
+extern void isr_stub_lapic_timer(void);
 extern void isr_stub_keyboard(void);
 extern void isr_stub_mouse(void);
+extern void isr_stub_spurious(void);
+extern void isr_stub_ipi(void);
+extern uint64_t irq_stub_table[16];
 
 extern void isr_stub_double_fault(void);
+extern void isr_stub_page_fault(void);
 
 void handle_double_fault(void) {
     /* Set recovery flag in CMOS for bootloader detection */
@@ -28,17 +41,163 @@ void handle_double_fault(void) {
     }
 }
 
+/* PAGE FAULT: Runs on IST1 so a boot stack overflow can still be reported */
+void handle_page_fault(uint64_t addr, uint64_t error) {
+    serial_sync_mode(); // Nothing will drain the TX ring after this
+    serial_write_string(paging_is_guard_page(addr) ? "\n[PANIC] Kernel stack overflow (guard page hit)"
+                                                   : "\n[PANIC] Page fault");
+    serial_write_string(" at ");
+    serial_write_hex(addr);
+    serial_write_string(" error ");
+    serial_write_hex(error);
+    serial_write_string("\n");
+
+    /* Same recovery path as a double fault */
+    handle_double_fault();
+}
+
+/* Optional per-IRQ callbacks installed by drivers / the event loop */
+static irq_handler_t irq_handlers[16];
+
+void irq_set_handler(int irq, irq_handler_t handler) {
+    if (irq >= 0 && irq < 16) irq_handlers[irq] = handler;
+}
+
+/* Runs after every IRQ handler and its EOI (the scheduler preempts here) */
+static void (*irq_exit_hook)(void) = NULL;
+
+void irq_set_exit_hook(void (*hook)(void)) {
+    irq_exit_hook = hook;
+}
+
+void irq_return(void) {
+    if (irq_exit_hook) irq_exit_hook();
+}
+
+// Handlers run with interrupts off, so one slot per CPU is enough
+static isr_frame_t *irq_frames[SMP_MAX_CPUS];
+static int irq_depth[SMP_MAX_CPUS];
+
+int irq_in_interrupt(void) {
+    return irq_depth[smp_this_cpu()] > 0;
+}
+
+static inline void irq_enter(isr_frame_t *frame, int vector) {
+    int cpu = smp_this_cpu();
+    irq_frames[cpu] = frame;
+    irq_depth[cpu]++;
+    metric_inc(METRIC_IRQ(vector));
+}
+
+static inline void irq_leave(void) {
+    int cpu = smp_this_cpu();
+    irq_depth[cpu]--;
+    irq_frames[cpu] = NULL;
+}
+
+isr_frame_t *irq_frame(void) {
+    return irq_frames[smp_this_cpu()];
+}
+
+void irq_unmask(int irq) {
+    if (apic_is_enabled()) {
+        apic_irq_mask(irq, 0);
+        return;
+    }
+    uint16_t port = irq < 8 ? 0x21 : 0xA1;
+    outb(port, inb(port) & ~(1 << (irq & 7)));
+    if (irq >= 8) outb(0x21, inb(0x21) & ~(1 << 2)); // Cascade
+}
+
+void irq_mask(int irq) {
+    if (apic_is_enabled()) {
+        apic_irq_mask(irq, 1);
+        return;
+    }
+    uint16_t port = irq < 8 ? 0x21 : 0xA1;
+    outb(port, inb(port) | (1 << (irq & 7)));
+}
+
+/* One LAPIC register write once the IOAPIC routes IRQs, port I/O before */
+static void irq_eoi(int irq) {
+    if (apic_is_enabled()) {
+        apic_eoi();
+        return;
+    }
+    if (irq >= 8) outb(0xA0, 0x20); // Slave EOI
+    outb(0x20, 0x20);               // Master EOI
+}
+
+// Span names for handle_irq(); trace events keep the pointer, not a copy
+static const char *const irq_trace_names[16] = {
+    "irq0", "irq1", "irq2", "irq3", "irq4", "irq5", "irq6", "irq7",
+    "irq8", "irq9", "irq10", "irq11", "irq12", "irq13", "irq14", "irq15"
+};
+
+/* TIMER: One-shot wakeups (PIT IRQ 0 or the LAPIC timer vector) */
+static void timer_interrupt(isr_frame_t *frame, int vector) {
+    irq_enter(frame, vector);
+    TRACE_BEGIN("irq timer");
+    if (irq_handlers[0]) irq_handlers[0]();
+    irq_eoi(0);
+    TRACE_END("irq timer");
+    irq_leave();
+}
+
+void handle_timer_interrupt(isr_frame_t *frame) {
+    timer_interrupt(frame, APIC_VECTOR_IRQ_BASE + 0);
+}
+
+void handle_lapic_timer_interrupt(isr_frame_t *frame) {
+    timer_interrupt(frame, APIC_VECTOR_TIMER);
+}
+
 /* KEYBOARD: Handle via Interrupt (Good!) */
-void handle_keyboard_interrupt(void) {
-    uint8_t scancode = inb(0x60);
-    keyboard_handler_main(scancode);
-    outb(0x20, 0x20); // Master EOI
+void handle_keyboard_interrupt(isr_frame_t *frame) {
+    irq_enter(frame, APIC_VECTOR_IRQ_BASE + 1);
+    TRACE_BEGIN("irq keyboard");
+    if (irq_handlers[1]) {
+        irq_handlers[1]();
+    } else {
+        uint8_t scancode = inb(0x60);
+        keyboard_handler_main(scancode);
+    }
+    irq_eoi(1);
+    TRACE_END("irq keyboard");
+    irq_leave();
 }
 
-/* MOUSE: We will DISABLE this interrupt so Polling works */
-void handle_mouse_interrupt(void) {
-    outb(0xA0, 0x20); // Slave EOI
-    outb(0x20, 0x20); // Master EOI
+/* MOUSE: Masked unless the event loop takes over PS/2 input */
+void handle_mouse_interrupt(isr_frame_t *frame) {
+    irq_enter(frame, APIC_VECTOR_IRQ_BASE + 12);
+    TRACE_BEGIN("irq mouse");
+    if (irq_handlers[12]) irq_handlers[12]();
+    irq_eoi(12);
+    TRACE_END("irq mouse");
+    irq_leave();
+}
+
+/* IPI: the interrupt itself is the message (wakes a halted CPU); TLB
+ * shootdowns and the profiler's sampling of the application processors
+ * also come this way */
+void handle_ipi(isr_frame_t *frame) {
+    irq_enter(frame, APIC_VECTOR_IPI);
+    TRACE_BEGIN("ipi");
+    smp_tlb_check();
+    prof_ipi();
+    apic_eoi();
+    TRACE_END("ipi");
+    irq_leave();
+}
+
+/* Everything else (IDE, NIC, AC97...) goes through the handler table */
+void handle_irq(isr_frame_t *frame, int irq) {
+    irq_enter(frame, APIC_VECTOR_IRQ_BASE + irq);
+    TRACE_BEGIN(irq_trace_names[irq & 15]);
+    if (irq_handlers[irq]) irq_handlers[irq]();
+    irq_eoi(irq);
+    TRACE_END(irq_trace_names[irq & 15]);
+    irq_leave();
 }
 
 void set_idt_gate(int n, uint64_t handler) {
@@ -72,8 +231,16 @@ void init_idt(void) {
     /* 3. Set Gates - Validate addresses before setting */
     if (isr_stub_double_fault && isr_stub_keyboard && isr_stub_mouse) {
         set_idt_gate_ist(8, (uint64_t)isr_stub_double_fault, 1);  // Double fault uses IST1
-        set_idt_gate(0x21, (uint64_t)isr_stub_keyboard);
-        set_idt_gate(0x2C, (uint64_t)isr_stub_mouse);
+        set_idt_gate_ist(14, (uint64_t)isr_stub_page_fault, 1);   // Page fault too (stack guard)
+        for (int irq = 0; irq < 16; irq++) {
+            set_idt_gate(APIC_VECTOR_IRQ_BASE + irq, irq_stub_table[irq]);
+        }
+        set_idt_gate(APIC_VECTOR_IRQ_BASE + 0, (uint64_t)isr_stub_timer);
+        set_idt_gate(APIC_VECTOR_IRQ_BASE + 1, (uint64_t)isr_stub_keyboard);
+        set_idt_gate(APIC_VECTOR_IRQ_BASE + 12, (uint64_t)isr_stub_mouse);
+        set_idt_gate(APIC_VECTOR_TIMER, (uint64_t)isr_stub_lapic_timer);
+        set_idt_gate(APIC_VECTOR_SPURIOUS, (uint64_t)isr_stub_spurious);
+        set_idt_gate(APIC_VECTOR_IPI, (uint64_t)isr_stub_ipi);
     }
 
     /* 4. Load IDT */
@@ -99,4 +266,9 @@ void init_idt(void) {
     outb(0xA1, 0xFF); // Disable Mouse IRQ (Let Polling handle it)
 
     __asm__ volatile ("sti");
-}
\ No newline at end of file
+}
+
+/* Application processors share the BSP's IDT */
+void idt_load_cpu(void) {
+    load_idt(&idt_ptr);
+}
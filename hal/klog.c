@@ -0,0 +1,258 @@
+/* hal/klog.c */
+#include "../include/kernel.h"
+#include "../include/klog.h"
+#include "../include/pmm.h"
+#include "../include/string.h"
+#include "clock.h"
+#include "serial.h"
+#include "smp.h"
+
+/*
+ * Binary kernel log.
+ * Each CPU owns a ring of fixed-size records. A writer claims the next slot
+ * with interrupts off (the BSP ring is shared by its threads and IRQs), so a
+ * log call is a timestamp plus a handful of stores. Readers validate a copy
+ * with the record's sequence number, since writers overwrite the oldest
+ * record without waiting for anyone.
+ */
+
+#define RING_MASK       (KLOG_RING_RECORDS - 1)
+
+typedef struct {
+    volatile uint64_t head;         // Records ever written to this ring
+    klog_record_t *records;
+    uint64_t echoed;                // klogd: next record to echo
+} klog_ring_t;
+
+static klog_record_t bsp_records[KLOG_RING_RECORDS];
+static klog_ring_t rings[SMP_MAX_CPUS] = { [0] = { 0, bsp_records, 0 } };
+static volatile uint64_t dropped = 0;
+static int echo_level = KLOG_INFO;
+
+static const char *level_names[] = { "ERR", "WARN", "INFO", "DBG", "TRACE" };
+static const char *subsys_names[KLOG_NUM_SYS] = {
+    "core", "sched", "input", "video", "doom", "net", "audio", "storage"
+};
+
+/* --- Write side --- */
+
+void klog_write(int level, int subsys, const char *fmt, const uint64_t *args, int nargs) {
+    int cpu = smp_this_cpu();
+    klog_ring_t *ring = &rings[cpu];
+    if (!ring->records) {
+        __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (nargs > KLOG_MAX_ARGS) nargs = KLOG_MAX_ARGS;
+
+    uint64_t flags = irq_save();
+    uint64_t idx = ring->head;
+    klog_record_t *rec = &ring->records[idx & RING_MASK];
+
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    rec->time_ns = clock_ns();
+    rec->fmt = fmt;
+    rec->level = (uint8_t)level;
+    rec->subsys = (uint8_t)subsys;
+    rec->nargs = (uint8_t)nargs;
+    rec->cpu = (uint8_t)cpu;
+    for (int i = 0; i < nargs; i++) rec->args[i] = args[i];
+    __atomic_store_n(&rec->seq, idx + 1, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&ring->head, idx + 1, __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+/* --- Read side --- */
+
+// Copy record 'idx' out of a ring; 0 if it was overwritten or is incomplete
+static int ring_read(klog_ring_t *ring, uint64_t idx, klog_record_t *out) {
+    klog_record_t *rec = &ring->records[idx & RING_MASK];
+    if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != idx + 1) return 0;
+    *out = *rec;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&rec->seq, __ATOMIC_RELAXED) == idx + 1;
+}
+
+static uint64_t ring_oldest(klog_ring_t *ring, uint64_t head) {
+    return head > KLOG_RING_RECORDS ? head - KLOG_RING_RECORDS : 0;
+}
+
+int klog_snapshot(klog_record_t *out, int max) {
+    uint64_t cursor[SMP_MAX_CPUS], oldest[SMP_MAX_CPUS];
+    for (int c = 0; c < SMP_MAX_CPUS; c++) {
+        cursor[c] = rings[c].records ? __atomic_load_n(&rings[c].head, __ATOMIC_ACQUIRE) : 0;
+        oldest[c] = ring_oldest(&rings[c], cursor[c]);
+    }
+
+    // Merge backwards from the newest record of every CPU
+    int count = 0;
+    klog_record_t rec;
+    while (count < max) {
+        int best = -1;
+        uint64_t best_time = 0;
+        for (int c = 0; c < SMP_MAX_CPUS; c++) {
+            while (cursor[c] > oldest[c] && !ring_read(&rings[c], cursor[c] - 1, &rec)) cursor[c]--;
+            if (cursor[c] > oldest[c] && (best < 0 || rec.time_ns > best_time)) {
+                best = c;
+                best_time = rec.time_ns;
+            }
+        }
+        if (best < 0) break;
+        ring_read(&rings[best], --cursor[best], &out[max - 1 - count]);
+        count++;
+    }
+
+    // Newest were filled from the end; move them to the front
+    if (count < max) memmove(out, out + (max - count), count * sizeof(klog_record_t));
+    return count;
+}
+
+/* --- Formatting --- */
+
+static int put_char(char *out, size_t size, int len, char c) {
+    if ((size_t)len + 1 < size) out[len] = c;
+    return len + 1;
+}
+
+static int put_number(char *out, size_t size, int len, uint64_t value, int base,
+                      int width, char pad, int upper) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char buf[24];
+    int n = 0;
+    do {
+        buf[n++] = digits[value % base];
+        value /= base;
+    } while (value > 0);
+    while (width-- > n) len = put_char(out, size, len, pad);
+    while (n > 0) len = put_char(out, size, len, buf[--n]);
+    return len;
+}
+
+// printf subset over 64-bit args: %d %i %u %x %X %p %s %c %% with 0/width
+static int format_args(char *out, size_t size, int len, const char *fmt,
+                       const uint64_t *args, int nargs) {
+    int arg = 0;
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') {
+            len = put_char(out, size, len, *p);
+            continue;
+        }
+        p++;
+        char pad = ' ';
+        int width = 0;
+        if (*p == '0') {
+            pad = '0';
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') width = width * 10 + (*p++ - '0');
+        while (*p == 'l' || *p == 'z') p++;
+        if (!*p) break;
+
+        uint64_t value = (*p != '%' && arg < nargs) ? args[arg] : 0;
+        if (*p != '%') arg++;
+
+        switch (*p) {
+        case 'd': case 'i':
+            if ((int64_t)value < 0) {
+                len = put_char(out, size, len, '-');
+                value = -(int64_t)value;
+            }
+            len = put_number(out, size, len, value, 10, width, pad, 0);
+            break;
+        case 'u': len = put_number(out, size, len, value, 10, width, pad, 0); break;
+        case 'x': len = put_number(out, size, len, value, 16, width, pad, 0); break;
+        case 'X': len = put_number(out, size, len, value, 16, width, pad, 1); break;
+        case 'p':
+            len = put_char(out, size, len, '0');
+            len = put_char(out, size, len, 'x');
+            len = put_number(out, size, len, value, 16, 16, '0', 0);
+            break;
+        case 'c': len = put_char(out, size, len, (char)value); break;
+        case 's': {
+            const char *s = value ? (const char *)(uintptr_t)value : "(null)";
+            while (*s) len = put_char(out, size, len, *s++);
+            break;
+        }
+        default: len = put_char(out, size, len, *p); break;
+        }
+    }
+    return len;
+}
+
+int klog_format(const klog_record_t *rec, char *out, size_t size) {
+    if (size == 0) return 0;
+
+    uint64_t us = rec->time_ns / 1000;
+    int len = put_char(out, size, 0, '[');
+    len = put_number(out, size, len, us / 1000000, 10, 5, ' ', 0);
+    len = put_char(out, size, len, '.');
+    len = put_number(out, size, len, us % 1000000, 10, 6, '0', 0);
+    len = put_char(out, size, len, ']');
+    len = put_char(out, size, len, ' ');
+
+    if (rec->level <= KLOG_WARN) {
+        for (const char *s = level_names[rec->level]; *s; s++) len = put_char(out, size, len, *s);
+        len = put_char(out, size, len, ' ');
+    }
+    const char *sys = rec->subsys < KLOG_NUM_SYS ? subsys_names[rec->subsys] : "?";
+    while (*sys) len = put_char(out, size, len, *sys++);
+    len = put_char(out, size, len, ':');
+    len = put_char(out, size, len, ' ');
+
+    len = format_args(out, size, len, rec->fmt, rec->args, rec->nargs);
+    out[(size_t)len < size ? (size_t)len : size - 1] = 0;
+    return len;
+}
+
+/* --- Serial echo --- */
+
+// Echo new records in timestamp order across CPUs
+void klog_flush(void) {
+    char line[KLOG_LINE_LEN];
+    klog_record_t rec, next;
+
+    for (;;) {
+        int best = -1;
+        for (int c = 0; c < SMP_MAX_CPUS; c++) {
+            klog_ring_t *ring = &rings[c];
+            if (!ring->records) continue;
+            uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            if (ring->echoed < ring_oldest(ring, head)) ring->echoed = ring_oldest(ring, head);
+
+            // Skip records that were overwritten while being read
+            while (ring->echoed < head && !ring_read(ring, ring->echoed, &next)) ring->echoed++;
+            if (ring->echoed < head && (best < 0 || next.time_ns < rec.time_ns)) {
+                best = c;
+                rec = next;
+            }
+        }
+        if (best < 0) return;
+
+        rings[best].echoed++;
+        if (rec.level <= echo_level) {
+            klog_format(&rec, line, sizeof(line));
+            serial_write_string(line);
+            serial_write_string("\n");
+        }
+    }
+}
+
+void klog_init(void) {
+    for (int c = 1; c < smp_cpu_count() && c < SMP_MAX_CPUS; c++) {
+        if (rings[c].records) continue;
+        klog_record_t *records = pmm_alloc_pages(pmm_order_for_size(KLOG_RING_RECORDS * sizeof(klog_record_t)));
+        if (!records) break;
+        memset(records, 0, KLOG_RING_RECORDS * sizeof(klog_record_t));
+        rings[c].records = records;
+    }
+}
+
+void klog_set_echo_level(int level) {
+    echo_level = level;
+}
+
+uint64_t klog_dropped(void) {
+    return dropped;
+}
@@ -0,0 +1,104 @@
+/* hal/metrics.c */
+#include "../include/kernel.h"
+#include "../include/metrics.h"
+#include "smp.h"
+
+/*
+ * Metrics registry.
+ * Counter slots are indexed [cpu][metric], with every CPU's row aligned to a
+ * cache line. The add is a plain read-modify-write instruction, which an
+ * interrupt on the same CPU cannot split. The one exposure is a thread being
+ * migrated between looking up its CPU and the add, which at worst loses that
+ * single update.
+ */
+
+#define NUM_GAUGES  (METRIC_NUM - METRIC_NUM_COUNTERS)
+
+typedef struct {
+    uint64_t counters[METRIC_NUM_COUNTERS];
+} __attribute__((aligned(64))) metric_cpu_t;
+
+static metric_cpu_t cpu_counters[SMP_MAX_CPUS];
+static uint64_t gauges[NUM_GAUGES] __attribute__((aligned(64)));
+static void (*samplers[METRIC_MAX_SAMPLERS])(void);
+static int num_samplers = 0;
+
+static const char *const names[METRIC_NUM - METRIC_SERIAL_TX_DROPPED] = {
+    "serial tx dropped",
+    "net rx packets",
+    "net rx bytes",
+    "net tx packets",
+    "net tx bytes",
+    "audio underruns",
+    "ide sectors read",
+    "ide sectors written",
+    "doom frames",
+    "glyph cache hits",
+    "glyph cache misses",
+    "glyph cache evictions",
+    "heap total",
+    "heap used",
+    "heap free",
+    "heap frag",
+    "doom tic lag"
+};
+
+void metric_add(int id, uint64_t n) {
+    if (id < 0 || id >= METRIC_NUM_COUNTERS) return;
+    uint64_t *slot = &cpu_counters[smp_this_cpu()].counters[id];
+    __asm__ volatile("addq %1, %0" : "+m"(*slot) : "r"(n));
+}
+
+void metric_set(int id, uint64_t value) {
+    if (id < METRIC_NUM_COUNTERS || id >= METRIC_NUM) return;
+    __atomic_store_n(&gauges[id - METRIC_NUM_COUNTERS], value, __ATOMIC_RELAXED);
+}
+
+int metric_add_sampler(void (*fn)(void)) {
+    if (num_samplers >= METRIC_MAX_SAMPLERS) return -1;
+    samplers[num_samplers++] = fn;
+    return 0;
+}
+
+static void run_samplers(void) {
+    for (int i = 0; i < num_samplers; i++) samplers[i]();
+}
+
+uint64_t metric_read_cpu(int id, int cpu) {
+    if (id < 0 || id >= METRIC_NUM_COUNTERS || cpu < 0 || cpu >= SMP_MAX_CPUS) return 0;
+    return __atomic_load_n(&cpu_counters[cpu].counters[id], __ATOMIC_RELAXED);
+}
+
+uint64_t metric_read(int id) {
+    if (id >= METRIC_NUM_COUNTERS && id < METRIC_NUM) {
+        run_samplers();
+        return __atomic_load_n(&gauges[id - METRIC_NUM_COUNTERS], __ATOMIC_RELAXED);
+    }
+
+    uint64_t sum = 0;
+    for (int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        sum += metric_read_cpu(id, cpu);
+    }
+    return sum;
+}
+
+void metric_snapshot(uint64_t *out) {
+    for (int id = 0; id < METRIC_NUM_COUNTERS; id++) out[id] = 0;
+
+    // Row by row, so each CPU's lines are read once
+    for (int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        for (int id = 0; id < METRIC_NUM_COUNTERS; id++) {
+            out[id] += __atomic_load_n(&cpu_counters[cpu].counters[id], __ATOMIC_RELAXED);
+        }
+    }
+    run_samplers();
+    for (int i = 0; i < NUM_GAUGES; i++) {
+        out[METRIC_NUM_COUNTERS + i] = __atomic_load_n(&gauges[i], __ATOMIC_RELAXED);
+    }
+}
+
+const char *metric_name(int id) {
+    if (id >= METRIC_IRQ_BASE && id < METRIC_IRQ_BASE + METRIC_IRQ_VECTORS) return "irq";
+    if (id >= METRIC_SERIAL_TX_DROPPED && id < METRIC_NUM) return names[id - METRIC_SERIAL_TX_DROPPED];
+    return "?";
+}
@@ -0,0 +1,292 @@
+/* hal/paging.c */
+#include "../include/kernel.h"
+#include "../include/pmm.h"
+#include "../include/spinlock.h"
+#include "paging.h"
+#include "serial.h"
+#include "smp.h"
+
+/*
+ * Kernel page tables.
+ * Physical memory stays identity mapped exactly like the firmware left it,
+ * but with 1GB pages where the CPU supports them (2MB otherwise) and with
+ * explicit memory types through PAT: RAM write-back, MMIO uncached and the
+ * GOP framebuffer write-combining. Huge pages are only split where a range
+ * with a different type or a guard page needs it.
+ *
+ * After boot the tables still change (thread stack guard pages), possibly
+ * from a thread that gets preempted mid-split, so every walk that may
+ * create or split a table runs under paging_lock with interrupts off.
+ */
+
+#define PTE_PRESENT     (1ULL << 0)
+#define PTE_WRITE       (1ULL << 1)
+#define PTE_PWT         (1ULL << 3)
+#define PTE_PCD         (1ULL << 4)
+#define PTE_HUGE        (1ULL << 7)     // PS bit in PDPT/PD entries
+#define PTE_PAT_4K      (1ULL << 7)     // PAT bit in PT entries
+#define PTE_PAT_HUGE    (1ULL << 12)    // PAT bit in 2MB/1GB entries
+#define PTE_ADDR_MASK   0x000FFFFFFFFFF000ULL
+#define PTE_CACHE_MASK  (PTE_PWT | PTE_PCD)
+
+#define SIZE_4K         0x1000ULL
+#define SIZE_2M         0x200000ULL
+#define SIZE_1G         0x40000000ULL
+
+#define MSR_IA32_PAT    0x277
+
+/*
+ * PAT layout (index = PAT:PCD:PWT):
+ *   0 WB, 1 WT, 2 UC-, 3 UC, 4 WC, 5 WP, 6 UC-, 7 UC
+ * Entries 0-3 match the power-on default so firmware mappings keep
+ * their meaning until CR3 is switched.
+ */
+#define PAT_VALUE       0x0007050100070406ULL
+
+extern char stack_guard[];      // entry.S: page below the boot stack
+
+static uint64_t *pml4 = NULL;
+static int has_1g_pages = 0;
+static int has_pat = 0;
+static int paging_enabled = 0;
+static uint64_t guard_page = 0;
+static spinlock_t paging_lock = SPINLOCK_INIT;
+
+static inline void cpuid(uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    __asm__ volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline void write_cr3(uint64_t value) {
+    __asm__ volatile("mov %0, %%cr3" : : "r"(value) : "memory");
+}
+
+static inline void flush_tlb(void) {
+    if (paging_enabled) write_cr3((uint64_t)(uintptr_t)pml4);
+}
+
+// PTE bits selecting a PAT index; the PAT bit moves for huge pages
+static uint64_t cache_bits(int cache_type, int huge) {
+    uint64_t bits = 0;
+    if (cache_type & 1) bits |= PTE_PWT;
+    if (cache_type & 2) bits |= PTE_PCD;
+    if ((cache_type & 4) && has_pat) bits |= huge ? PTE_PAT_HUGE : PTE_PAT_4K;
+    return bits;
+}
+
+static uint64_t *alloc_table(void) {
+    uint64_t *table = pmm_alloc_pages(0);
+    if (!table) return NULL;
+    for (int i = 0; i < 512; i++) table[i] = 0;
+    return table;
+}
+
+// Replace a huge page entry with a table of the next smaller page size
+// that maps the same range with the same attributes.
+static uint64_t *split_entry(uint64_t *entry, uint64_t child_size) {
+    uint64_t old = *entry;
+    uint64_t *table = alloc_table();
+    if (!table) return NULL;
+
+    uint64_t base = old & PTE_ADDR_MASK & ~(child_size * 512 - 1);
+    uint64_t flags = old & (PTE_PRESENT | PTE_WRITE | PTE_CACHE_MASK);
+    uint64_t pat = old & PTE_PAT_HUGE;
+
+    for (int i = 0; i < 512; i++) {
+        if (child_size == SIZE_4K) {
+            table[i] = (base + i * child_size) | flags | (pat ? PTE_PAT_4K : 0);
+        } else {
+            table[i] = (base + i * child_size) | flags | pat | PTE_HUGE;
+        }
+    }
+
+    *entry = (uint64_t)(uintptr_t)table | PTE_PRESENT | PTE_WRITE;
+    return table;
+}
+
+// Return the next-level table behind an entry, creating or splitting it
+static uint64_t *next_table(uint64_t *entry, uint64_t child_size) {
+    if (!(*entry & PTE_PRESENT)) {
+        uint64_t *table = alloc_table();
+        if (!table) return NULL;
+        *entry = (uint64_t)(uintptr_t)table | PTE_PRESENT | PTE_WRITE;
+        return table;
+    }
+    if (*entry & PTE_HUGE) {
+        return split_entry(entry, child_size);
+    }
+    return (uint64_t *)(uintptr_t)(*entry & PTE_ADDR_MASK);
+}
+
+// Find the entry mapping 'addr' at the level whose pages are 'page_size'
+static uint64_t *walk(uint64_t addr, uint64_t page_size) {
+    uint64_t *pdpt = next_table(&pml4[(addr >> 39) & 0x1FF], SIZE_1G);
+    if (!pdpt) return NULL;
+    uint64_t *entry = &pdpt[(addr >> 30) & 0x1FF];
+    if (page_size == SIZE_1G) return entry;
+
+    uint64_t *pd = next_table(entry, SIZE_2M);
+    if (!pd) return NULL;
+    entry = &pd[(addr >> 21) & 0x1FF];
+    if (page_size == SIZE_2M) return entry;
+
+    uint64_t *pt = next_table(entry, SIZE_4K);
+    if (!pt) return NULL;
+    return &pt[(addr >> 12) & 0x1FF];
+}
+
+static int map_range(uint64_t phys, uint64_t size, int cache_type) {
+    uint64_t addr = phys & ~(SIZE_4K - 1);
+    uint64_t end = (phys + size + SIZE_4K - 1) & ~(SIZE_4K - 1);
+
+    while (addr < end) {
+        uint64_t page_size = SIZE_4K;
+        if (has_1g_pages && !(addr & (SIZE_1G - 1)) && end - addr >= SIZE_1G) {
+            page_size = SIZE_1G;
+        } else if (!(addr & (SIZE_2M - 1)) && end - addr >= SIZE_2M) {
+            page_size = SIZE_2M;
+        }
+
+        uint64_t *entry = walk(addr, page_size);
+        if (!entry) return -1; // Out of memory for page tables
+
+        uint64_t huge = (page_size != SIZE_4K);
+        *entry = addr | PTE_PRESENT | PTE_WRITE | (huge ? PTE_HUGE : 0) | cache_bits(cache_type, huge);
+        addr += page_size;
+    }
+    return 0;
+}
+
+// Program the PAT following the SDM sequence: caches off and flushed
+static void pat_init(void) {
+    uint64_t cr0;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    __asm__ volatile("mov %0, %%cr0" : : "r"((cr0 | (1ULL << 30)) & ~(1ULL << 29)) : "memory");
+    __asm__ volatile("wbinvd" : : : "memory");
+
+    wrmsr(MSR_IA32_PAT, PAT_VALUE);
+
+    __asm__ volatile("wbinvd" : : : "memory");
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
+}
+
+void paging_init(BootInfo *info) {
+    if (paging_enabled) return;
+    if (!pmm_is_initialized()) {
+        serial_write_string("[PAGING] No physical allocator, keeping firmware page tables\n");
+        return;
+    }
+
+    uint32_t a, b, c, d;
+    cpuid(1, &a, &b, &c, &d);
+    has_pat = (d >> 16) & 1;
+    cpuid(0x80000000, &a, &b, &c, &d);
+    if (a >= 0x80000001) {
+        cpuid(0x80000001, &a, &b, &c, &d);
+        has_1g_pages = (d >> 26) & 1;
+    }
+
+    pml4 = alloc_table();
+    if (!pml4) return;
+
+    // Everything up to the end of the memory map (at least 4GB) starts as WB.
+    // Holes keep the memory type the firmware's MTRRs give them.
+    uint64_t top = 0x100000000ULL;
+    uint8_t *map = (uint8_t *)info->memory_map;
+    size_t count = info->memory_map_desc_size ? info->memory_map_size / info->memory_map_desc_size : 0;
+    for (size_t i = 0; i < count; i++) {
+        efi_memory_descriptor_t *desc = (efi_memory_descriptor_t *)(map + i * info->memory_map_desc_size);
+        uint64_t end = desc->physical_start + (desc->number_of_pages << PMM_PAGE_SHIFT);
+        if (end > top) top = end;
+    }
+
+    uint64_t fb_base = (uint64_t)(uintptr_t)info->framebuffer;
+    uint64_t fb_size = (uint64_t)info->pitch * info->height * sizeof(uint32_t);
+    if (fb_base + fb_size > top) top = fb_base + fb_size;
+    top = (top + SIZE_1G - 1) & ~(SIZE_1G - 1);
+
+    if (map_range(0, top, PAGE_CACHE_WB) != 0) {
+        serial_write_string("[PAGING] Out of memory building page tables\n");
+        return;
+    }
+
+    // Device registers: firmware-reported MMIO plus the IOAPIC/HPET/LAPIC window
+    for (size_t i = 0; i < count; i++) {
+        efi_memory_descriptor_t *desc = (efi_memory_descriptor_t *)(map + i * info->memory_map_desc_size);
+        if (desc->type == EFI_MEMORY_MAPPED_IO || desc->type == EFI_MEMORY_MAPPED_IO + 1) {
+            map_range(desc->physical_start, desc->number_of_pages << PMM_PAGE_SHIFT, PAGE_CACHE_UC);
+        }
+    }
+    map_range(0xFEC00000ULL, 0x01400000ULL, PAGE_CACHE_UC);
+
+    if (fb_base && fb_size) {
+        map_range(fb_base, fb_size, has_pat ? PAGE_CACHE_WC : PAGE_CACHE_WB);
+    }
+
+    // Unmapped page under the boot stack turns an overflow into a #PF
+    guard_page = (uint64_t)(uintptr_t)stack_guard;
+    uint64_t *guard = walk(guard_page, SIZE_4K);
+    if (guard) *guard = 0;
+
+    if (has_pat) pat_init();
+
+    write_cr3((uint64_t)(uintptr_t)pml4);
+    paging_enabled = 1;
+
+    serial_write_string("[PAGING] Identity mapped up to ");
+    serial_write_hex(top);
+    serial_write_string(has_1g_pages ? " with 1GB pages" : " with 2MB pages");
+    serial_write_string(has_pat ? ", framebuffer WC\n" : ", no PAT\n");
+    serial_write_string("[PAGING] Stack guard page at ");
+    serial_write_hex(guard_page);
+    serial_write_string("\n");
+}
+
+// Application processors load the same CR3 from the SMP trampoline but
+// every CPU has its own PAT MSR
+void paging_init_cpu(void) {
+    if (paging_enabled && has_pat) pat_init();
+}
+
+uint64_t paging_root(void) {
+    return (uint64_t)(uintptr_t)pml4;
+}
+
+int paging_is_enabled(void) {
+    return paging_enabled;
+}
+
+int paging_map_range(uint64_t phys, uint64_t size, int cache_type) {
+    if (!paging_enabled) return -1;
+    uint64_t flags = spin_lock_irqsave(&paging_lock);
+    int result = map_range(phys, size, cache_type);
+    flush_tlb();
+    spin_unlock_irqrestore(&paging_lock, flags);
+    smp_tlb_shootdown();
+    return result;
+}
+
+int paging_map_mmio(uint64_t phys, uint64_t size) {
+    return paging_map_range(phys, size, PAGE_CACHE_UC);
+}
+
+int paging_unmap_page(uint64_t addr) {
+    if (!paging_enabled) return -1;
+    uint64_t flags = spin_lock_irqsave(&paging_lock);
+    uint64_t *entry = walk(addr & ~(SIZE_4K - 1), SIZE_4K);
+    if (entry) {
+        *entry = 0;
+        __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+    }
+    spin_unlock_irqrestore(&paging_lock, flags);
+    if (!entry) return -1;
+    smp_tlb_shootdown();
+    return 0;
+}
+
+int paging_is_guard_page(uint64_t addr) {
+    return guard_page && addr >= guard_page && addr < guard_page + SIZE_4K;
+}
@@ -0,0 +1,36 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <stdint.h>
+#include "../include/kernel.h"
+
+// Memory types, numbered by their PAT index as programmed in paging_init()
+#define PAGE_CACHE_WB       0   // Write-back (normal RAM)
+#define PAGE_CACHE_WT       1   // Write-through
+#define PAGE_CACHE_UC_MINUS 2   // Uncached, MTRR may override to WC
+#define PAGE_CACHE_UC       3   // Strong uncached (MMIO registers)
+#define PAGE_CACHE_WC       4   // Write-combining (framebuffers)
+
+// Build the kernel's own identity-mapped page tables and switch CR3 to them.
+// Needs the physical allocator, so call it after pmm_init().
+void paging_init(BootInfo *info);
+int paging_is_enabled(void);
+
+// Per-CPU setup for application processors, and the shared PML4
+void paging_init_cpu(void);
+uint64_t paging_root(void);
+
+// Identity map [phys, phys + size) with the given memory type, using the
+// largest pages that fit. Existing huge pages are split at the edges.
+int paging_map_range(uint64_t phys, uint64_t size, int cache_type);
+
+// Convenience wrapper for device registers
+int paging_map_mmio(uint64_t phys, uint64_t size);
+
+// Remove a single 4KB page (used for stack guard pages)
+int paging_unmap_page(uint64_t addr);
+
+// True if addr lies in a guard page installed by paging_init()
+int paging_is_guard_page(uint64_t addr);
+
+#endif
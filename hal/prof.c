@@ -0,0 +1,208 @@
+/* hal/prof.c */
+#include "../include/kernel.h"
+#include "../include/pmm.h"
+#include "../include/prof.h"
+#include "serial.h"
+#include "smp.h"
+#include "timer.h"
+
+/*
+ * Statistical profiler.
+ * The BSP's one-shot timer carries a sampler (timer_set_sampler) that reads
+ * the interrupted frame through irq_frame() and walks saved RBPs (the kernel
+ * is built without -fomit-frame-pointer). Every other CPU gets an IPI per
+ * tick and samples itself from handle_ipi. The walk only follows frame
+ * pointers that stay on the interrupted stack, so a bogus RBP ends the
+ * backtrace instead of faulting.
+ */
+
+#define PROF_FRAME_MAX      (64 * 1024)     // Largest step between saved RBPs
+#define PROF_MIN_HZ         10
+#define PROF_MAX_HZ         10000
+
+static prof_sample_t *buffers[SMP_MAX_CPUS];
+static volatile uint32_t counts[SMP_MAX_CPUS];
+static volatile uint8_t pending[SMP_MAX_CPUS];
+static volatile uint64_t dropped = 0;
+static volatile int running = 0;
+static int sample_hz = PROF_DEFAULT_HZ;
+
+/* --- Sampling --- */
+
+static void record_sample(int cpu, isr_frame_t *frame) {
+    if (!frame || !buffers[cpu]) return;
+    uint32_t n = counts[cpu];
+    if (n >= PROF_SAMPLES) {
+        __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    prof_sample_t *s = &buffers[cpu][n];
+    int depth = 0;
+    s->pc[depth++] = frame->rip;
+
+    uint64_t sp = frame->rsp;
+    uint64_t rbp = frame->rbp;
+    while (depth < PROF_MAX_DEPTH) {
+        if ((rbp & 7) || rbp < sp || rbp - sp > PROF_FRAME_MAX) break;
+        uint64_t *fp = (uint64_t *)(uintptr_t)rbp;
+        if (!fp[1]) break;
+        s->pc[depth++] = fp[1];     // Return address
+        sp = rbp + 16;
+        rbp = fp[0];
+    }
+    while (depth < PROF_MAX_DEPTH) s->pc[depth++] = 0;
+
+    counts[cpu] = n + 1;
+}
+
+// Timer sampler on the BSP
+static void prof_tick(void) {
+    record_sample(smp_this_cpu(), irq_frame());
+
+    for (int i = 1; i < SMP_MAX_CPUS; i++) {
+        percpu_t *cpu = smp_cpu(i);
+        if (!cpu || !cpu->online || !buffers[i]) continue;
+        pending[i] = 1;
+        smp_wake(i);
+    }
+}
+
+void prof_ipi(void) {
+    int cpu = smp_this_cpu();
+    if (!pending[cpu]) return;
+    pending[cpu] = 0;
+    record_sample(cpu, irq_frame());
+}
+
+/* --- Control --- */
+
+int prof_start(int hz) {
+    if (running) return 0;
+    if (hz < PROF_MIN_HZ) hz = PROF_MIN_HZ;
+    if (hz > PROF_MAX_HZ) hz = PROF_MAX_HZ;
+
+    for (int i = 0; i < SMP_MAX_CPUS; i++) {
+        percpu_t *cpu = smp_cpu(i);
+        if (i > 0 && (!cpu || !cpu->online)) continue;
+        if (!buffers[i]) buffers[i] = pmm_alloc_pages(pmm_order_for_size(PROF_SAMPLES * sizeof(prof_sample_t)));
+        counts[i] = 0;
+        pending[i] = 0;
+    }
+    if (!buffers[0]) return -1;
+
+    dropped = 0;
+    sample_hz = hz;
+    running = 1;
+    if (timer_set_sampler(prof_tick, 1000000000ULL / hz) != 0) {
+        running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void prof_stop(void) {
+    if (!running) return;
+    timer_set_sampler(NULL, 0);
+    running = 0;
+}
+
+int prof_is_running(void) {
+    return running;
+}
+
+uint64_t prof_sample_count(void) {
+    uint64_t total = 0;
+    for (int i = 0; i < SMP_MAX_CPUS; i++) total += counts[i];
+    return total;
+}
+
+uint64_t prof_dropped(void) {
+    return dropped;
+}
+
+/* --- Folded dump --- */
+
+static int sample_cmp(const prof_sample_t *a, const prof_sample_t *b) {
+    for (int i = 0; i < PROF_MAX_DEPTH; i++) {
+        if (a->pc[i] != b->pc[i]) return a->pc[i] < b->pc[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+static void sample_swap(prof_sample_t *a, prof_sample_t *b) {
+    prof_sample_t t = *a;
+    *a = *b;
+    *b = t;
+}
+
+static void sift_down(prof_sample_t *s, uint32_t root, uint32_t n) {
+    for (;;) {
+        uint32_t child = root * 2 + 1;
+        if (child >= n) return;
+        if (child + 1 < n && sample_cmp(&s[child], &s[child + 1]) < 0) child++;
+        if (sample_cmp(&s[root], &s[child]) >= 0) return;
+        sample_swap(&s[root], &s[child]);
+        root = child;
+    }
+}
+
+// In-place heapsort so equal stacks end up adjacent (no allocation)
+static void sort_samples(prof_sample_t *s, uint32_t n) {
+    if (n < 2) return;
+    for (uint32_t i = n / 2; i-- > 0;) sift_down(s, i, n);
+    for (uint32_t end = n - 1; end > 0; end--) {
+        sample_swap(&s[0], &s[end]);
+        sift_down(s, 0, end);
+    }
+}
+
+int prof_dump(void) {
+    // Stop sampling while the buffers are sorted, and let serial block
+    int was_running = running;
+    prof_stop();
+    int policy = serial_set_overflow_policy(SERIAL_TX_WAIT);
+
+    serial_write_string("\n# prof begin hz=");
+    serial_write_dec(sample_hz);
+    serial_write_string(" samples=");
+    serial_write_dec(prof_sample_count());
+    serial_write_string(" dropped=");
+    serial_write_dec(dropped);
+    serial_write_string("\n");
+
+    // One line per distinct stack: "<cpu> <count> <leaf pc> <return addrs...>"
+    int stacks = 0;
+    for (int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        prof_sample_t *s = buffers[cpu];
+        uint32_t n = counts[cpu];
+        if (!s || n == 0) continue;
+        sort_samples(s, n);
+
+        for (uint32_t i = 0; i < n;) {
+            uint32_t run = 1;
+            while (i + run < n && sample_cmp(&s[i], &s[i + run]) == 0) run++;
+
+            serial_write_dec(cpu);
+            serial_write_char(' ');
+            serial_write_dec(run);
+            for (int d = 0; d < PROF_MAX_DEPTH && s[i].pc[d]; d++) {
+                serial_write_char(' ');
+                serial_write_hex(s[i].pc[d]);
+            }
+            serial_write_char('\n');
+            stacks++;
+            i += run;
+        }
+    }
+
+    serial_write_string("# prof end\n");
+    serial_set_overflow_policy(policy);
+
+    // Resuming keeps appending to the (now sorted) buffers
+    if (was_running) {
+        running = 1;
+        if (timer_set_sampler(prof_tick, 1000000000ULL / sample_hz) != 0) running = 0;
+    }
+    return stacks;
+}
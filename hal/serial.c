@@ -1,8 +1,43 @@
 #include "serial.h"
 #include "../include/kernel.h"
+#include "../include/metrics.h"
+#include "../include/spinlock.h"
+#include "smp.h"
 
 // COM1 serial port base address
 #define SERIAL_PORT 0x3F8
+#define SERIAL_IRQ  4
+
+#define UART_IER    1   // Interrupt enable
+#define UART_IIR    2   // Interrupt identification (read)
+#define UART_LSR    5   // Line status
+#define UART_MSR    6   // Modem status
+
+#define IER_THRE    0x02
+#define LSR_THRE    0x20
+#define UART_FIFO   16  // Bytes the TX FIFO takes once THRE is set
+
+#define TX_TAKEOVER_SPINS   (1 << 20)   // Without a byte sent, before serial_sync_mode() forces the lock
+
+/*
+ * Buffered transmit.
+ * Writers reserve space in tx_ring with a CAS on tx_reserve, copy their bytes
+ * and publish them in reservation order through tx_commit. The THRE interrupt
+ * moves committed bytes into the UART FIFO, 16 at a time. Until
+ * serial_enable_irq() (and after serial_sync_mode()) every byte is polled out
+ * directly as before.
+ */
+#define TX_MASK     (SERIAL_TX_RING_SIZE - 1)
+
+static char tx_ring[SERIAL_TX_RING_SIZE];
+static volatile uint32_t tx_reserve = 0;    // Next byte a writer may claim
+static volatile uint32_t tx_commit = 0;     // Bytes before this are complete
+static volatile uint32_t tx_tail = 0;       // Next byte to hand to the UART
+static volatile int tx_armed = 0;           // THRE interrupt enabled
+static int tx_irq_mode = 0;
+static int tx_policy = SERIAL_TX_OVERFLOW_DEFAULT;
+static spinlock_t tx_drain_lock = SPINLOCK_INIT;
+static volatile int tx_drain_owner = -1;    // CPU holding tx_drain_lock
 
 void serial_init(void) {
     // Disable interrupts
@@ -41,17 +76,208 @@ void serial_init(void) {
 }
 
 static int serial_is_transmit_empty() {
-    return inb(SERIAL_PORT + 5) & 0x20;
+    return inb(SERIAL_PORT + UART_LSR) & LSR_THRE;
 }
 
-void serial_write_char(char c) {
+static void serial_put_polled(char c) {
     while (!serial_is_transmit_empty());
     outb(SERIAL_PORT, c);
 }
 
+/* --- Consumer side --- */
+
+// Hand up to one FIFO's worth of committed bytes to the UART (THR empty)
+static void tx_fill_fifo(void) {
+    uint32_t tail = tx_tail;
+    uint32_t commit = __atomic_load_n(&tx_commit, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < UART_FIFO && tail != commit; i++) {
+        outb(SERIAL_PORT, tx_ring[tail & TX_MASK]);
+        tail++;
+    }
+    __atomic_store_n(&tx_tail, tail, __ATOMIC_RELEASE);
+}
+
+// THRE fires when the FIFO runs dry; keep it enabled only while bytes remain
+static void tx_kick(void) {
+    if (!__atomic_exchange_n(&tx_armed, 1, __ATOMIC_ACQ_REL)) {
+        outb(SERIAL_PORT + UART_IER, IER_THRE);
+    }
+}
+
+static void serial_irq(void) {
+    if (!spin_trylock(&tx_drain_lock)) return;
+    tx_drain_owner = smp_this_cpu();
+
+    // Edge-triggered line: service every pending cause until IIR reads idle
+    uint8_t iir;
+    while (!((iir = inb(SERIAL_PORT + UART_IIR)) & 0x01)) {
+        switch (iir & 0x0E) {
+        case 0x02: tx_fill_fifo(); break;                   // THR empty
+        case 0x06: inb(SERIAL_PORT + UART_LSR); break;      // Line status
+        case 0x04: case 0x0C: inb(SERIAL_PORT); break;      // RX data
+        default: inb(SERIAL_PORT + UART_MSR); break;        // Modem status
+        }
+    }
+
+    if (__atomic_load_n(&tx_commit, __ATOMIC_ACQUIRE) == tx_tail) {
+        __atomic_store_n(&tx_armed, 0, __ATOMIC_RELEASE);
+        outb(SERIAL_PORT + UART_IER, 0x00);
+        // A writer may have committed after the check above
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&tx_commit, __ATOMIC_ACQUIRE) != tx_tail) tx_kick();
+    }
+    tx_drain_owner = -1;
+    spin_unlock(&tx_drain_lock);
+}
+
+// Poll committed bytes out directly; the caller holds tx_drain_lock
+static void tx_drain_locked(void) {
+    uint32_t commit = __atomic_load_n(&tx_commit, __ATOMIC_ACQUIRE);
+    uint32_t tail = tx_tail;
+    while (tail != commit) {
+        serial_put_polled(tx_ring[tail & TX_MASK]);
+        tail++;
+        __atomic_store_n(&tx_tail, tail, __ATOMIC_RELEASE);     // Progress, for serial_sync_mode()
+    }
+}
+
+// Full ring with the wait policy
+static void tx_drain_polled(void) {
+    spin_lock(&tx_drain_lock);
+    tx_drain_owner = smp_this_cpu();
+    tx_drain_locked();
+    tx_drain_owner = -1;
+    spin_unlock(&tx_drain_lock);
+}
+
+/* --- Producer side --- */
+
+// Queue as much of 'str' as fits; returns the number of bytes queued
+static uint32_t tx_put(const char *str, uint32_t len) {
+    // IRQs off so a handler on this CPU cannot wait on our commit
+    uint64_t flags = irq_save();
+
+    uint32_t start, n;
+    for (;;) {
+        start = __atomic_load_n(&tx_reserve, __ATOMIC_RELAXED);
+        uint32_t room = SERIAL_TX_RING_SIZE - (start - __atomic_load_n(&tx_tail, __ATOMIC_ACQUIRE));
+        n = len < room ? len : room;
+        if (n == 0) break;
+        if (__atomic_compare_exchange_n(&tx_reserve, &start, start + n, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
+    }
+
+    if (n > 0) {
+        for (uint32_t i = 0; i < n; i++) tx_ring[(start + i) & TX_MASK] = str[i];
+        // Earlier reservations (other CPUs) publish first
+        while (__atomic_load_n(&tx_commit, __ATOMIC_ACQUIRE) != start) cpu_relax();
+        __atomic_store_n(&tx_commit, start + n, __ATOMIC_RELEASE);
+    }
+
+    irq_restore(flags);
+    if (n > 0) tx_kick();
+    return n;
+}
+
+static void serial_write(const char *str, uint32_t len) {
+    if (!tx_irq_mode) {
+        for (uint32_t i = 0; i < len; i++) serial_put_polled(str[i]);
+        return;
+    }
+
+    while (len > 0) {
+        uint32_t n = tx_put(str, len);
+        str += n;
+        len -= n;
+        if (len == 0) break;
+
+        if (tx_policy == SERIAL_TX_DROP) {
+            metric_add(METRIC_SERIAL_TX_DROPPED, len);
+            return;
+        }
+        tx_drain_polled();
+    }
+}
+
+/* --- Public API --- */
+
+void serial_write_char(char c) {
+    serial_write(&c, 1);
+}
+
 void serial_write_string(const char *str) {
-    while (*str) {
-        serial_write_char(*str);
-        str++;
+    uint32_t len = 0;
+    while (str[len]) len++;
+    serial_write(str, len);
+}
+
+void serial_write_dec(uint64_t value) {
+    char buf[20];
+    int n = 0;
+    do {
+        buf[n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0) serial_write_char(buf[--n]);
+}
+
+void serial_write_hex(uint64_t value) {
+    const char *digits = "0123456789ABCDEF";
+    char buf[16];
+    int n = 0;
+    do {
+        buf[n++] = digits[value & 0xF];
+        value >>= 4;
+    } while (value > 0);
+    serial_write_string("0x");
+    while (n > 0) serial_write_char(buf[--n]);
+}
+
+void serial_enable_irq(void) {
+    if (tx_irq_mode) return;
+    irq_set_handler(SERIAL_IRQ, serial_irq);
+    irq_unmask(SERIAL_IRQ);
+    tx_irq_mode = 1;
+}
+
+void serial_sync_mode(void) {
+    tx_irq_mode = 0;
+    outb(SERIAL_PORT + UART_IER, 0x00);
+
+    // A drain this CPU interrupted will never finish, so its lock is taken
+    // over as is. One on another CPU is waited for while it keeps sending;
+    // the lock is only forced once it stalls, in case that CPU is wedged.
+    int cpu = smp_this_cpu();
+    if (tx_drain_owner != cpu || !__atomic_load_n(&tx_drain_lock.locked, __ATOMIC_ACQUIRE)) {
+        uint32_t seen = __atomic_load_n(&tx_tail, __ATOMIC_ACQUIRE);
+        uint32_t spins = 0;
+        while (!spin_trylock(&tx_drain_lock)) {
+            uint32_t tail = __atomic_load_n(&tx_tail, __ATOMIC_ACQUIRE);
+            if (tail != seen) {
+                seen = tail;
+                spins = 0;
+            } else if (++spins >= TX_TAKEOVER_SPINS) {
+                break;
+            }
+            cpu_relax();
+        }
     }
+    tx_drain_owner = cpu;
+    tx_drain_locked();
+    tx_drain_owner = -1;
+    spin_unlock(&tx_drain_lock);
+}
+
+int serial_set_overflow_policy(int policy) {
+    int previous = tx_policy;
+    tx_policy = policy;
+    return previous;
+}
+
+uint64_t serial_tx_dropped(void) {
+    return metric_read(METRIC_SERIAL_TX_DROPPED);
+}
+
+uint32_t serial_tx_pending(void) {
+    return __atomic_load_n(&tx_commit, __ATOMIC_ACQUIRE) - __atomic_load_n(&tx_tail, __ATOMIC_ACQUIRE);
 }
@@ -4,8 +4,33 @@
 #include <stdint.h>
 
 // Serial port I/O functions
+// After serial_enable_irq() writes go into a lock-free TX ring drained by
+// the UART's transmit-empty interrupt, so writers never wait on the line.
+
+#define SERIAL_TX_RING_SIZE     16384   // Power of two
+
+// What a writer does when the ring is full
+#define SERIAL_TX_DROP          0       // Drop the rest of the write and count it
+#define SERIAL_TX_WAIT          1       // Poll bytes out until there is room
+
+#ifndef SERIAL_TX_OVERFLOW_DEFAULT
+#define SERIAL_TX_OVERFLOW_DEFAULT  SERIAL_TX_DROP
+#endif
+
 void serial_init(void);
 void serial_write_char(char c);
 void serial_write_string(const char *str);
+void serial_write_dec(uint64_t value);
+void serial_write_hex(uint64_t value);  // "0x" and the significant digits
+
+// Switch to the buffered, interrupt-driven transmit path (IRQ 4)
+void serial_enable_irq(void);
+
+// Flush the ring by polling and write synchronously from now on (panics)
+void serial_sync_mode(void);
+
+int serial_set_overflow_policy(int policy);     // Returns the previous one
+uint64_t serial_tx_dropped(void);   // Bytes lost to a full ring
+uint32_t serial_tx_pending(void);   // Bytes queued, not yet sent
 
 #endif
@@ -0,0 +1,279 @@
+/* hal/smp.c */
+#include "../include/kernel.h"
+#include "../include/pmm.h"
+#include "../include/spinlock.h"
+#include "../include/string.h"
+#include "apic.h"
+#include "clock.h"
+#include "fpu.h"
+#include "paging.h"
+#include "serial.h"
+#include "smp.h"
+
+/*
+ * Application processor startup.
+ * APs are started one at a time through a shared real-mode trampoline: INIT,
+ * 10ms, SIPI, and a second SIPI only if the first did not take. Once in C,
+ * each AP loads its own GDT/TSS, the shared IDT, the same FPU/XSAVE setup
+ * as the BSP and PAT, then idles in hlt until smp_call() hands it work.
+ *
+ * TLB shootdown: every page table change bumps a generation number and
+ * IPIs the other online CPUs, which reload CR3 and record the generation
+ * they have flushed up to. The kernel maps nothing global, so the reload
+ * drops every translation.
+ */
+
+extern uint8_t smp_trampoline_start[], smp_trampoline_end[];
+extern uint8_t tramp_gdtr[], tramp_gdt[], tramp_pm_jump[], tramp_pm32[];
+extern uint8_t tramp_lm_jump[], tramp_lm64[];
+extern uint8_t tramp_efer[], tramp_cr3[], tramp_stack[], tramp_arg[], tramp_entry[];
+
+#define TRAMP_OFFSET(sym)   ((uintptr_t)(sym) - (uintptr_t)smp_trampoline_start)
+#define TRAMP_FIELD(base, type, sym) (*(type *)((base) + TRAMP_OFFSET(sym)))
+
+#define MSR_EFER            0xC0000080
+#define MSR_GS_BASE         0xC0000101
+#define EFER_LME            (1ULL << 8)
+#define EFER_LMA            (1ULL << 10)
+
+#define ICR_INIT            0x00004500  // INIT, level assert
+#define ICR_STARTUP         0x00004600  // SIPI, vector = page number
+
+static percpu_t cpus[SMP_MAX_CPUS];
+static volatile int work_pending[SMP_MAX_CPUS];
+static int cpu_slots = 0;
+static volatile int cpus_online = 0;
+static int smp_ready = 0;
+
+static volatile uint64_t tlb_generation = 0;
+static volatile uint64_t tlb_flushed[SMP_MAX_CPUS];
+static spinlock_t tlb_lock = SPINLOCK_INIT;
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/* --- AP side --- */
+
+static void ap_idle_loop(percpu_t *cpu) {
+    for (;;) {
+        __asm__ volatile("cli");
+        void (*fn)(void *) = cpu->work_fn;
+        if (fn) {
+            void *arg = cpu->work_arg;
+            cpu->work_fn = NULL;
+            __asm__ volatile("sti");
+            fn(arg);
+            cpu->work_done++;
+            __atomic_store_n(&work_pending[cpu->index], 0, __ATOMIC_RELEASE);
+            continue;
+        }
+        __asm__ volatile("sti; hlt");   // An IPI ends the halt
+    }
+}
+
+static void ap_main(percpu_t *cpu) {
+    gdt_init_cpu(cpu->index, (uint64_t)(uintptr_t)(cpu->ist_stack + PMM_PAGE_SIZE));
+    wrmsr(MSR_GS_BASE, (uint64_t)(uintptr_t)cpu);
+    idt_load_cpu();
+    fpu_init_cpu();
+    paging_init_cpu();
+    apic_init_cpu();
+
+    cpu->started_ns = clock_ns();
+    __atomic_add_fetch(&cpus_online, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&cpu->online, 1, __ATOMIC_RELEASE);
+
+    ap_idle_loop(cpu);
+}
+
+/* --- BSP side --- */
+
+// Two free pages below 1MB: trampoline code, then the low PML4 copy
+static uint64_t find_trampoline_pages(BootInfo *info) {
+    uint8_t *map = (uint8_t *)info->memory_map;
+    size_t count = info->memory_map_desc_size ? info->memory_map_size / info->memory_map_desc_size : 0;
+
+    for (size_t i = 0; i < count; i++) {
+        efi_memory_descriptor_t *desc = (efi_memory_descriptor_t *)(map + i * info->memory_map_desc_size);
+        if (desc->type != EFI_CONVENTIONAL_MEMORY && desc->type != EFI_BOOT_SERVICES_CODE &&
+            desc->type != EFI_BOOT_SERVICES_DATA) continue;
+
+        uint64_t start = desc->physical_start < 0x1000 ? 0x1000 : desc->physical_start;
+        uint64_t end = desc->physical_start + (desc->number_of_pages << PMM_PAGE_SHIFT);
+        if (end > 0xA0000) end = 0xA0000;
+        if (start + 2 * PMM_PAGE_SIZE <= end) return start;
+    }
+    return 0;
+}
+
+static void setup_trampoline(uint8_t *base) {
+    uint64_t cr3 = paging_root();
+    if (!cr3) __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+
+    memcpy(base, smp_trampoline_start, smp_trampoline_end - smp_trampoline_start);
+    memcpy(base + PMM_PAGE_SIZE, (void *)(uintptr_t)(cr3 & ~0xFFFULL), PMM_PAGE_SIZE);
+
+    uint32_t linear = (uint32_t)(uintptr_t)base;
+    TRAMP_FIELD(base, uint32_t, tramp_gdtr + 2) = linear + TRAMP_OFFSET(tramp_gdt);
+    TRAMP_FIELD(base, uint32_t, tramp_pm_jump) = linear + TRAMP_OFFSET(tramp_pm32);
+    TRAMP_FIELD(base, uint32_t, tramp_lm_jump) = linear + TRAMP_OFFSET(tramp_lm64);
+    TRAMP_FIELD(base, uint64_t, tramp_efer) = (rdmsr(MSR_EFER) & ~EFER_LMA) | EFER_LME;
+    TRAMP_FIELD(base, uint64_t, tramp_cr3) = cr3;
+    TRAMP_FIELD(base, uint64_t, tramp_entry) = (uint64_t)(uintptr_t)ap_main;
+}
+
+static int wait_online(percpu_t *cpu, uint64_t us) {
+    uint64_t end = clock_ns() + us * 1000;
+    while (clock_ns() < end) {
+        if (__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE)) return 1;
+        __asm__ volatile("pause");
+    }
+    return cpu->online;
+}
+
+static int start_ap(percpu_t *cpu, uint8_t *tramp) {
+    cpu->stack = pmm_alloc_pages(pmm_order_for_size(SMP_STACK_SIZE));
+    cpu->ist_stack = pmm_alloc_pages(0);
+    if (!cpu->stack || !cpu->ist_stack) return 0;
+
+    TRAMP_FIELD(tramp, uint64_t, tramp_stack) = (uint64_t)(uintptr_t)(cpu->stack + SMP_STACK_SIZE);
+    TRAMP_FIELD(tramp, uint64_t, tramp_arg) = (uint64_t)(uintptr_t)cpu;
+
+    uint32_t vector = (uint32_t)((uintptr_t)tramp >> 12);
+    apic_send_ipi(cpu->lapic_id, ICR_INIT);
+    clock_delay_ms(10);
+
+    apic_send_ipi(cpu->lapic_id, ICR_STARTUP | vector);
+    if (wait_online(cpu, 200)) return 1;
+    apic_send_ipi(cpu->lapic_id, ICR_STARTUP | vector);
+    return wait_online(cpu, 100000);
+}
+
+int smp_init(BootInfo *info) {
+    if (smp_ready) return cpus_online;
+
+    percpu_t *bsp = &cpus[0];
+    bsp->self = bsp;
+    bsp->index = 0;
+    bsp->lapic_id = apic_is_enabled() ? apic_lapic_id() : 0;
+    bsp->online = 1;
+    bsp->started_ns = clock_ns();
+    wrmsr(MSR_GS_BASE, (uint64_t)(uintptr_t)bsp);
+    cpu_slots = 1;
+    cpus_online = 1;
+    smp_ready = 1;
+
+    uint64_t tramp_phys = info ? find_trampoline_pages(info) : 0;
+    if (!apic_is_enabled() || apic_cpu_count() <= 1 || !tramp_phys) {
+        serial_write_string("[SMP] Running on the bootstrap processor only\n");
+        return cpus_online;
+    }
+
+    uint8_t *tramp = (uint8_t *)(uintptr_t)tramp_phys;
+    setup_trampoline(tramp);
+
+    for (int i = 0; i < apic_cpu_count() && cpu_slots < SMP_MAX_CPUS; i++) {
+        uint32_t id = apic_cpu_lapic_id(i);
+        if (id == bsp->lapic_id) continue;
+
+        percpu_t *cpu = &cpus[cpu_slots];
+        cpu->self = cpu;
+        cpu->index = cpu_slots;
+        cpu->lapic_id = id;
+
+        serial_write_string("[SMP] CPU ");
+        serial_write_dec(cpu->index);
+        serial_write_string(" (LAPIC ");
+        serial_write_dec(id);
+        if (start_ap(cpu, tramp)) {
+            serial_write_string(") online\n");
+            cpu_slots++;
+        } else {
+            serial_write_string(") did not respond\n");
+            if (cpu->stack) pmm_free_pages(cpu->stack, pmm_order_for_size(SMP_STACK_SIZE));
+            if (cpu->ist_stack) pmm_free_pages(cpu->ist_stack, 0);
+            memset(cpu, 0, sizeof(*cpu));
+        }
+    }
+
+    serial_write_string("[SMP] ");
+    serial_write_dec(cpus_online);
+    serial_write_string(" CPU(s) online\n");
+    return cpus_online;
+}
+
+int smp_cpu_count(void) {
+    return smp_ready ? cpus_online : 1;
+}
+
+percpu_t *smp_cpu(int index) {
+    return index >= 0 && index < cpu_slots ? &cpus[index] : NULL;
+}
+
+int smp_this_cpu(void) {
+    return smp_ready ? this_cpu()->index : 0;
+}
+
+int smp_call(int index, void (*fn)(void *), void *arg) {
+    if (index <= 0 || index >= cpu_slots || !cpus[index].online) return -1;
+
+    int expected = 0;
+    if (!__atomic_compare_exchange_n(&work_pending[index], &expected, 1, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return -1;
+    }
+    cpus[index].work_arg = arg;
+    __atomic_store_n(&cpus[index].work_fn, fn, __ATOMIC_RELEASE);
+    smp_wake(index);
+    return 0;
+}
+
+void smp_wake(int index) {
+    if (index < 0 || index >= cpu_slots || index == smp_this_cpu()) return;
+    apic_send_ipi(cpus[index].lapic_id, APIC_VECTOR_IPI);
+}
+
+void smp_tlb_check(void) {
+    if (!smp_ready) return;
+    int index = this_cpu()->index;
+    uint64_t generation = __atomic_load_n(&tlb_generation, __ATOMIC_ACQUIRE);
+    if (tlb_flushed[index] == generation) return;
+
+    uint64_t cr3;
+    __asm__ volatile("mov %%cr3, %0; mov %0, %%cr3" : "=r"(cr3) : : "memory");
+    __atomic_store_n(&tlb_flushed[index], generation, __ATOMIC_RELEASE);
+}
+
+void smp_tlb_shootdown(void) {
+    if (!smp_ready || cpus_online <= 1) return;
+
+    // Interrupts stay off while waiting, so a CPU that wants the lock keeps
+    // answering the current holder's shootdown itself
+    uint64_t flags = irq_save();
+    while (!spin_trylock(&tlb_lock)) {
+        smp_tlb_check();
+        cpu_relax();
+    }
+
+    int self = this_cpu()->index;
+    uint64_t generation = __atomic_add_fetch(&tlb_generation, 1, __ATOMIC_ACQ_REL);
+    tlb_flushed[self] = generation;             // The caller flushed already
+
+    for (int i = 0; i < cpu_slots; i++) {
+        if (i != self && cpus[i].online) apic_send_ipi(cpus[i].lapic_id, APIC_VECTOR_IPI);
+    }
+    for (int i = 0; i < cpu_slots; i++) {
+        if (i == self || !cpus[i].online) continue;
+        while (__atomic_load_n(&tlb_flushed[i], __ATOMIC_ACQUIRE) < generation) cpu_relax();
+    }
+
+    spin_unlock(&tlb_lock);
+    irq_restore(flags);
+}
@@ -0,0 +1,55 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include "../include/kernel.h"
+#include "gdt.h"
+
+// Application processor bring-up and per-CPU data.
+// smp_init() starts every enabled CPU in the MADT with INIT-SIPI-SIPI. Each
+// CPU's GS base points at its percpu_t, so this_cpu() is a single load.
+
+#define SMP_MAX_CPUS        GDT_MAX_CPUS
+#define SMP_STACK_SIZE      (16 * 1024)
+
+typedef struct percpu {
+    struct percpu *self;            // Must stay first (read through %gs:0)
+    int index;                      // 0 = bootstrap processor
+    uint32_t lapic_id;
+    volatile int online;
+    uint8_t *stack;                 // Base of the kernel stack allocation
+    uint8_t *ist_stack;             // Double/page fault stack
+    uint64_t started_ns;            // clock_ns() when the CPU came online
+    void (*volatile work_fn)(void *);   // Pending smp_call() request
+    void *volatile work_arg;
+    volatile uint64_t work_done;    // Completed smp_call() requests
+    void *user;                     // Free slot for subsystems (job queues...)
+} percpu_t;
+
+static inline percpu_t *this_cpu(void) {
+    percpu_t *cpu;
+    __asm__ volatile("movq %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+// Start the application processors; returns the number of online CPUs
+int smp_init(BootInfo *info);
+
+int smp_cpu_count(void);            // Online CPUs, including the BSP
+percpu_t *smp_cpu(int index);
+int smp_this_cpu(void);             // Index of the calling CPU (0 before init)
+
+// Run fn(arg) on another CPU's idle loop; returns -1 if it is busy/offline
+int smp_call(int index, void (*fn)(void *), void *arg);
+
+// Wake a halted CPU so it rechecks for work
+void smp_wake(int index);
+
+// After changing page tables (and flushing the local TLB): make every other
+// online CPU flush its TLB, and wait until they all have
+void smp_tlb_shootdown(void);
+
+// IPI handler side of smp_tlb_shootdown()
+void smp_tlb_check(void);
+
+#endif
@@ -0,0 +1,204 @@
+/* hal/timer.c */
+#include "../include/kernel.h"
+#include "apic.h"
+#include "clock.h"
+#include "timer.h"
+
+/*
+ * Tickless one-shot timer.
+ * With the local APIC up it uses TSC-deadline mode when the CPU has it (the
+ * deadline is an absolute TSC value, so no conversion drift) and a
+ * calibrated one-shot count otherwise. Before that, PIT channel 0 in mode 0
+ * (interrupt on terminal count) stands in. Nothing ticks periodically; an
+ * interrupt only happens when someone is waiting for a deadline, or while a
+ * sampler (the profiler) asks for one every period on top of it.
+ */
+
+#define PIT_HZ          1193182
+#define PIT_MIN_NS      50000ULL        // Shorter waits are not worth a halt
+#define PIT_MAX_NS      50000000ULL     // 16-bit counter tops out near 55ms
+
+#define MSR_IA32_TSC_DEADLINE   0x6E0
+#define LVT_MODE_ONESHOT        (0 << 17)
+#define LVT_MODE_TSC_DEADLINE   (2 << 17)
+#define LVT_MASKED              (1 << 16)
+#define LAPIC_DIVIDE_16         0x3
+
+typedef enum { TIMER_NONE, TIMER_PIT, TIMER_LAPIC, TIMER_TSC_DEADLINE } timer_mode_t;
+
+static void (*timer_callback)(void) = NULL;
+static timer_mode_t timer_mode = TIMER_NONE;
+static uint64_t lapic_timer_hz = 0;
+
+// The caller's deadline and the sampler's share the one hardware timer
+static uint64_t requested_ns = UINT64_MAX;
+static void (*sampler)(void) = NULL;
+static uint64_t sample_period_ns = 0;
+static uint64_t sample_next_ns = UINT64_MAX;
+
+static void timer_program(uint64_t deadline_ns);
+static void timer_stop(void);
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static void timer_irq(void) {
+    if (sampler) {
+        uint64_t now = clock_ns();
+        if (now >= sample_next_ns) {
+            sampler();
+            sample_next_ns = now + sample_period_ns;
+        }
+        if (now < requested_ns) {
+            // Only the sampler was due; the caller's deadline still stands
+            timer_program(requested_ns < sample_next_ns ? requested_ns : sample_next_ns);
+            return;
+        }
+    }
+
+    requested_ns = UINT64_MAX;
+    if (timer_callback) timer_callback();
+    if (sampler && requested_ns == UINT64_MAX) timer_program(sample_next_ns);
+}
+
+static int cpu_has_tsc_deadline(void) {
+    uint32_t a, b, c, d;
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(1), "c"(0));
+    return (c >> 24) & 1;
+}
+
+// Count LAPIC timer ticks (divide by 16) across 10ms of TSC time
+static uint64_t calibrate_lapic_timer(void) {
+    apic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+    apic_write(LAPIC_REG_LVT_TIMER, LVT_MASKED | APIC_VECTOR_TIMER);
+    apic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFF);
+    clock_delay_us(10000);
+    uint32_t elapsed = 0xFFFFFFFF - apic_read(LAPIC_REG_TIMER_CURRENT);
+    apic_write(LAPIC_REG_TIMER_INIT, 0);
+    return (uint64_t)elapsed * 100;
+}
+
+void timer_oneshot_init(void (*callback)(void)) {
+    timer_callback = callback;
+    irq_set_handler(0, timer_irq);
+
+    if (apic_is_enabled() && clock_is_calibrated()) {
+        if (cpu_has_tsc_deadline()) {
+            timer_mode = TIMER_TSC_DEADLINE;
+            apic_write(LAPIC_REG_LVT_TIMER, LVT_MODE_TSC_DEADLINE | APIC_VECTOR_TIMER);
+        } else {
+            lapic_timer_hz = calibrate_lapic_timer();
+            timer_mode = TIMER_LAPIC;
+            apic_write(LAPIC_REG_LVT_TIMER, LVT_MODE_ONESHOT | APIC_VECTOR_TIMER);
+        }
+        timer_disarm();
+        irq_mask(0); // The PIT stays quiet from here on
+        return;
+    }
+
+    timer_mode = TIMER_PIT;
+    timer_disarm();
+    irq_unmask(0);
+}
+
+static void timer_program(uint64_t deadline_ns) {
+    if (timer_mode == TIMER_TSC_DEADLINE) {
+        // A deadline already in the past fires immediately
+        wrmsr(MSR_IA32_TSC_DEADLINE, clock_ns_to_tsc(deadline_ns));
+        return;
+    }
+
+    uint64_t now = clock_ns();
+    uint64_t delta = deadline_ns > now ? deadline_ns - now : 0;
+
+    if (timer_mode == TIMER_LAPIC) {
+        uint64_t count = delta * (lapic_timer_hz / 1000) / 1000000ULL;
+        if (count < 1) count = 1;
+        if (count > 0xFFFFFFFF) count = 0xFFFFFFFF;
+        apic_write(LAPIC_REG_TIMER_INIT, (uint32_t)count);
+        return;
+    }
+
+    if (delta < PIT_MIN_NS) delta = PIT_MIN_NS;
+    if (delta > PIT_MAX_NS) delta = PIT_MAX_NS;
+
+    uint32_t count = (uint32_t)(delta * PIT_HZ / 1000000000ULL);
+    if (count < 1) count = 1;
+    if (count > 0xFFFF) count = 0xFFFF;
+
+    outb(0x43, 0x30);                   // Channel 0, lobyte/hibyte, mode 0
+    outb(0x40, count & 0xFF);
+    outb(0x40, count >> 8);
+}
+
+static void timer_stop(void) {
+    if (timer_mode == TIMER_TSC_DEADLINE) {
+        wrmsr(MSR_IA32_TSC_DEADLINE, 0);
+    } else if (timer_mode == TIMER_LAPIC) {
+        apic_write(LAPIC_REG_TIMER_INIT, 0);
+    } else {
+        // Mode 0 holds its output high after terminal count, so a command
+        // without a reload leaves the channel idle until the next arm.
+        outb(0x43, 0x30);
+    }
+}
+
+void timer_arm(uint64_t deadline_ns) {
+    requested_ns = deadline_ns;
+    timer_program(sampler && sample_next_ns < deadline_ns ? sample_next_ns : deadline_ns);
+}
+
+void timer_disarm(void) {
+    requested_ns = UINT64_MAX;
+    if (sampler) {
+        timer_program(sample_next_ns);
+    } else {
+        timer_stop();
+    }
+}
+
+int timer_set_sampler(void (*fn)(void), uint64_t period_ns) {
+    if (timer_mode == TIMER_NONE) return -1;
+
+    uint64_t flags = irq_save();
+    sampler = period_ns ? fn : NULL;
+    sample_period_ns = period_ns;
+    sample_next_ns = sampler ? clock_ns() + period_ns : UINT64_MAX;
+
+    if (requested_ns != UINT64_MAX || sampler) {
+        timer_program(requested_ns < sample_next_ns ? requested_ns : sample_next_ns);
+    } else {
+        timer_stop();
+    }
+    irq_restore(flags);
+    return 0;
+}
+
+void timer_sleep_until(uint64_t deadline_ns) {
+    uint64_t rflags;
+    __asm__ volatile("pushfq; popq %0" : "=r"(rflags));
+
+    // Without a wakeup source (or with IRQs off) a halt could last forever
+    if (timer_mode == TIMER_NONE || !(rflags & 0x200)) {
+        while (clock_ns() < deadline_ns) __asm__ volatile("pause");
+        return;
+    }
+
+    for (;;) {
+        timer_arm(deadline_ns);
+        __asm__ volatile("cli");
+        if (clock_ns() >= deadline_ns) break;
+        __asm__ volatile("sti; hlt");
+    }
+    __asm__ volatile("sti");
+}
+
+const char *timer_source_name(void) {
+    switch (timer_mode) {
+    case TIMER_TSC_DEADLINE: return "lapic tsc-deadline";
+    case TIMER_LAPIC:        return "lapic one-shot";
+    case TIMER_PIT:          return "pit";
+    default:                 return "none";
+    }
+}
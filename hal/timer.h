@@ -0,0 +1,23 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// Tickless one-shot timer (LAPIC TSC-deadline, LAPIC one-shot or the PIT).
+// timer_arm() schedules a single IRQ 0 at (or shortly after) an absolute
+// clock_ns() deadline; the installed callback runs from the interrupt.
+// Call timer_oneshot_init() after apic_init() to get the LAPIC backend.
+
+void timer_oneshot_init(void (*callback)(void));
+void timer_arm(uint64_t deadline_ns);
+void timer_disarm(void);
+
+// Also call 'fn' from the timer interrupt every period_ns (0 stops it).
+// The caller's own deadlines keep working alongside. -1 before init.
+int timer_set_sampler(void (*fn)(void), uint64_t period_ns);
+
+// Halt until clock_ns() reaches the deadline (busy-waits before init)
+void timer_sleep_until(uint64_t deadline_ns);
+const char *timer_source_name(void);
+
+#endif
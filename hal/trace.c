@@ -0,0 +1,225 @@
+/* hal/trace.c */
+#include "../include/kernel.h"
+#include "../include/pmm.h"
+#include "../include/trace.h"
+#include "clock.h"
+#include "serial.h"
+#include "smp.h"
+
+/*
+ * TSC trace rings.
+ * Each CPU appends to its own ring with interrupts off, so a trace point
+ * costs an rdtsc and a few stores and never touches a shared cache line.
+ * Timestamps stay raw TSC until trace_dump() converts them against the
+ * calibrated clock, which also puts them on the same time base as klog.
+ */
+
+#define RING_MASK       (TRACE_RING_EVENTS - 1)
+
+typedef struct {
+    volatile uint64_t head;         // Events ever written to this ring
+    trace_event_t *events;
+} trace_ring_t;
+
+static trace_event_t bsp_events[TRACE_RING_EVENTS];
+static trace_ring_t rings[SMP_MAX_CPUS] = { [0] = { 0, bsp_events } };
+static volatile int running = 1;
+
+// Thread on each CPU, and the names seen so far for the export (by id)
+static int16_t cpu_tid[SMP_MAX_CPUS] = { [0 ... SMP_MAX_CPUS - 1] = -1 };
+static struct {
+    int tid;
+    char name[TRACE_NAME_LEN];
+} thread_names[TRACE_MAX_THREADS];
+
+/* --- Recording --- */
+
+void trace_event(const char *name, int phase, int64_t value) {
+    if (!__atomic_load_n(&running, __ATOMIC_RELAXED)) return;
+
+    int cpu = smp_this_cpu();
+    trace_ring_t *ring = &rings[cpu];
+    if (!ring->events) return;
+
+    uint64_t flags = irq_save();
+    trace_event_t *ev = &ring->events[ring->head & RING_MASK];
+    ev->tsc = rdtsc();
+    ev->name = name;
+    ev->value = value;
+    ev->phase = (uint8_t)phase;
+    ev->cpu = (uint8_t)cpu;
+    ev->tid = cpu_tid[cpu];
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+void trace_thread_switch(int tid, const char *name) {
+    cpu_tid[smp_this_cpu()] = (int16_t)tid;
+
+    // Copied, since the thread (and its name) may be gone by dump time
+    int slot = tid & (TRACE_MAX_THREADS - 1);
+    if (thread_names[slot].tid != tid || !thread_names[slot].name[0]) {
+        thread_names[slot].tid = tid;
+        int i = 0;
+        for (; name && name[i] && i < TRACE_NAME_LEN - 1; i++) thread_names[slot].name[i] = name[i];
+        thread_names[slot].name[i] = '\0';
+    }
+}
+
+void trace_init(void) {
+    for (int i = 1; i < smp_cpu_count() && i < SMP_MAX_CPUS; i++) {
+        if (rings[i].events) continue;
+        rings[i].events = pmm_alloc_pages(pmm_order_for_size(TRACE_RING_EVENTS * sizeof(trace_event_t)));
+    }
+}
+
+void trace_start(void) {
+    __atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+}
+
+void trace_stop(void) {
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+}
+
+int trace_is_running(void) {
+    return running;
+}
+
+void trace_clear(void) {
+    int was_running = running;
+    trace_stop();
+    for (int c = 0; c < SMP_MAX_CPUS; c++) __atomic_store_n(&rings[c].head, 0, __ATOMIC_RELEASE);
+    if (was_running) trace_start();
+}
+
+uint64_t trace_events_recorded(void) {
+    uint64_t total = 0;
+    for (int c = 0; c < SMP_MAX_CPUS; c++) total += rings[c].head;
+    return total;
+}
+
+/* --- Chrome trace-event export --- */
+
+// Events outside any thread (boot, AP job workers) get one track per CPU
+#define CPU_TRACK_TID   1000
+
+typedef struct {
+    char buf[256];
+    int len;
+    int lines;
+} json_line_t;
+
+static void json_char(json_line_t *line, char c) {
+    if (line->len < (int)sizeof(line->buf) - 1) line->buf[line->len++] = c;
+}
+
+static void json_str(json_line_t *line, const char *s) {
+    while (*s) json_char(line, *s++);
+}
+
+static void json_dec(json_line_t *line, uint64_t value, int min_digits) {
+    char tmp[24];
+    int n = 0;
+    do {
+        tmp[n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0 || n < min_digits);
+    while (n > 0) json_char(line, tmp[--n]);
+}
+
+// Names are literals, but keep the output valid JSON whatever they contain
+static void json_name(json_line_t *line, const char *name) {
+    json_char(line, '"');
+    for (const char *p = name ? name : "?"; *p; p++) {
+        if (*p == '"' || *p == '\\') json_char(line, '\\');
+        json_char(line, (*p >= 0x20) ? *p : '?');
+    }
+    json_char(line, '"');
+}
+
+// Start the next array element
+static void json_begin(json_line_t *line) {
+    json_str(line, line->lines++ ? ",\n{" : "{");
+}
+
+static void json_flush(json_line_t *line) {
+    line->buf[line->len] = '\0';
+    serial_write_string(line->buf);
+    line->len = 0;
+}
+
+static void json_track_name(json_line_t *line, int tid, const char *name, int cpu) {
+    json_begin(line);
+    json_str(line, "\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":");
+    json_dec(line, tid, 1);
+    json_str(line, ",\"args\":{\"name\":");
+    if (name) {
+        json_name(line, name);
+    } else {
+        json_str(line, "\"CPU ");
+        json_dec(line, cpu, 1);
+        json_char(line, '"');
+    }
+    json_str(line, "}}");
+    json_flush(line);
+}
+
+int trace_dump(void) {
+    // Freeze the rings, and let serial block rather than drop the export
+    int was_running = running;
+    trace_stop();
+    int policy = serial_set_overflow_policy(SERIAL_TX_WAIT);
+
+    // Map raw TSC onto clock_ns(): ns = now_ns - (now_tsc - tsc) in ns
+    uint64_t now_tsc = rdtsc();
+    uint64_t now_ns = clock_ns();
+
+    json_line_t line = { .len = 0, .lines = 0 };
+    serial_write_string("\n{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        if (thread_names[i].name[0]) json_track_name(&line, thread_names[i].tid, thread_names[i].name, 0);
+    }
+
+    int count = 0;
+    for (int c = 0; c < SMP_MAX_CPUS; c++) {
+        trace_ring_t *ring = &rings[c];
+        if (!ring->events) continue;
+
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        if (head > first) json_track_name(&line, CPU_TRACK_TID + c, NULL, c);
+
+        for (uint64_t i = first; i < head; i++) {
+            trace_event_t *ev = &ring->events[i & RING_MASK];
+            uint64_t age = ev->tsc < now_tsc ? clock_tsc_to_ns(now_tsc - ev->tsc) : 0;
+            uint64_t ns = now_ns > age ? now_ns - age : 0;
+
+            json_begin(&line);
+            json_str(&line, "\"name\":");
+            json_name(&line, ev->name);
+            json_str(&line, ",\"ph\":\"");
+            json_char(&line, (char)ev->phase);
+            json_str(&line, "\",\"ts\":");
+            json_dec(&line, ns / 1000, 1);          // Microseconds, ns fraction
+            json_char(&line, '.');
+            json_dec(&line, ns % 1000, 3);
+            json_str(&line, ",\"pid\":0,\"tid\":");
+            json_dec(&line, ev->tid >= 0 ? (uint64_t)ev->tid : CPU_TRACK_TID + ev->cpu, 1);
+            if (ev->phase == TRACE_PH_COUNTER) {
+                json_str(&line, ",\"args\":{\"value\":");
+                if (ev->value < 0) json_char(&line, '-');
+                json_dec(&line, ev->value < 0 ? -(uint64_t)ev->value : (uint64_t)ev->value, 1);
+                json_char(&line, '}');
+            }
+            json_char(&line, '}');
+            json_flush(&line);
+            count++;
+        }
+    }
+
+    serial_write_string("\n]}\n");
+    serial_set_overflow_policy(policy);
+    if (was_running) trace_start();
+    return count;
+}
@@ -0,0 +1,218 @@
+/* hosted/host_hal.c */
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../include/kernel.h"
+#include "../include/klog.h"
+#include "../include/trace.h"
+#include "../include/jobs.h"
+#include "../include/sched.h"
+#include "smp.h"
+#include "serial.h"
+#include "clock.h"
+
+/*
+ * Linux stand-ins for the HAL the graphics, fs and Doom code link against
+ * in the hosted build (scripts/build_hosted.sh).
+ * The clock runs on clock_gettime(CLOCK_MONOTONIC) with the TSC calibrated
+ * against it, serial output goes to stdout and the kernel log to stderr,
+ * sleeping uses nanosleep and parallel_for runs its whole range inline.
+ * Tracing compiles in but records nothing.
+ */
+
+/* --- Clock --- */
+
+static uint64_t start_ns;
+static uint64_t start_tsc;
+static uint64_t tsc_hz;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void clock_init(void) {
+    struct timespec nap = { 0, 50 * 1000 * 1000 };
+
+    start_ns = monotonic_ns();
+    start_tsc = rdtsc();
+    nanosleep(&nap, NULL);
+
+    uint64_t elapsed = monotonic_ns() - start_ns;
+    tsc_hz = (rdtsc() - start_tsc) * 1000000000ULL / elapsed;
+}
+
+int clock_is_calibrated(void) {
+    return tsc_hz != 0;
+}
+
+uint64_t clock_ns(void) {
+    return monotonic_ns() - start_ns;
+}
+
+uint64_t clock_us(void) {
+    return clock_ns() / 1000;
+}
+
+uint64_t clock_ms(void) {
+    return clock_ns() / 1000000;
+}
+
+uint64_t clock_tsc_to_ns(uint64_t ticks) {
+    if (!tsc_hz) return 0;
+    return (ticks / tsc_hz) * 1000000000ULL + (ticks % tsc_hz) * 1000000000ULL / tsc_hz;
+}
+
+uint64_t clock_ns_to_tsc(uint64_t ns) {
+    return start_tsc + (ns / 1000000000ULL) * tsc_hz + (ns % 1000000000ULL) * tsc_hz / 1000000000ULL;
+}
+
+uint64_t clock_tsc_hz(void) {
+    return tsc_hz;
+}
+
+const char *clock_source_name(void) {
+    return "clock_gettime";
+}
+
+int clock_tsc_invariant(void) {
+    return 1;
+}
+
+int64_t clock_wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec;
+}
+
+void clock_delay_us(uint64_t us) {
+    uint64_t end = monotonic_ns() + us * 1000;
+    while (monotonic_ns() < end) __asm__ volatile("pause");
+}
+
+void clock_delay_ms(uint64_t ms) {
+    clock_delay_us(ms * 1000);
+}
+
+// Millisecond tick used by the desktop and the Doom stubs (system_stubs.c)
+uint64_t timer_ms(void) {
+    return clock_ms();
+}
+
+/* --- Serial --- */
+
+static int overflow_policy = SERIAL_TX_OVERFLOW_DEFAULT;
+
+void serial_init(void) {
+}
+
+void serial_write_char(char c) {
+    putchar(c);
+}
+
+void serial_write_string(const char *str) {
+    fputs(str, stdout);
+}
+
+void serial_write_dec(uint64_t value) {
+    printf("%" PRIu64, value);
+}
+
+void serial_write_hex(uint64_t value) {
+    printf("0x%" PRIX64, value);
+}
+
+void serial_enable_irq(void) {
+}
+
+void serial_sync_mode(void) {
+    fflush(stdout);
+}
+
+int serial_set_overflow_policy(int policy) {
+    int old = overflow_policy;
+    overflow_policy = policy;
+    return old;
+}
+
+uint64_t serial_tx_dropped(void) {
+    return 0;
+}
+
+uint32_t serial_tx_pending(void) {
+    return 0;
+}
+
+/* --- Kernel log --- */
+
+static int echo_level = KLOG_INFO;
+
+static const char *subsys_names[KLOG_NUM_SYS] = {
+    "core", "sched", "input", "video", "doom", "net", "audio", "storage"
+};
+
+void klog_init(void) {
+}
+
+void klog_flush(void) {
+}
+
+void klog_set_echo_level(int level) {
+    echo_level = level;
+}
+
+// Formatted immediately: the arguments are 64-bit slots, which the x86-64
+// calling convention passes the same way as the integers and pointers the
+// format expects
+void klog_write(int level, int subsys, const char *fmt, const uint64_t *args, int nargs) {
+    uint64_t a[KLOG_MAX_ARGS] = { 0 };
+    char line[KLOG_LINE_LEN];
+
+    if (level > echo_level) return;
+    for (int i = 0; i < nargs && i < KLOG_MAX_ARGS; i++) a[i] = args[i];
+
+    snprintf(line, sizeof(line), fmt, a[0], a[1], a[2], a[3], a[4], a[5]);
+    fprintf(stderr, "[%12.6f] %s: %s\n", clock_ns() / 1e9,
+            subsys >= 0 && subsys < KLOG_NUM_SYS ? subsys_names[subsys] : "?", line);
+}
+
+/* --- Tracing --- */
+
+void trace_init(void) {
+}
+
+void trace_event(const char *name, int phase, int64_t value) {
+    (void)name;
+    (void)phase;
+    (void)value;
+}
+
+void trace_thread_switch(int tid, const char *name) {
+    (void)tid;
+    (void)name;
+}
+
+/* --- Threads and jobs --- */
+
+// One CPU as far as per-CPU data (hal/metrics.c) is concerned
+int smp_this_cpu(void) {
+    return 0;
+}
+
+void thread_sleep_ms(uint64_t ms) {
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+void sched_preempt_disable(void) {
+}
+
+void sched_preempt_enable(void) {
+}
+
+void parallel_for(int count, int grain, job_range_fn_t fn, void *arg) {
+    (void)grain;
+    if (count > 0) fn(arg, 0, count);
+}
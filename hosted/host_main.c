@@ -0,0 +1,202 @@
+/* hosted/host_main.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../include/kernel.h"
+#include "../include/pmm.h"
+#include "../include/fs.h"
+#include "../include/ttf.h"
+#include "../include/bench.h"
+#include "../include/blit.h"
+#include "../kernel/graphics/inter_font_data.h"
+#include "clock.h"
+
+/*
+ * Entry point of the hosted build: boots the allocator, filesystem and font
+ * the way kernel.c does, on a memory framebuffer, then runs the registered
+ * benchmarks or Doom as a Linux process.
+ * The kernel heap and page allocator manage an anonymous mapping that is
+ * described to pmm_init() as a single conventional-memory UEFI descriptor.
+ *
+ *   tiny64-host [options] bench [prefix]
+ *   tiny64-host [options] doom [doom args]     e.g. -iwad doom1.wad -timedemo demo1
+ *
+ * Options: --fb WxH (framebuffer, default 1024x768), --heap MB (memory given
+ * to the page allocator, default 256), --ttf FILE (font for the TTF paths
+ * instead of the built-in data), --frames N (stop Doom after N frames),
+ * --ppm FILE (write the framebuffer out on exit).
+ */
+
+BootInfo* global_boot_info = NULL;
+ttf_font_t global_ttf_font;
+
+void mem_init_dispatch(void);
+void fs_init(void);
+void doomgeneric_SetBootInfo(BootInfo* info);
+void doomgeneric_Create(int argc, char **argv);
+void doomgeneric_InitMain(void);
+void doomgeneric_Tick(void);
+
+static BootInfo boot_info;
+static efi_memory_descriptor_t memory_map[1];
+static const char *ppm_path = NULL;
+static const char *ttf_path = NULL;
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: tiny64-host [options] bench [prefix]\n"
+            "       tiny64-host [options] doom [doom args]\n"
+            "options: --fb WxH  --heap MB  --ttf FILE  --frames N  --ppm FILE\n");
+    exit(2);
+}
+
+static void write_ppm(void) {
+    if (!ppm_path || !boot_info.framebuffer) return;
+
+    FILE *f = fopen(ppm_path, "wb");
+    if (!f) {
+        perror(ppm_path);
+        return;
+    }
+    fprintf(f, "P6\n%u %u\n255\n", boot_info.width, boot_info.height);
+    for (uint32_t y = 0; y < boot_info.height; y++) {
+        for (uint32_t x = 0; x < boot_info.width; x++) {
+            uint32_t px = boot_info.framebuffer[y * boot_info.pitch + x];
+            fputc((px >> 16) & 0xFF, f);
+            fputc((px >> 8) & 0xFF, f);
+            fputc(px & 0xFF, f);
+        }
+    }
+    fclose(f);
+}
+
+// The whole file through ttf_load_font_data, as kernel.c loads the embedded font
+static int load_ttf(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    int ok = size > 0 && fread(data, 1, size, f) == (size_t)size;
+    fclose(f);
+
+    int result = ok ? ttf_load_font_data(data, size, &global_ttf_font) : -1;
+    free(data);
+    return result;
+}
+
+// Same order as kernel_main: memcpy/blit dispatch, page allocator, clock, heap,
+// filesystem, then the TTF font
+static void boot(uint32_t width, uint32_t height, size_t heap_mb) {
+    size_t arena_size = heap_mb << 20;
+    void *arena = mmap(NULL, arena_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+
+    memory_map[0].type = EFI_CONVENTIONAL_MEMORY;
+    memory_map[0].physical_start = (uintptr_t)arena;
+    memory_map[0].virtual_start = (uintptr_t)arena;
+    memory_map[0].number_of_pages = arena_size >> PMM_PAGE_SHIFT;
+
+    boot_info.framebuffer = calloc((size_t)width * height, sizeof(uint32_t));
+    boot_info.backbuffer = boot_info.framebuffer;
+    boot_info.width = width;
+    boot_info.height = height;
+    boot_info.pitch = width;
+    boot_info.memory_map = memory_map;
+    boot_info.memory_map_size = sizeof(memory_map);
+    boot_info.memory_map_desc_size = sizeof(memory_map[0]);
+    global_boot_info = &boot_info;
+
+    mem_init_dispatch();
+    blit_init_dispatch();
+    pmm_init(&boot_info);
+    clock_init();
+    init_heap();
+    fs_init();
+    int ttf = ttf_path ? load_ttf(ttf_path)
+                       : ttf_load_font_data(inter_font_data, inter_font_size, &global_ttf_font);
+    if (ttf != 0) {
+        fprintf(stderr, "tiny64-host: TTF font did not load, TTF paths use their fallbacks\n");
+    }
+}
+
+static int run_bench(const char *filter) {
+    static char lines[BENCH_MAX_LINES][BENCH_LINE_LEN];
+    int count = bench_run(filter, lines, BENCH_MAX_LINES);
+
+    // JSON lines went to stdout with the rest of the serial output
+    for (int i = 0; i < count; i++) {
+        fprintf(stderr, "%s\n", lines[i]);
+    }
+    return 0;
+}
+
+static int run_doom(int argc, char **argv, long frames) {
+    // -mmap serves the WAD from a file mapping; -nogui keeps I_Error off zenity
+    char **doom_argv = calloc(argc + 3, sizeof(char *));
+    int doom_argc = 0;
+    doom_argv[doom_argc++] = "doom";
+    doom_argv[doom_argc++] = "-mmap";
+    doom_argv[doom_argc++] = "-nogui";
+    for (int i = 0; i < argc; i++) {
+        doom_argv[doom_argc++] = argv[i];
+    }
+
+    doomgeneric_SetBootInfo(&boot_info);
+    doomgeneric_Create(doom_argc, doom_argv);
+    doomgeneric_InitMain();
+
+    // -timedemo ends the process from I_Error with the result
+    for (long i = 0; frames == 0 || i < frames; i++) {
+        doomgeneric_Tick();
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    uint32_t width = 1024, height = 768;
+    size_t heap_mb = 256;
+    long frames = 0;
+    int i = 1;
+
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "--fb") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &width, &height) != 2 || !width || !height) usage();
+        } else if (strcmp(argv[i], "--heap") == 0 && i + 1 < argc) {
+            heap_mb = strtoul(argv[++i], NULL, 10);
+            if (heap_mb < 32) usage();
+        } else if (strcmp(argv[i], "--ttf") == 0 && i + 1 < argc) {
+            ttf_path = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) {
+            ppm_path = argv[++i];
+        } else {
+            usage();
+        }
+    }
+    if (i >= argc) usage();
+
+    boot(width, height, heap_mb);
+    atexit(write_ppm);
+
+    if (strcmp(argv[i], "bench") == 0) {
+        return run_bench(i + 1 < argc ? argv[i + 1] : NULL);
+    }
+    if (strcmp(argv[i], "doom") == 0) {
+        return run_doom(argc - i - 1, argv + i + 1, frames);
+    }
+    usage();
+    return 2;
+}
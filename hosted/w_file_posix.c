@@ -0,0 +1,118 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	WAD I/O functions, memory mapped (hosted build only).
+//	Selected with -mmap; lumps are then used straight out of the
+//	mapping instead of being copied through stdio.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "w_file.h"
+#include "z_zone.h"
+
+typedef struct
+{
+    wad_file_t wad;
+    int handle;
+} posix_wad_file_t;
+
+extern wad_file_class_t posix_wad_file;
+
+static wad_file_t *W_POSIX_OpenFile(char *path)
+{
+    posix_wad_file_t *result;
+    struct stat st;
+    void *mapped;
+    int handle;
+
+    handle = open(path, O_RDONLY);
+
+    if (handle < 0)
+    {
+        return NULL;
+    }
+
+    if (fstat(handle, &st) != 0 || st.st_size == 0)
+    {
+        close(handle);
+        return NULL;
+    }
+
+    // Private and writable: the engine may patch cached lumps in place,
+    // which must not reach the file.
+
+    mapped = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                  handle, 0);
+
+    if (mapped == MAP_FAILED)
+    {
+        close(handle);
+        return NULL;
+    }
+
+    result = Z_Malloc(sizeof(posix_wad_file_t), PU_STATIC, 0);
+    result->wad.file_class = &posix_wad_file;
+    result->wad.mapped = mapped;
+    result->wad.length = st.st_size;
+    result->handle = handle;
+
+    return &result->wad;
+}
+
+static void W_POSIX_CloseFile(wad_file_t *wad)
+{
+    posix_wad_file_t *posix_wad;
+
+    posix_wad = (posix_wad_file_t *) wad;
+
+    munmap(posix_wad->wad.mapped, posix_wad->wad.length);
+    close(posix_wad->handle);
+    Z_Free(posix_wad);
+}
+
+// Read data from the specified position in the file into the
+// provided buffer.  Returns the number of bytes read.
+
+size_t W_POSIX_Read(wad_file_t *wad, unsigned int offset,
+                    void *buffer, size_t buffer_len)
+{
+    if (offset >= wad->length)
+    {
+        return 0;
+    }
+
+    if (buffer_len > wad->length - offset)
+    {
+        buffer_len = wad->length - offset;
+    }
+
+    memcpy(buffer, wad->mapped + offset, buffer_len);
+
+    return buffer_len;
+}
+
+
+wad_file_class_t posix_wad_file =
+{
+    W_POSIX_OpenFile,
+    W_POSIX_CloseFile,
+    W_POSIX_Read,
+};
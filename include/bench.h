@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// In-kernel microbenchmark framework for Tiny64 OS
+// BENCH(name, fn) places an entry in the .bench section (collected by the
+// linker script), so any file can register a benchmark; BENCH_IF() adds a
+// check that skips it on hardware without the feature it measures. The `bench` command
+// calibrates each one until a repetition takes BENCH_MIN_REP_NS, warms it up,
+// times BENCH_REPS repetitions with the TSC and reports the median and p95
+// time per iteration: on the terminal and as one JSON object per line on
+// serial, e.g.
+//   {"bench":"memcpy 4KB","iters":4096,"reps":21,"median_ns":98.125,"p95_ns":101.500}
+
+#define BENCH_WARMUP        2
+#define BENCH_REPS          21
+#define BENCH_MIN_REP_NS    1000000ULL      // Calibrate repetitions to >= 1ms
+#define BENCH_MAX_ITERS     (1ULL << 24)
+
+#define BENCH_LINE_LEN      80
+#define BENCH_MAX_LINES     48
+
+// Run the measured operation 'iters' times
+typedef void (*bench_fn_t)(uint64_t iters);
+
+typedef struct {
+    const char *name;
+    bench_fn_t fn;
+    int (*available)(void);     // NULL: always runs
+} bench_t;
+
+#define BENCH(name, fn) BENCH_IF(name, fn, NULL)
+
+#define BENCH_IF(name, fn, available) \
+    static const bench_t bench_entry_##fn \
+    __attribute__((used, section(".bench"), aligned(8))) = { name, fn, available }
+
+typedef struct {
+    const char *name;
+    uint64_t iters;         // Iterations per repetition
+    uint64_t median_ps;     // Per iteration, picoseconds
+    uint64_t p95_ps;
+} bench_result_t;
+
+int bench_count(void);
+const bench_t *bench_get(int index);
+
+// Calibrate, warm up and time one benchmark
+void bench_run_one(const bench_t *bench, bench_result_t *result);
+
+// Runs every benchmark whose name starts with 'filter' (NULL or "" for all),
+// writes a JSON line per result to serial and fills 'lines' with a summary.
+// Returns the number of lines written.
+int bench_run(const char *filter, char lines[][BENCH_LINE_LEN], int max_lines);
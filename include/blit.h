@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+
+// 32bpp fill/copy engine for Tiny64 OS
+// A surface is a pixel array with a pitch; every call clips its rectangle
+// against the surfaces once and then runs unchecked SIMD row loops (SSE2, or
+// AVX2 once blit_init_dispatch() has found it enabled). Stores go around the
+// cache (movntdq) when the call covers more than BLIT_STREAM_MIN bytes or the
+// destination is marked BLIT_WC, so a large fill or copy does not evict the
+// caller's working set and write-combined video memory sees full lines.
+
+#define BLIT_WC             1               // Write-combined video memory
+#define BLIT_STREAM_MIN     (1024 * 1024)   // Bytes per call before stores stream
+
+typedef struct {
+    uint32_t *pixels;
+    uint32_t width, height;
+    uint32_t pitch;                         // Pixels from one row to the next
+    uint32_t flags;                         // BLIT_WC
+} blit_surface_t;
+
+void blit_init_dispatch(void);              // Pick SSE2/AVX2 from CPUID, call once at boot
+const char *blit_impl_name(void);
+
+void blit_fill(const blit_surface_t *dst, int x, int y, int w, int h, uint32_t color);
+
+// Rectangle copy; within one surface the source and destination may overlap
+void blit_copy(const blit_surface_t *dst, int dx, int dy,
+               const blit_surface_t *src, int sx, int sy, int w, int h);
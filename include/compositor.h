@@ -0,0 +1,34 @@
+#pragma once
+#include "kernel.h"
+
+// Window compositor for Tiny64 OS
+// The desktop and every window own an offscreen surface: a window-sized
+// BootInfo that the ordinary graphics primitives draw into in window
+// coordinates. Whatever a primitive touches on a surface is reported as
+// damage on the screen; flip_buffers() then rebuilds just those rectangles
+// in the display backbuffer from the windows, top of the z-order first, so
+// a pixel hidden behind another window is never copied. Windows are opaque
+// rectangles; a new one goes on top. The mouse cursor is drawn over the
+// result by the driver.
+
+#define COMP_MAX_WINDOWS    8       // Including the desktop
+
+typedef struct comp_window comp_window_t;
+
+// Take over the display: the desktop surface starts as a copy of what is on
+// screen. -1 without a display backbuffer or the memory for the desktop.
+int compositor_init(BootInfo *display);
+int compositor_is_running(void);
+
+// The bottom layer, covering the whole screen (NULL before compositor_init)
+BootInfo *comp_desktop(void);
+
+// A new window on top of the others, black until drawn; NULL when full or
+// out of memory
+comp_window_t *comp_window_create(int x, int y, int w, int h);
+
+// Remove the window; what it covered is recomposited on the next flip
+void comp_window_destroy(comp_window_t *win);
+
+// Draw target for the window, in window coordinates
+BootInfo *comp_window_surface(comp_window_t *win);
@@ -37,7 +37,11 @@
 #undef HAVE_MEMORY_H
 
 /* Define to 1 if you have the `mmap' function. */
+#ifdef TINY64_HOSTED
+#define HAVE_MMAP 1
+#else
 #undef HAVE_MMAP
+#endif
 
 /* Define to 1 if you have the `sched_setaffinity' function. */
 #undef HAVE_SCHED_SETAFFINITY
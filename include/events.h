@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+
+// Input/timer event queue for Tiny64 OS
+// PS/2 bytes are queued from IRQ 1/12, soft timers are checked on every
+// wait, and events_wait() halts the CPU until one of them is ready.
+
+typedef enum {
+    EVENT_NONE = 0,
+    EVENT_KEY,      // data = raw set 1 scancode byte
+    EVENT_MOUSE,    // data = raw PS/2 mouse packet byte
+    EVENT_TIMER     // id = timer handle from events_add_timer()
+} event_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t data;
+    uint16_t id;
+    uint64_t time_ns;   // clock_ns() when the event was produced
+} event_t;
+
+#define EVENT_QUEUE_SIZE 256
+#define EVENT_MAX_TIMERS 8
+
+// Route PS/2 and timer IRQs into the queue (call after keyboard/mouse init)
+void events_init(void);
+
+// Periodic soft timer; returns a handle >= 0 or -1 if none are free
+int events_add_timer(uint32_t period_ms);
+void events_remove_timer(int id);
+
+// Non-blocking: returns 1 and fills 'ev' if an event is ready
+int events_poll(event_t *ev);
+int events_pending(void);
+
+// Blocking: sleeps in hlt until an event is ready
+void events_wait(event_t *ev);
+
+// Statistics
+uint64_t events_idle_ns(void);
+uint32_t events_dropped(void);
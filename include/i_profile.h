@@ -0,0 +1,67 @@
+//
+// Tiny64 OS
+//
+// DESCRIPTION:
+//      Per-frame Doom phase profiler and on-screen overlay.
+//      Phases are timed with the TSC and summed over a frame (the tickers
+//      can run several tics per frame); I_ProfileFrame() files the sums into
+//      a rolling window of PROFILE_HISTORY frames for min/avg/p99. Every
+//      phase also shows up as a span in the kernel trace (`trace dump`).
+//
+
+
+#ifndef __I_PROFILE__
+#define __I_PROFILE__
+
+#include <stdint.h>
+#include "doomtype.h"
+
+#define PROFILE_HISTORY 128     // Frames in the rolling window
+
+typedef enum
+{
+    PROFILE_FRAME,              // doomgeneric_Tick, sleeping included
+    PROFILE_G_TICKER,
+    PROFILE_P_TICKER,
+    PROFILE_RENDER,             // R_RenderPlayerView
+    PROFILE_BSP,                // R_RenderBSPNode: walls and plane/sprite setup
+    PROFILE_PLANES,             // R_DrawPlanes
+    PROFILE_MASKED,             // R_DrawMasked: sprites and masked mid textures
+    PROFILE_ST_DRAWER,
+    PROFILE_HU_DRAWER,
+    PROFILE_FINISH,             // I_FinishUpdate, palette conversion included
+    PROFILE_BLIT,               // DG_DrawFrame
+    NUM_PROFILE_PHASES
+} profile_phase_t;
+
+typedef enum
+{
+    PROFILE_VISPLANES,
+    PROFILE_DRAWSEGS,
+    PROFILE_VISSPRITES,
+    PROFILE_COLUMNS,
+    PROFILE_SPANS,
+    NUM_PROFILE_COUNTERS
+} profile_counter_t;
+
+// Bumped by the column and span drawers in r_draw.c
+extern unsigned int profile_columns;
+extern unsigned int profile_spans;
+
+void I_ProfileBegin(profile_phase_t phase);
+void I_ProfileEnd(profile_phase_t phase);
+
+// Value of a per-frame counter (the renderer sets the limits it uses)
+void I_ProfileCount(profile_counter_t counter, unsigned int value);
+
+// Close the current frame: file its phase times and counters in the window
+void I_ProfileFrame(void);
+
+// F12 in the Doom window
+void I_ProfileToggleOverlay(void);
+boolean I_ProfileOverlayVisible(void);
+
+// Draw the stats and a frame-time graph into the w x h window at 'dest'
+void I_ProfileDrawOverlay(uint32_t *dest, int pitch, int w, int h);
+
+#endif
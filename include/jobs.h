@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+// Work-stealing job system for Tiny64 OS
+// Every online CPU is a worker with its own Chase-Lev deque: the owner pushes
+// and pops at the bottom, idle workers steal from the top. Waiting on a
+// counter runs queued jobs instead of spinning, so fork/join nests freely.
+// Without application processors (or before jobs_init()) jobs simply run
+// inline on the caller, which keeps every user correct on one core.
+
+#define JOBS_DEQUE_SIZE     256     // Per worker, power of two
+
+typedef void (*job_fn_t)(void *arg);
+typedef void (*job_range_fn_t)(void *arg, int start, int end);
+
+// Join point for a group of jobs
+typedef struct {
+    volatile int pending;
+} job_counter_t;
+
+#define JOB_COUNTER_INIT    { 0 }
+
+// Hand the application processors over to the job workers (after smp_init)
+void jobs_init(void);
+int jobs_worker_count(void);        // 1 when running sequentially
+
+// Fork: queue fn(arg) on the calling CPU's deque, counted in 'counter'
+void job_spawn(job_counter_t *counter, job_fn_t fn, void *arg);
+
+// Join: run or steal jobs until every job counted in 'counter' has finished
+void job_wait(job_counter_t *counter);
+
+// Call fn(arg, start, end) over [0, count) in chunks of at most 'grain'
+// (0 picks a grain from the worker count) and wait for all of them
+void parallel_for(int count, int grain, job_range_fn_t fn, void *arg);
+
+// Jobs executed and stolen since boot, per worker
+uint64_t jobs_executed(int worker);
+uint64_t jobs_stolen(int worker);
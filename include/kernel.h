@@ -12,6 +12,10 @@ typedef struct {
     uint32_t width;
     uint32_t height;
     uint32_t pitch;
+    void *memory_map;               // UEFI memory map (EFI_MEMORY_DESCRIPTOR array)
+    uint64_t memory_map_size;       // Size of the map in bytes
+    uint64_t memory_map_desc_size;  // Stride between descriptors
+    void *acpi_rsdp;                 // ACPI RSDP from the EFI configuration table (or NULL)
 } BootInfo;
 
 /* --- Hardware Port I/O (Inline Assembly) --- */
@@ -33,6 +37,31 @@ static inline void io_wait(void) {
     outb(0x80, 0);
 }
 
+/* --- Interrupt Flag Helpers --- */
+
+#ifdef TINY64_HOSTED
+// Hosted build (scripts/build_hosted.sh): a Linux process has no interrupt
+// flag to touch, and cli/sti would fault
+static inline uint64_t irq_save(void) {
+    return 0;
+}
+
+static inline void irq_restore(uint64_t flags) {
+    (void)flags;
+}
+#else
+// Disable interrupts and return the previous RFLAGS for irq_restore()
+static inline uint64_t irq_save(void) {
+    uint64_t flags;
+    __asm__ volatile ( "pushfq; popq %0; cli" : "=r"(flags) : : "memory" );
+    return flags;
+}
+
+static inline void irq_restore(uint64_t flags) {
+    if (flags & 0x200) __asm__ volatile ( "sti" : : : "memory" );
+}
+#endif
+
 /* --- CMOS NVRAM Helpers (Survives Reboot) --- */
 
 static inline void write_cmos(uint8_t addr, uint8_t val) {
@@ -49,6 +78,11 @@ static inline uint8_t read_cmos(uint8_t addr) {
 
 void init_double_buffer(BootInfo *info);
 void flip_buffers(BootInfo *info);
+void mark_dirty_rect(BootInfo *info, int x, int y, int w, int h); // Region to copy on the next flip
+// Set by the compositor: damage on a surface other than the display's, and
+// rebuilding a display rectangle before flip_buffers() copies it out
+void set_compositor_hooks(void (*damage)(BootInfo *surface, int x, int y, int w, int h),
+                          void (*compose)(BootInfo *display, int x0, int y0, int x1, int y1));
 void clear_backbuffer(BootInfo *info, uint32_t color);
 
 void fill_rect(BootInfo *info, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color);
@@ -63,11 +97,14 @@ void kprint(BootInfo *info, const char *str, int x, int y, uint32_t color);
 
 // TTF font rendering
 void kprint_ttf(BootInfo *info, const char *str, int x, int y, uint32_t color, void *ttf_font);
+// kprint_ttf() without the serial echo
+void draw_string_ttf(BootInfo *info, const char *str, int x, int y, uint32_t color, void *ttf_font);
 
 /* --- Cursor Logic (mouse.c) --- */
 
 void draw_cursor(BootInfo *info, int x, int y);
 void restore_cursor_bg(BootInfo *info, int x, int y);
+void cursor_refresh(BootInfo *info, int x0, int y0, int x1, int y1); // Redraw over new pixels in the rectangle
 
 /* --- Memory Management Prototypes --- */
 
@@ -81,7 +118,24 @@ void debug_heap(BootInfo *info, int start_y);
 
 void init_gdt(void);
 void init_idt(void);
+void idt_load_cpu(void);
 void set_idt_gate_ist(int n, uint64_t handler, uint8_t ist);
+typedef void (*irq_handler_t)(void);
+void irq_set_handler(int irq, irq_handler_t handler);
+
+// Registers saved by the IRQ stubs (hal/idt_asm.S), lowest address first
+typedef struct isr_frame {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rbp, rsi, rdx, rcx, rax, rbx, rdi;
+    uint64_t rip, cs, rflags, rsp, ss;      // Pushed by the CPU
+} isr_frame_t;
+
+// Frame of the interrupt being handled on this CPU, NULL outside handlers
+isr_frame_t *irq_frame(void);
+void irq_unmask(int irq);
+void irq_mask(int irq);
+void irq_set_exit_hook(void (*hook)(void));
+int irq_in_interrupt(void);
 int mouse_init(void);
 void handle_mouse(BootInfo *info);
 void mouse_handle_byte(BootInfo *info, uint8_t data);
@@ -0,0 +1,83 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary kernel log for Tiny64 OS
+// LOG_*() stores (timestamp, format pointer, level, subsystem, integer args)
+// in the calling CPU's ring and returns. Nothing is formatted until
+// klog_flush() (the klogd thread) echoes new records to serial or `dmesg`
+// prints the ring. Levels above KLOG_LEVEL compile out entirely.
+//
+// Arguments are stored as 64-bit integers: cast pointers to uintptr_t, and
+// only pass %s strings that outlive the record (literals, static names).
+
+#define KLOG_ERROR  0
+#define KLOG_WARN   1
+#define KLOG_INFO   2
+#define KLOG_DEBUG  3
+#define KLOG_TRACE  4
+
+#ifndef KLOG_LEVEL
+#define KLOG_LEVEL  KLOG_DEBUG      // Compiled-in maximum
+#endif
+
+#define KLOG_MAX_ARGS       6
+#define KLOG_RING_RECORDS   512     // Per CPU, power of two
+#define KLOG_LINE_LEN       120
+
+typedef enum {
+    KLOG_SYS_CORE,
+    KLOG_SYS_SCHED,
+    KLOG_SYS_INPUT,
+    KLOG_SYS_VIDEO,
+    KLOG_SYS_DOOM,
+    KLOG_SYS_NET,
+    KLOG_SYS_AUDIO,
+    KLOG_SYS_STORAGE,
+    KLOG_NUM_SYS
+} klog_subsys_t;
+
+typedef struct {
+    volatile uint64_t seq;          // Record number + 1 once complete, 0 while written
+    uint64_t time_ns;
+    const char *fmt;                // The format string doubles as the format id
+    uint8_t level;
+    uint8_t subsys;
+    uint8_t nargs;
+    uint8_t cpu;
+    uint64_t args[KLOG_MAX_ARGS];
+} klog_record_t;
+
+void klog_write(int level, int subsys, const char *fmt, const uint64_t *args, int nargs);
+
+#define KLOG(level, subsys, fmt, ...) do {                                      \
+        if ((level) <= KLOG_LEVEL) {                                            \
+            const uint64_t klog_args_[] = { 0, ##__VA_ARGS__ };                 \
+            klog_write((level), (subsys), (fmt), klog_args_ + 1,                \
+                       (int)(sizeof(klog_args_) / sizeof(klog_args_[0])) - 1);  \
+        }                                                                       \
+    } while (0)
+
+#define LOG_ERR(subsys, fmt, ...)   KLOG(KLOG_ERROR, subsys, fmt, ##__VA_ARGS__)
+#define LOG_WARN(subsys, fmt, ...)  KLOG(KLOG_WARN, subsys, fmt, ##__VA_ARGS__)
+#define LOG_INFO(subsys, fmt, ...)  KLOG(KLOG_INFO, subsys, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(subsys, fmt, ...) KLOG(KLOG_DEBUG, subsys, fmt, ##__VA_ARGS__)
+#define LOG_TRACE(subsys, fmt, ...) KLOG(KLOG_TRACE, subsys, fmt, ##__VA_ARGS__)
+
+// Rings for the application processors (after smp_init); the BSP's ring
+// is static so logging works from the first instruction
+void klog_init(void);
+
+// Format and write every record not yet echoed, oldest first (one caller)
+void klog_flush(void);
+
+// Records at or below this level are echoed by klog_flush() (runtime)
+void klog_set_echo_level(int level);
+
+// Format one record as "[   12.345678] sys: message"
+int klog_format(const klog_record_t *rec, char *out, size_t size);
+
+// Newest 'max' records from every CPU, oldest first; returns the count
+int klog_snapshot(klog_record_t *out, int max);
+
+uint64_t klog_dropped(void);        // Records lost to a CPU without a ring
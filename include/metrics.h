@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+
+// Kernel metrics registry for Tiny64 OS
+// Counters only go up and are kept per CPU, each CPU's block starting on its
+// own cache line, so metric_add() from an IRQ handler is a single add with no
+// lock prefix and no line bouncing between CPUs; readers sum the CPUs.
+// Gauges hold a current value (heap used, tic lag) and are set by their owner,
+// either as it changes or from a sampler that readers run first when keeping
+// it current would cost the owner's fast path.
+// Rates (IRQs/s, sectors/s, fps) are left to readers that sample the
+// counters periodically, such as `top`.
+
+#define METRIC_IRQ_VECTORS  256
+
+typedef enum {
+    /* Counters */
+    METRIC_IRQ_BASE,                        // One per interrupt vector
+    METRIC_SERIAL_TX_DROPPED = METRIC_IRQ_BASE + METRIC_IRQ_VECTORS,  // Bytes
+    METRIC_NET_RX_PACKETS,
+    METRIC_NET_RX_BYTES,
+    METRIC_NET_TX_PACKETS,
+    METRIC_NET_TX_BYTES,
+    METRIC_AUDIO_UNDERRUNS,
+    METRIC_IDE_SECTORS_READ,
+    METRIC_IDE_SECTORS_WRITTEN,
+    METRIC_DOOM_FRAMES,
+    METRIC_GLYPH_CACHE_HITS,
+    METRIC_GLYPH_CACHE_MISSES,
+    METRIC_GLYPH_CACHE_EVICTIONS,
+    METRIC_NUM_COUNTERS,
+
+    /* Gauges */
+    METRIC_HEAP_TOTAL = METRIC_NUM_COUNTERS,    // Bytes
+    METRIC_HEAP_USED,
+    METRIC_HEAP_FREE,
+    METRIC_HEAP_FRAG,                       // Per mille of free block memory outside the largest free block
+    METRIC_DOOM_TIC_LAG,                    // Tics made but not yet run
+    METRIC_NUM
+} metric_id_t;
+
+#define METRIC_IRQ(vector)  (METRIC_IRQ_BASE + ((vector) & (METRIC_IRQ_VECTORS - 1)))
+#define METRIC_MAX_SAMPLERS 8
+
+// Counters: add to the calling CPU's slot
+void metric_add(int id, uint64_t n);
+#define metric_inc(id)      metric_add((id), 1)
+
+// Gauges: replace the value
+void metric_set(int id, uint64_t value);
+
+// Run 'fn' (which sets gauges) before every gauge read; -1 when full
+int metric_add_sampler(void (*fn)(void));
+
+// Counter summed over every CPU, or the gauge's value
+uint64_t metric_read(int id);
+
+// One CPU's share of a counter
+uint64_t metric_read_cpu(int id, int cpu);
+
+// Every metric at once, indexed by metric_id_t ('out' holds METRIC_NUM)
+void metric_snapshot(uint64_t *out);
+
+const char *metric_name(int id);
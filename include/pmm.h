@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "kernel.h"
+
+// Physical page-frame allocator for Tiny64 OS
+// Binary buddy allocator over the conventional memory reported by UEFI.
+// Memory is identity mapped, so the returned addresses are usable pointers.
+
+#define PMM_PAGE_SIZE   4096
+#define PMM_PAGE_SHIFT  12
+#define PMM_MAX_ORDER   12      // Largest block: 2^12 pages = 16MB
+
+// UEFI memory descriptor as handed over in BootInfo::memory_map
+typedef struct {
+    uint32_t type;
+    uint64_t physical_start;
+    uint64_t virtual_start;
+    uint64_t number_of_pages;
+    uint64_t attribute;
+} efi_memory_descriptor_t;
+
+// UEFI memory types the kernel cares about
+#define EFI_LOADER_CODE             1
+#define EFI_LOADER_DATA             2
+#define EFI_BOOT_SERVICES_CODE      3
+#define EFI_BOOT_SERVICES_DATA      4
+#define EFI_CONVENTIONAL_MEMORY     7
+#define EFI_ACPI_RECLAIM_MEMORY     9
+#define EFI_MEMORY_MAPPED_IO        11
+
+void pmm_init(BootInfo *info);
+int pmm_is_initialized(void);
+
+// Allocate/free 2^order contiguous, naturally aligned pages
+void *pmm_alloc_pages(unsigned int order);
+void pmm_free_pages(void *addr, unsigned int order);
+
+// Smallest order whose block holds 'bytes'
+unsigned int pmm_order_for_size(size_t bytes);
+
+size_t pmm_get_total_pages(void);
+size_t pmm_get_free_pages(void);
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+
+// Sampling profiler for Tiny64 OS
+// While running, the timer interrupt records the interrupted RIP and a short
+// frame-pointer backtrace on the BSP every period, and IPIs the other CPUs
+// so they record their own. `prof dump` folds identical stacks and writes
+// them to serial; scripts/prof_symbolize.py resolves them against
+// bin/kernel.elf and emits flamegraph input. Code that runs with interrupts
+// off is never sampled and shows up where interrupts come back on.
+
+#define PROF_DEFAULT_HZ     1000
+#define PROF_MAX_DEPTH      8       // RIP plus return addresses per sample
+#define PROF_SAMPLES        4096    // Per CPU; further samples are dropped
+
+typedef struct {
+    uint64_t pc[PROF_MAX_DEPTH];    // Leaf first, zero-terminated when shorter
+} prof_sample_t;
+
+// Clears the previous profile; -1 without a timer or sample memory
+int prof_start(int hz);
+void prof_stop(void);
+int prof_is_running(void);
+
+// Write the folded profile to serial; returns the number of distinct stacks
+int prof_dump(void);
+
+uint64_t prof_sample_count(void);
+uint64_t prof_dropped(void);        // Samples lost to full buffers
+
+// From the IPI handler: record this CPU's sample if the BSP asked for one
+void prof_ipi(void);
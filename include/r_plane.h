@@ -26,6 +26,8 @@
 
 
 // Visplane related.
+#define MAXVISPLANES	128
+
 extern  short*		lastopening;
 
 
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+
+// Preemptive kernel threads for Tiny64 OS
+// Round-robin within strict priority levels on the boot CPU. The one-shot
+// timer is armed for the next sleeper or the end of the current time slice,
+// and a switch requested from IRQ context happens on the way out of the
+// interrupt.
+
+#define SCHED_PRIO_HIGH     0   // Input / desktop
+#define SCHED_PRIO_NORMAL   1
+#define SCHED_PRIO_LOW      2   // Background work
+#define SCHED_NUM_PRIOS     3
+
+#define SCHED_SLICE_NS      10000000ULL     // 10ms
+#define THREAD_STACK_SIZE   (64 * 1024)     // Includes one guard page
+#define THREAD_NAME_LEN     16
+
+typedef enum {
+    THREAD_READY,
+    THREAD_RUNNING,
+    THREAD_SLEEPING,    // Waiting for wake_ns or thread_wakeup()
+    THREAD_BLOCKED,     // Waiting for thread_wakeup() only
+    THREAD_DEAD
+} thread_state_t;
+
+typedef struct thread {
+    uint8_t *fpu_state;             // XSAVE/FXSAVE image (top of the stack)
+    uint64_t rsp;                   // Saved stack pointer while switched out
+    uint8_t *stack;                 // Base of the stack allocation (NULL for boot)
+    int id;
+    int priority;
+    thread_state_t state;
+    char name[THREAD_NAME_LEN];
+    uint64_t wake_ns;
+    uint64_t run_ns;                // Total time on CPU
+    uint64_t last_start_ns;
+    uint64_t switches;              // Times switched in
+    void (*entry)(void *);
+    void *arg;
+    struct thread *next;            // Run queue / sleep list link
+    struct thread *all_next;        // Every live thread
+} thread_t;
+
+// Turn the boot flow into the first thread and start the idle thread.
+// Call after apic_init() so the LAPIC timer drives preemption.
+void sched_init(void);
+int sched_is_running(void);
+
+thread_t *thread_create(const char *name, void (*entry)(void *), void *arg, int priority);
+void thread_exit(void) __attribute__((noreturn));
+thread_t *thread_current(void);
+
+void thread_yield(void);
+void thread_sleep_until(uint64_t deadline_ns);     // UINT64_MAX blocks until woken
+void thread_sleep_ms(uint64_t ms);
+void thread_wakeup(thread_t *thread);               // Safe from IRQ context
+
+// Keep the current thread on the CPU (nestable); IRQs still run
+void sched_preempt_disable(void);
+void sched_preempt_enable(void);
+
+// Snapshot of live threads for reporting; returns the number filled
+int sched_get_threads(thread_t **out, int max);
+uint64_t sched_idle_ns(void);
@@ -0,0 +1,74 @@
+#pragma once
+#include <stdint.h>
+#include "kernel.h"
+
+// Spinlocks for Tiny64 OS
+// spinlock_t is a test-and-test-and-set lock for short, low-contention
+// sections. ticket_lock_t hands the lock out in arrival order, so no CPU can
+// starve under contention. The _irqsave variants also disable interrupts on
+// the local CPU, which is required for anything an IRQ handler may take.
+
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+typedef struct {
+    volatile uint16_t next;     // Next ticket to hand out
+    volatile uint16_t serving;  // Ticket currently holding the lock
+} ticket_lock_t;
+
+#define SPINLOCK_INIT       { 0 }
+#define TICKET_LOCK_INIT    { 0, 0 }
+
+static inline void cpu_relax(void) {
+    __asm__ volatile("pause" : : : "memory");
+}
+
+/* --- Test-and-set --- */
+
+static inline int spin_trylock(spinlock_t *lock) {
+    return __atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE) == 0;
+}
+
+static inline void spin_lock(spinlock_t *lock) {
+    while (!spin_trylock(lock)) {
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) cpu_relax();
+    }
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t spin_lock_irqsave(spinlock_t *lock) {
+    uint64_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+/* --- Ticket --- */
+
+static inline void ticket_lock(ticket_lock_t *lock) {
+    uint16_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&lock->serving, __ATOMIC_ACQUIRE) != ticket) cpu_relax();
+}
+
+static inline void ticket_unlock(ticket_lock_t *lock) {
+    __atomic_store_n(&lock->serving, lock->serving + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t ticket_lock_irqsave(ticket_lock_t *lock) {
+    uint64_t flags = irq_save();
+    ticket_lock(lock);
+    return flags;
+}
+
+static inline void ticket_unlock_irqrestore(ticket_lock_t *lock, uint64_t flags) {
+    ticket_unlock(lock);
+    irq_restore(flags);
+}
@@ -7,6 +7,19 @@
 // Memory functions
 void* memset(void* dest, int c, size_t n);
 void* memcpy(void* dest, const void* src, size_t n);
+void* memmove(void* dest, const void* src, size_t n);
+
+// Runtime-selected memcpy/memset variants
+typedef struct {
+    const char *name;
+    void *(*copy)(void *dest, const void *src, size_t n);
+    void *(*set)(void *dest, int c, size_t n);
+    int available;
+} mem_impl_t;
+
+void mem_init_dispatch(void);           // Pick variants from CPUID, call once at boot
+const char *mem_impl_name(void);
+int mem_get_impls(const mem_impl_t **impls);
 
 // String functions
 size_t strlen(const char* str);
@@ -0,0 +1,22 @@
+#pragma once
+#include "kernel.h"
+
+// Live system monitor for Tiny64 OS
+// A desktop window showing rates and levels from the metrics registry: IRQs
+// per CPU and the busiest vectors, heap use and fragmentation, Doom fps and
+// tic lag, NIC and IDE throughput, audio underruns and serial drops.
+// The terminal calls top_update() from its one-second timer while it is open.
+
+#define TOP_WIDTH   340
+#define TOP_HEIGHT  300
+
+// Save what is under the window, draw it and take the first sample
+void top_open(BootInfo *info, int x, int y);
+
+// Put back what the window covered
+void top_close(BootInfo *info);
+
+int top_is_open(void);
+
+// Sample the registry and redraw the window contents
+void top_update(BootInfo *info);
@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+
+// TSC trace points for Tiny64 OS
+// TRACE_BEGIN/TRACE_END bracket a span, TRACE_COUNTER samples a value. Each
+// call is one rdtsc and a 32-byte store into the calling CPU's ring; the
+// oldest events are overwritten. `trace dump` (trace_dump()) streams the
+// rings over serial as Chrome trace-event JSON for chrome://tracing or
+// Perfetto. Build with -DTRACE_ENABLED=0 to compile every trace point out.
+//
+// Names are stored by pointer: use string literals.
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED       1
+#endif
+
+#define TRACE_RING_EVENTS   4096    // Per CPU, power of two
+#define TRACE_MAX_THREADS   64      // Thread names remembered for the export
+#define TRACE_NAME_LEN      16
+
+#define TRACE_PH_BEGIN      'B'
+#define TRACE_PH_END        'E'
+#define TRACE_PH_COUNTER    'C'
+
+typedef struct {
+    uint64_t tsc;
+    const char *name;
+    int64_t value;                  // Counter sample, unused for spans
+    uint8_t phase;                  // TRACE_PH_*
+    uint8_t cpu;
+    int16_t tid;                    // Thread running at the time, -1 outside threads
+    uint32_t reserved;
+} trace_event_t;
+
+void trace_event(const char *name, int phase, int64_t value);
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(name)           trace_event((name), TRACE_PH_BEGIN, 0)
+#define TRACE_END(name)             trace_event((name), TRACE_PH_END, 0)
+#define TRACE_COUNTER(name, value)  trace_event((name), TRACE_PH_COUNTER, (int64_t)(value))
+#else
+#define TRACE_BEGIN(name)           do { } while (0)
+#define TRACE_END(name)             do { } while (0)
+#define TRACE_COUNTER(name, value)  do { (void)(value); } while (0)
+#endif
+
+// Rings for the application processors (after smp_init); the BSP's ring
+// is static so boot can be traced before the PMM exists
+void trace_init(void);
+
+// Called by the scheduler on every switch, so spans are attributed to the
+// thread that ran them and preemption does not interleave their nesting
+void trace_thread_switch(int tid, const char *name);
+
+// Recording is on from boot; stopping keeps the rings for a later dump
+void trace_start(void);
+void trace_stop(void);
+int trace_is_running(void);
+
+// Forget everything recorded so far
+void trace_clear(void);
+
+// Write the rings to serial as {"traceEvents":[...]}; returns the event count
+int trace_dump(void);
+
+uint64_t trace_events_recorded(void);
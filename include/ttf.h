@@ -98,17 +98,21 @@ typedef struct {
     int16_t num_contours;
 } ttf_glyph_outline_t;
 
-#define GLYPH_CACHE_SIZE 256
-#define GLYPH_BITMAP_SIZE 64  // 8x8 pixels
+// Glyph cache
+// Rendered glyphs are shared by every font, keyed by (font, glyph, box
+// size, subpixel offset) and evicted least recently used first. Bitmaps are
+// packed into one arena of TTF_CACHE_PAGE pages, each carved into slots of
+// a single power-of-two size. ttf_get_glyph() hands out a pointer into the
+// arena that stays valid, and unevicted, until ttf_release_glyph().
+#define TTF_CACHE_ARENA     (64 * 1024)     // Bytes of glyph bitmaps
+#define TTF_CACHE_PAGE      4096            // Largest cached bitmap, in bytes
+#define TTF_SUBPIXEL_STEPS  4               // Horizontal offsets per pixel
 
-// Cached glyph structure
 typedef struct {
-    uint16_t glyph_index;
-    uint8_t bitmap[GLYPH_BITMAP_SIZE];
+    const uint8_t *pixels;                  // width * height coverage bytes, row-major
     int width;
     int height;
-    int valid;
-} cached_glyph_t;
+} ttf_glyph_bitmap_t;
 
 // Font structure
 typedef struct {
@@ -129,8 +133,6 @@ typedef struct {
     // Horizontal metrics (hmtx) data
     ttf_long_hor_metric_t *hmtx_table;
     int16_t *hmtx_left_side_bearings;
-    // Glyph cache
-    cached_glyph_t glyph_cache[GLYPH_CACHE_SIZE];
 } ttf_font_t;
 
 // Function declarations
@@ -139,4 +141,13 @@ int ttf_load_font(const char *filename, ttf_font_t *font);
 int ttf_load_font_data(const uint8_t *data, size_t size, ttf_font_t *font);
 void ttf_free_font(ttf_font_t *font);
 int ttf_get_glyph_index(ttf_font_t *font, uint32_t codepoint);
-int ttf_render_glyph(ttf_font_t *font, uint16_t glyph_index, uint8_t *bitmap, int width, int height, int x, int y, int pixel_size);
\ No newline at end of file
+int ttf_render_glyph(ttf_font_t *font, uint16_t glyph_index, uint8_t *bitmap, int width, int height, int x, int y, int pixel_size);
+
+// The glyph fitted to a width x height box, shifted right by
+// subpixel / TTF_SUBPIXEL_STEPS of a pixel. NULL when the box is larger than
+// TTF_CACHE_PAGE or every slot that could hold it is in use.
+const ttf_glyph_bitmap_t *ttf_get_glyph(ttf_font_t *font, uint16_t glyph_index, int width, int height, int subpixel);
+void ttf_release_glyph(const ttf_glyph_bitmap_t *glyph);
+
+// Drop the font's glyphs, or every glyph for NULL
+void ttf_cache_flush(ttf_font_t *font);
@@ -0,0 +1,314 @@
+#include "../include/kernel.h"
+#include "../include/bench.h"
+#include "../include/string.h"
+#include "../include/pmm.h"
+#include "../include/fs.h"
+#include "../include/ttf.h"
+#include "../include/blit.h"
+#include "../hal/serial.h"
+#include "../hal/clock.h"
+
+// Microbenchmark runner and the seed benchmarks
+// Results are per iteration; a repetition runs the benchmark's loop enough
+// times to last BENCH_MIN_REP_NS so TSC overhead and IRQ jitter average out,
+// and the median/p95 over BENCH_REPS repetitions is what gets reported.
+
+extern int snprintf(char* str, size_t size, const char* format, ...);
+extern ttf_font_t global_ttf_font;
+
+extern const bench_t __bench_start[];
+extern const bench_t __bench_end[];
+
+int bench_count(void) {
+    return (int)(__bench_end - __bench_start);
+}
+
+const bench_t *bench_get(int index) {
+    if (index < 0 || index >= bench_count()) return NULL;
+    return &__bench_start[index];
+}
+
+/* --- Runner --- */
+
+static uint64_t time_rep(bench_fn_t fn, uint64_t iters) {
+    uint64_t start = rdtsc();
+    fn(iters);
+    return clock_tsc_to_ns(rdtsc() - start);
+}
+
+void bench_run_one(const bench_t *bench, bench_result_t *result) {
+    uint64_t samples[BENCH_REPS];
+
+    // Double the iteration count until one repetition is long enough
+    uint64_t iters = 1;
+    while (iters < BENCH_MAX_ITERS && time_rep(bench->fn, iters) < BENCH_MIN_REP_NS) {
+        iters *= 2;
+    }
+
+    for (int i = 0; i < BENCH_WARMUP; i++) {
+        bench->fn(iters);
+    }
+
+    // Insertion sort as the samples come in
+    for (int i = 0; i < BENCH_REPS; i++) {
+        uint64_t ps = time_rep(bench->fn, iters) * 1000 / iters;
+        int j = i;
+        while (j > 0 && samples[j - 1] > ps) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = ps;
+    }
+
+    result->name = bench->name;
+    result->iters = iters;
+    result->median_ps = samples[BENCH_REPS / 2];
+    result->p95_ps = samples[(BENCH_REPS * 95 + 99) / 100 - 1];
+}
+
+// "12.345" nanoseconds from picoseconds
+static void format_ns(char *buf, size_t size, uint64_t ps) {
+    unsigned int frac = (unsigned int)(ps % 1000);
+    snprintf(buf, size, "%u.%s%u", (unsigned int)(ps / 1000),
+             frac < 10 ? "00" : frac < 100 ? "0" : "", frac);
+}
+
+static void report(const bench_result_t *r, char *line) {
+    char median[24], p95[24], json[160];
+    format_ns(median, sizeof(median), r->median_ps);
+    format_ns(p95, sizeof(p95), r->p95_ps);
+
+    snprintf(json, sizeof(json), "{\"bench\":\"%s\",\"iters\":%u,\"reps\":%d,\"median_ns\":%s,\"p95_ns\":%s}\n",
+             r->name, (unsigned int)r->iters, BENCH_REPS, median, p95);
+
+    // Results must not be dropped behind a full TX ring
+    int policy = serial_set_overflow_policy(SERIAL_TX_WAIT);
+    serial_write_string(json);
+    serial_set_overflow_policy(policy);
+
+    snprintf(line, BENCH_LINE_LEN, "%s: median %s ns, p95 %s ns", r->name, median, p95);
+}
+
+/* --- Seed benchmarks --- */
+
+#define BENCH_COPY_MAX      (1 << 20)
+#define BENCH_SURFACE_W     1024
+#define BENCH_SURFACE_H     768
+#define BENCH_CHURN_SLOTS   32
+#define BENCH_FILE          "bench.dat"
+
+static uint8_t *copy_src;
+static uint8_t *copy_dst;
+static BootInfo surface;                // Offscreen target for the graphics benchmarks
+static void *churn_slots[BENCH_CHURN_SLOTS];
+static uint32_t churn_seed;
+
+static int bench_setup(void) {
+    if (!copy_src) copy_src = pmm_alloc_pages(pmm_order_for_size(BENCH_COPY_MAX));
+    if (!copy_dst) copy_dst = pmm_alloc_pages(pmm_order_for_size(BENCH_COPY_MAX));
+    if (!surface.framebuffer) {
+        surface.framebuffer = pmm_alloc_pages(pmm_order_for_size(BENCH_SURFACE_W * BENCH_SURFACE_H * sizeof(uint32_t)));
+        surface.backbuffer = surface.framebuffer;
+        surface.width = BENCH_SURFACE_W;
+        surface.height = BENCH_SURFACE_H;
+        surface.pitch = BENCH_SURFACE_W;
+    }
+    if (!copy_src || !copy_dst || !surface.framebuffer) return -1;
+
+    for (int i = 0; i < BENCH_COPY_MAX; i++) copy_src[i] = (uint8_t)i;
+    fs_write_file(BENCH_FILE, copy_src, MAX_FILE_SIZE);
+    return 0;
+}
+
+static void bench_teardown(void) {
+    for (int i = 0; i < BENCH_CHURN_SLOTS; i++) {
+        if (churn_slots[i]) kfree(churn_slots[i]);
+        churn_slots[i] = NULL;
+    }
+    fs_delete_file(BENCH_FILE);
+}
+
+static void bench_memcpy_64(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) memcpy(copy_dst, copy_src, 64);
+}
+
+static void bench_memcpy_4k(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) memcpy(copy_dst, copy_src, 4096);
+}
+
+static void bench_memcpy_1m(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) memcpy(copy_dst, copy_src, BENCH_COPY_MAX);
+}
+
+static void bench_memset_4k(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) memset(copy_dst, (int)i, 4096);
+}
+
+static void bench_memset_64(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) memset(copy_dst, (int)i, 64);
+}
+
+static void bench_memset_1m(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) memset(copy_dst, (int)i, BENCH_COPY_MAX);
+}
+
+// The memcpy/memset variants from string.c, each called directly rather
+// than through whatever dispatch picked
+static const mem_impl_t *mem_variant(const char *name) {
+    const mem_impl_t *impls;
+    int count = mem_get_impls(&impls);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(impls[i].name, name) == 0) return impls[i].available ? &impls[i] : NULL;
+    }
+    return NULL;
+}
+
+static void variant_copy(const char *name, size_t size, uint64_t iters) {
+    const mem_impl_t *impl = mem_variant(name);
+    for (uint64_t i = 0; i < iters; i++) impl->copy(copy_dst, copy_src, size);
+}
+
+static void variant_set(const char *name, size_t size, uint64_t iters) {
+    const mem_impl_t *impl = mem_variant(name);
+    for (uint64_t i = 0; i < iters; i++) impl->set(copy_dst, (int)i, size);
+}
+
+#define MEM_VARIANT_BENCHES(v) \
+    static int bench_##v##_available(void) { return mem_variant(#v) != NULL; } \
+    static void bench_memcpy_##v##_64(uint64_t iters) { variant_copy(#v, 64, iters); } \
+    static void bench_memcpy_##v##_4k(uint64_t iters) { variant_copy(#v, 4096, iters); } \
+    static void bench_memcpy_##v##_1m(uint64_t iters) { variant_copy(#v, BENCH_COPY_MAX, iters); } \
+    static void bench_memset_##v##_64(uint64_t iters) { variant_set(#v, 64, iters); } \
+    static void bench_memset_##v##_4k(uint64_t iters) { variant_set(#v, 4096, iters); } \
+    static void bench_memset_##v##_1m(uint64_t iters) { variant_set(#v, BENCH_COPY_MAX, iters); } \
+    BENCH_IF("memcpy " #v " 64B", bench_memcpy_##v##_64, bench_##v##_available); \
+    BENCH_IF("memcpy " #v " 4KB", bench_memcpy_##v##_4k, bench_##v##_available); \
+    BENCH_IF("memcpy " #v " 1MB", bench_memcpy_##v##_1m, bench_##v##_available); \
+    BENCH_IF("memset " #v " 64B", bench_memset_##v##_64, bench_##v##_available); \
+    BENCH_IF("memset " #v " 4KB", bench_memset_##v##_4k, bench_##v##_available); \
+    BENCH_IF("memset " #v " 1MB", bench_memset_##v##_1m, bench_##v##_available)
+
+static void bench_fill_rect_small(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) fill_rect(&surface, 100, 100, 64, 64, 0xFF336699);
+}
+
+static void bench_fill_rect_large(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) fill_rect(&surface, 0, 0, 800, 600, 0xFF336699);
+}
+
+static void bench_clear_backbuffer(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) clear_backbuffer(&surface, 0xFF000000);
+}
+
+// Top-left quarter onto the bottom-right one, through the engine fill_rect uses
+static void bench_blit_copy(uint64_t iters) {
+    blit_surface_t target = { surface.framebuffer, surface.width, surface.height, surface.pitch, 0 };
+    for (uint64_t i = 0; i < iters; i++) {
+        blit_copy(&target, BENCH_SURFACE_W / 2, BENCH_SURFACE_H / 2, &target, 0, 0,
+                  BENCH_SURFACE_W / 2, BENCH_SURFACE_H / 2);
+    }
+}
+
+static void bench_draw_char_1x(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) draw_char_scaled(&surface, 'A' + (i % 26), 200, 200, 0xFFFFFFFF, 1);
+}
+
+static void bench_draw_char_3x(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) draw_char_scaled(&surface, 'A' + (i % 26), 200, 200, 0xFFFFFFFF, 3);
+}
+
+// The drawing half of kprint_ttf; its serial echo would land among the results
+static void bench_draw_string_ttf(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) {
+        draw_string_ttf(&surface, "Tiny64 benchmark", 20, 300, 0xFFFFFFFF, &global_ttf_font);
+    }
+}
+
+// Allocate and free a mix of sizes with a window of live blocks
+static void bench_kmalloc_churn(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) {
+        int slot = (int)(i % BENCH_CHURN_SLOTS);
+        churn_seed = churn_seed * 1103515245 + 12345;
+        if (churn_slots[slot]) kfree(churn_slots[slot]);
+        churn_slots[slot] = kmalloc(16 + ((churn_seed >> 16) % 4096));
+    }
+}
+
+static void bench_fs_read_file(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; i++) fs_read_file(BENCH_FILE, copy_dst, MAX_FILE_SIZE);
+}
+
+static uint16_t bench_glyph(void) {
+    return (uint16_t)ttf_get_glyph_index(&global_ttf_font, 'g');
+}
+
+// Flushes the cache first, so every iteration parses and rasterizes
+static void bench_glyph_cold(uint64_t iters) {
+    uint16_t glyph = bench_glyph();
+    for (uint64_t i = 0; i < iters; i++) {
+        ttf_cache_flush(&global_ttf_font);
+        ttf_release_glyph(ttf_get_glyph(&global_ttf_font, glyph, 8, 8, 0));
+    }
+}
+
+static void bench_glyph_cached(uint64_t iters) {
+    uint16_t glyph = bench_glyph();
+    for (uint64_t i = 0; i < iters; i++) {
+        ttf_release_glyph(ttf_get_glyph(&global_ttf_font, glyph, 8, 8, 0));
+    }
+}
+
+BENCH("memcpy 64B", bench_memcpy_64);
+BENCH("memcpy 4KB", bench_memcpy_4k);
+BENCH("memcpy 1MB", bench_memcpy_1m);
+BENCH("memset 64B", bench_memset_64);
+BENCH("memset 4KB", bench_memset_4k);
+BENCH("memset 1MB", bench_memset_1m);
+BENCH("fill_rect 64x64", bench_fill_rect_small);
+BENCH("fill_rect 800x600", bench_fill_rect_large);
+BENCH("clear_backbuffer 1024x768", bench_clear_backbuffer);
+BENCH("blit_copy 512x384", bench_blit_copy);
+BENCH("draw_char_scaled x1", bench_draw_char_1x);
+BENCH("draw_char_scaled x3", bench_draw_char_3x);
+BENCH("draw_string_ttf 16 chars", bench_draw_string_ttf);
+BENCH("kmalloc/kfree churn", bench_kmalloc_churn);
+BENCH("fs_read_file 4KB", bench_fs_read_file);
+BENCH("ttf_get_glyph cold", bench_glyph_cold);
+BENCH("ttf_get_glyph cached", bench_glyph_cached);
+
+MEM_VARIANT_BENCHES(movsq);
+MEM_VARIANT_BENCHES(erms);
+MEM_VARIANT_BENCHES(sse2);
+MEM_VARIANT_BENCHES(avx2);
+
+/* --- Command --- */
+
+int bench_run(const char *filter, char lines[][BENCH_LINE_LEN], int max_lines) {
+    int count = 0;
+    size_t filter_len = filter ? strlen(filter) : 0;
+
+    if (bench_setup() != 0) {
+        if (max_lines > 0) {
+            snprintf(lines[0], BENCH_LINE_LEN, "bench: out of memory");
+            count = 1;
+        }
+        return count;
+    }
+
+    for (int i = 0; i < bench_count() && count < max_lines; i++) {
+        const bench_t *bench = bench_get(i);
+        if (filter_len && strncmp(bench->name, filter, filter_len) != 0) continue;
+        if (bench->available && !bench->available()) continue;
+
+        bench_result_t result;
+        bench_run_one(bench, &result);
+        report(&result, lines[count++]);
+    }
+
+    bench_teardown();
+
+    if (count == 0 && max_lines > 0) {
+        snprintf(lines[count++], BENCH_LINE_LEN, "bench: nothing matches '%s'", filter);
+    }
+    return count;
+}
@@ -0,0 +1,180 @@
+#include "../include/kernel.h"
+#include "../include/compositor.h"
+#include "../include/blit.h"
+#include "../include/pmm.h"
+#include "../include/spinlock.h"
+#include "../hal/serial.h"
+
+// Window compositor
+// Window slots are static, so the damage hook can tell a window surface from
+// any other BootInfo (the benchmarks', the display) by address alone. The
+// z-order is a stack of slot pointers with the desktop at the bottom; it is
+// only changed, and only walked, under comp_lock. Damage is not queued here:
+// it goes straight into the display's dirty-rectangle list, and
+// flip_buffers() calls back into compose_rect() for each merged rectangle
+// before copying it to the screen.
+
+struct comp_window {
+    BootInfo surface;               // Window-sized; backbuffer == framebuffer
+    int x, y;                       // Screen position
+    unsigned int order;             // Pixel allocation, for pmm_free_pages
+    int in_use;
+};
+
+static comp_window_t windows[COMP_MAX_WINDOWS];
+static comp_window_t *stack[COMP_MAX_WINDOWS];     // [0] is the desktop
+static int depth = 0;
+static BootInfo *display = NULL;
+static spinlock_t comp_lock = SPINLOCK_INIT;
+
+static comp_window_t *window_alloc(int x, int y, int w, int h) {
+    comp_window_t *win = NULL;
+    for (int i = 0; i < COMP_MAX_WINDOWS; i++) {
+        if (!windows[i].in_use) {
+            win = &windows[i];
+            break;
+        }
+    }
+    if (!win || w <= 0 || h <= 0) return NULL;
+
+    unsigned int order = pmm_order_for_size((size_t)w * h * sizeof(uint32_t));
+    uint32_t *pixels = pmm_alloc_pages(order);
+    if (!pixels) return NULL;
+
+    win->surface.framebuffer = pixels;
+    win->surface.backbuffer = pixels;
+    win->surface.width = w;
+    win->surface.height = h;
+    win->surface.pitch = w;
+    win->x = x;
+    win->y = y;
+    win->order = order;
+    win->in_use = 1;
+    return win;
+}
+
+// Surface to window, without a lock: slots never move
+static comp_window_t *window_of(BootInfo *surface) {
+    uintptr_t p = (uintptr_t)surface;
+    if (p < (uintptr_t)&windows[0] || p >= (uintptr_t)&windows[COMP_MAX_WINDOWS]) return NULL;
+    comp_window_t *win = &windows[(p - (uintptr_t)&windows[0]) / sizeof(comp_window_t)];
+    return (&win->surface == surface && win->in_use) ? win : NULL;
+}
+
+/* --- Hooks called from graphics.c --- */
+
+static void damage_hook(BootInfo *surface, int x, int y, int w, int h) {
+    comp_window_t *win = window_of(surface);
+    if (!win) return;
+
+    // Clip to the window so a primitive that overhangs it damages nothing outside
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (w > (int)surface->width - x) w = surface->width - x;
+    if (h > (int)surface->height - y) h = surface->height - y;
+    if (w <= 0 || h <= 0) return;
+
+    mark_dirty_rect(display, win->x + x, win->y + y, w, h);
+}
+
+// Fill [x0, x1) x [y0, y1) from stack[level] and below. The window's part is
+// copied, and the up to four bands around it that it does not cover are
+// handed to the windows underneath; the desktop covers everything.
+static void compose_rect(const blit_surface_t *back, int level, int x0, int y0, int x1, int y1) {
+    for (; level >= 0; level--) {
+        comp_window_t *win = stack[level];
+        int wx1 = win->x + (int)win->surface.width;
+        int wy1 = win->y + (int)win->surface.height;
+        int ix0 = x0 > win->x ? x0 : win->x;
+        int iy0 = y0 > win->y ? y0 : win->y;
+        int ix1 = x1 < wx1 ? x1 : wx1;
+        int iy1 = y1 < wy1 ? y1 : wy1;
+        if (ix0 >= ix1 || iy0 >= iy1) continue;
+
+        blit_surface_t src = { win->surface.backbuffer, win->surface.width, win->surface.height,
+                               win->surface.pitch, 0 };
+        blit_copy(back, ix0, iy0, &src, ix0 - win->x, iy0 - win->y, ix1 - ix0, iy1 - iy0);
+
+        if (y0 < iy0) compose_rect(back, level - 1, x0, y0, x1, iy0);      // Above
+        if (iy1 < y1) compose_rect(back, level - 1, x0, iy1, x1, y1);      // Below
+        if (x0 < ix0) compose_rect(back, level - 1, x0, iy0, ix0, iy1);    // Left
+        if (ix1 < x1) compose_rect(back, level - 1, ix1, iy0, x1, iy1);    // Right
+        return;
+    }
+}
+
+static void compose_hook(BootInfo *info, int x0, int y0, int x1, int y1) {
+    blit_surface_t back = { info->backbuffer, info->width, info->height, info->pitch, 0 };
+
+    uint64_t flags = spin_lock_irqsave(&comp_lock);
+    compose_rect(&back, depth - 1, x0, y0, x1, y1);
+    spin_unlock_irqrestore(&comp_lock, flags);
+
+    cursor_refresh(info, x0, y0, x1, y1);
+}
+
+/* --- Windows --- */
+
+int compositor_init(BootInfo *info) {
+    if (display) return 0;
+    if (!info->backbuffer || info->backbuffer == info->framebuffer) return -1;
+
+    comp_window_t *desktop = window_alloc(0, 0, info->width, info->height);
+    if (!desktop) {
+        serial_write_string("[COMP] No memory for the desktop surface\n");
+        return -1;
+    }
+
+    blit_surface_t back = { info->backbuffer, info->width, info->height, info->pitch, 0 };
+    blit_surface_t surface = { desktop->surface.backbuffer, info->width, info->height, info->width, 0 };
+    blit_copy(&surface, 0, 0, &back, 0, 0, info->width, info->height);
+
+    stack[0] = desktop;
+    depth = 1;
+    display = info;
+    set_compositor_hooks(damage_hook, compose_hook);
+    serial_write_string("[COMP] Compositor running\n");
+    return 0;
+}
+
+int compositor_is_running(void) {
+    return display != NULL;
+}
+
+BootInfo *comp_desktop(void) {
+    return display ? &stack[0]->surface : NULL;
+}
+
+comp_window_t *comp_window_create(int x, int y, int w, int h) {
+    if (!display) return NULL;
+
+    uint64_t flags = spin_lock_irqsave(&comp_lock);
+    comp_window_t *win = depth < COMP_MAX_WINDOWS ? window_alloc(x, y, w, h) : NULL;
+    if (win) stack[depth++] = win;
+    spin_unlock_irqrestore(&comp_lock, flags);
+    if (!win) return NULL;
+
+    fill_rect(&win->surface, 0, 0, w, h, 0xFF000000);
+    return win;
+}
+
+void comp_window_destroy(comp_window_t *win) {
+    if (!win || !win->in_use || win == stack[0]) return;
+
+    uint64_t flags = spin_lock_irqsave(&comp_lock);
+    for (int i = 1; i < depth; i++) {
+        if (stack[i] != win) continue;
+        for (int j = i; j < depth - 1; j++) stack[j] = stack[j + 1];
+        depth--;
+        break;
+    }
+    win->in_use = 0;
+    spin_unlock_irqrestore(&comp_lock, flags);
+
+    mark_dirty_rect(display, win->x, win->y, win->surface.width, win->surface.height);
+    pmm_free_pages(win->surface.backbuffer, win->order);
+}
+
+BootInfo *comp_window_surface(comp_window_t *win) {
+    return win ? &win->surface : NULL;
+}
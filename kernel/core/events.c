@@ -0,0 +1,195 @@
+#include "../include/kernel.h"
+#include "../include/events.h"
+#include "../include/sched.h"
+#include "../hal/serial.h"
+#include "../hal/clock.h"
+#include "../hal/timer.h"
+
+// Event queue
+// A single-producer ring filled from IRQ context and drained by the desktop
+// loop. Soft timers are kept as absolute deadlines; when nothing is queued the
+// waiting thread sleeps until the earliest one (or halts the CPU directly on
+// the one-shot timer if the scheduler is not running).
+
+typedef struct {
+    uint64_t period_ns;
+    uint64_t next_ns;
+    int active;
+} soft_timer_t;
+
+static event_t queue[EVENT_QUEUE_SIZE];
+static volatile uint32_t queue_head = 0;   // Written by IRQs
+static volatile uint32_t queue_tail = 0;   // Written by the consumer
+static volatile uint32_t queue_dropped = 0;
+
+static soft_timer_t timers[EVENT_MAX_TIMERS];
+static uint64_t idle_ns = 0;
+static int events_ready = 0;
+static thread_t *volatile waiter = NULL;    // Thread blocked in events_wait()
+
+static void queue_push(uint8_t type, uint8_t data) {
+    uint32_t head = queue_head;
+    if (head - queue_tail >= EVENT_QUEUE_SIZE) {
+        queue_dropped++;
+        return;
+    }
+    event_t *ev = &queue[head % EVENT_QUEUE_SIZE];
+    ev->type = type;
+    ev->data = data;
+    ev->id = 0;
+    ev->time_ns = clock_ns();
+    queue_head = head + 1;
+}
+
+// Drain every byte the controller holds; bit 5 tells mouse from keyboard
+static void ps2_drain(void) {
+    uint8_t status;
+    while ((status = inb(0x64)) & 1) {
+        uint8_t data = inb(0x60);
+        queue_push((status & 0x20) ? EVENT_MOUSE : EVENT_KEY, data);
+    }
+    if (waiter && queue_head != queue_tail) thread_wakeup(waiter);
+}
+
+static int ps2_wait_write(void) {
+    for (int i = 0; i < 100000; i++) {
+        if (!(inb(0x64) & 2)) return 0;
+    }
+    return -1;
+}
+
+static int ps2_wait_read(void) {
+    for (int i = 0; i < 100000; i++) {
+        if (inb(0x64) & 1) return 0;
+    }
+    return -1;
+}
+
+void events_init(void) {
+    if (events_ready) return;
+
+    __asm__ volatile("cli");
+
+    // Turn on controller IRQ generation for both ports
+    if (ps2_wait_write() == 0) {
+        outb(0x64, 0x20);
+        if (ps2_wait_read() == 0) {
+            uint8_t config = inb(0x60) | 0x03;
+            if (ps2_wait_write() == 0) {
+                outb(0x64, 0x60);
+                if (ps2_wait_write() == 0) outb(0x60, config);
+            }
+        }
+    }
+
+    irq_set_handler(1, ps2_drain);
+    irq_set_handler(12, ps2_drain);
+    if (!sched_is_running()) timer_oneshot_init(NULL);
+    irq_unmask(1);
+    irq_unmask(12);
+
+    events_ready = 1;
+    __asm__ volatile("sti");
+
+    serial_write_string("[EVENTS] IRQ-driven input, idle timer via ");
+    serial_write_string(timer_source_name());
+    serial_write_string("\n");
+}
+
+/* --- Soft timers --- */
+
+int events_add_timer(uint32_t period_ms) {
+    for (int i = 0; i < EVENT_MAX_TIMERS; i++) {
+        if (!timers[i].active) {
+            timers[i].period_ns = (uint64_t)period_ms * 1000000ULL;
+            timers[i].next_ns = clock_ns() + timers[i].period_ns;
+            timers[i].active = 1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void events_remove_timer(int id) {
+    if (id >= 0 && id < EVENT_MAX_TIMERS) timers[id].active = 0;
+}
+
+// Fire at most one due timer; a late timer skips missed periods
+static int timer_poll(event_t *ev, uint64_t now) {
+    for (int i = 0; i < EVENT_MAX_TIMERS; i++) {
+        soft_timer_t *t = &timers[i];
+        if (!t->active || now < t->next_ns) continue;
+
+        t->next_ns += t->period_ns;
+        if (t->next_ns <= now) t->next_ns = now + t->period_ns;
+
+        ev->type = EVENT_TIMER;
+        ev->data = 0;
+        ev->id = (uint16_t)i;
+        ev->time_ns = now;
+        return 1;
+    }
+    return 0;
+}
+
+static uint64_t next_deadline(void) {
+    uint64_t earliest = UINT64_MAX;
+    for (int i = 0; i < EVENT_MAX_TIMERS; i++) {
+        if (timers[i].active && timers[i].next_ns < earliest) earliest = timers[i].next_ns;
+    }
+    return earliest;
+}
+
+/* --- Consumer API --- */
+
+int events_pending(void) {
+    return queue_head != queue_tail;
+}
+
+int events_poll(event_t *ev) {
+    uint32_t tail = queue_tail;
+    if (tail != queue_head) {
+        *ev = queue[tail % EVENT_QUEUE_SIZE];
+        queue_tail = tail + 1;
+        return 1;
+    }
+    return timer_poll(ev, clock_ns());
+}
+
+void events_wait(event_t *ev) {
+    for (;;) {
+        if (events_poll(ev)) return;
+
+        uint64_t deadline = next_deadline();
+        if (!sched_is_running() && deadline != UINT64_MAX) timer_arm(deadline);
+
+        // Check-then-sleep with IRQs off: a byte arriving in between either
+        // finds 'waiter' set or, without threads, wakes the hlt (sti only
+        // takes effect after hlt starts).
+        __asm__ volatile("cli");
+        ps2_drain(); // Controllers that never raise IRQs still make progress
+        if (events_pending()) {
+            __asm__ volatile("sti");
+            continue;
+        }
+
+        uint64_t start = clock_ns();
+        if (sched_is_running()) {
+            waiter = thread_current();
+            thread_sleep_until(deadline);
+            waiter = NULL;
+            __asm__ volatile("sti");
+        } else {
+            __asm__ volatile("sti; hlt");
+        }
+        idle_ns += clock_ns() - start;
+    }
+}
+
+uint64_t events_idle_ns(void) {
+    return idle_ns;
+}
+
+uint32_t events_dropped(void) {
+    return queue_dropped;
+}
@@ -0,0 +1,281 @@
+#include "../include/kernel.h"
+#include "../include/jobs.h"
+#include "../include/spinlock.h"
+#include "../hal/serial.h"
+#include "../hal/smp.h"
+
+// Work-stealing job system
+// One Chase-Lev deque per CPU. The BSP's deque is shared by every thread on
+// the BSP, so owner operations run with interrupts off to keep them atomic
+// with respect to preemption; on the APs the worker loop is the only owner.
+
+#define DEQUE_MASK  (JOBS_DEQUE_SIZE - 1)
+
+typedef struct {
+    job_fn_t fn;
+    void *arg;
+    job_counter_t *counter;
+} job_t;
+
+typedef struct {
+    volatile int64_t top;           // Thieves take from here
+    volatile int64_t bottom;        // Owner pushes and pops here
+    job_t jobs[JOBS_DEQUE_SIZE];
+    volatile int sleeping;          // Halted waiting for work
+    uint64_t executed;
+    uint64_t stolen;
+} __attribute__((aligned(64))) worker_t;
+
+static worker_t workers[SMP_MAX_CPUS];
+static int num_workers = 1;
+static int jobs_ready = 0;
+
+/* --- Chase-Lev deque --- */
+
+static int deque_push(worker_t *w, const job_t *job) {
+    int64_t b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+    if (b - t >= JOBS_DEQUE_SIZE) return 0;
+
+    w->jobs[b & DEQUE_MASK] = *job;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+static int deque_pop(worker_t *w, job_t *out) {
+    int64_t b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&w->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&w->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    *out = w->jobs[b & DEQUE_MASK];
+    if (t == b) {
+        // Last job: race the thieves for it
+        int won = __atomic_compare_exchange_n(&w->top, &t, t + 1, 0,
+                                              __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return 1;
+}
+
+static int deque_steal(worker_t *w, job_t *out) {
+    int64_t t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&w->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) return 0;
+
+    job_t job = w->jobs[t & DEQUE_MASK];
+    if (!__atomic_compare_exchange_n(&w->top, &t, t + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    *out = job;
+    return 1;
+}
+
+static int deque_empty(worker_t *w) {
+    return __atomic_load_n(&w->bottom, __ATOMIC_ACQUIRE) <= __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+}
+
+/* --- Workers --- */
+
+static inline int worker_index(void) {
+    return smp_this_cpu();
+}
+
+static void run_job(worker_t *w, const job_t *job) {
+    job->fn(job->arg);
+    w->executed++;
+    __atomic_sub_fetch(&job->counter->pending, 1, __ATOMIC_RELEASE);
+}
+
+// Own deque first (newest job, still hot in cache), then steal the oldest
+static int find_job(int self, job_t *out) {
+    worker_t *w = &workers[self];
+    uint64_t flags = irq_save();
+    int found = deque_pop(w, out);
+    irq_restore(flags);
+    if (found) return 1;
+
+    for (int i = 1; i < num_workers; i++) {
+        int victim = (self + i) % num_workers;
+        if (deque_steal(&workers[victim], out)) {
+            w->stolen++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int any_work(void) {
+    for (int i = 0; i < num_workers; i++) {
+        if (!deque_empty(&workers[i])) return 1;
+    }
+    return 0;
+}
+
+static void wake_one_worker(int self) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (int i = 1; i < num_workers; i++) {
+        int target = (self + i) % num_workers;
+        if (target != 0 && __atomic_load_n(&workers[target].sleeping, __ATOMIC_RELAXED)) {
+            smp_wake(target);
+            return;
+        }
+    }
+}
+
+// Runs forever on each AP, entered through smp_call()
+static void worker_main(void *arg) {
+    worker_t *w = arg;
+    int self = worker_index();
+    job_t job;
+
+    for (;;) {
+        if (find_job(self, &job)) {
+            run_job(w, &job);
+            continue;
+        }
+
+        // Publish that we are going to sleep, then look once more with
+        // interrupts off so a wake IPI sent in between ends the hlt
+        __atomic_store_n(&w->sleeping, 1, __ATOMIC_SEQ_CST);
+        __asm__ volatile("cli");
+        if (any_work()) {
+            __asm__ volatile("sti");
+        } else {
+            __asm__ volatile("sti; hlt");
+        }
+        __atomic_store_n(&w->sleeping, 0, __ATOMIC_RELAXED);
+    }
+}
+
+/* --- Public API --- */
+
+void jobs_init(void) {
+    if (jobs_ready) return;
+
+    int cpus = smp_cpu_count();
+    if (cpus > SMP_MAX_CPUS) cpus = SMP_MAX_CPUS;
+    if (cpus <= 1) {
+        serial_write_string("[JOBS] Single CPU, jobs run inline\n");
+        return;
+    }
+
+    num_workers = cpus;
+    jobs_ready = 1;
+    for (int i = 1; i < num_workers; i++) {
+        if (smp_call(i, worker_main, &workers[i]) != 0) {
+            serial_write_string("[JOBS] Could not start a worker\n");
+        }
+    }
+
+    serial_write_string("[JOBS] Work-stealing workers on ");
+    serial_write_dec(num_workers);
+    serial_write_string(" CPUs\n");
+}
+
+int jobs_worker_count(void) {
+    return jobs_ready ? num_workers : 1;
+}
+
+void job_spawn(job_counter_t *counter, job_fn_t fn, void *arg) {
+    if (!jobs_ready) {
+        fn(arg);
+        return;
+    }
+
+    int self = worker_index();
+    worker_t *w = &workers[self];
+    job_t job = { fn, arg, counter };
+    __atomic_add_fetch(&counter->pending, 1, __ATOMIC_RELAXED);
+
+    uint64_t flags = irq_save();
+    int queued = deque_push(w, &job);
+    irq_restore(flags);
+
+    if (queued) {
+        wake_one_worker(self);
+    } else {
+        run_job(w, &job);   // Deque full: no parallelism left to gain anyway
+    }
+}
+
+void job_wait(job_counter_t *counter) {
+    if (!jobs_ready) return;
+
+    int self = worker_index();
+    job_t job;
+    while (__atomic_load_n(&counter->pending, __ATOMIC_ACQUIRE) > 0) {
+        if (find_job(self, &job)) {
+            run_job(&workers[self], &job);
+        } else {
+            cpu_relax();
+        }
+    }
+}
+
+/* --- parallel_for --- */
+
+typedef struct {
+    job_range_fn_t fn;
+    void *arg;
+    int count;
+    int grain;
+    volatile int next;      // First index not yet claimed
+} range_job_t;
+
+// Each job keeps claiming chunks until the range is used up, so a slow
+// worker never holds the others back
+static void range_job_main(void *arg) {
+    range_job_t *range = arg;
+    for (;;) {
+        int start = __atomic_fetch_add(&range->next, range->grain, __ATOMIC_RELAXED);
+        if (start >= range->count) return;
+        int end = start + range->grain;
+        if (end > range->count) end = range->count;
+        range->fn(range->arg, start, end);
+    }
+}
+
+void parallel_for(int count, int grain, job_range_fn_t fn, void *arg) {
+    if (count <= 0) return;
+
+    int nworkers = jobs_worker_count();
+    if (nworkers == 1) {
+        fn(arg, 0, count);
+        return;
+    }
+
+    if (grain <= 0) grain = (count + nworkers * 4 - 1) / (nworkers * 4);
+    if (grain < 1) grain = 1;
+    int chunks = (count + grain - 1) / grain;
+    if (chunks == 1) {
+        fn(arg, 0, count);
+        return;
+    }
+
+    range_job_t range = { fn, arg, count, grain, 0 };
+    job_counter_t counter = JOB_COUNTER_INIT;
+    int jobs = chunks < nworkers ? chunks : nworkers;
+
+    // The caller is one of the workers, so queue one job fewer and join in
+    for (int i = 1; i < jobs; i++) job_spawn(&counter, range_job_main, &range);
+    range_job_main(&range);
+    job_wait(&counter);
+}
+
+uint64_t jobs_executed(int worker) {
+    return worker >= 0 && worker < SMP_MAX_CPUS ? workers[worker].executed : 0;
+}
+
+uint64_t jobs_stolen(int worker) {
+    return worker >= 0 && worker < SMP_MAX_CPUS ? workers[worker].stolen : 0;
+}
@@ -1,5 +1,11 @@
 #include "../include/kernel.h"
 #include "../hal/serial.h"
+#include "../hal/paging.h"
+#include "../hal/acpi.h"
+#include "../hal/clock.h"
+#include "../hal/apic.h"
+#include "../hal/smp.h"
+#include "../hal/fpu.h"
 #include "../include/fs.h"
 #include "../include/keyboard.h"
 #include "../include/ttf.h"
@@ -9,6 +15,18 @@
 #include "../drivers/rtl8139.h"
 #include "../drivers/ac97.h"
 #include "../drivers/ide.h"
+#include "../include/pmm.h"
+#include "../include/bench.h"
+#include "../include/events.h"
+#include "../include/sched.h"
+#include "../include/jobs.h"
+#include "../include/klog.h"
+#include "../include/prof.h"
+#include "../include/trace.h"
+#include "../include/metrics.h"
+#include "../include/top.h"
+#include "../include/blit.h"
+#include "../include/compositor.h"
 #include <stdbool.h>
 #include <string.h>
 
@@ -26,12 +44,16 @@ typedef struct {
 extern int fseek(FILE* stream, long offset, int origin);
 extern long ftell(FILE* stream);
 extern int sprintf(char* str, const char* format, ...);
+extern int snprintf(char* str, size_t size, const char* format, ...);
 
 // SEEK constants
 #define SEEK_SET 0
 #define SEEK_CUR 1
 #define SEEK_END 2
 
+// Log records shown by the dmesg command
+#define DMESG_LINES 16
+
 // File operations from doom_stubs.c
 extern FILE* fopen(const char* filename, const char* mode);
 extern int fclose(FILE* stream);
@@ -48,6 +70,40 @@ void enter_graphics_mode(BootInfo *info);
 
 // Doom declarations
 void doomgeneric_Create(int argc, char **argv);
+void doom_handle_key_press(unsigned char scancode, int pressed);
+
+// Doom thread: loads the WAD, then renders until the terminal sets doom_quit
+static thread_t *volatile doom_thread = NULL;
+static volatile int doom_quit = 0;
+static comp_window_t *doom_window = NULL;     // Under the compositor
+
+static void doom_thread_main(void *arg) {
+  BootInfo *info = (BootInfo *)arg;
+
+  char* doom_args[] = {"doom", "-iwad", "doom.wad"};
+  doomgeneric_SetBootInfo(info);
+  doomgeneric_Create(3, doom_args);
+
+  // Initialize Doom's main code (this does WAD loading, etc.)
+  extern void doomgeneric_InitMain(void);
+  doomgeneric_InitMain();
+
+  while (!doom_quit) {
+    // I_FinishUpdate() draws the frame into the window; present it
+    doomgeneric_Tick();
+    flip_buffers(info);
+  }
+
+  serial_write_string("[DOOM] Thread exiting\n");
+  if (doom_window) {
+    extern void DG_SetSurface(BootInfo *surface);
+    DG_SetSurface(NULL);
+    comp_window_destroy(doom_window);
+    doom_window = NULL;
+    flip_buffers(info);
+  }
+  doom_thread = NULL;
+}
 
 // Enhanced kprint that uses TTF if available
 void kprint_auto(BootInfo *info, const char *str, int x, int y, uint32_t color) {
@@ -102,6 +158,46 @@ int is_qemu(void) {
 #endif
 }
 
+// Deferred log formatting, off every hot path
+static void klogd_main(void *arg) {
+  (void)arg;
+  for (;;) {
+    klog_flush();
+    thread_sleep_ms(50);
+  }
+}
+
+// Desktop background rows [start, end): a subtle vertical gradient
+static void desktop_gradient_rows(void *arg, int start, int end) {
+  BootInfo *info = arg;
+  for (uint32_t y = start; y < (uint32_t)end; y++) {
+    uint32_t gradient_color = 0xFFEBEBEB - (y * 0x00010101);
+    fill_rect(info, 0, y, info->width, 1, gradient_color);
+  }
+}
+
+// CPUID brand string (leaves 0x80000002-4), empty if unsupported
+static void cpu_brand_string(char out[49]) {
+  uint32_t regs[12];
+  uint32_t max_leaf;
+  __asm__ volatile("cpuid" : "=a"(max_leaf) : "a"(0x80000000) : "ebx", "ecx", "edx");
+  out[0] = 0;
+  if (max_leaf < 0x80000004) return;
+
+  for (uint32_t i = 0; i < 3; i++) {
+    __asm__ volatile("cpuid"
+                     : "=a"(regs[i * 4]), "=b"(regs[i * 4 + 1]), "=c"(regs[i * 4 + 2]), "=d"(regs[i * 4 + 3])
+                     : "a"(0x80000002 + i), "c"(0));
+  }
+  memcpy(out, regs, 48);
+  out[48] = 0;
+
+  // Vendors pad the string with leading spaces
+  char *start = out;
+  while (*start == ' ') start++;
+  if (start != out) memmove(out, start, strlen(start) + 1);
+}
+
 // Ensure outw is declared (may be implemented elsewhere)
 // Properly define outw using inline assembly for x86 platforms
 static inline void outw(uint16_t port, uint16_t val) {
@@ -175,9 +271,46 @@ void kernel_main(BootInfo *info) {
   // Initialize serial port for console output FIRST
   serial_init();
 
+  // Enable SSE/AVX state (XSAVE) before memcpy dispatch checks XCR0
+  fpu_init();
+
+  // Select memcpy/memset and blit variants for this CPU
+  mem_init_dispatch();
+  blit_init_dispatch();
+
+  // Take ownership of conventional RAM before anything allocates
+  pmm_init(info);
+
+  // Switch to kernel page tables (huge pages, WC framebuffer, stack guard)
+  paging_init(info);
+
+  // Firmware tables, then a calibrated TSC for every timestamp after this
+  acpi_init(info);
+  clock_init();
+
   // Initialize IDT for keyboard interrupts in boot terminal
   init_idt();
 
+  // Route IRQs through the IOAPIC and EOI via the local APIC when possible
+  apic_init();
+
+  // Serial output through the TX ring from here on; writers no longer poll
+  serial_enable_irq();
+
+  // From here on the boot flow is a thread; Doom and friends get their own
+  sched_init();
+
+  // Bring up the application processors; they idle until handed work
+  smp_init(info);
+  jobs_init();
+
+  // Per-CPU log rings; klogd formats records and echoes them to serial
+  klog_init();
+  thread_create("klogd", klogd_main, NULL, SCHED_PRIO_LOW);
+
+  // Trace rings for the APs (the BSP has been tracing since boot)
+  trace_init();
+
   // PHASE 1: TEXT-MODE BOOT TERMINAL
   // Show cool ASCII art and boot terminal before graphics
   show_boot_terminal(info);
@@ -349,6 +482,9 @@ void enter_graphics_mode(BootInfo *info) {
   const uint32_t BOOT_TIMEOUT =
       is_qemu() ? 0x80000 : 0x20FFFFF; // Much shorter timeout in QEMU
 
+  // Boot phases are traced around their work, not the watchdog delays
+  TRACE_BEGIN("boot: display");
+
   // Initialize double buffering
   init_double_buffer(info);
 
@@ -363,6 +499,7 @@ void enter_graphics_mode(BootInfo *info) {
   // Progress bar background
   draw_rect(info, 50, 80, 300, 12, 0xFF333333);
   flip_buffers(info); // Show initial progress bar
+  TRACE_END("boot: display");
 
   // --- PHASE 1: Memory Management ---
   boot_watchdog += 0x100000; // Update watchdog
@@ -382,10 +519,21 @@ void enter_graphics_mode(BootInfo *info) {
   if (boot_watchdog > BOOT_TIMEOUT)
     goto boot_timeout;
 
+  TRACE_BEGIN("boot: memory");
   init_heap();
-  kprint(info, "[OK] Memory Manager (1MB heap allocated)", 50, 110, 0xFF00FF00);
+  {
+    // The heap starts small and grows from the PMM; this is its size now
+    char mem_msg[64];
+    size_t heap_total, heap_used, heap_free;
+    get_heap_stats(&heap_total, &heap_used, &heap_free);
+    snprintf(mem_msg, sizeof(mem_msg), "[OK] Memory Manager (%uMB RAM, %uKB heap)",
+             (unsigned int)((pmm_get_total_pages() * PMM_PAGE_SIZE) >> 20),
+             (unsigned int)(heap_total >> 10));
+    kprint(info, mem_msg, 50, 110, 0xFF00FF00);
+  }
   draw_rect(info, 50, 80, 75, 12, 0xFF00AA00); // 25% progress
   flip_buffers(info);
+  TRACE_END("boot: memory");
 
   // --- PHASE 2: CPU Architecture ---
   boot_watchdog += 0x100000;
@@ -403,10 +551,12 @@ void enter_graphics_mode(BootInfo *info) {
   if (boot_watchdog > BOOT_TIMEOUT)
     goto boot_timeout;
 
+  TRACE_BEGIN("boot: cpu");
   init_gdt();
   kprint(info, "[OK] Global Descriptor Table", 50, 135, 0xFF00FF00);
   draw_rect(info, 50, 80, 120, 12, 0xFF00AA00); // 40% progress
   flip_buffers(info);
+  TRACE_END("boot: cpu");
 
   for (volatile uint32_t i = 0;
        i < (is_qemu() ? 0x3FFF : 0x2FFFFF) && boot_watchdog < BOOT_TIMEOUT;
@@ -421,6 +571,7 @@ void enter_graphics_mode(BootInfo *info) {
   flip_buffers(info);
 
   // --- PHASE 3: Input Subsystems ---
+  TRACE_BEGIN("boot: input");
   kprint(info, "[    ] Input Subsystems", 50, 185, 0xFFFFFF00);
   flip_buffers(info);
   for (volatile uint32_t i = 0; i < (is_qemu() ? 0x1FFF : 0x1FFFFF); i++)
@@ -479,7 +630,9 @@ void enter_graphics_mode(BootInfo *info) {
   serial_write_string("[BOOT] About to call kprint for keyboard success\n");
   kprint(info, "[OK] PS/2 Keyboard", 50, 250, 0xFF00FF00);
   serial_write_string("[BOOT] kprint completed, keyboard phase done\n");
+  TRACE_END("boot: input");
 
+  TRACE_BEGIN("boot: drivers");
   kprint(info, "[    ] Filesystem", 50, 300, 0xFFFFFF00);
   serial_write_string("[BOOT] About to call fs_init()\n");
   
@@ -525,6 +678,7 @@ void enter_graphics_mode(BootInfo *info) {
     serial_write_string("[BOOT] TTF font loading failed - using bitmap fonts\n");
     kprint(info, "[FAIL] TTF Font System", 50, 325, 0xFFFF0000);
   }
+  TRACE_END("boot: drivers");
 
   // --- PHASE 4: Graphics & Display ---
   serial_write_string("[BOOT] Starting Phase 4: Graphics & Display\n");
@@ -547,6 +701,7 @@ void enter_graphics_mode(BootInfo *info) {
     goto boot_timeout;
 
   // Initialize cursor position
+  TRACE_BEGIN("boot: graphics");
   mouse_x = info->width / 2;
   mouse_y = info->height / 2;
   draw_cursor(info, mouse_x, mouse_y);
@@ -555,6 +710,7 @@ void enter_graphics_mode(BootInfo *info) {
   kprint(info, "[OK] Mouse Cursor", 50, 260, 0xFF00FF00);
   draw_rect(info, 50, 80, 285, 12, 0xFF00AA00); // 95% progress
   flip_buffers(info);
+  TRACE_END("boot: graphics");
 
   // --- PHASE 5: System Validation ---
   boot_watchdog += 0x100000;
@@ -571,6 +727,7 @@ void enter_graphics_mode(BootInfo *info) {
     goto boot_timeout;
 
   // Memory allocation test
+  TRACE_BEGIN("boot: validation");
   serial_write_string("[MEMORY_TEST] Testing kmalloc(256)...\n");
   void *test_ptr = kmalloc(256);
   if (test_ptr) {
@@ -585,6 +742,7 @@ void enter_graphics_mode(BootInfo *info) {
 
   draw_rect(info, 50, 80, 300, 12, 0xFF00AA00); // 100% progress
   flip_buffers(info);
+  TRACE_END("boot: validation");
 
   // --- FINAL INITIALIZATION COMPLETE ---
   kprint(info, "[COMPLETE] Tiny64 OS Ready!", 50, 450, 0xFF00FF00);
@@ -629,15 +787,10 @@ boot_timeout:
   }
 
   /* TRANSITION TO DESKTOP ENVIRONMENT */
+  TRACE_BEGIN("boot: desktop");
 
   // Clear backbuffer and draw desktop background with gradient
-  for (uint32_t y = 0; y < info->height; y++) {
-    uint32_t gradient_color = 0xFFEBEBEB - (y * 0x00010101); // Subtle gradient
-    for (uint32_t x = 0; x < info->width; x++) {
-      uint32_t* fb = info->backbuffer ? info->backbuffer : info->framebuffer;
-      fb[y * info->pitch + x] = gradient_color;
-    }
-  }
+  parallel_for(info->height, 16, desktop_gradient_rows, info);
 
   // Draw taskbar with improved styling
   uint32_t tb_h = info->height / 12;
@@ -662,6 +815,8 @@ boot_timeout:
       }
     }
   }
+  mark_dirty_rect(info, start_cx - start_radius, start_cy - start_radius,
+                  2 * start_radius + 1, 2 * start_radius + 1);
 
   // Start button border (simple rectangle approximation)
   draw_rect(info, start_cx - start_radius, start_cy - start_radius,
@@ -674,6 +829,7 @@ boot_timeout:
 
   // Initialize Windows XP Style Desktop
   init_winxp_desktop(info);
+  TRACE_END("boot: desktop");
 
   // Keep keyboard interrupts disabled - polling works reliably
   // keyboard_enable_interrupt();
@@ -686,14 +842,29 @@ boot_timeout:
   int tw_w = 600;
   int tw_h = 400;
 
+  // Under the compositor the terminal is a window of its own; its text and
+  // the clock no longer touch the desktop, and the desktop is never redrawn
+  BootInfo *term = info;
+  BootInfo *desktop = info;
+  if (compositor_init(info) == 0) {
+    desktop = comp_desktop();
+    comp_window_t *term_window = comp_window_create(tw_x, tw_y, tw_w, tw_h);
+    if (term_window) {
+      term = comp_window_surface(term_window);
+      draw_winxp_terminal(term, 0, 0, tw_w, tw_h);
+      tw_x = 0; // Terminal coordinates are window-relative from here
+      tw_y = 0;
+    }
+  }
+
   // Terminal content starts below the title bar (24px) and has some padding
-  kprint_auto(info, "Tiny64 Terminal v1.0", tw_x + 35, tw_y + 15, 0xFF000000);
-  kprint_auto(info, "Type 'help' for available commands", tw_x + 35, tw_y + 35, 0xFF333333);
+  kprint_auto(term, "Tiny64 Terminal v1.0", tw_x + 35, tw_y + 15, 0xFF000000);
+  kprint_auto(term, "Type 'help' for available commands", tw_x + 35, tw_y + 35, 0xFF333333);
 
   // Initialize terminal with compact prompt inside Windows XP terminal window
   int prompt_x = tw_x + 10;
   int prompt_y = tw_y + 60; // Position below title bar and help text
-  draw_char_scaled(info, '>', prompt_x, prompt_y, 0xFF00AA00, 1); // Green prompt character (scale adjusted later)
+  draw_char_scaled(term, '>', prompt_x, prompt_y, 0xFF00AA00, 1); // Green prompt character (scale adjusted later)
 
   // Flip to show the complete desktop
   flip_buffers(info);
@@ -721,7 +892,7 @@ boot_timeout:
   int max_lines = terminal_content_height / line_height;
 
   // Redraw prompt at computed scale so it matches character size
-  draw_char_scaled(info, '>', prompt_x, prompt_y, 0xFF00AA00, scale);
+  draw_char_scaled(term, '>', prompt_x, prompt_y, 0xFF00AA00, scale);
   flip_buffers(info);
 
   int term_x = prompt_x + char_width; // Current text position (after prompt)
@@ -737,18 +908,39 @@ boot_timeout:
   int mouse_test_start_time = 0;
 
   // Activity indicators
-  int activity_counter = 0;
   int blink_state = 0;
+  int cursor_visible = 1;
+
+  // PS/2 bytes arrive by IRQ from here on; periodic work runs off soft timers
+  events_init();
+  int activity_timer = events_add_timer(1000);
+  int cursor_timer = events_add_timer(500);
+  // Periodically request a mouse sample so QEMU/hosts that don't stream
+  // continuously still produce bytes (helps when mouse is idle).
+  int mouse_timer = events_add_timer(100);
+  int dirty = 0;
 
   for (;;) {
     // use the outer term_x and term_y
 
-    uint8_t status = inb(0x64);
-    if (status & 1) { // Output buffer full
-      uint8_t data = inb(0x60);
+    event_t ev;
+    events_wait(&ev);
+
+    if (ev.type == EVENT_KEY || ev.type == EVENT_MOUSE) {
+      uint8_t data = ev.data;
+      dirty = 1;
 
-      if (status & 0x20) { // Bit 5 (AUX) set = mouse data
+      if (ev.type == EVENT_MOUSE) {
         mouse_handle_byte(info, data);
+      } else if (doom_thread) {
+        // Doom has the keyboard; ESC hands it back to the terminal
+        if (data == 0x01) {
+          doom_quit = 1;
+          kprint_auto(term, "Doom exited.", prompt_x, term_y, 0xFFFFFF00);
+          term_y += line_height;
+        } else if (data != 0xE0) {
+          doom_handle_key_press(data & 0x7F, !(data & 0x80));
+        }
       } else { // Keyboard data - instant processing with key state tracking
         // Convert scancode to character with shift/caps lock support
         static uint8_t extended = 0;
@@ -778,12 +970,12 @@ boot_timeout:
             // Draw caps lock indicator
             uint32_t indicator_color =
                 caps_lock ? 0xFFFF0000 : 0xFFCCCCCC; // Red if on, gray if off
-            fill_rect(info, 460, 275, 30, 15,
+            fill_rect(term, tw_x + 260, tw_y + 175, 30, 15,
                       indicator_color); // Small indicator in terminal title bar
             if (caps_lock) {
-              kprint(info, "CAPS", 465, 280, 0xFFFFFFFF);
+              kprint(term, "CAPS", tw_x + 265, tw_y + 180, 0xFFFFFFFF);
             } else {
-              kprint(info, "    ", 465, 280, 0xFFCCCCCC); // Clear when off
+              kprint(term, "    ", tw_x + 265, tw_y + 180, 0xFFCCCCCC); // Clear when off
             }
           } else if (!extended) {
             // Only process key presses (make codes), not repeats or releases
@@ -965,7 +1157,7 @@ boot_timeout:
               // Move to new line and show new prompt
               term_y += line_height;
               term_x = prompt_x;
-              draw_char_scaled(info, '>', term_x, term_y, 0xFF00AA00, scale);
+              draw_char_scaled(term, '>', term_x, term_y, 0xFF00AA00, scale);
               term_x += char_width;
 
               // Reset character count for new line
@@ -978,10 +1170,10 @@ boot_timeout:
             // Display the character and update command buffer
             if (c >= 32 && c <= 126) { // Printable characters
               // Clear any cursor at this position first (full glyph height)
-              fill_rect(info, term_x, term_y, 1, line_height, 0xFF000000);
+              fill_rect(term, term_x, term_y, 1, line_height, 0xFF000000);
 
               // Draw scaled terminal character (white text)
-              draw_char_scaled(info, c, term_x, term_y, 0xFFFFFFFF, scale);
+              draw_char_scaled(term, c, term_x, term_y, 0xFFFFFFFF, scale);
 
               // Append to command buffer if space allows
         if (cmd_len < (int)sizeof(command_buffer) - 1) {
@@ -1004,17 +1196,12 @@ boot_timeout:
                 // Check if we need to scroll
                 if (term_y >= (tw_y + tw_h - line_height)) {
                   // Scroll up: clear terminal area and reset cursor
-                  for (int cy = tw_y + 70; cy < tw_y + tw_h - 10; cy++) {
-                    for (int cx = tw_x + 5; cx < tw_x + tw_w - 5; cx++) {
-                      uint32_t *fb = info->backbuffer ? info->backbuffer : info->framebuffer;
-                      fb[cy * info->pitch + cx] = 0xFFFFFFFF; // White background
-                    }
-                  }
+                  fill_rect(term, tw_x + 5, tw_y + 70, tw_w - 10, tw_h - 80, 0xFFFFFFFF); // White background
                   term_y = tw_y + 85; // Reset to near top of terminal area
                   flip_buffers(info);
 
                   // Redraw prompt at new position
-                  draw_char_scaled(info, '>', prompt_x, term_y, 0xFF00AA00, scale);
+                  draw_char_scaled(term, '>', prompt_x, term_y, 0xFF00AA00, scale);
                   term_x = prompt_x + char_width;
                 }
               }
@@ -1030,12 +1217,12 @@ boot_timeout:
                     char *p = listbuf;
                     while (*p) {
                       // Print each file on its own line
-                      kprint_auto(info, p, prompt_x, term_y, 0xFF00FF00);
+                      kprint_auto(term, p, prompt_x, term_y, 0xFF00FF00);
                       term_y += line_height;
                       p += strlen(p) + 1;
                     }
                     } else {
-                    kprint_auto(info, "(no files)", prompt_x, term_y, 0xFFFFFFFF);
+                    kprint_auto(term, "(no files)", prompt_x, term_y, 0xFFFFFFFF);
                     term_y += line_height;
                   }
                 } else if (strncmp(command_buffer, "cat ", 4) == 0) {
@@ -1049,16 +1236,16 @@ boot_timeout:
                     char *nl;
                     while ((nl = strchr(line, '\n')) != NULL) {
                       *nl = '\0';
-                      kprint_auto(info, line, prompt_x, term_y, 0xFFFFFFFF);
+                      kprint_auto(term, line, prompt_x, term_y, 0xFFFFFFFF);
                       term_y += line_height;
                       line = nl + 1;
                     }
                     if (*line) {
-                      kprint_auto(info, line, prompt_x, term_y, 0xFFFFFFFF);
+                      kprint_auto(term, line, prompt_x, term_y, 0xFFFFFFFF);
                       term_y += line_height;
                     }
               } else {
-                    kprint_auto(info, "File not found", prompt_x, term_y, 0xFFFF0000);
+                    kprint_auto(term, "File not found", prompt_x, term_y, 0xFFFF0000);
                     term_y += line_height;
                   }
                 } else if (strncmp(command_buffer, "write ", 6) == 0) {
@@ -1070,20 +1257,20 @@ boot_timeout:
                     const char *fname = args;
                     const char *text = space + 1;
                     fs_write_file(fname, (const uint8_t *)text, strlen(text));
-                    kprint_auto(info, "Wrote file", prompt_x, term_y, 0xFF00FF00);
+                    kprint_auto(term, "Wrote file", prompt_x, term_y, 0xFF00FF00);
                     term_y += line_height;
             } else {
-                    kprint_auto(info, "Usage: write <file> <text>", prompt_x, term_y, 0xFFFF0000);
+                    kprint_auto(term, "Usage: write <file> <text>", prompt_x, term_y, 0xFFFF0000);
                     term_y += line_height;
             }
                 } else if (strcmp(command_buffer, "wadtest") == 0) {
                   // Test if embedded WAD data exists
-                  kprint_auto(info, "Testing embedded WAD data...", prompt_x, term_y, 0xFFFFFF00);
+                  kprint_auto(term, "Testing embedded WAD data...", prompt_x, term_y, 0xFFFFFF00);
                   term_y += line_height;
 
                   FILE* test_file = fopen("doom.wad", "rb");
                   if (test_file) {
-                    kprint_auto(info, "SUCCESS: doom.wad found!", prompt_x, term_y, 0xFF00FF00);
+                    kprint_auto(term, "SUCCESS: doom.wad found!", prompt_x, term_y, 0xFF00FF00);
                     term_y += line_height;
                     // Get file size
                     fseek(test_file, 0, SEEK_END);
@@ -1091,11 +1278,11 @@ boot_timeout:
                     fseek(test_file, 0, SEEK_SET);
                     char size_msg[64];
                     sprintf(size_msg, "File size: %ld bytes", file_size);
-                    kprint_auto(info, size_msg, prompt_x, term_y, 0xFFFFFFFF);
+                    kprint_auto(term, size_msg, prompt_x, term_y, 0xFFFFFFFF);
                     term_y += line_height;
                     fclose(test_file);
                   } else {
-                    kprint_auto(info, "FAILED: doom.wad not found", prompt_x, term_y, 0xFFFF0000);
+                    kprint_auto(term, "FAILED: doom.wad not found", prompt_x, term_y, 0xFFFF0000);
                     term_y += line_height;
 
                     // Check embedded WAD function
@@ -1107,65 +1294,68 @@ boot_timeout:
                     if (wad_data != NULL && wad_size > 0) {
                       char size_buf[64];
                       sprintf(size_buf, "WAD found! Size: %zu bytes", wad_size);
-                      kprint_auto(info, size_buf, prompt_x, term_y, 0xFF00FF00);
+                      kprint_auto(term, size_buf, prompt_x, term_y, 0xFF00FF00);
                       term_y += line_height;
 
                       // Check first few bytes to verify it's a valid WAD
                       if (wad_size >= 4 && wad_data[0] == 'I' && wad_data[1] == 'W' && wad_data[2] == 'A' && wad_data[3] == 'D') {
-                        kprint_auto(info, "Valid IWAD signature detected", prompt_x, term_y, 0xFF00FF00);
+                        kprint_auto(term, "Valid IWAD signature detected", prompt_x, term_y, 0xFF00FF00);
                         term_y += line_height;
                       } else {
-                        kprint_auto(info, "WARNING: Invalid WAD signature", prompt_x, term_y, 0xFFFF8800);
+                        kprint_auto(term, "WARNING: Invalid WAD signature", prompt_x, term_y, 0xFFFF8800);
                         term_y += line_height;
                       }
                     } else {
-                      kprint_auto(info, "ERROR: WAD data not available", prompt_x, term_y, 0xFFFF0000);
+                      kprint_auto(term, "ERROR: WAD data not available", prompt_x, term_y, 0xFFFF0000);
                       term_y += line_height;
                     }
                   }
                   flip_buffers(info);
                   continue;
+                } else if (strcmp(command_buffer, "doom") == 0 && doom_thread) {
+                  kprint_auto(term, "Doom is already running (ESC to quit)", prompt_x, term_y, 0xFFFFFF00);
+                  term_y += line_height;
                 } else if (strcmp(command_buffer, "doom") == 0) {
                   // Check if WAD file exists with debug output
-                  kprint_auto(info, "Checking for embedded Doom WAD...", prompt_x, term_y, 0xFFFFFF00);
+                  kprint_auto(term, "Checking for embedded Doom WAD...", prompt_x, term_y, 0xFFFFFF00);
                   term_y += line_height;
                   flip_buffers(info);
 
                   // Try to open embedded WAD files
                   FILE* wad_test = fopen("doom.wad", "rb");
                   if (wad_test) {
-                    kprint_auto(info, "doom.wad found in embedded data!", prompt_x, term_y, 0xFF00FF00);
+                    kprint_auto(term, "doom.wad found in embedded data!", prompt_x, term_y, 0xFF00FF00);
                     term_y += line_height;
                   } else {
-                    kprint_auto(info, "doom.wad not found, trying doom1.wad...", prompt_x, term_y, 0xFFFFFF00);
+                    kprint_auto(term, "doom.wad not found, trying doom1.wad...", prompt_x, term_y, 0xFFFFFF00);
                     term_y += line_height;
                     wad_test = fopen("doom1.wad", "rb");
                     if (wad_test) {
-                      kprint_auto(info, "doom.wad found in embedded data!", prompt_x, term_y, 0xFF00FF00);
+                      kprint_auto(term, "doom.wad found in embedded data!", prompt_x, term_y, 0xFF00FF00);
                       term_y += line_height;
                     } else {
-                      kprint_auto(info, "doom.wad not found, trying doom2.wad...", prompt_x, term_y, 0xFFFFFF00);
+                      kprint_auto(term, "doom.wad not found, trying doom2.wad...", prompt_x, term_y, 0xFFFFFF00);
                       term_y += line_height;
                       wad_test = fopen("doom2.wad", "rb");
                       if (wad_test) {
-                        kprint_auto(info, "doom2.wad found in embedded data!", prompt_x, term_y, 0xFF00FF00);
+                        kprint_auto(term, "doom2.wad found in embedded data!", prompt_x, term_y, 0xFF00FF00);
                         term_y += line_height;
                       }
                     }
                   }
 
                   if (!wad_test) {
-                    kprint_auto(info, "ERROR: No embedded Doom WAD found!", prompt_x, term_y, 0xFFFF0000);
+                    kprint_auto(term, "ERROR: No embedded Doom WAD found!", prompt_x, term_y, 0xFFFF0000);
                     term_y += line_height;
-                    kprint_auto(info, "WAD embedding may have failed during build", prompt_x, term_y, 0xFFFF0000);
+                    kprint_auto(term, "WAD embedding may have failed during build", prompt_x, term_y, 0xFFFF0000);
                     term_y += line_height;
-                    kprint_auto(info, "Check build output for embedding errors", prompt_x, term_y, 0xFFFFFF00);
+                    kprint_auto(term, "Check build output for embedding errors", prompt_x, term_y, 0xFFFFFF00);
                     term_y += line_height;
                     flip_buffers(info);
                     continue;
                   } else {
                     fclose(wad_test);
-                    kprint_auto(info, "Launching Doom with embedded WAD...", prompt_x, term_y, 0xFF00FF00);
+                    kprint_auto(term, "Launching Doom with embedded WAD...", prompt_x, term_y, 0xFF00FF00);
                     term_y += line_height;
                     flip_buffers(info);
                   }
@@ -1184,97 +1374,235 @@ boot_timeout:
                     doom_window_h = info->height - doom_window_y - 10;
                   }
 
+                  // Doom gets a window of its own when it can; the frame is
+                  // then drawn in window coordinates
+                  extern void DG_SetWindowPosition(int x, int y);
+                  extern void DG_SetSurface(BootInfo *surface);
+                  BootInfo *doom_target = info;
+                  int frame_x = doom_window_x;
+                  int frame_y = doom_window_y;
+                  doom_window = comp_window_create(doom_window_x - 2, doom_window_y - 22,
+                                                   doom_window_w + 4, doom_window_h + 24);
+                  if (doom_window) {
+                    doom_target = comp_window_surface(doom_window);
+                    frame_x = 2;
+                    frame_y = 22;
+                  } else if (compositor_is_running()) {
+                    kprint_auto(term, "ERROR: No room for the Doom window", prompt_x, term_y, 0xFFFF0000);
+                    term_y += line_height;
+                    flip_buffers(info);
+                    continue;
+                  }
+
                   // Draw Doom window frame
-                  fill_rect(info, doom_window_x - 2, doom_window_y - 22, doom_window_w + 4, doom_window_h + 24, 0xFF666666); // Window border
-                  fill_rect(info, doom_window_x, doom_window_y - 20, doom_window_w, 18, 0xFF000080); // Title bar
-                  kprint_auto(info, "Doom", doom_window_x + 5, doom_window_y - 18, 0xFFFFFFFF);
+                  fill_rect(doom_target, frame_x - 2, frame_y - 22, doom_window_w + 4, doom_window_h + 24, 0xFF666666); // Window border
+                  fill_rect(doom_target, frame_x, frame_y - 20, doom_window_w, 18, 0xFF000080); // Title bar
+                  kprint_auto(doom_target, "Doom", frame_x + 5, frame_y - 18, 0xFFFFFFFF);
 
                   // Set Doom window position
-                  extern void DG_SetWindowPosition(int x, int y);
-                  DG_SetWindowPosition(doom_window_x, doom_window_y);
-
-                  // Initialize Doom with windowed rendering
-                  char* doom_args[] = {"doom", "-iwad", "doom.wad"};
-                  doomgeneric_SetBootInfo(info);
-                  doomgeneric_Create(3, doom_args);
-                  
-                  // Initialize Doom's main code (this does WAD loading, etc.)
-                  extern void doomgeneric_InitMain(void);
-                  doomgeneric_InitMain();
-
-                  // Main Doom loop with windowed rendering
-                  while (1) {
-                      doomgeneric_Tick();
-
-                      // Draw Doom frame to framebuffer
-                      DG_DrawFrame();
-
-                      // Re-draw terminal window on top (to keep it visible)
-                      draw_terminal_window(info, tw_x, tw_y, tw_w, tw_h);
-                      kprint_auto(info, "Tiny6 Terminal v1.0", tw_x + 35, tw_y + 15, 0xFF000000);
-                      kprint_auto(info, "Type 'help' for available commands", tw_x + 35, tw_y + 35, 0xFF333333);
-                      draw_char_scaled(info, '>', prompt_x, prompt_y, 0xFF00AA00, scale);
-
-                      flip_buffers(info);
-
-                      // Check for escape key to exit Doom
-                      if (last_key_pressed == 0x01) { // ESC key
-                          kprint_auto(info, "Doom exited", prompt_x, term_y, 0xFFFF0000);
-                          term_y += line_height;
-                          break;
-                      }
+                  DG_SetSurface(doom_window ? doom_target : NULL);
+                  DG_SetWindowPosition(frame_x, frame_y);
+
+                  // Doom runs in its own thread; the terminal stays live and
+                  // forwards keys to it until ESC
+                  doom_quit = 0;
+                  doom_thread = thread_create("doom", doom_thread_main, info, SCHED_PRIO_NORMAL);
+                  if (!doom_thread) {
+                    kprint_auto(term, "ERROR: Could not start the Doom thread", prompt_x, term_y, 0xFFFF0000);
+                    term_y += line_height;
+                    DG_SetSurface(NULL);
+                    comp_window_destroy(doom_window);
+                    doom_window = NULL;
                   }
-
-                  kprint_auto(info, "Doom exited.", prompt_x, term_y, 0xFFFFFF00);
-                  term_y += line_height;
                   flip_buffers(info);
                 } else if (strcmp(command_buffer, "echo") == 0) {
                   // Echo command - just print arguments
                   if (cmd_len > 5) { // "echo " is 5 chars
-                    kprint_auto(info, command_buffer + 5, prompt_x, term_y, 0xFFFFFFFF);
+                    kprint_auto(term, command_buffer + 5, prompt_x, term_y, 0xFFFFFFFF);
                     term_y += line_height;
                   }
                 } else if (strcmp(command_buffer, "mkdir") == 0) {
                   // Directory creation (placeholder for now)
-                  kprint_auto(info, "mkdir: Directory creation not implemented yet", prompt_x, term_y, 0xFFFFFF00);
+                  kprint_auto(term, "mkdir: Directory creation not implemented yet", prompt_x, term_y, 0xFFFFFF00);
                   term_y += line_height;
                 } else if (strcmp(command_buffer, "rm") == 0) {
                   // File removal (placeholder for now)
-                  kprint_auto(info, "rm: File removal not implemented yet", prompt_x, term_y, 0xFFFFFF00);
+                  kprint_auto(term, "rm: File removal not implemented yet", prompt_x, term_y, 0xFFFFFF00);
                   term_y += line_height;
                 } else if (strcmp(command_buffer, "meminfo") == 0) {
-                  // Memory information
+                  // Memory information (heap figures from the metrics registry)
                   char mem_buf[64];
-                  sprintf(mem_buf, "Memory: 1MB heap allocated");
-                  kprint_auto(info, mem_buf, prompt_x, term_y, 0xFF00FF00);
+                  uint64_t heap_frag = metric_read(METRIC_HEAP_FRAG);
+                  snprintf(mem_buf, sizeof(mem_buf), "RAM: %uKB free of %uKB",
+                           (unsigned int)(pmm_get_free_pages() * (PMM_PAGE_SIZE / 1024)),
+                           (unsigned int)(pmm_get_total_pages() * (PMM_PAGE_SIZE / 1024)));
+                  kprint_auto(term, mem_buf, prompt_x, term_y, 0xFF00FF00);
+                  term_y += line_height;
+                  snprintf(mem_buf, sizeof(mem_buf), "Heap: %uKB used, %uKB free of %uKB",
+                           (unsigned int)(metric_read(METRIC_HEAP_USED) / 1024),
+                           (unsigned int)(metric_read(METRIC_HEAP_FREE) / 1024),
+                           (unsigned int)(metric_read(METRIC_HEAP_TOTAL) / 1024));
+                  kprint_auto(term, mem_buf, prompt_x, term_y, 0xFF00FF00);
+                  term_y += line_height;
+                  snprintf(mem_buf, sizeof(mem_buf), "Heap fragmentation: %u.%u pct",
+                           (unsigned int)(heap_frag / 10), (unsigned int)(heap_frag % 10));
+                  kprint_auto(term, mem_buf, prompt_x, term_y, 0xFF00FF00);
                   term_y += line_height;
                 } else if (strcmp(command_buffer, "cpuinfo") == 0) {
                   // CPU information
-                  kprint_auto(info, "CPU: x86_64 Long Mode", prompt_x, term_y, 0xFF00FF00);
+                  char cpu_line[96];
+                  char brand[49];
+                  cpu_brand_string(brand);
+                  snprintf(cpu_line, sizeof(cpu_line), "CPU: %s", brand[0] ? brand : "x86_64 Long Mode");
+                  kprint_auto(term, cpu_line, prompt_x, term_y, 0xFF00FF00);
+                  term_y += line_height;
+                  kprint_auto(term, "Architecture: 64-bit UEFI boot", prompt_x, term_y, 0xFF00FF00);
                   term_y += line_height;
-                  kprint_auto(info, "Architecture: 64-bit UEFI boot", prompt_x, term_y, 0xFF00FF00);
+                  snprintf(cpu_line, sizeof(cpu_line), "%d CPU(s) online", smp_cpu_count());
+                  kprint_auto(term, cpu_line, prompt_x, term_y, 0xFF00FF00);
+                  term_y += line_height;
+                  for (int c = 0; c < SMP_MAX_CPUS; c++) {
+                    percpu_t *cpu = smp_cpu(c);
+                    if (!cpu || !cpu->online) continue;
+                    uint64_t cpu_irqs = 0;
+                    for (int v = 0; v < METRIC_IRQ_VECTORS; v++) cpu_irqs += metric_read_cpu(METRIC_IRQ(v), c);
+                    snprintf(cpu_line, sizeof(cpu_line), "  CPU %d: LAPIC %u, %s, %u IRQs", cpu->index,
+                             (unsigned int)cpu->lapic_id, cpu->index == 0 ? "BSP" : "AP", (unsigned int)cpu_irqs);
+                    kprint_auto(term, cpu_line, prompt_x, term_y, 0xFFCCCCCC);
+                    term_y += line_height;
+                  }
+                } else if (strcmp(command_buffer, "bench") == 0 || strncmp(command_buffer, "bench ", 6) == 0) {
+                  // Registered microbenchmarks, optionally only those matching a name prefix
+                  const char *filter = command_buffer[5] ? command_buffer + 6 : "";
+                  kprint_auto(term, "Running benchmarks (JSON lines on serial)...", prompt_x, term_y, 0xFFFFFF00);
+                  term_y += line_height;
+                  flip_buffers(info);
+                  static char bench_lines[BENCH_MAX_LINES][BENCH_LINE_LEN];
+                  int result_count = bench_run(filter, bench_lines, BENCH_MAX_LINES);
+                  for (int i = 0; i < result_count; i++) {
+                    kprint_auto(term, bench_lines[i], prompt_x, term_y, 0xFF00FF00);
+                    term_y += line_height;
+                  }
+                } else if (strcmp(command_buffer, "dmesg") == 0) {
+                  // Newest kernel log records from every CPU
+                  klog_record_t records[DMESG_LINES];
+                  char log_line[KLOG_LINE_LEN];
+                  int log_count = klog_snapshot(records, DMESG_LINES);
+                  for (int i = 0; i < log_count; i++) {
+                    klog_format(&records[i], log_line, sizeof(log_line));
+                    uint32_t color = records[i].level <= KLOG_WARN ? 0xFFFF6060 : 0xFFCCCCCC;
+                    kprint_auto(term, log_line, prompt_x, term_y, color);
+                    term_y += line_height;
+                  }
+                  if (log_count == 0) {
+                    kprint_auto(term, "Kernel log is empty", prompt_x, term_y, 0xFFCCCCCC);
+                    term_y += line_height;
+                  }
+                } else if (strcmp(command_buffer, "trace") == 0 || strncmp(command_buffer, "trace ", 6) == 0) {
+                  // TSC trace rings: status, start/stop/clear, or Chrome JSON over serial
+                  const char *sub = command_buffer[5] ? command_buffer + 6 : "";
+                  char trace_line[96];
+                  if (strcmp(sub, "dump") == 0) {
+                    kprint_auto(term, "Writing trace JSON to serial...", prompt_x, term_y, 0xFFFFFF00);
+                    term_y += line_height;
+                    flip_buffers(info);
+                    int events = trace_dump();
+                    snprintf(trace_line, sizeof(trace_line), "%d events written (load in chrome://tracing)", events);
+                    kprint_auto(term, trace_line, prompt_x, term_y, 0xFF00FF00);
+                  } else if (strcmp(sub, "start") == 0) {
+                    trace_start();
+                    kprint_auto(term, "Tracing started", prompt_x, term_y, 0xFF00FF00);
+                  } else if (strcmp(sub, "stop") == 0) {
+                    trace_stop();
+                    kprint_auto(term, "Tracing stopped", prompt_x, term_y, 0xFF00FF00);
+                  } else if (strcmp(sub, "clear") == 0) {
+                    trace_clear();
+                    kprint_auto(term, "Trace rings cleared", prompt_x, term_y, 0xFF00FF00);
+                  } else {
+                    snprintf(trace_line, sizeof(trace_line), "Tracing %s, %u events recorded",
+                             trace_is_running() ? "on" : "off", (unsigned int)trace_events_recorded());
+                    kprint_auto(term, trace_line, prompt_x, term_y, 0xFFCCCCCC);
+                    term_y += line_height;
+                    kprint_auto(term, "Usage: trace [dump|start|stop|clear]", prompt_x, term_y, 0xFFCCCCCC);
+                  }
+                  term_y += line_height;
+                } else if (strcmp(command_buffer, "prof") == 0 || strncmp(command_buffer, "prof ", 5) == 0) {
+                  // Sampling profiler: start [hz], stop, or folded stacks over serial
+                  const char *sub = command_buffer[4] ? command_buffer + 5 : "";
+                  char prof_line[96];
+                  if (strncmp(sub, "start", 5) == 0) {
+                    int hz = 0;
+                    for (const char *p = sub + 5; *p; p++) {
+                      if (*p >= '0' && *p <= '9') hz = hz * 10 + (*p - '0');
+                    }
+                    if (hz == 0) hz = PROF_DEFAULT_HZ;
+                    if (prof_start(hz) == 0) {
+                      snprintf(prof_line, sizeof(prof_line), "Profiling at %d Hz", hz);
+                      kprint_auto(term, prof_line, prompt_x, term_y, 0xFF00FF00);
+                    } else {
+                      kprint_auto(term, "prof: no timer or sample memory", prompt_x, term_y, 0xFFFF0000);
+                    }
+                  } else if (strcmp(sub, "stop") == 0) {
+                    prof_stop();
+                    snprintf(prof_line, sizeof(prof_line), "Profiler stopped, %u samples",
+                             (unsigned int)prof_sample_count());
+                    kprint_auto(term, prof_line, prompt_x, term_y, 0xFF00FF00);
+                  } else if (strcmp(sub, "dump") == 0) {
+                    kprint_auto(term, "Writing profile to serial...", prompt_x, term_y, 0xFFFFFF00);
+                    term_y += line_height;
+                    flip_buffers(info);
+                    int stacks = prof_dump();
+                    snprintf(prof_line, sizeof(prof_line), "%d stacks written (scripts/prof_symbolize.py)", stacks);
+                    kprint_auto(term, prof_line, prompt_x, term_y, 0xFF00FF00);
+                  } else {
+                    snprintf(prof_line, sizeof(prof_line), "Profiler %s, %u samples, %u dropped",
+                             prof_is_running() ? "running" : "stopped",
+                             (unsigned int)prof_sample_count(), (unsigned int)prof_dropped());
+                    kprint_auto(term, prof_line, prompt_x, term_y, 0xFFCCCCCC);
+                    term_y += line_height;
+                    kprint_auto(term, "Usage: prof [start [hz]|stop|dump]", prompt_x, term_y, 0xFFCCCCCC);
+                  }
+                  term_y += line_height;
+                } else if (strcmp(command_buffer, "top") == 0) {
+                  // Live metrics window, redrawn by the one-second timer
+                  if (top_is_open()) {
+                    top_close(info);
+                    kprint_auto(term, "top: closed", prompt_x, term_y, 0xFFCCCCCC);
+                  } else {
+                    top_open(info, info->width - TOP_WIDTH - 10, 10);
+                    kprint_auto(term, "top: type 'top' again to close", prompt_x, term_y, 0xFFCCCCCC);
+                  }
                   term_y += line_height;
                 } else if (strcmp(command_buffer, "netinfo") == 0) {
                   // Network information
-                  kprint_auto(info, "Network: RTL8139 driver loaded", prompt_x, term_y, 0xFF00FF00);
+                  kprint_auto(term, "Network: RTL8139 driver loaded", prompt_x, term_y, 0xFF00FF00);
+                  term_y += line_height;
+                  kprint_auto(term, "Status: Ethernet interface available", prompt_x, term_y, 0xFF00FF00);
+                  term_y += line_height;
+                  char net_line[64];
+                  snprintf(net_line, sizeof(net_line), "RX: %u packets, %u bytes",
+                           (unsigned int)metric_read(METRIC_NET_RX_PACKETS), (unsigned int)metric_read(METRIC_NET_RX_BYTES));
+                  kprint_auto(term, net_line, prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "Status: Ethernet interface available", prompt_x, term_y, 0xFF00FF00);
+                  snprintf(net_line, sizeof(net_line), "TX: %u packets, %u bytes",
+                           (unsigned int)metric_read(METRIC_NET_TX_PACKETS), (unsigned int)metric_read(METRIC_NET_TX_BYTES));
+                  kprint_auto(term, net_line, prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
                 } else if (strcmp(command_buffer, "usbinfo") == 0) {
                   // USB information
-                  kprint_auto(info, "USB: UHCI driver loaded", prompt_x, term_y, 0xFF00FF00);
+                  kprint_auto(term, "USB: UHCI driver loaded", prompt_x, term_y, 0xFF00FF00);
                   term_y += line_height;
-                  kprint_auto(info, "Status: USB 1.1 host controller ready", prompt_x, term_y, 0xFF00FF00);
+                  kprint_auto(term, "Status: USB 1.1 host controller ready", prompt_x, term_y, 0xFF00FF00);
                   term_y += line_height;
                 } else if (strcmp(command_buffer, "play") == 0) {
                   // Audio playback (placeholder)
-                  kprint_auto(info, "play: Audio playback not implemented yet", prompt_x, term_y, 0xFFFFFF00);
+                  kprint_auto(term, "play: Audio playback not implemented yet", prompt_x, term_y, 0xFFFFFF00);
                   term_y += line_height;
-                  kprint_auto(info, "AC97 audio driver is loaded and ready", prompt_x, term_y, 0xFF00FF00);
+                  kprint_auto(term, "AC97 audio driver is loaded and ready", prompt_x, term_y, 0xFF00FF00);
                   term_y += line_height;
                 } else if (strcmp(command_buffer, "reboot") == 0) {
                   // System reboot
-                  kprint_auto(info, "Rebooting system...", prompt_x, term_y, 0xFFFF0000);
+                  kprint_auto(term, "Rebooting system...", prompt_x, term_y, 0xFFFF0000);
                   term_y += line_height;
                   flip_buffers(info);
                   // Simple reboot via keyboard controller
@@ -1282,61 +1610,66 @@ boot_timeout:
                   outb(0x64, 0xFE); // Pulse reset line
                 } else if (strcmp(command_buffer, "shutdown") == 0) {
                   // System shutdown
-                  kprint_auto(info, "Shutting down system...", prompt_x, term_y, 0xFFFF0000);
+                  kprint_auto(term, "Shutting down system...", prompt_x, term_y, 0xFFFF0000);
                   term_y += line_height;
                   flip_buffers(info);
                   // QEMU shutdown
                   outw(0x604, 0x2000);
                   while (1); // Halt if shutdown fails
                 } else if (strcmp(command_buffer, "help") == 0 || strcmp(command_buffer, "?") == 0) {
-                  kprint_auto(info, "Available commands:", prompt_x, term_y, 0xFFFFFFFF);
+                  kprint_auto(term, "Available commands:", prompt_x, term_y, 0xFFFFFFFF);
+                  term_y += line_height;
+                  kprint_auto(term, "  ls              - List files", prompt_x, term_y, 0xFFCCCCCC);
+                  term_y += line_height;
+                  kprint_auto(term, "  cat <file>      - Display file contents", prompt_x, term_y, 0xFFCCCCCC);
+                  term_y += line_height;
+                  kprint_auto(term, "  write <file> <text> - Create/write file", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  ls              - List files", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  echo <text>     - Display text", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  cat <file>      - Display file contents", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  mkdir <dir>     - Create directory", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  write <file> <text> - Create/write file", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  rm <file>       - Remove file", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  echo <text>     - Display text", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  meminfo         - Show memory information", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  mkdir <dir>     - Create directory", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  bench [prefix]  - Run microbenchmarks", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  rm <file>       - Remove file", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  dmesg           - Show recent kernel log", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  meminfo         - Show memory information", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  trace [dump]    - Trace status / export to serial", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  cpuinfo         - Show CPU information", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  prof [start|stop|dump] - Sampling profiler", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  netinfo         - Show network status", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  cpuinfo         - Show CPU information", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  usbinfo         - Show USB status", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  top             - Toggle the live system monitor", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  play <file>     - Play audio file", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  netinfo         - Show network status", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  doom            - Launch Doom (if available)", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  usbinfo         - Show USB status", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  reboot          - Reboot the system", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  play <file>     - Play audio file", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  shutdown        - Shutdown the system", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  doom            - Launch Doom (if available)", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  clear/cls       - Clear terminal", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  reboot          - Reboot the system", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
-                  kprint_auto(info, "  help/?          - Show this help", prompt_x, term_y, 0xFFCCCCCC);
+                  kprint_auto(term, "  shutdown        - Shutdown the system", prompt_x, term_y, 0xFFCCCCCC);
+                  term_y += line_height;
+                  kprint_auto(term, "  clear/cls       - Clear terminal", prompt_x, term_y, 0xFFCCCCCC);
+                  term_y += line_height;
+                  kprint_auto(term, "  help/?          - Show this help", prompt_x, term_y, 0xFFCCCCCC);
                   term_y += line_height;
                 } else if (strcmp(command_buffer, "clear") == 0 || strcmp(command_buffer, "cls") == 0) {
                   // Clear the terminal area
-                  for (int cy = tw_y + 70; cy < tw_y + tw_h - 10; cy++) {
-                    for (int cx = tw_x + 5; cx < tw_x + tw_w - 5; cx++) {
-                      uint32_t *fb = info->backbuffer ? info->backbuffer : info->framebuffer;
-                      fb[cy * info->pitch + cx] = 0xFFFFFFFF; // White background
-                    }
-                  }
+                  fill_rect(term, tw_x + 5, tw_y + 70, tw_w - 10, tw_h - 80, 0xFFFFFFFF); // White background
                   term_y = tw_y + 85; // Reset to prompt position
-                  draw_char_scaled(info, '>', prompt_x, term_y, 0xFF00AA00, scale);
+                  draw_char_scaled(term, '>', prompt_x, term_y, 0xFF00AA00, scale);
                   term_x = prompt_x + char_width;
                   flip_buffers(info);
                 } else {
-                  kprint_auto(info, "Unknown command. Type 'help' for available commands.", prompt_x, term_y, 0xFFFF0000);
+                  kprint_auto(term, "Unknown command. Type 'help' for available commands.", prompt_x, term_y, 0xFFFF0000);
                   term_y += line_height;
           }
         }
@@ -1350,7 +1683,7 @@ boot_timeout:
               term_x = prompt_x;
 
               // Draw prompt (scaled)
-              draw_char_scaled(info, '>', prompt_x, term_y, 0xFF00AA00, scale);
+              draw_char_scaled(term, '>', prompt_x, term_y, 0xFF00AA00, scale);
               term_x = prompt_x + char_width;
               flip_buffers(info);
             } else if (c == '\b' && term_x > prompt_x + char_width) { // Backspace
@@ -1361,44 +1694,37 @@ boot_timeout:
               }
               // Move cursor back and clear the character
               term_x -= char_width;
-              draw_char_scaled(info, ' ', term_x, term_y, 0xFFFFFFFF, scale);
+              draw_char_scaled(term, ' ', term_x, term_y, 0xFFFFFFFF, scale);
               flip_buffers(info);
             }
           }
         }
       }
+    } else if (ev.type == EVENT_TIMER) {
+      if (ev.id == activity_timer) {
+        // Activity indicator in taskbar (blinking effect)
+        blink_state = !blink_state;
+        uint32_t indicator_color = blink_state ? 0xFF00FF00 : 0xFF22262A;
+        fill_rect(desktop, info->width - 40, tb_y + 5, 30, tb_h - 10,
+                  indicator_color);
+        top_update(info);
+        dirty = 1;
+      } else if (ev.id == cursor_timer) {
+        // Cursor blinking in terminal (compact size for new font)
+        cursor_visible = !cursor_visible;
+        // Draw cursor as a simple vertical bar (black when visible on white bg)
+        uint32_t cursor_color = cursor_visible ? 0xFF000000 : 0xFFFFFFFF;
+        fill_rect(term, term_x, term_y + 2, 1, 12, cursor_color);
+        dirty = 1;
+      } else if (ev.id == mouse_timer) {
+        mouse_request_sample();
+      }
     }
 
-    // Activity indicator in taskbar (blinking effect)
-    activity_counter++;
-    if (activity_counter % (is_qemu() ? 500 : 3000) == 0) {
-      blink_state = !blink_state;
-      uint32_t indicator_color = blink_state ? 0xFF00FF00 : 0xFF22262A;
-      fill_rect(info, info->width - 40, tb_y + 5, 30, tb_h - 10,
-                indicator_color);
-    }
-
-    // Periodically request a mouse sample so QEMU/hosts that don't stream
-    // continuously still produce bytes (helps when mouse is idle).
-    if (activity_counter % (is_qemu() ? 50 : 500) == 0) {
-      mouse_request_sample();
-    }
-
-    // Cursor blinking in terminal (compact size for new font)
-    if (activity_counter % (is_qemu() ? 300 : 1800) == 0) {
-      static int cursor_visible = 1;
-      cursor_visible = !cursor_visible;
-      // Draw cursor as a simple vertical bar (black when visible on white bg)
-      uint32_t cursor_color = cursor_visible ? 0xFF000000 : 0xFFFFFFFF;
-      fill_rect(info, term_x, term_y + 2, 1, 12, cursor_color);
-      
+    // Present once per burst of events rather than once per event
+    if (dirty && !events_pending()) {
+      flip_buffers(info);
+      dirty = 0;
     }
-
-    // Flip buffers to show all updates at once
-    flip_buffers(info);
-
-    // Gentle CPU usage
-    for (volatile int k = 0; k < (is_qemu() ? 60 : 300); k++)
-      ;
   }
 }
\ No newline at end of file
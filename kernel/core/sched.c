@@ -0,0 +1,384 @@
+#include "../include/kernel.h"
+#include "../include/sched.h"
+#include "../include/pmm.h"
+#include "../include/string.h"
+#include "../include/trace.h"
+#include "../hal/serial.h"
+#include "../hal/clock.h"
+#include "../hal/paging.h"
+#include "../hal/timer.h"
+#include "../hal/fpu.h"
+
+// Kernel thread scheduler
+// Every scheduler structure is only touched with interrupts disabled, which
+// is enough on a single CPU. Threads switch with context_switch() (callee-saved
+// registers + RFLAGS) plus an XSAVE/XRSTOR of every enabled FPU/SSE/AVX
+// component, kept in the top FPU_STATE_MAX bytes of each thread's stack.
+
+extern void context_switch(uint64_t *old_rsp, uint64_t new_rsp);
+
+static thread_t boot_thread;                // The flow that called sched_init()
+static uint8_t boot_fpu_state[FPU_STATE_MAX] __attribute__((aligned(FPU_STATE_ALIGN)));
+static thread_t *idle_thread = NULL;
+static thread_t *current = NULL;
+
+static thread_t *run_head[SCHED_NUM_PRIOS];
+static thread_t *run_tail[SCHED_NUM_PRIOS];
+static thread_t *sleepers = NULL;           // Sorted by wake_ns
+static thread_t *all_threads = NULL;
+static thread_t *zombies = NULL;            // Exited, stack not yet freed
+
+static volatile int need_resched = 0;
+static int preempt_count = 0;
+static int sched_running = 0;
+static int next_thread_id = 0;
+static uint64_t slice_end_ns = 0;
+
+/* --- Queues --- */
+
+static void run_enqueue(thread_t *t) {
+    t->state = THREAD_READY;
+    t->next = NULL;
+    if (run_tail[t->priority]) {
+        run_tail[t->priority]->next = t;
+    } else {
+        run_head[t->priority] = t;
+    }
+    run_tail[t->priority] = t;
+}
+
+static thread_t *run_dequeue(void) {
+    for (int p = 0; p < SCHED_NUM_PRIOS; p++) {
+        thread_t *t = run_head[p];
+        if (t) {
+            run_head[p] = t->next;
+            if (!run_head[p]) run_tail[p] = NULL;
+            t->next = NULL;
+            return t;
+        }
+    }
+    return NULL;
+}
+
+// Highest priority (lowest number) with a ready thread, or SCHED_NUM_PRIOS
+static int run_best_priority(void) {
+    for (int p = 0; p < SCHED_NUM_PRIOS; p++) {
+        if (run_head[p]) return p;
+    }
+    return SCHED_NUM_PRIOS;
+}
+
+static void sleep_insert(thread_t *t) {
+    thread_t **link = &sleepers;
+    while (*link && (*link)->wake_ns <= t->wake_ns) link = &(*link)->next;
+    t->next = *link;
+    *link = t;
+}
+
+static void sleep_remove(thread_t *t) {
+    for (thread_t **link = &sleepers; *link; link = &(*link)->next) {
+        if (*link == t) {
+            *link = t->next;
+            t->next = NULL;
+            return;
+        }
+    }
+}
+
+static int current_priority(void) {
+    return current == idle_thread ? SCHED_NUM_PRIOS : current->priority;
+}
+
+/* --- Stacks --- */
+
+#define STACK_ORDER 4   // 16 pages = THREAD_STACK_SIZE
+
+static uint8_t *stack_alloc(void) {
+    uint8_t *stack = pmm_alloc_pages(STACK_ORDER);
+    if (stack && paging_is_enabled()) {
+        paging_unmap_page((uint64_t)(uintptr_t)stack); // Overflow faults instead of corrupting
+    }
+    return stack;
+}
+
+static void stack_free(uint8_t *stack) {
+    if (paging_is_enabled()) {
+        paging_map_range((uint64_t)(uintptr_t)stack, PMM_PAGE_SIZE, PAGE_CACHE_WB);
+    }
+    pmm_free_pages(stack, STACK_ORDER);
+}
+
+// Free exited threads. Runs in the idle thread with interrupts enabled, so
+// remapping a guard page never happens inside schedule().
+static void reap_zombies(void) {
+    for (;;) {
+        uint64_t flags = irq_save();
+        thread_t *t = zombies;
+        if (t) {
+            zombies = t->next;
+            for (thread_t **link = &all_threads; *link; link = &(*link)->all_next) {
+                if (*link == t) {
+                    *link = t->all_next;
+                    break;
+                }
+            }
+        }
+        irq_restore(flags);
+        if (!t) return;
+
+        stack_free(t->stack);
+        kfree(t);
+    }
+}
+
+/* --- Core --- */
+
+// Program the one-shot timer for the next thing the scheduler cares about
+static void sched_arm_timer(void) {
+    uint64_t deadline = sleepers ? sleepers->wake_ns : UINT64_MAX;
+    if (run_best_priority() <= current_priority() && slice_end_ns < deadline) {
+        deadline = slice_end_ns;
+    }
+    if (deadline != UINT64_MAX) timer_arm(deadline);
+}
+
+// Pick the next thread and switch to it. Interrupts must be disabled.
+static void schedule(void) {
+    thread_t *prev = current;
+    if (prev->state == THREAD_RUNNING && prev != idle_thread) run_enqueue(prev);
+
+    thread_t *next = run_dequeue();
+    if (!next) next = idle_thread;
+
+    uint64_t now = clock_ns();
+    prev->run_ns += now - prev->last_start_ns;
+    next->last_start_ns = now;
+    next->state = THREAD_RUNNING;
+    current = next;
+    need_resched = 0;
+    slice_end_ns = now + SCHED_SLICE_NS;
+    sched_arm_timer();
+
+    if (next != prev) {
+        next->switches++;
+        trace_thread_switch(next->id, next->name);
+        fpu_save(prev->fpu_state);
+        fpu_restore(next->fpu_state);
+        context_switch(&prev->rsp, next->rsp);
+    }
+}
+
+// Timer IRQ: wake due sleepers, expire the time slice
+static void sched_timer_irq(void) {
+    uint64_t now = clock_ns();
+    while (sleepers && sleepers->wake_ns <= now) {
+        thread_t *t = sleepers;
+        sleepers = t->next;
+        run_enqueue(t);
+    }
+
+    int best = run_best_priority();
+    if (best < current_priority() || (best == current_priority() && now >= slice_end_ns)) {
+        need_resched = 1;
+    } else {
+        sched_arm_timer();
+    }
+}
+
+// Last thing on the way out of every IRQ
+static void sched_irq_exit(void) {
+    if (need_resched && preempt_count == 0) schedule();
+}
+
+static void thread_trampoline(void) {
+    __asm__ volatile("sti");
+    current->entry(current->arg);
+    thread_exit();
+}
+
+// A zombie is only queued once its thread has switched away for good,
+// so by the time idle runs its stack is free to go
+static void idle_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        reap_zombies();
+        __asm__ volatile("sti; hlt");
+    }
+}
+
+// Build a thread with its initial switch frame, without queueing it
+static thread_t *thread_spawn(const char *name, void (*entry)(void *), void *arg, int priority) {
+    thread_t *t = kmalloc(sizeof(thread_t));
+    if (!t) return NULL;
+    memset(t, 0, sizeof(thread_t));
+
+    t->stack = stack_alloc();
+    if (!t->stack) {
+        kfree(t);
+        return NULL;
+    }
+    t->id = next_thread_id++;
+    t->priority = priority;
+    t->entry = entry;
+    t->arg = arg;
+    strncpy(t->name, name, THREAD_NAME_LEN - 1);
+
+    // New threads start with the creator's FPU control state
+    t->fpu_state = t->stack + THREAD_STACK_SIZE - FPU_STATE_MAX;
+    fpu_save(t->fpu_state);
+
+    // Initial frame for context_switch: six registers, RFLAGS (IF off), return
+    uint64_t *sp = (uint64_t *)t->fpu_state;
+    *--sp = 0;                                  // Fake return address for the trampoline
+    *--sp = (uint64_t)(uintptr_t)thread_trampoline;
+    *--sp = 0x2;                                // RFLAGS
+    for (int i = 0; i < 6; i++) *--sp = 0;      // rbp rbx r12 r13 r14 r15
+    t->rsp = (uint64_t)(uintptr_t)sp;
+
+    uint64_t flags = irq_save();
+    t->all_next = all_threads;
+    all_threads = t;
+    irq_restore(flags);
+    return t;
+}
+
+/* --- Public API --- */
+
+void sched_init(void) {
+    if (sched_running) return;
+
+    memset(&boot_thread, 0, sizeof(boot_thread));
+    boot_thread.id = next_thread_id++;
+    boot_thread.priority = SCHED_PRIO_HIGH;
+    boot_thread.state = THREAD_RUNNING;
+    boot_thread.last_start_ns = clock_ns();
+    strncpy(boot_thread.name, "kernel", THREAD_NAME_LEN - 1);
+    boot_thread.fpu_state = boot_fpu_state;
+    trace_thread_switch(boot_thread.id, boot_thread.name);
+    all_threads = &boot_thread;
+    current = &boot_thread;
+
+    // The idle thread is never queued; it runs only when nothing else can
+    idle_thread = thread_spawn("idle", idle_main, NULL, SCHED_PRIO_LOW);
+    if (!idle_thread) {
+        serial_write_string("[SCHED] Could not create the idle thread\n");
+        return;
+    }
+
+    uint64_t flags = irq_save();
+    timer_oneshot_init(sched_timer_irq);
+    irq_set_exit_hook(sched_irq_exit);
+    sched_running = 1;
+    irq_restore(flags);
+
+    serial_write_string("[SCHED] Preemptive scheduler running, timer: ");
+    serial_write_string(timer_source_name());
+    serial_write_string("\n");
+}
+
+int sched_is_running(void) {
+    return sched_running;
+}
+
+thread_t *thread_create(const char *name, void (*entry)(void *), void *arg, int priority) {
+    if (priority < 0 || priority >= SCHED_NUM_PRIOS) return NULL;
+
+    thread_t *t = thread_spawn(name, entry, arg, priority);
+    if (!t) return NULL;
+
+    uint64_t flags = irq_save();
+    run_enqueue(t);
+    if (sched_running && priority < current_priority()) need_resched = 1;
+    if (need_resched && preempt_count == 0 && !irq_in_interrupt()) schedule();
+    irq_restore(flags);
+    return t;
+}
+
+void thread_exit(void) {
+    irq_save();
+    current->state = THREAD_DEAD;
+    current->next = zombies;
+    zombies = current;
+    schedule();
+    for (;;) __asm__ volatile("hlt"); // Not reached
+}
+
+thread_t *thread_current(void) {
+    return current;
+}
+
+void thread_yield(void) {
+    if (!sched_running) return;
+    uint64_t flags = irq_save();
+    schedule();
+    irq_restore(flags);
+}
+
+void thread_sleep_until(uint64_t deadline_ns) {
+    if (!sched_running || current == idle_thread) {
+        timer_sleep_until(deadline_ns);
+        return;
+    }
+
+    uint64_t flags = irq_save();
+    if (deadline_ns > clock_ns()) {
+        current->wake_ns = deadline_ns;
+        if (deadline_ns == UINT64_MAX) {
+            current->state = THREAD_BLOCKED;
+        } else {
+            current->state = THREAD_SLEEPING;
+            sleep_insert(current);
+        }
+        schedule();
+    }
+    irq_restore(flags);
+}
+
+void thread_sleep_ms(uint64_t ms) {
+    thread_sleep_until(clock_ns() + ms * 1000000ULL);
+}
+
+void thread_wakeup(thread_t *t) {
+    if (!t) return;
+
+    uint64_t flags = irq_save();
+    if (t->state == THREAD_SLEEPING || t->state == THREAD_BLOCKED) {
+        if (t->state == THREAD_SLEEPING) sleep_remove(t);
+        run_enqueue(t);
+        if (t->priority < current_priority()) need_resched = 1;
+        if (need_resched && preempt_count == 0 && !irq_in_interrupt()) schedule();
+    }
+    irq_restore(flags);
+}
+
+void sched_preempt_disable(void) {
+    uint64_t flags = irq_save();
+    preempt_count++;
+    irq_restore(flags);
+}
+
+void sched_preempt_enable(void) {
+    uint64_t flags = irq_save();
+    if (preempt_count > 0) preempt_count--;
+    if (preempt_count == 0 && need_resched && !irq_in_interrupt()) schedule();
+    irq_restore(flags);
+}
+
+int sched_get_threads(thread_t **out, int max) {
+    int count = 0;
+    uint64_t flags = irq_save();
+    for (thread_t *t = all_threads; t && count < max; t = t->all_next) {
+        if (t->state != THREAD_DEAD) out[count++] = t;
+    }
+    irq_restore(flags);
+    return count;
+}
+
+uint64_t sched_idle_ns(void) {
+    if (!idle_thread) return 0;
+    uint64_t flags = irq_save();
+    uint64_t total = idle_thread->run_ns;
+    if (current == idle_thread) total += clock_ns() - idle_thread->last_start_ns;
+    irq_restore(flags);
+    return total;
+}
@@ -0,0 +1,236 @@
+#include "../include/kernel.h"
+#include "../include/top.h"
+#include "../include/metrics.h"
+#include "../include/compositor.h"
+#include "../include/string.h"
+#include "../hal/clock.h"
+#include "../hal/smp.h"
+
+// System monitor window
+// Every update takes a registry snapshot; counters are shown as rates over
+// the time since the previous snapshot and gauges as they are. Text uses the
+// 16x16 bitmap font at a 10 pixel advance (its glyphs sit in columns 3-12)
+// and is drawn with draw_char, so nothing is echoed to serial. Under the
+// compositor the monitor is a window of its own and is drawn in window
+// coordinates; otherwise it draws on the screen over a saved copy of what
+// was there.
+
+extern int snprintf(char* str, size_t size, const char* format, ...);
+
+#define TOP_TITLE_H     20
+#define TOP_PAD         10
+#define TOP_LINE_H      18
+#define TOP_CHAR_W      10
+#define TOP_CPU_LINES   2           // CPUs listed individually
+#define TOP_VECTORS     3           // Busiest vectors listed
+
+#define TOP_BG          0xFF101418
+#define TOP_TEXT        0xFFDDDDDD
+#define TOP_LABEL       0xFF80C0FF
+#define TOP_WARN        0xFFFF6060
+
+static int visible = 0;
+static int win_x, win_y;
+static comp_window_t *window;       // Compositor window, if any
+static uint32_t *saved;             // Pixels under the window, without one
+static uint64_t prev[METRIC_NUM];
+static uint64_t prev_cpu_irqs[SMP_MAX_CPUS];
+static uint64_t prev_ms;
+
+static uint32_t *top_target(BootInfo *info) {
+    return info->backbuffer ? info->backbuffer : info->framebuffer;
+}
+
+// Where the window is drawn: its own surface, or the screen
+static BootInfo *top_surface(BootInfo *info) {
+    return window ? comp_window_surface(window) : info;
+}
+
+static void top_text(BootInfo *info, const char *str, int x, int y, uint32_t color) {
+    for (; *str; str++) {
+        draw_char(info, *str, x - 3, y, color);
+        x += TOP_CHAR_W;
+    }
+}
+
+static void top_line(BootInfo *info, int line, const char *label, const char *value, uint32_t color) {
+    int y = win_y + TOP_TITLE_H + 6 + line * TOP_LINE_H;
+    top_text(info, label, win_x + TOP_PAD, y, TOP_LABEL);
+    top_text(info, value, win_x + TOP_PAD + 8 * TOP_CHAR_W, y, color);
+}
+
+// Per-second rate of a counter between two snapshots
+static uint64_t rate(const uint64_t *now, int id, uint64_t dt_ms) {
+    return dt_ms ? (now[id] - prev[id]) * 1000 / dt_ms : 0;
+}
+
+static uint64_t cpu_irqs(int cpu) {
+    uint64_t sum = 0;
+    for (int v = 0; v < METRIC_IRQ_VECTORS; v++) {
+        sum += metric_read_cpu(METRIC_IRQ(v), cpu);
+    }
+    return sum;
+}
+
+void top_open(BootInfo *info, int x, int y) {
+    if (visible) return;
+
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x + TOP_WIDTH > (int)info->width) x = info->width - TOP_WIDTH;
+    if (y + TOP_HEIGHT > (int)info->height) y = info->height - TOP_HEIGHT;
+    win_x = x;
+    win_y = y;
+
+    window = comp_window_create(x, y, TOP_WIDTH, TOP_HEIGHT);
+    if (window) {
+        win_x = 0;
+        win_y = 0;
+    } else if (compositor_is_running()) {
+        return;                     // The next flip would paint over the screen copy
+    } else {
+        uint32_t *fb = top_target(info);
+        saved = kmalloc(TOP_WIDTH * TOP_HEIGHT * sizeof(uint32_t));
+        if (saved) {
+            for (int row = 0; row < TOP_HEIGHT; row++) {
+                memcpy(&saved[row * TOP_WIDTH], &fb[(win_y + row) * info->pitch + win_x],
+                       TOP_WIDTH * sizeof(uint32_t));
+            }
+        }
+    }
+
+    BootInfo *surface = top_surface(info);
+    fill_rect(surface, win_x, win_y, TOP_WIDTH, TOP_HEIGHT, 0xFF666666);  // Border
+    fill_rect(surface, win_x + 2, win_y + 2, TOP_WIDTH - 4, TOP_TITLE_H - 2, 0xFF000080);
+    top_text(surface, "top", win_x + 8, win_y + 3, 0xFFFFFFFF);
+
+    metric_snapshot(prev);
+    for (int c = 0; c < SMP_MAX_CPUS; c++) prev_cpu_irqs[c] = cpu_irqs(c);
+    prev_ms = clock_ms();
+    visible = 1;
+
+    top_update(info);
+}
+
+void top_close(BootInfo *info) {
+    if (!visible) return;
+    visible = 0;
+    if (window) {
+        comp_window_destroy(window);
+        window = NULL;
+        return;
+    }
+    if (!saved) return;
+
+    uint32_t *fb = top_target(info);
+    for (int row = 0; row < TOP_HEIGHT; row++) {
+        memcpy(&fb[(win_y + row) * info->pitch + win_x], &saved[row * TOP_WIDTH],
+               TOP_WIDTH * sizeof(uint32_t));
+    }
+    mark_dirty_rect(info, win_x, win_y, TOP_WIDTH, TOP_HEIGHT);
+    kfree(saved);
+    saved = NULL;
+}
+
+int top_is_open(void) {
+    return visible;
+}
+
+void top_update(BootInfo *info) {
+    if (!visible) return;
+
+    static uint64_t now[METRIC_NUM];
+    char value[40];
+    int line = 0;
+
+    uint64_t now_ms = clock_ms();
+    uint64_t dt_ms = now_ms - prev_ms;
+    metric_snapshot(now);
+    info = top_surface(info);
+
+    fill_rect(info, win_x + 2, win_y + TOP_TITLE_H, TOP_WIDTH - 4, TOP_HEIGHT - TOP_TITLE_H - 2, TOP_BG);
+
+    snprintf(value, sizeof(value), "%u s, %d CPU(s)", (unsigned int)(now_ms / 1000), smp_cpu_count());
+    top_line(info, line++, "Uptime", value, TOP_TEXT);
+
+    // IRQs: total, then per CPU
+    uint64_t total_irqs = 0;
+    for (int v = 0; v < METRIC_IRQ_VECTORS; v++) total_irqs += rate(now, METRIC_IRQ(v), dt_ms);
+    snprintf(value, sizeof(value), "%u/s", (unsigned int)total_irqs);
+    top_line(info, line++, "IRQs", value, TOP_TEXT);
+
+    int listed = 0;
+    for (int c = 0; c < SMP_MAX_CPUS; c++) {
+        percpu_t *cpu = smp_cpu(c);
+        uint64_t irqs = cpu_irqs(c);
+        uint64_t per_sec = dt_ms ? (irqs - prev_cpu_irqs[c]) * 1000 / dt_ms : 0;
+        prev_cpu_irqs[c] = irqs;
+        if ((c > 0 && (!cpu || !cpu->online)) || listed >= TOP_CPU_LINES) continue;
+
+        snprintf(value, sizeof(value), "cpu%d %u/s", c, (unsigned int)per_sec);
+        top_line(info, line++, "", value, TOP_TEXT);
+        listed++;
+    }
+
+    // Busiest vectors over the last interval
+    int busiest[TOP_VECTORS];
+    for (int i = 0; i < TOP_VECTORS; i++) busiest[i] = -1;
+    for (int v = 0; v < METRIC_IRQ_VECTORS; v++) {
+        uint64_t r = rate(now, METRIC_IRQ(v), dt_ms);
+        if (r == 0) continue;
+        for (int i = 0; i < TOP_VECTORS; i++) {
+            if (busiest[i] < 0 || r > rate(now, METRIC_IRQ(busiest[i]), dt_ms)) {
+                for (int j = TOP_VECTORS - 1; j > i; j--) busiest[j] = busiest[j - 1];
+                busiest[i] = v;
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < TOP_VECTORS; i++) {
+        if (busiest[i] < 0) {
+            top_line(info, line++, "", "-", TOP_TEXT);
+            continue;
+        }
+        snprintf(value, sizeof(value), "vec 0x%x %u/s", busiest[i],
+                 (unsigned int)rate(now, METRIC_IRQ(busiest[i]), dt_ms));
+        top_line(info, line++, "", value, TOP_TEXT);
+    }
+
+    // Heap
+    uint64_t frag = now[METRIC_HEAP_FRAG];
+    snprintf(value, sizeof(value), "%u of %uKB used",
+             (unsigned int)(now[METRIC_HEAP_USED] / 1024), (unsigned int)(now[METRIC_HEAP_TOTAL] / 1024));
+    top_line(info, line++, "Heap", value, TOP_TEXT);
+    snprintf(value, sizeof(value), "frag %u.%u pct", (unsigned int)(frag / 10), (unsigned int)(frag % 10));
+    top_line(info, line++, "", value, frag >= 500 ? TOP_WARN : TOP_TEXT);
+
+    // Doom
+    uint64_t lag = now[METRIC_DOOM_TIC_LAG];
+    snprintf(value, sizeof(value), "%u fps, lag %u tics",
+             (unsigned int)rate(now, METRIC_DOOM_FRAMES, dt_ms), (unsigned int)lag);
+    top_line(info, line++, "Doom", value, lag > 1 ? TOP_WARN : TOP_TEXT);
+
+    // Devices
+    snprintf(value, sizeof(value), "rx %u pkt/s %uKB/s",
+             (unsigned int)rate(now, METRIC_NET_RX_PACKETS, dt_ms),
+             (unsigned int)(rate(now, METRIC_NET_RX_BYTES, dt_ms) / 1024));
+    top_line(info, line++, "Net", value, TOP_TEXT);
+    snprintf(value, sizeof(value), "tx %u pkt/s %uKB/s",
+             (unsigned int)rate(now, METRIC_NET_TX_PACKETS, dt_ms),
+             (unsigned int)(rate(now, METRIC_NET_TX_BYTES, dt_ms) / 1024));
+    top_line(info, line++, "", value, TOP_TEXT);
+
+    snprintf(value, sizeof(value), "rd %u wr %u sect/s",
+             (unsigned int)rate(now, METRIC_IDE_SECTORS_READ, dt_ms),
+             (unsigned int)rate(now, METRIC_IDE_SECTORS_WRITTEN, dt_ms));
+    top_line(info, line++, "IDE", value, TOP_TEXT);
+
+    snprintf(value, sizeof(value), "%u underruns", (unsigned int)now[METRIC_AUDIO_UNDERRUNS]);
+    top_line(info, line++, "Audio", value, now[METRIC_AUDIO_UNDERRUNS] ? TOP_WARN : TOP_TEXT);
+
+    snprintf(value, sizeof(value), "%u bytes dropped", (unsigned int)now[METRIC_SERIAL_TX_DROPPED]);
+    top_line(info, line++, "Serial", value, now[METRIC_SERIAL_TX_DROPPED] ? TOP_WARN : TOP_TEXT);
+
+    memcpy(prev, now, sizeof(prev));
+    prev_ms = now_ms;
+}
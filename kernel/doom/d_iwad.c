@@ -41,7 +41,7 @@ extern char* strrchr(const char* s, int c);
 static char* kernel_strdup(const char* str) {
     if (!str) return NULL;
     size_t len = strlen(str) + 1;
-    char* dup = kmalloc(len);
+    char* dup = malloc(len);
     if (dup) {
         memcpy(dup, str, len);
     }
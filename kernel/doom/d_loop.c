@@ -31,6 +31,7 @@
 
 #include "m_argv.h"
 #include "m_fixed.h"
+#include "metrics.h"
 
 #include "net_client.h"
 #include "net_gui.h"
@@ -733,6 +734,7 @@ void TryRunTics (void)
     lowtic = GetLowTic();
 
     availabletics = lowtic - gametic/ticdup;
+    metric_set(METRIC_DOOM_TIC_LAG, availabletics > 0 ? availabletics : 0);
 
     // decide how many tics to run
 
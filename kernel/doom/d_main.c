@@ -74,6 +74,8 @@
 
 #include <string.h>
 #include "d_main.h"
+#include "i_profile.h"
+#include "metrics.h"
 
 //
 // D-DoomLoop()
@@ -220,7 +222,9 @@ void D_Display (void)
 			redrawsbar = true;
 		if (inhelpscreensstate && !inhelpscreens)
 			redrawsbar = true;              // just put away the help screen
+		I_ProfileBegin (PROFILE_ST_DRAWER);
 		ST_Drawer (viewheight == 200, redrawsbar );
+		I_ProfileEnd (PROFILE_ST_DRAWER);
 		fullscreen = viewheight == 200;
 		break;
 
@@ -242,10 +246,18 @@ void D_Display (void)
     
     // draw the view directly
     if (gamestate == GS_LEVEL && !automapactive && gametic)
+    {
+    	I_ProfileBegin (PROFILE_RENDER);
     	R_RenderPlayerView (&players[displayplayer]);
+    	I_ProfileEnd (PROFILE_RENDER);
+    }
 
     if (gamestate == GS_LEVEL && gametic)
+    {
+    	I_ProfileBegin (PROFILE_HU_DRAWER);
     	HU_Drawer ();
+    	I_ProfileEnd (PROFILE_HU_DRAWER);
+    }
     
     // clean up border stuff
     if (gamestate != oldgamestate && gamestate != GS_LEVEL)
@@ -405,6 +417,8 @@ boolean D_GrabMouseCallback(void)
 
 void doomgeneric_Tick()
 {
+    I_ProfileBegin(PROFILE_FRAME);
+
     // frame syncronous IO operations
     I_StartFrame ();
 
@@ -417,6 +431,10 @@ void doomgeneric_Tick()
     {
         D_Display ();
     }
+
+    I_ProfileEnd(PROFILE_FRAME);
+    I_ProfileFrame();
+    metric_inc(METRIC_DOOM_FRAMES);
 }
 
 //
@@ -26,6 +26,7 @@
 #include "m_menu.h"
 #include "m_misc.h"
 #include "i_system.h"
+#include "i_profile.h"
 #include "i_timer.h"
 #include "i_video.h"
 #include "g_game.h"
@@ -91,7 +92,9 @@ static void RunTic(ticcmd_t *cmds, boolean *ingame)
     if (advancedemo)
         D_DoAdvanceDemo ();
 
+    I_ProfileBegin (PROFILE_G_TICKER);
     G_Ticker ();
+    I_ProfileEnd (PROFILE_G_TICKER);
 }
 
 static loop_interface_t doom_loop_interface = {
@@ -6,15 +6,16 @@
 #include "doomgeneric.h"
 #include "../include/kernel.h"
 #include "../hal/serial.h"
+#include "../hal/clock.h"
+#include "../include/sched.h"
+#include "../include/klog.h"
+#include "i_profile.h"
 #include <stdbool.h>
 #include <ctype.h>
 
 // Access to global boot info (declared in kernel.c)
 extern BootInfo* global_boot_info;
 
-// Timer function from system_stubs.c
-extern uint64_t timer_ms(void);
-
 #define KEYQUEUE_SIZE 16
 
 static unsigned short s_KeyQueue[KEYQUEUE_SIZE];
@@ -213,39 +214,43 @@ void DG_Init() {
     }
 }
 
-// Window position for Doom (set by caller)
+// Window position for Doom (set by caller), on the screen or, under the
+// compositor, on the surface of Doom's window
 static int doom_window_x = 50;
 static int doom_window_y = 100;
+static BootInfo* doom_surface = NULL;
 
 void DG_SetWindowPosition(int x, int y) {
     doom_window_x = x;
     doom_window_y = y;
 }
 
+void DG_SetSurface(BootInfo* surface) {
+    doom_surface = surface;
+}
+
 void DG_DrawFrame() {
+    // The overlay goes into the converted frame, which I_FinishUpdate
+    // rewrites in full every frame
+    if (DG_ScreenBuffer) {
+        I_ProfileDrawOverlay(DG_ScreenBuffer, DOOMGENERIC_RESX, DOOMGENERIC_RESX, DOOMGENERIC_RESY);
+    }
+
+    I_ProfileBegin(PROFILE_BLIT);
+
     // Debug: indicate frame is being drawn
     static int frame_count = 0;
-    if (frame_count % 60 == 0) { // Print every 60 frames (~1 second at 60fps)
-        serial_write_string("Doom: Drawing frame ");
-        // Simple frame counter print
-        char buf[16];
-        int n = frame_count;
-        int i = 0;
-        do {
-            buf[i++] = '0' + (n % 10);
-            n /= 10;
-        } while (n > 0);
-        while (i > 0) {
-            serial_write_char(buf[--i]);
-        }
-        serial_write_string("\n");
+    if (frame_count % 60 == 0) { // Every 60 frames (~1 second at 60fps)
+        LOG_DEBUG(KLOG_SYS_DOOM, "Drawing frame %d", frame_count);
     }
     frame_count++;
 
-    // Copy the Doom frame buffer to the window
-    if (global_boot_info && DG_ScreenBuffer) {
-        uint32_t* fb = global_boot_info->framebuffer;
-        uint32_t pitch = global_boot_info->pitch;
+    // Copy the Doom frame buffer to the window; the Doom thread's
+    // flip_buffers() then presents it with the rest of the desktop
+    BootInfo* target = doom_surface ? doom_surface : global_boot_info;
+    if (target && DG_ScreenBuffer) {
+        uint32_t* fb = target->backbuffer ? target->backbuffer : target->framebuffer;
+        uint32_t pitch = target->pitch;
 
         // Render Doom to fit within window bounds
         for (int y = 0; y < DOOMGENERIC_RESY; y++) {
@@ -255,33 +260,29 @@ void DG_DrawFrame() {
                 int dst_y = doom_window_y + y;
 
                 // Only render if within screen bounds
-                if (dst_x >= 0 && dst_x < (int)global_boot_info->width &&
-                    dst_y >= 0 && dst_y < (int)global_boot_info->height) {
+                if (dst_x >= 0 && dst_x < (int)target->width &&
+                    dst_y >= 0 && dst_y < (int)target->height) {
                     int dst_idx = dst_y * pitch + dst_x;
-                    if (dst_idx < (int)global_boot_info->width * (int)global_boot_info->height) {
+                    if (dst_idx < (int)target->pitch * (int)target->height) {
                         fb[dst_idx] = DG_ScreenBuffer[src_idx];
                     }
                 }
             }
         }
+        mark_dirty_rect(target, doom_window_x, doom_window_y, DOOMGENERIC_RESX, DOOMGENERIC_RESY);
     }
+
+    I_ProfileEnd(PROFILE_BLIT);
 }
 
 void DG_SleepMs(uint32_t ms) {
-    // Simple busy wait - in a real OS we'd use proper timers
-    volatile uint32_t count = ms * 1000; // Rough approximation
-    while (count--) {
-        // Busy wait
-    }
+    // Sleep the Doom thread between tics so the desktop and idle can run
+    thread_sleep_ms(ms);
 }
 
 uint32_t DG_GetTicksMs() {
-    // Return milliseconds since start
-    static uint32_t start_ticks = 0;
-    if (start_ticks == 0) {
-        start_ticks = timer_ms();
-    }
-    return timer_ms() - start_ticks;
+    // Milliseconds since the clock was calibrated at boot
+    return (uint32_t)clock_ms();
 }
 
 int DG_GetKey(int* pressed, unsigned char* key) {
@@ -297,14 +298,7 @@ int DG_GetKey(int* pressed, unsigned char* key) {
 
         // Debug: show key being processed
         if (*pressed) {
-            serial_write_string("Doom: Key processed: 0x");
-            char hex[3];
-            unsigned char val = *key;
-            hex[0] = "0123456789ABCDEF"[val >> 4];
-            hex[1] = "0123456789ABCDEF"[val & 0xF];
-            hex[2] = 0;
-            serial_write_string(hex);
-            serial_write_string("\n");
+            LOG_DEBUG(KLOG_SYS_DOOM, "Key processed: 0x%02X", *key);
         }
 
         return 1;
@@ -322,6 +316,12 @@ void DG_SetWindowTitle(const char* title) {
 
 // Keyboard input handling for Doom
 void doom_handle_key_press(unsigned char scancode, int pressed) {
+    // F12 toggles the frame profiler overlay instead of reaching Doom
+    if (scancode == 0x58) {
+        if (pressed) I_ProfileToggleOverlay();
+        return;
+    }
+
     unsigned char doomKey = convertToDoomKey(scancode);
     if (doomKey != 0) {
         addKeyToQueue(pressed, doomKey);
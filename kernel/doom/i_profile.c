@@ -0,0 +1,315 @@
+//
+// Tiny64 OS
+//
+// DESCRIPTION:
+//      Per-frame Doom phase profiler and on-screen overlay.
+//
+
+#include <stdio.h>
+
+#include "i_profile.h"
+#include "r_local.h"
+#include "../hal/clock.h"
+#include "../include/trace.h"
+
+// Overlay text uses the kernel's 16x16 font, trimmed to the columns the
+// glyphs actually use so a line fits 60+ characters in the Doom window
+extern const uint16_t* font16x16[96];
+
+#define GLYPH_FIRST_COL     3
+#define GLYPH_COLS          10
+#define GLYPH_FIRST_ROW     1
+#define GLYPH_ROWS          14
+#define LINE_HEIGHT         14
+
+#define GRAPH_HEIGHT        64
+#define GRAPH_FULL_US       50000   // Frame time at the top of the graph
+#define TIC_US              28571   // One 35 Hz tic
+
+static const char *phase_names[NUM_PROFILE_PHASES] =
+{
+    "frame", "G_Ticker", "P_Ticker", "render", " bsp", " planes", " masked",
+    "ST_Drawer", "HU_Drawer", "finish", " blit"
+};
+
+#if TRACE_ENABLED
+// Trace span names: same phases, prefixed so they group in the viewer
+static const char *trace_names[NUM_PROFILE_PHASES] =
+{
+    "doom: frame", "doom: G_Ticker", "doom: P_Ticker", "doom: R_RenderPlayerView",
+    "doom: R_RenderBSPNode", "doom: R_DrawPlanes", "doom: R_DrawMasked",
+    "doom: ST_Drawer", "doom: HU_Drawer", "doom: I_FinishUpdate", "doom: DG_DrawFrame"
+};
+#endif
+
+static const char *counter_names[NUM_PROFILE_COUNTERS] =
+{
+    "visplanes", "drawsegs", "vissprites", "columns", "spans"
+};
+
+// 0: no limit
+static const unsigned int counter_limits[NUM_PROFILE_COUNTERS] =
+{
+    MAXVISPLANES, MAXDRAWSEGS, MAXVISSPRITES, 0, 0
+};
+
+unsigned int profile_columns;
+unsigned int profile_spans;
+
+static uint64_t phase_start[NUM_PROFILE_PHASES];
+static uint64_t phase_ticks[NUM_PROFILE_PHASES];       // This frame so far
+static unsigned int frame_counters[NUM_PROFILE_COUNTERS];
+
+// Rolling window, microseconds per phase per frame
+static uint32_t history[NUM_PROFILE_PHASES][PROFILE_HISTORY];
+static unsigned int counter_history[NUM_PROFILE_COUNTERS][PROFILE_HISTORY];
+static int history_pos;
+static int history_len;
+
+static boolean overlay_visible;
+
+//
+// Timing
+//
+
+void I_ProfileBegin(profile_phase_t phase)
+{
+    TRACE_BEGIN(trace_names[phase]);
+    phase_start[phase] = rdtsc();
+}
+
+void I_ProfileEnd(profile_phase_t phase)
+{
+    phase_ticks[phase] += rdtsc() - phase_start[phase];
+    TRACE_END(trace_names[phase]);
+}
+
+void I_ProfileCount(profile_counter_t counter, unsigned int value)
+{
+    frame_counters[counter] = value;
+}
+
+void I_ProfileFrame(void)
+{
+    int i;
+
+    frame_counters[PROFILE_COLUMNS] = profile_columns;
+    frame_counters[PROFILE_SPANS] = profile_spans;
+    profile_columns = 0;
+    profile_spans = 0;
+
+    for (i = 0; i < NUM_PROFILE_PHASES; i++)
+    {
+        uint64_t us = clock_tsc_to_ns(phase_ticks[i]) / 1000;
+        history[i][history_pos] = us > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)us;
+        phase_ticks[i] = 0;
+    }
+    for (i = 0; i < NUM_PROFILE_COUNTERS; i++)
+    {
+        counter_history[i][history_pos] = frame_counters[i];
+        frame_counters[i] = 0;
+    }
+
+    history_pos = (history_pos + 1) % PROFILE_HISTORY;
+    if (history_len < PROFILE_HISTORY)
+        history_len++;
+}
+
+void I_ProfileToggleOverlay(void)
+{
+    overlay_visible = !overlay_visible;
+}
+
+boolean I_ProfileOverlayVisible(void)
+{
+    return overlay_visible;
+}
+
+//
+// Statistics
+//
+
+typedef struct
+{
+    uint32_t min, avg, p99;
+} phasestats_t;
+
+static void PhaseStats(int phase, phasestats_t *stats)
+{
+    uint32_t sorted[PROFILE_HISTORY];
+    uint64_t sum = 0;
+    int i, j;
+
+    // Insertion sort: the window is small and mostly ordered frame to frame
+    for (i = 0; i < history_len; i++)
+    {
+        uint32_t v = history[phase][i];
+        sum += v;
+        for (j = i; j > 0 && sorted[j - 1] > v; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+
+    stats->min = sorted[0];
+    stats->avg = (uint32_t)(sum / history_len);
+    stats->p99 = sorted[(history_len * 99 + 99) / 100 - 1];
+}
+
+//
+// Overlay drawing
+//
+
+static uint32_t *ov_dest;
+static int ov_pitch, ov_w, ov_h;
+
+static void PutPixel(int x, int y, uint32_t color)
+{
+    if (x >= 0 && x < ov_w && y >= 0 && y < ov_h)
+        ov_dest[y * ov_pitch + x] = color;
+}
+
+// Halve the brightness of a rectangle so the text stays readable
+static void Darken(int x, int y, int w, int h)
+{
+    int px, py;
+
+    for (py = y; py < y + h && py < ov_h; py++)
+    {
+        uint32_t *row = ov_dest + py * ov_pitch;
+        for (px = x; px < x + w && px < ov_w; px++)
+            row[px] = 0xFF000000 | ((row[px] >> 1) & 0x7F7F7F);
+    }
+}
+
+static void DrawText(int x, int y, const char *text, uint32_t color)
+{
+    for (; *text; text++, x += GLYPH_COLS)
+    {
+        const uint16_t *glyph;
+        int row, col;
+
+        if (*text < 33 || *text > 126)
+            continue;
+        glyph = font16x16[*text - 32];
+
+        for (row = 0; row < GLYPH_ROWS; row++)
+        {
+            uint16_t bits = glyph[GLYPH_FIRST_ROW + row];
+            for (col = 0; col < GLYPH_COLS; col++)
+            {
+                if (bits & (0x8000 >> (GLYPH_FIRST_COL + col)))
+                    PutPixel(x + col, y + row, color);
+            }
+        }
+    }
+}
+
+// "12.34" for a microsecond value, in milliseconds
+static void FormatMs(char *buf, size_t size, uint32_t us)
+{
+    unsigned int frac = (us % 1000) / 10;
+    snprintf(buf, size, "%u.%s%u", us / 1000, frac < 10 ? "0" : "", frac);
+}
+
+// Right-align 'text' in a field of 'width' characters
+static void DrawField(int x, int y, int width, const char *text, uint32_t color)
+{
+    int len = 0;
+    while (text[len])
+        len++;
+    DrawText(x + (width - len) * GLYPH_COLS, y, text, color);
+}
+
+static void DrawGraph(int x, int y)
+{
+    int i;
+
+    // One 2px bar per frame, oldest on the left; the line marks one tic
+    for (i = 0; i < history_len; i++)
+    {
+        int idx = (history_pos - history_len + i + PROFILE_HISTORY) % PROFILE_HISTORY;
+        uint32_t us = history[PROFILE_FRAME][idx];
+        int bar = us >= GRAPH_FULL_US ? GRAPH_HEIGHT : (int)(us * GRAPH_HEIGHT / GRAPH_FULL_US);
+        uint32_t color = us <= TIC_US ? 0xFF40E040 : us <= 2 * TIC_US ? 0xFFE0E040 : 0xFFE04040;
+        int py;
+
+        for (py = 0; py < bar; py++)
+        {
+            PutPixel(x + i * 2, y + GRAPH_HEIGHT - 1 - py, color);
+            PutPixel(x + i * 2 + 1, y + GRAPH_HEIGHT - 1 - py, color);
+        }
+    }
+    for (i = 0; i < PROFILE_HISTORY * 2; i++)
+        PutPixel(x + i, y + GRAPH_HEIGHT - 1 - TIC_US * GRAPH_HEIGHT / GRAPH_FULL_US, 0xFF808080);
+}
+
+void I_ProfileDrawOverlay(uint32_t *dest, int pitch, int w, int h)
+{
+    const int x = 8;
+    int y = 6;
+    int lines = 2 + NUM_PROFILE_PHASES + NUM_PROFILE_COUNTERS;
+    char buf[64];
+    int i;
+
+    if (!overlay_visible || history_len == 0)
+        return;
+
+    ov_dest = dest;
+    ov_pitch = pitch;
+    ov_w = w;
+    ov_h = h;
+
+    Darken(0, 0, 40 * GLYPH_COLS, y + lines * LINE_HEIGHT + GRAPH_HEIGHT + 10);
+
+    DrawText(x, y, "phase (ms)", 0xFFFFFFFF);
+    DrawField(x + 10 * GLYPH_COLS, y, 8, "min", 0xFFFFFFFF);
+    DrawField(x + 18 * GLYPH_COLS, y, 8, "avg", 0xFFFFFFFF);
+    DrawField(x + 26 * GLYPH_COLS, y, 8, "p99", 0xFFFFFFFF);
+    y += LINE_HEIGHT;
+
+    for (i = 0; i < NUM_PROFILE_PHASES; i++)
+    {
+        phasestats_t stats;
+        PhaseStats(i, &stats);
+
+        DrawText(x, y, phase_names[i], 0xFFC0C0C0);
+        FormatMs(buf, sizeof(buf), stats.min);
+        DrawField(x + 10 * GLYPH_COLS, y, 8, buf, 0xFFC0C0C0);
+        FormatMs(buf, sizeof(buf), stats.avg);
+        DrawField(x + 18 * GLYPH_COLS, y, 8, buf, 0xFFFFFFFF);
+        FormatMs(buf, sizeof(buf), stats.p99);
+        DrawField(x + 26 * GLYPH_COLS, y, 8, buf, 0xFFFFE080);
+        y += LINE_HEIGHT;
+    }
+    y += LINE_HEIGHT / 2;
+
+    // Counters: last frame, window peak, and the engine limit if there is one
+    for (i = 0; i < NUM_PROFILE_COUNTERS; i++)
+    {
+        int last = (history_pos + PROFILE_HISTORY - 1) % PROFILE_HISTORY;
+        unsigned int peak = 0;
+        uint32_t color = 0xFFC0C0C0;
+        int j;
+
+        for (j = 0; j < history_len; j++)
+        {
+            if (counter_history[i][j] > peak)
+                peak = counter_history[i][j];
+        }
+        if (counter_limits[i] && peak * 4 >= counter_limits[i] * 3)
+            color = 0xFFFF6060;             // Within a quarter of the limit
+
+        DrawText(x, y, counter_names[i], color);
+        snprintf(buf, sizeof(buf), "%u", counter_history[i][last]);
+        DrawField(x + 10 * GLYPH_COLS, y, 8, buf, color);
+        if (counter_limits[i])
+            snprintf(buf, sizeof(buf), "peak %u/%u", peak, counter_limits[i]);
+        else
+            snprintf(buf, sizeof(buf), "peak %u", peak);
+        DrawText(x + 20 * GLYPH_COLS, y, buf, color);
+        y += LINE_HEIGHT;
+    }
+    y += 4;
+
+    DrawGraph(x, y);
+}
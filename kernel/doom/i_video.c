@@ -38,6 +38,7 @@ rcsid[] = "$Id: i_x.c,v 1.6 1997/02/03 22:45:10 b1 Exp $";
 #include "doomkeys.h"
 
 #include "doomgeneric.h"
+#include "i_profile.h"
 
 #include <stdbool.h>
 #include <stdlib.h>
@@ -324,6 +325,8 @@ void I_FinishUpdate (void)
     int x_offset, y_offset, x_offset_end;
     unsigned char *line_in, *line_out;
 
+    I_ProfileBegin(PROFILE_FINISH);
+
     /* Offsets in case FB is bigger than DOOM */
     /* 600 = s_Fb heigt, 200 screenheight */
     /* 600 = s_Fb heigt, 200 screenheight */
@@ -367,6 +370,8 @@ void I_FinishUpdate (void)
     }
 
 	DG_DrawFrame();
+
+    I_ProfileEnd(PROFILE_FINISH);
 }
 
 //
@@ -35,6 +35,7 @@
 
 // State.
 #include "doomstat.h"
+#include "i_profile.h"
 
 
 // ?
@@ -119,6 +120,8 @@ void R_DrawColumn (void)
 	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x); 
 #endif 
 
+    profile_columns++;
+
     // Framebuffer destination address.
     // Use ylookup LUT to avoid multiply with ScreenWidth.
     // Use columnofs LUT for subwindows? 
@@ -230,6 +233,8 @@ void R_DrawColumnLow (void)
     }
     //	dccount++; 
 #endif 
+
+    profile_columns++;
     // Blocky mode, need to multiply by 2.
     x = dc_x << 1;
     
@@ -309,6 +314,8 @@ void R_DrawFuzzColumn (void)
 		 dc_yl, dc_yh, dc_x);
     }
 #endif
+
+    profile_columns++;
     
     dest = ylookup[dc_yl] + columnofs[dc_x];
 
@@ -374,6 +381,8 @@ void R_DrawFuzzColumnLow (void)
 		 dc_yl, dc_yh, dc_x);
     }
 #endif
+
+    profile_columns++;
     
     dest = ylookup[dc_yl] + columnofs[x];
     dest2 = ylookup[dc_yl] + columnofs[x+1];
@@ -443,6 +452,8 @@ void R_DrawTranslatedColumn (void)
     
 #endif 
 
+    profile_columns++;
+
 
     dest = ylookup[dc_yl] + columnofs[dc_x]; 
 
@@ -492,6 +503,8 @@ void R_DrawTranslatedColumnLow (void)
     
 #endif 
 
+    profile_columns++;
+
 
     dest = ylookup[dc_yl] + columnofs[x]; 
     dest2 = ylookup[dc_yl] + columnofs[x+1]; 
@@ -607,6 +620,8 @@ void R_DrawSpan (void)
 //	dscount++;
 #endif
 
+    profile_spans++;
+
     // Pack position and step variables into a single 32-bit integer,
     // with x in the top 16 bits and y in the bottom 16 bits.  For
     // each 16-bit part, the top 6 bits are the integer part and the
@@ -736,6 +751,8 @@ void R_DrawSpanLow (void)
 //	dscount++; 
 #endif
 
+    profile_spans++;
+
     position = ((ds_xfrac << 10) & 0xffff0000)
              | ((ds_yfrac >> 6)  & 0x0000ffff);
     step = ((ds_xstep << 10) & 0xffff0000)
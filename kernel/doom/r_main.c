@@ -35,6 +35,8 @@
 #include "r_local.h"
 #include "r_sky.h"
 
+#include "i_profile.h"
+
 
 
 
@@ -874,17 +876,24 @@ void R_RenderPlayerView (player_t* player)
     NetUpdate ();
 
     // The head node is the last node output.
+    I_ProfileBegin (PROFILE_BSP);
     R_RenderBSPNode (numnodes-1);
+    I_ProfileEnd (PROFILE_BSP);
     
     // Check for new console commands.
     NetUpdate ();
     
+    I_ProfileBegin (PROFILE_PLANES);
     R_DrawPlanes ();
+    I_ProfileEnd (PROFILE_PLANES);
     
     // Check for new console commands.
     NetUpdate ();
     
+    I_ProfileCount (PROFILE_VISSPRITES, vissprite_p - vissprites);
+    I_ProfileBegin (PROFILE_MASKED);
     R_DrawMasked ();
+    I_ProfileEnd (PROFILE_MASKED);
 
     // Check for new console commands.
     NetUpdate ();				
@@ -32,6 +32,8 @@
 #include "r_local.h"
 #include "r_sky.h"
 
+#include "i_profile.h"
+
 
 
 planefunction_t		floorfunc;
@@ -42,7 +44,6 @@ planefunction_t		ceilingfunc;
 //
 
 // Here comes the obnoxious "visplane".
-#define MAXVISPLANES	128
 visplane_t		visplanes[MAXVISPLANES];
 visplane_t*		lastvisplane;
 visplane_t*		floorplane;
@@ -380,6 +381,9 @@ void R_DrawPlanes (void)
 		 lastopening - openings);
 #endif
 
+    I_ProfileCount (PROFILE_DRAWSEGS, ds_p - drawsegs);
+    I_ProfileCount (PROFILE_VISPLANES, lastvisplane - visplanes);
+
     for (pl = visplanes ; pl < lastvisplane ; pl++)
     {
 	if (pl->minx > pl->maxx)
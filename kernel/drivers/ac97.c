@@ -3,7 +3,10 @@
 
 #include "ac97.h"
 #include "../../hal/serial.h" // for serial output
+#include "../../hal/apic.h"   // for PCI IRQ routing
 #include "../../include/io.h" // for port I/O
+#include "../../include/klog.h"
+#include "../../include/metrics.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
@@ -41,31 +44,23 @@ static inline void ac97_write32(ac97_device_t* dev, uint16_t offset, uint32_t va
     outl(dev->nabm_base + offset, value);
 }
 
+// Count an underrun latched by the last playback and clear the status bits.
+// No IRQ handler is installed, so this runs whenever playback starts or stops.
+static void ac97_check_underrun(ac97_device_t* dev) {
+    uint16_t status = ac97_read16(dev, AC97_NABM_PCM_OUT_SR);
+    if (status & AC97_SR_FIFOE) {
+        metric_inc(METRIC_AUDIO_UNDERRUNS);
+    }
+    ac97_write16(dev, AC97_NABM_PCM_OUT_SR, status & (AC97_SR_LVBCI | AC97_SR_BCIS | AC97_SR_FIFOE));
+}
+
 void ac97_init(void) {
     serial_write_string("AC97: Initializing audio driver\n");
     ac97_devices = NULL;
 }
 
 ac97_device_t* ac97_probe(uint32_t nabm_base, uint32_t mixer_base, uint8_t irq) {
-    serial_write_string("AC97: Probing device at NABM 0x");
-    // Simple hex print for NABM base
-    char hex[5];
-    uint32_t val = nabm_base;
-    for (int i = 3; i >= 0; i--) {
-        hex[i] = "0123456789ABCDEF"[val & 0xF];
-        val >>= 4;
-    }
-    hex[4] = 0;
-    serial_write_string(hex);
-    serial_write_string(", Mixer 0x");
-    val = mixer_base;
-    for (int i = 3; i >= 0; i--) {
-        hex[i] = "0123456789ABCDEF"[val & 0xF];
-        val >>= 4;
-    }
-    hex[4] = 0;
-    serial_write_string(hex);
-    serial_write_string("\n");
+    LOG_INFO(KLOG_SYS_AUDIO, "AC97: Probing device at NABM 0x%04X, Mixer 0x%04X", nabm_base, mixer_base);
 
     // Allocate device structure
     ac97_device_t* dev = (ac97_device_t*)kmalloc(sizeof(ac97_device_t));
@@ -78,6 +73,7 @@ ac97_device_t* ac97_probe(uint32_t nabm_base, uint32_t mixer_base, uint8_t irq)
     dev->nabm_base = nabm_base;
     dev->mixer_base = mixer_base;
     dev->irq = irq;
+    apic_irq_set_pci(irq); // INTx: level triggered, active low
     dev->next = ac97_devices;
     ac97_devices = dev;
 
@@ -133,10 +129,12 @@ void ac97_set_pcm_volume(ac97_device_t* dev, uint8_t left, uint8_t right) {
 
 int ac97_play_pcm(ac97_device_t* dev, const void* data, uint32_t size, ac97_audio_format_t* format) {
     if (!dev->initialized) {
-        serial_write_string("AC97: Device not initialized\n");
+        LOG_WARN(KLOG_SYS_AUDIO, "AC97: Device not initialized");
         return -1;
     }
 
+    ac97_check_underrun(dev);
+
     if (size > 65536) { // Limit buffer size
         size = 65536;
     }
@@ -144,7 +142,7 @@ int ac97_play_pcm(ac97_device_t* dev, const void* data, uint32_t size, ac97_audi
     // Set up buffer descriptor
     dev->bd_list[0].buffer_addr = (uint32_t)kmalloc(size);
     if (!dev->bd_list[0].buffer_addr) {
-        serial_write_string("AC97: Failed to allocate audio buffer\n");
+        LOG_ERR(KLOG_SYS_AUDIO, "AC97: Failed to allocate audio buffer (%u bytes)", size);
         return -1;
     }
 
@@ -169,7 +167,7 @@ int ac97_play_pcm(ac97_device_t* dev, const void* data, uint32_t size, ac97_audi
     pcm_ctl |= (1 << 0); // Run
     ac97_write32(dev, AC97_NABM_PCM_OUT + 4, pcm_ctl);
 
-    serial_write_string("AC97: Started PCM playback\n");
+    LOG_INFO(KLOG_SYS_AUDIO, "AC97: Started PCM playback (%u bytes, %u Hz)", size, format->sample_rate);
 
     return size;
 }
@@ -179,6 +177,7 @@ void ac97_stop_playback(ac97_device_t* dev) {
     uint32_t pcm_ctl = ac97_read32(dev, AC97_NABM_PCM_OUT + 4);
     pcm_ctl &= ~(1 << 0); // Clear run bit
     ac97_write32(dev, AC97_NABM_PCM_OUT + 4, pcm_ctl);
+    ac97_check_underrun(dev);
 
     // Free buffer if allocated
     if (dev->bd_list[0].buffer_addr) {
@@ -186,7 +185,7 @@ void ac97_stop_playback(ac97_device_t* dev) {
         dev->bd_list[0].buffer_addr = 0;
     }
 
-    serial_write_string("AC97: Stopped PCM playback\n");
+    LOG_INFO(KLOG_SYS_AUDIO, "AC97: Stopped PCM playback");
 }
 
 void ac97_codec_write(ac97_device_t* dev, uint8_t reg, uint16_t value) {
@@ -203,15 +202,6 @@ uint16_t ac97_codec_read(ac97_device_t* dev, uint8_t reg) {
 }
 
 void ac97_dump_registers(ac97_device_t* dev) {
-    serial_write_string("AC97: Register dump:\n");
-    uint16_t master_vol = ac97_codec_read(dev, AC97_MASTER_VOL);
-    serial_write_string("Master Volume: 0x");
-    char hex[5];
-    hex[0] = "0123456789ABCDEF"[master_vol >> 12];
-    hex[1] = "0123456789ABCDEF"[(master_vol >> 8) & 0xF];
-    hex[2] = "0123456789ABCDEF"[(master_vol >> 4) & 0xF];
-    hex[3] = "0123456789ABCDEF"[master_vol & 0xF];
-    hex[4] = 0;
-    serial_write_string(hex);
-    serial_write_string("\n");
+    LOG_INFO(KLOG_SYS_AUDIO, "AC97: Register dump:");
+    LOG_INFO(KLOG_SYS_AUDIO, "Master Volume: 0x%04X", ac97_codec_read(dev, AC97_MASTER_VOL));
 }
@@ -13,6 +13,12 @@
 #define AC97_NABM_MIC_IN     0x0C  // Microphone Buffer Descriptor Base Address
 #define AC97_NABM_GLOBAL_CTL 0x2C  // Global Control
 #define AC97_NABM_GLOBAL_STS 0x30  // Global Status
+#define AC97_NABM_PCM_OUT_SR 0x16  // PCM Out Status (16-bit)
+
+// Channel status bits (write 1 to clear the latched ones)
+#define AC97_SR_LVBCI        (1 << 2)  // Last valid buffer completed
+#define AC97_SR_BCIS         (1 << 3)  // Buffer completion interrupt
+#define AC97_SR_FIFOE        (1 << 4)  // FIFO error (underrun on output)
 
 // AC97 Codec Registers (via mixer)
 #define AC97_RESET           0x00  // Reset register
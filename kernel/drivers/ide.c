@@ -4,6 +4,7 @@
 #include "ide.h"
 #include "../../hal/serial.h" // for serial output
 #include "../../include/io.h" // for port I/O
+#include "../../include/metrics.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
@@ -209,6 +210,7 @@ int ide_read_sectors(ide_drive_t* drive, uint32_t lba, uint8_t count, void* buff
         ide_read_buffer(drive->base_port + IDE_DATA, (uint8_t*)buffer + (sector * 512), 512);
     }
 
+    metric_add(METRIC_IDE_SECTORS_READ, count);
     return count;
 }
 
@@ -266,6 +268,7 @@ int ide_write_sectors(ide_drive_t* drive, uint32_t lba, uint8_t count, const voi
         }
     }
 
+    metric_add(METRIC_IDE_SECTORS_WRITTEN, count);
     return count;
 }
 
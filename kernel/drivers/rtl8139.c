@@ -3,7 +3,10 @@
 
 #include "rtl8139.h"
 #include "../../hal/serial.h" // for serial output
+#include "../../hal/apic.h"   // for PCI IRQ routing
 #include "../../include/io.h" // for port I/O
+#include "../../include/klog.h"
+#include "../../include/metrics.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
@@ -48,17 +51,7 @@ void rtl8139_init(void) {
 }
 
 rtl8139_device_t* rtl8139_probe(uint32_t io_base, uint8_t irq) {
-    serial_write_string("RTL8139: Probing device at IO 0x");
-    // Simple hex print for IO base
-    char hex[5];
-    uint32_t val = io_base;
-    for (int i = 3; i >= 0; i--) {
-        hex[i] = "0123456789ABCDEF"[val & 0xF];
-        val >>= 4;
-    }
-    hex[4] = 0;
-    serial_write_string(hex);
-    serial_write_string("\n");
+    LOG_INFO(KLOG_SYS_NET, "RTL8139: Probing device at IO 0x%04X", io_base);
 
     // Allocate device structure
     rtl8139_device_t* dev = (rtl8139_device_t*)kmalloc(sizeof(rtl8139_device_t));
@@ -70,6 +63,7 @@ rtl8139_device_t* rtl8139_probe(uint32_t io_base, uint8_t irq) {
     memset(dev, 0, sizeof(rtl8139_device_t));
     dev->io_base = io_base;
     dev->irq = irq;
+    apic_irq_set_pci(irq); // INTx: level triggered, active low
     dev->next = rtl8139_devices;
     rtl8139_devices = dev;
 
@@ -92,16 +86,9 @@ rtl8139_device_t* rtl8139_probe(uint32_t io_base, uint8_t irq) {
     rtl8139_enable_interrupts(dev);
 
     serial_write_string("RTL8139: Device initialized successfully\n");
-    serial_write_string("RTL8139: MAC Address: ");
-    for (int i = 0; i < 6; i++) {
-        char mac_hex[3];
-        mac_hex[0] = "0123456789ABCDEF"[dev->mac_addr[i] >> 4];
-        mac_hex[1] = "0123456789ABCDEF"[dev->mac_addr[i] & 0xF];
-        mac_hex[2] = 0;
-        serial_write_string(mac_hex);
-        if (i < 5) serial_write_string(":");
-    }
-    serial_write_string("\n");
+    LOG_INFO(KLOG_SYS_NET, "RTL8139: MAC Address: %02X:%02X:%02X:%02X:%02X:%02X",
+             dev->mac_addr[0], dev->mac_addr[1], dev->mac_addr[2],
+             dev->mac_addr[3], dev->mac_addr[4], dev->mac_addr[5]);
 
     return dev;
 }
@@ -180,7 +167,7 @@ void rtl8139_enable_interrupts(rtl8139_device_t* dev) {
 
 int rtl8139_send_packet(rtl8139_device_t* dev, const void* data, uint32_t len) {
     if (len > 1500) {
-        serial_write_string("RTL8139: Packet too large\n");
+        LOG_WARN(KLOG_SYS_NET, "RTL8139: Packet too large (%u bytes)", len);
         return -1;
     }
 
@@ -190,7 +177,7 @@ int rtl8139_send_packet(rtl8139_device_t* dev, const void* data, uint32_t len) {
     // Copy packet data to a buffer (we'd normally DMA this)
     uint8_t* tx_buffer = (uint8_t*)kmalloc(len);
     if (!tx_buffer) {
-        serial_write_string("RTL8139: Failed to allocate TX buffer\n");
+        LOG_ERR(KLOG_SYS_NET, "RTL8139: Failed to allocate TX buffer");
         return -1;
     }
 
@@ -211,6 +198,8 @@ int rtl8139_send_packet(rtl8139_device_t* dev, const void* data, uint32_t len) {
     }
 
     kfree(tx_buffer);
+    metric_inc(METRIC_NET_TX_PACKETS);
+    metric_add(METRIC_NET_TX_BYTES, len);
     return len;
 }
 
@@ -232,7 +221,7 @@ int rtl8139_receive_packet(rtl8139_device_t* dev, void* buffer, uint32_t buffer_
     }
 
     if (length > buffer_size) {
-        serial_write_string("RTL8139: Packet too large for buffer\n");
+        LOG_WARN(KLOG_SYS_NET, "RTL8139: Packet too large for buffer (%u > %u)", length, buffer_size);
         return -1;
     }
 
@@ -246,17 +235,12 @@ int rtl8139_receive_packet(rtl8139_device_t* dev, void* buffer, uint32_t buffer_
     // Update tail pointer
     rtl8139_write16(dev, RTL8139_RXBUFTAIL, dev->current_rx - 16);
 
+    metric_inc(METRIC_NET_RX_PACKETS);
+    metric_add(METRIC_NET_RX_BYTES, length);
     return length;
 }
 
 void rtl8139_dump_registers(rtl8139_device_t* dev) {
-    serial_write_string("RTL8139: Register dump:\n");
-    serial_write_string("CHIPCMD: 0x");
-    char hex[3];
-    uint8_t val = rtl8139_read8(dev, RTL8139_CHIPCMD);
-    hex[0] = "0123456789ABCDEF"[val >> 4];
-    hex[1] = "0123456789ABCDEF"[val & 0xF];
-    hex[2] = 0;
-    serial_write_string(hex);
-    serial_write_string("\n");
+    LOG_INFO(KLOG_SYS_NET, "RTL8139: Register dump:");
+    LOG_INFO(KLOG_SYS_NET, "CHIPCMD: 0x%02X", rtl8139_read8(dev, RTL8139_CHIPCMD));
 }
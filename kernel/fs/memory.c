@@ -1,174 +1,599 @@
 #include "../include/kernel.h"
+#include "../include/pmm.h"
+#include "../include/spinlock.h"
+#include "../include/trace.h"
+#include "../include/metrics.h"
 
 // Memory Management for Tiny64 OS
-// Implements a simple heap-based dynamic memory allocator
-
-#define HEAP_START  0x200000        // Start at 2MB (inside bootloader-allocated kernel area)
-#define HEAP_SIZE   0x100000        // 1MB heap size
+// Two-tier heap allocator:
+//  - Small objects (<= SLAB_MAX_SIZE) come from per-size-class slab pages.
+//    Every class keeps a list of partially used pages, so kmalloc/kfree are O(1).
+//  - Larger requests use boundary-tag blocks kept in power-of-two bins.
+//    Neighbours are coalesced in O(1) through the header/footer tags.
+// Slab pages themselves are page-aligned blocks taken from the large allocator.
+// Heap regions come from the physical page allocator and more are added on
+// demand. Without a memory map the heap falls back to a fixed 1MB arena.
+
+#define HEAP_START  0x200000        // Fallback arena at 2MB (inside bootloader-allocated kernel area)
+#define HEAP_SIZE   0x100000        // Initial heap size, also the minimum growth step
 #define HEAP_END    (HEAP_START + HEAP_SIZE)
 
-#define MIN_BLOCK_SIZE  sizeof(block_t)
+#define PAGE_SIZE   4096
+#define PAGE_SHIFT  12
+
+#define HEAP_ALIGN      16
+#define ALIGN_UP(x, a)  (((x) + ((a) - 1)) & ~((uintptr_t)(a) - 1))
+
+/* --- Large block allocator --- */
 
-// Memory block header
+#define BLOCK_MAGIC     0x54363448454150ULL   // "T64HEAP"
+#define BLOCK_USED      1ULL
+#define BLOCK_HDR_SIZE  16                    // Keeps payloads 16-byte aligned
+#define BLOCK_FTR_SIZE  sizeof(size_t)
+#define MIN_BLOCK_SIZE  48                    // Header + free-list links + footer, rounded
+#define NUM_BINS        64
+#define FRAG_SCAN_MAX   8                     // Top-bin blocks examined for the largest free block
+
+// Block header. The size covers header, payload and footer; bit 0 marks it in use.
+// next_free/prev_free overlay the payload and are only valid while the block is free.
 typedef struct block {
-    size_t size;           // Size of this block (excluding header)
-    struct block *next;    // Next block in free list
-    uint8_t free;          // 1 = free, 0 = allocated
-} __attribute__((packed)) block_t;
+    size_t size;
+    size_t magic;
+    struct block *next_free;
+    struct block *prev_free;
+} block_t;
+
+/* --- Slab allocator --- */
+
+#define SLAB_MAX_SIZE       2048
+#define NUM_SIZE_CLASSES    14
+#define SLAB_FREE_MAGIC     0x5436344652454550ULL  // "T64FREEP", second word of a free object
+
+static const uint16_t class_sizes[NUM_SIZE_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+
+// Size (in 16-byte units) -> size class, built once at init
+static uint8_t class_lookup[SLAB_MAX_SIZE / HEAP_ALIGN + 1];
+
+// Per-page descriptor. size_class is 0 for pages not owned by a slab,
+// otherwise it is the class index + 1.
+typedef struct slab_page {
+    void *free_objs;
+    struct slab_page *next;
+    struct slab_page *prev;
+    uint16_t inuse;
+    uint8_t size_class;
+} slab_page_t;
+
+// A contiguous span of heap memory with its page descriptor table
+typedef struct heap_region {
+    uintptr_t start;            // First block
+    uintptr_t end;              // Epilogue header (end of usable blocks)
+    uintptr_t page_base;        // Address described by pages[0]
+    size_t num_pages;
+    slab_page_t *pages;
+    struct heap_region *next;
+} heap_region_t;
 
 // Global heap state
-static block_t *free_list = NULL;
+static heap_region_t *regions = NULL;
+static block_t *bins[NUM_BINS];
+static uint64_t bin_bitmap = 0;
+static slab_page_t *partial_pages[NUM_SIZE_CLASSES];
 static uint8_t heap_initialized = 0;
+static ticket_lock_t heap_lock = TICKET_LOCK_INIT;
+static uint8_t heap_growable = 0;      // Regions can be added from the PMM
 
-// Initialize the heap
-void init_heap(void) {
-    if (heap_initialized) return;
+// Running totals so get_heap_stats does not need to walk the heap
+static size_t heap_total_bytes = 0;
+static size_t heap_free_bytes = 0;     // Free large blocks
+static size_t slab_free_bytes = 0;     // Free objects inside slab pages
+static size_t slab_pages_in_use = 0;
 
-    // Create initial free block spanning entire heap
-    block_t *initial_block = (block_t *)HEAP_START;
-    initial_block->size = HEAP_SIZE - sizeof(block_t);
-    initial_block->next = NULL;
-    initial_block->free = 1;
+/* --- Block helpers --- */
 
-    free_list = initial_block;
-    heap_initialized = 1;
+static inline size_t block_size(block_t *b) {
+    return b->size & ~BLOCK_USED;
 }
 
-// Find a free block using first-fit algorithm
-static block_t* find_free_block(size_t size) {
-    block_t *current = free_list;
+static inline int block_is_used(block_t *b) {
+    return (b->size & BLOCK_USED) != 0;
+}
 
-    while (current) {
-        if (current->free && current->size >= size) {
-            return current;
-        }
-        current = current->next;
+static inline size_t *block_footer(block_t *b) {
+    return (size_t *)((uint8_t *)b + block_size(b) - BLOCK_FTR_SIZE);
+}
+
+static inline void block_set(block_t *b, size_t size, int used) {
+    b->size = size | (used ? BLOCK_USED : 0);
+    b->magic = BLOCK_MAGIC;
+    *block_footer(b) = b->size;
+}
+
+static inline int bin_index(size_t size) {
+    return 63 - __builtin_clzll(size);
+}
+
+static void bin_insert(block_t *b) {
+    int bin = bin_index(block_size(b));
+    b->prev_free = NULL;
+    b->next_free = bins[bin];
+    if (bins[bin]) bins[bin]->prev_free = b;
+    bins[bin] = b;
+    bin_bitmap |= 1ULL << bin;
+    heap_free_bytes += block_size(b);
+}
+
+static void bin_remove(block_t *b) {
+    int bin = bin_index(block_size(b));
+    if (b->prev_free) b->prev_free->next_free = b->next_free;
+    else bins[bin] = b->next_free;
+    if (b->next_free) b->next_free->prev_free = b->prev_free;
+    if (!bins[bin]) bin_bitmap &= ~(1ULL << bin);
+    heap_free_bytes -= block_size(b);
+}
+
+// Find a free block of at least 'size' bytes. Any block in a higher bin is
+// guaranteed to fit, so those are taken from the list head; only the exact
+// bin needs to be searched.
+static block_t *find_free_block(size_t size) {
+    int bin = bin_index(size);
+    uint64_t higher = (bin < NUM_BINS - 1) ? bin_bitmap & ~((2ULL << bin) - 1) : 0;
+
+    if (higher) {
+        return bins[__builtin_ctzll(higher)];
+    }
+
+    for (block_t *b = bins[bin]; b; b = b->next_free) {
+        if (block_size(b) >= size) return b;
     }
 
     return NULL; // No suitable block found
 }
 
-// Split a block if it's too large
+// Carve 'size' bytes off the front of a free block, returning the rest to the bins
 static void split_block(block_t *block, size_t size) {
-    if (block->size >= size + sizeof(block_t) + MIN_BLOCK_SIZE) {
-        // Create new block after this allocation
-        block_t *new_block = (block_t *)((uint8_t *)block + sizeof(block_t) + size);
-        new_block->size = block->size - size - sizeof(block_t);
-        new_block->next = block->next;
-        new_block->free = 1;
-
-        // Update current block
-        block->size = size;
-        block->next = new_block;
+    size_t total = block_size(block);
+
+    if (total - size >= MIN_BLOCK_SIZE) {
+        block_t *rest = (block_t *)((uint8_t *)block + size);
+        block_set(rest, total - size, 0);
+        bin_insert(rest);
+        block_set(block, size, 1);
+    } else {
+        block_set(block, total, 1);
     }
 }
 
-// Merge adjacent free blocks
-static void merge_free_blocks(void) {
-    block_t *current = free_list;
-
-    while (current && current->next) {
-        // Check if current block and next block are adjacent and both free
-        uint8_t *current_end = (uint8_t *)current + sizeof(block_t) + current->size;
-        block_t *next_block = (block_t *)current_end;
+// Merge with free neighbours using the boundary tags, then bin the result
+static void coalesce_and_insert(block_t *block) {
+    size_t size = block_size(block);
 
-        if ((uint8_t *)next_block == (uint8_t *)current->next &&
-            current->free && current->next->free) {
+    block_t *next = (block_t *)((uint8_t *)block + size);
+    if (!block_is_used(next)) {
+        bin_remove(next);
+        size += block_size(next);
+    }
 
-            // Merge blocks
-            current->size += sizeof(block_t) + current->next->size;
-            current->next = current->next->next;
-        } else {
-            current = current->next;
-        }
+    size_t prev_tag = *(size_t *)((uint8_t *)block - BLOCK_FTR_SIZE);
+    if (!(prev_tag & BLOCK_USED)) {
+        block_t *prev = (block_t *)((uint8_t *)block - prev_tag);
+        bin_remove(prev);
+        size += prev_tag;
+        block = prev;
     }
-}
 
-// Allocate memory
-void* kmalloc(size_t size) {
-    if (!heap_initialized) init_heap();
-    if (size == 0) return NULL;
+    block_set(block, size, 0);
+    bin_insert(block);
+}
 
-    // Prevent excessive allocations
-    if (size > HEAP_SIZE / 4) return NULL;
+static size_t block_request_size(size_t size) {
+    size_t total = ALIGN_UP(size + BLOCK_HDR_SIZE + BLOCK_FTR_SIZE, HEAP_ALIGN);
+    return total < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : total;
+}
 
-    // Align size to 8 bytes for better performance
-    size = (size + 7) & ~7;
+static void *block_alloc(size_t size) {
+    size_t total = block_request_size(size);
 
-    // Find a suitable free block
-    block_t *block = find_free_block(size);
+    block_t *block = find_free_block(total);
     if (!block) {
         return NULL; // Out of memory
     }
 
-    // Split block if necessary
-    split_block(block, size);
+    bin_remove(block);
+    split_block(block, total);
 
-    // Mark block as allocated
-    block->free = 0;
+    return (uint8_t *)block + BLOCK_HDR_SIZE;
+}
 
-    // Return pointer to data area
-    void *ptr = (void *)((uint8_t *)block + sizeof(block_t));
+// Allocate a block whose payload starts on an 'align' boundary.
+// Any slack in front of the aligned payload is returned as its own free block.
+static void *block_alloc_aligned(size_t size, size_t align) {
+    size_t total = block_request_size(size);
 
-    // Safety check: ensure pointer is within heap bounds
-    if ((uint8_t *)ptr < (uint8_t *)HEAP_START ||
-        (uint8_t *)ptr >= (uint8_t *)HEAP_END) {
+    block_t *block = find_free_block(total + align + MIN_BLOCK_SIZE);
+    if (!block) {
         return NULL;
     }
 
+    bin_remove(block);
+
+    uintptr_t payload = (uintptr_t)block + BLOCK_HDR_SIZE;
+    if (payload & (align - 1)) {
+        payload = ALIGN_UP(payload + MIN_BLOCK_SIZE, align);
+        block_t *aligned = (block_t *)(payload - BLOCK_HDR_SIZE);
+        size_t lead = (uintptr_t)aligned - (uintptr_t)block;
+        size_t rest = block_size(block) - lead;
+
+        block_set(block, lead, 0);
+        bin_insert(block);
+
+        block = aligned;
+        block_set(block, rest, 1);
+    }
+
+    split_block(block, total);
+    return (void *)payload;
+}
+
+static void block_free(block_t *block) {
+    block_set(block, block_size(block), 0);
+    coalesce_and_insert(block);
+}
+
+/* --- Regions --- */
+
+static heap_region_t *find_region(uintptr_t addr) {
+    for (heap_region_t *r = regions; r; r = r->next) {
+        if (addr >= r->start && addr < r->end) return r;
+    }
+    return NULL;
+}
+
+static inline slab_page_t *page_desc(heap_region_t *r, uintptr_t addr) {
+    return &r->pages[(addr - r->page_base) >> PAGE_SHIFT];
+}
+
+// Hand a span of memory to the heap. The region header and its page
+// descriptor table are placed at the start of the span itself.
+static void heap_add_region(uintptr_t base, size_t size) {
+    base = ALIGN_UP(base, HEAP_ALIGN);
+    heap_region_t *r = (heap_region_t *)base;
+
+    r->page_base = base & ~((uintptr_t)PAGE_SIZE - 1);
+    r->num_pages = (base + size - r->page_base + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    r->pages = (slab_page_t *)(base + sizeof(heap_region_t));
+
+    uint8_t *p = (uint8_t *)r->pages;
+    for (size_t i = 0; i < r->num_pages * sizeof(slab_page_t); i++) {
+        p[i] = 0;
+    }
+
+    // Leave room for a "used" prologue footer in front of the first block
+    uintptr_t first = ALIGN_UP((uintptr_t)(r->pages + r->num_pages) + BLOCK_FTR_SIZE, HEAP_ALIGN);
+    uintptr_t epilogue = (base + size - BLOCK_HDR_SIZE) & ~((uintptr_t)HEAP_ALIGN - 1);
+
+    r->start = first;
+    r->end = epilogue;
+
+    *(size_t *)(first - BLOCK_FTR_SIZE) = BLOCK_USED;
+    ((block_t *)epilogue)->size = BLOCK_USED;
+    ((block_t *)epilogue)->magic = BLOCK_MAGIC;
+
+    block_t *initial_block = (block_t *)first;
+    block_set(initial_block, epilogue - first, 0);
+    bin_insert(initial_block);
+
+    heap_total_bytes += epilogue - first;
+
+    r->next = regions;
+    regions = r;
+}
+
+// Add a fresh region from the physical allocator big enough for a 'need'
+// byte block (plus alignment slack). Regions are never handed back.
+static int heap_grow(size_t need) {
+    if (!heap_growable) return 0;
+
+    // Region header, page descriptors, prologue and epilogue
+    size_t overhead = sizeof(heap_region_t) + 2 * BLOCK_HDR_SIZE + PAGE_SIZE +
+                      ((need >> PAGE_SHIFT) + 2) * sizeof(slab_page_t);
+    size_t bytes = need + overhead;
+    if (bytes < HEAP_SIZE) bytes = HEAP_SIZE;
+    if (bytes > ((size_t)PMM_PAGE_SIZE << PMM_MAX_ORDER)) return 0;
+
+    unsigned int order = pmm_order_for_size(bytes);
+    void *mem = pmm_alloc_pages(order);
+    if (!mem) return 0;
+
+    heap_add_region((uintptr_t)mem, (size_t)PMM_PAGE_SIZE << order);
+    return 1;
+}
+
+static int slab_reclaim_empty(void);
+
+// Large allocation with the slow paths: drop cached slab pages, then grow
+static void *block_alloc_retry(size_t size, size_t align) {
+    void *ptr = align ? block_alloc_aligned(size, align) : block_alloc(size);
+    if (ptr) return ptr;
+
+    if (slab_reclaim_empty()) {
+        ptr = align ? block_alloc_aligned(size, align) : block_alloc(size);
+        if (ptr) return ptr;
+    }
+
+    if (heap_grow(block_request_size(size) + align + MIN_BLOCK_SIZE)) {
+        ptr = align ? block_alloc_aligned(size, align) : block_alloc(size);
+    }
     return ptr;
 }
 
-// Free memory
-void kfree(void *ptr) {
-    if (!ptr || !heap_initialized) return;
+/* --- Slab pages --- */
 
-    // Bounds check
-    if ((uint8_t *)ptr < (uint8_t *)HEAP_START + sizeof(block_t) ||
-        (uint8_t *)ptr >= (uint8_t *)HEAP_END) {
-        return; // Invalid pointer
+static void page_list_push(slab_page_t **head, slab_page_t *pg) {
+    pg->prev = NULL;
+    pg->next = *head;
+    if (*head) (*head)->prev = pg;
+    *head = pg;
+}
+
+static void page_list_remove(slab_page_t **head, slab_page_t *pg) {
+    if (pg->prev) pg->prev->next = pg->next;
+    else *head = pg->next;
+    if (pg->next) pg->next->prev = pg->prev;
+    pg->next = pg->prev = NULL;
+}
+
+static slab_page_t *slab_new_page(int cls) {
+    uint8_t *page = block_alloc_retry(PAGE_SIZE, PAGE_SIZE);
+    if (!page) return NULL;
+
+    heap_region_t *r = find_region((uintptr_t)page);
+    slab_page_t *pg = page_desc(r, (uintptr_t)page);
+
+    size_t obj_size = class_sizes[cls];
+    size_t count = PAGE_SIZE / obj_size;
+
+    // Thread the free list through the objects, lowest address first
+    void **prev = &pg->free_objs;
+    for (size_t i = 0; i < count; i++) {
+        void **obj = (void **)(page + i * obj_size);
+        obj[1] = (void *)SLAB_FREE_MAGIC;
+        *prev = obj;
+        prev = obj;
     }
+    *prev = NULL;
 
-    // Get block header from data pointer
-    block_t *block = (block_t *)((uint8_t *)ptr - sizeof(block_t));
+    pg->inuse = 0;
+    pg->size_class = cls + 1;
+    page_list_push(&partial_pages[cls], pg);
+
+    slab_free_bytes += count * obj_size;
+    slab_pages_in_use++;
+    return pg;
+}
 
-    // Additional validation
-    if (block->size == 0 || block->size > HEAP_SIZE) {
-        return; // Corrupted block
+static void *slab_alloc(int cls) {
+    slab_page_t *pg = partial_pages[cls];
+    if (!pg) {
+        pg = slab_new_page(cls);
+        if (!pg) return NULL;
     }
 
-    // Mark as free
-    block->free = 1;
+    void **obj = pg->free_objs;
+    pg->free_objs = *obj;
+    obj[1] = NULL;
+    pg->inuse++;
+    slab_free_bytes -= class_sizes[cls];
+
+    // Full pages leave the partial list until an object comes back
+    if (!pg->free_objs) {
+        page_list_remove(&partial_pages[cls], pg);
+    }
 
-    // Merge adjacent free blocks
-    merge_free_blocks();
+    return obj;
 }
 
-// Get heap statistics
-void get_heap_stats(size_t *total_size, size_t *used_size, size_t *free_size) {
-    if (!heap_initialized) {
-        *total_size = *used_size = *free_size = 0;
+static void slab_release_page(heap_region_t *r, slab_page_t *pg) {
+    int cls = pg->size_class - 1;
+    size_t obj_size = class_sizes[cls];
+    uintptr_t page = r->page_base + ((size_t)(pg - r->pages) << PAGE_SHIFT);
+
+    page_list_remove(&partial_pages[cls], pg);
+    pg->size_class = 0;
+    pg->free_objs = NULL;
+    slab_free_bytes -= (PAGE_SIZE / obj_size) * obj_size;
+    slab_pages_in_use--;
+    block_free((block_t *)(page - BLOCK_HDR_SIZE));
+}
+
+// Return every cached empty slab page to the block allocator.
+// Only used when a large allocation fails, so walking the lists is fine.
+static int slab_reclaim_empty(void) {
+    int released = 0;
+    for (heap_region_t *r = regions; r; r = r->next) {
+        for (size_t i = 0; i < r->num_pages; i++) {
+            slab_page_t *pg = &r->pages[i];
+            if (pg->size_class && pg->inuse == 0) {
+                slab_release_page(r, pg);
+                released++;
+            }
+        }
+    }
+    return released;
+}
+
+static void slab_free(heap_region_t *r, slab_page_t *pg, void *ptr) {
+    int cls = pg->size_class - 1;
+    size_t obj_size = class_sizes[cls];
+    uintptr_t page = r->page_base + ((size_t)(pg - r->pages) << PAGE_SHIFT);
+
+    // Reject pointers that are not at an object boundary
+    if (((uintptr_t)ptr - page) % obj_size != 0) {
         return;
     }
 
-    *total_size = HEAP_SIZE;
-    *used_size = 0;
-    *free_size = 0;
+    // Free objects carry the magic, so only a match (a double free, or live
+    // data that happens to look like it) needs the free list searched
+    void **obj = ptr;
+    if (obj[1] == (void *)SLAB_FREE_MAGIC) {
+        for (void **f = pg->free_objs; f; f = *f) {
+            if (f == obj) return; // Double free
+        }
+    }
+
+    int was_full = (pg->free_objs == NULL);
+    obj[0] = pg->free_objs;
+    obj[1] = (void *)SLAB_FREE_MAGIC;
+    pg->free_objs = obj;
+    pg->inuse--;
+    slab_free_bytes += obj_size;
 
-    block_t *current = (block_t *)HEAP_START;
-    uint8_t *heap_ptr = (uint8_t *)HEAP_START;
+    if (was_full) {
+        page_list_push(&partial_pages[cls], pg);
+    }
 
-    while (heap_ptr < (uint8_t *)HEAP_END) {
-        block_t *block = (block_t *)heap_ptr;
+    // Give empty pages back, but keep one per class to avoid thrashing
+    if (pg->inuse == 0 && (pg->next || pg->prev)) {
+        slab_release_page(r, pg);
+    }
+}
 
-        if (block->free) {
-            *free_size += block->size;
-        } else {
-            *used_size += block->size;
+/* --- Metrics --- */
+
+// Registry sampler for the heap gauges, run when they are read so kmalloc
+// and kfree stay untouched. The largest free block is in the highest
+// non-empty bin, whose blocks are all within a factor of two of each other,
+// so a few of them are enough to look at.
+static void heap_sample_metrics(void) {
+    uint64_t flags = ticket_lock_irqsave(&heap_lock);
+
+    size_t largest = 0;
+    if (bin_bitmap) {
+        int scanned = 0;
+        for (block_t *b = bins[63 - __builtin_clzll(bin_bitmap)]; b && scanned < FRAG_SCAN_MAX; b = b->next_free) {
+            if (block_size(b) > largest) largest = block_size(b);
+            scanned++;
         }
+    }
+    size_t total = heap_total_bytes;
+    size_t free = heap_free_bytes + slab_free_bytes;
+    size_t frag = heap_free_bytes ? 1000 - largest * 1000 / heap_free_bytes : 0;
+
+    ticket_unlock_irqrestore(&heap_lock, flags);
+
+    metric_set(METRIC_HEAP_TOTAL, total);
+    metric_set(METRIC_HEAP_USED, total - free);
+    metric_set(METRIC_HEAP_FREE, free);
+    metric_set(METRIC_HEAP_FRAG, frag);
+}
+
+/* --- Public API --- */
 
-        heap_ptr += sizeof(block_t) + block->size;
+// Initialize the heap
+void init_heap(void) {
+    if (heap_initialized) return;
+
+    int cls = 0;
+    for (size_t units = 0; units <= SLAB_MAX_SIZE / HEAP_ALIGN; units++) {
+        while (class_sizes[cls] < units * HEAP_ALIGN) cls++;
+        class_lookup[units] = cls;
+    }
+
+    void *initial = pmm_alloc_pages(pmm_order_for_size(HEAP_SIZE));
+    if (initial) {
+        heap_add_region((uintptr_t)initial, HEAP_SIZE);
+        heap_growable = 1;
+    } else {
+        heap_add_region(HEAP_START, HEAP_SIZE);
     }
+    heap_initialized = 1;
+    metric_add_sampler(heap_sample_metrics);
+}
+
+// Allocate memory
+// Threads can be preempted, IRQ handlers may allocate and other CPUs share
+// the heap, so the allocator runs under an IRQ-safe ticket lock.
+void* kmalloc(size_t size) {
+    if (size == 0) return NULL;
+
+    TRACE_BEGIN("kmalloc");
+    uint64_t flags = ticket_lock_irqsave(&heap_lock);
+    if (!heap_initialized) init_heap();
+
+    void *ptr;
+    if (size <= SLAB_MAX_SIZE) {
+        ptr = slab_alloc(class_lookup[(size + HEAP_ALIGN - 1) / HEAP_ALIGN]);
+    } else if (!heap_growable && size > HEAP_SIZE / 4) {
+        ptr = NULL; // Prevent excessive allocations from the fixed arena
+    } else {
+        ptr = block_alloc_retry(size, 0);
+    }
+    size_t used = heap_total_bytes - heap_free_bytes - slab_free_bytes;
+    ticket_unlock_irqrestore(&heap_lock, flags);
+    TRACE_COUNTER("heap used", used);
+    TRACE_END("kmalloc");
+    return ptr;
+}
+
+static void kfree_locked(void *ptr) {
+    heap_region_t *r = find_region((uintptr_t)ptr);
+    if (!r) {
+        return; // Invalid pointer
+    }
+
+    slab_page_t *pg = page_desc(r, (uintptr_t)ptr);
+    if (pg->size_class) {
+        slab_free(r, pg, ptr);
+        return;
+    }
+
+    // Get block header from data pointer
+    block_t *block = (block_t *)((uint8_t *)ptr - BLOCK_HDR_SIZE);
+    if ((uintptr_t)block < r->start || block->magic != BLOCK_MAGIC || !block_is_used(block)) {
+        return; // Corrupted block or double free
+    }
+
+    block_free(block);
+}
+
+// Free memory
+void kfree(void *ptr) {
+    if (!ptr || !heap_initialized) return;
+
+    TRACE_BEGIN("kfree");
+    uint64_t flags = ticket_lock_irqsave(&heap_lock);
+    kfree_locked(ptr);
+    size_t used = heap_total_bytes - heap_free_bytes - slab_free_bytes;
+    ticket_unlock_irqrestore(&heap_lock, flags);
+    TRACE_COUNTER("heap used", used);
+    TRACE_END("kfree");
+}
+
+// Get heap statistics
+void get_heap_stats(size_t *total_size, size_t *used_size, size_t *free_size) {
+    if (!heap_initialized) {
+        *total_size = *used_size = *free_size = 0;
+        return;
+    }
+
+    *total_size = heap_total_bytes;
+    *free_size = heap_free_bytes + slab_free_bytes;
+    *used_size = heap_total_bytes - *free_size;
+}
+
+static void format_size_line(char *buf, const char *label, size_t value) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    while (*label) *buf++ = *label++;
+    while (n > 0) *buf++ = digits[--n];
+    *buf = '\0';
 }
 
 // Debug function to print heap layout
@@ -181,22 +606,37 @@ void debug_heap(BootInfo *info, int start_y) {
     kprint(info, "Heap Layout:", 10, start_y, 0xFFFFFFFF);
     start_y += 20;
 
-    block_t *current = (block_t *)HEAP_START;
-    uint8_t *heap_ptr = (uint8_t *)HEAP_START;
-    int block_num = 0;
-
-    while (heap_ptr < (uint8_t *)HEAP_END && block_num < 10) { // Show first 10 blocks
-        block_t *block = (block_t *)heap_ptr;
-
-        char buffer[64];
-        // This is a simplified print - you'd need a proper sprintf
-        kprint(info, block->free ? "FREE" : "USED", 10, start_y, block->free ? 0xFF00FF00 : 0xFFFF0000);
-
-        // Print size (simplified)
-        kprint(info, " block", 80, start_y, 0xFFFFFFFF);
-
+    size_t total, used, free;
+    get_heap_stats(&total, &used, &free);
+
+    char buffer[64];
+    format_size_line(buffer, "Total bytes: ", total);
+    kprint(info, buffer, 10, start_y, 0xFFFFFFFF);
+    start_y += 15;
+    format_size_line(buffer, "Used bytes:  ", used);
+    kprint(info, buffer, 10, start_y, 0xFFFF0000);
+    start_y += 15;
+    format_size_line(buffer, "Free bytes:  ", free);
+    kprint(info, buffer, 10, start_y, 0xFF00FF00);
+    start_y += 15;
+    format_size_line(buffer, "Slab pages:  ", slab_pages_in_use);
+    kprint(info, buffer, 10, start_y, 0xFFFFFFFF);
+    start_y += 15;
+    format_size_line(buffer, "Frag (1/1000): ", metric_read(METRIC_HEAP_FRAG));
+    kprint(info, buffer, 10, start_y, 0xFFFFFFFF);
+    start_y += 15;
+
+    // Show up to 10 free bins
+    int shown = 0;
+    for (int bin = 0; bin < NUM_BINS && shown < 10; bin++) {
+        if (!bins[bin]) continue;
+        size_t count = 0;
+        for (block_t *b = bins[bin]; b; b = b->next_free) count++;
+        format_size_line(buffer, "FREE bin 2^", bin);
+        kprint(info, buffer, 10, start_y, 0xFF00FF00);
+        format_size_line(buffer, " blocks: ", count);
+        kprint(info, buffer, 200, start_y, 0xFFFFFFFF);
         start_y += 15;
-        heap_ptr += sizeof(block_t) + block->size;
-        block_num++;
+        shown++;
     }
 }
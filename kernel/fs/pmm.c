@@ -0,0 +1,225 @@
+#include "../include/kernel.h"
+#include "../include/pmm.h"
+#include "../include/spinlock.h"
+#include "../hal/serial.h"
+
+// Physical Memory Manager for Tiny64 OS
+// Buddy allocator built from the UEFI memory map. Every managed frame has one
+// metadata byte; free blocks are linked through their own first bytes.
+
+#define FRAME_FREE          0x80    // Frame heads a free block
+#define FRAME_RESERVED      0x40    // Not managed (firmware, kernel, MMIO, holes)
+
+#define LOW_MEMORY_LIMIT    0x100000    // Leave real-mode memory alone
+
+typedef struct free_block {
+    struct free_block *next;
+    struct free_block *prev;
+} free_block_t;
+
+static uint8_t *frame_meta = NULL;      // One byte per frame from base_pfn
+static uint64_t base_pfn = 0;
+static size_t frame_count = 0;
+static free_block_t *free_lists[PMM_MAX_ORDER + 1];
+static size_t total_pages = 0;
+static size_t free_pages = 0;
+static int pmm_ready = 0;
+static ticket_lock_t pmm_lock = TICKET_LOCK_INIT;
+
+static inline free_block_t *pfn_to_block(uint64_t pfn) {
+    return (free_block_t *)(uintptr_t)(pfn << PMM_PAGE_SHIFT);
+}
+
+static void list_push(unsigned int order, uint64_t pfn) {
+    free_block_t *b = pfn_to_block(pfn);
+    b->prev = NULL;
+    b->next = free_lists[order];
+    if (free_lists[order]) free_lists[order]->prev = b;
+    free_lists[order] = b;
+    frame_meta[pfn - base_pfn] = FRAME_FREE | order;
+}
+
+static void list_remove(unsigned int order, uint64_t pfn) {
+    free_block_t *b = pfn_to_block(pfn);
+    if (b->prev) b->prev->next = b->next;
+    else free_lists[order] = b->next;
+    if (b->next) b->next->prev = b->prev;
+    frame_meta[pfn - base_pfn] = 0;
+}
+
+// Return a block to the free lists, merging with its buddy while possible
+static void free_block(uint64_t pfn, unsigned int order) {
+    free_pages += 1UL << order;
+
+    while (order < PMM_MAX_ORDER) {
+        uint64_t buddy = pfn ^ (1ULL << order);
+        if (buddy < base_pfn || buddy - base_pfn >= frame_count) break;
+        if (frame_meta[buddy - base_pfn] != (FRAME_FREE | order)) break;
+
+        list_remove(order, buddy);
+        frame_meta[pfn - base_pfn] = 0;
+        pfn &= ~(1ULL << order);
+        order++;
+    }
+
+    list_push(order, pfn);
+}
+
+// Free an arbitrary page range as the largest naturally aligned blocks that fit
+static void free_range(uint64_t start_pfn, uint64_t end_pfn) {
+    while (start_pfn < end_pfn) {
+        unsigned int order = PMM_MAX_ORDER;
+        while (order > 0 &&
+               ((start_pfn & ((1ULL << order) - 1)) || start_pfn + (1ULL << order) > end_pfn)) {
+            order--;
+        }
+        free_block(start_pfn, order);
+        total_pages += 1UL << order;
+        start_pfn += 1ULL << order;
+    }
+}
+
+void pmm_init(BootInfo *info) {
+    if (pmm_ready) return;
+    if (!info || !info->memory_map || !info->memory_map_size || !info->memory_map_desc_size) {
+        serial_write_string("[PMM] No UEFI memory map, physical allocator disabled\n");
+        return;
+    }
+
+    uint8_t *map = (uint8_t *)info->memory_map;
+    size_t stride = info->memory_map_desc_size;
+    size_t count = info->memory_map_size / stride;
+
+    // Pass 1: find the span of usable memory
+    uint64_t lowest = UINT64_MAX, highest = 0;
+    for (size_t i = 0; i < count; i++) {
+        efi_memory_descriptor_t *d = (efi_memory_descriptor_t *)(map + i * stride);
+        if (d->type != EFI_CONVENTIONAL_MEMORY) continue;
+        uint64_t start = d->physical_start;
+        uint64_t end = start + (d->number_of_pages << PMM_PAGE_SHIFT);
+        if (end <= LOW_MEMORY_LIMIT) continue;
+        if (start < LOW_MEMORY_LIMIT) start = LOW_MEMORY_LIMIT;
+        if (start < lowest) lowest = start;
+        if (end > highest) highest = end;
+    }
+
+    if (highest == 0) {
+        serial_write_string("[PMM] No conventional memory found\n");
+        return;
+    }
+
+    // Align the metadata base so buddy addresses can be computed with XOR
+    base_pfn = (lowest >> PMM_PAGE_SHIFT) & ~((1ULL << PMM_MAX_ORDER) - 1);
+    frame_count = (highest >> PMM_PAGE_SHIFT) - base_pfn;
+    size_t meta_pages = (frame_count + PMM_PAGE_SIZE - 1) >> PMM_PAGE_SHIFT;
+
+    // Pass 2: carve the metadata array out of the first region large enough
+    uint64_t meta_start = 0;
+    for (size_t i = 0; i < count && !meta_start; i++) {
+        efi_memory_descriptor_t *d = (efi_memory_descriptor_t *)(map + i * stride);
+        if (d->type != EFI_CONVENTIONAL_MEMORY) continue;
+        uint64_t start = d->physical_start < LOW_MEMORY_LIMIT ? LOW_MEMORY_LIMIT : d->physical_start;
+        uint64_t end = d->physical_start + (d->number_of_pages << PMM_PAGE_SHIFT);
+        if (end > start && end - start >= (meta_pages << PMM_PAGE_SHIFT)) {
+            meta_start = start;
+        }
+    }
+
+    if (!meta_start) {
+        serial_write_string("[PMM] No room for frame metadata\n");
+        return;
+    }
+
+    frame_meta = (uint8_t *)(uintptr_t)meta_start;
+    for (size_t i = 0; i < frame_count; i++) {
+        frame_meta[i] = FRAME_RESERVED;
+    }
+
+    // Pass 3: release every conventional page except the metadata itself
+    uint64_t meta_end_pfn = (meta_start >> PMM_PAGE_SHIFT) + meta_pages;
+    for (size_t i = 0; i < count; i++) {
+        efi_memory_descriptor_t *d = (efi_memory_descriptor_t *)(map + i * stride);
+        if (d->type != EFI_CONVENTIONAL_MEMORY) continue;
+        uint64_t start = d->physical_start < LOW_MEMORY_LIMIT ? LOW_MEMORY_LIMIT : d->physical_start;
+        uint64_t end = d->physical_start + (d->number_of_pages << PMM_PAGE_SHIFT);
+        if (end <= start) continue;
+
+        uint64_t start_pfn = start >> PMM_PAGE_SHIFT;
+        uint64_t end_pfn = end >> PMM_PAGE_SHIFT;
+        if (start == meta_start) start_pfn = meta_end_pfn;
+
+        // Mark the range managed before freeing so buddies see each other
+        for (uint64_t pfn = start_pfn; pfn < end_pfn; pfn++) {
+            frame_meta[pfn - base_pfn] = 0;
+        }
+        free_range(start_pfn, end_pfn);
+    }
+
+    pmm_ready = 1;
+
+    serial_write_string("[PMM] Managing ");
+    serial_write_dec((total_pages << PMM_PAGE_SHIFT) >> 20);
+    serial_write_string("MB of conventional memory in ");
+    serial_write_dec(count);
+    serial_write_string(" map entries\n");
+}
+
+int pmm_is_initialized(void) {
+    return pmm_ready;
+}
+
+static void *alloc_pages_locked(unsigned int order) {
+    unsigned int found = order;
+    while (found <= PMM_MAX_ORDER && !free_lists[found]) found++;
+    if (found > PMM_MAX_ORDER) return NULL; // Out of memory
+
+    uint64_t pfn = (uintptr_t)free_lists[found] >> PMM_PAGE_SHIFT;
+    list_remove(found, pfn);
+
+    // Split down to the requested order, freeing the upper halves
+    while (found > order) {
+        found--;
+        list_push(found, pfn + (1ULL << found));
+    }
+
+    frame_meta[pfn - base_pfn] = order;
+    free_pages -= 1UL << order;
+    return (void *)(uintptr_t)(pfn << PMM_PAGE_SHIFT);
+}
+
+void *pmm_alloc_pages(unsigned int order) {
+    if (!pmm_ready || order > PMM_MAX_ORDER) return NULL;
+
+    uint64_t flags = ticket_lock_irqsave(&pmm_lock);
+    void *pages = alloc_pages_locked(order);
+    ticket_unlock_irqrestore(&pmm_lock, flags);
+    return pages;
+}
+
+void pmm_free_pages(void *addr, unsigned int order) {
+    if (!pmm_ready || !addr || order > PMM_MAX_ORDER) return;
+
+    uint64_t pfn = (uintptr_t)addr >> PMM_PAGE_SHIFT;
+    if (pfn < base_pfn || pfn - base_pfn >= frame_count) return;
+
+    // Only accept the head of an allocated block of the same order
+    if (frame_meta[pfn - base_pfn] != order) return;
+
+    uint64_t flags = ticket_lock_irqsave(&pmm_lock);
+    free_block(pfn, order);
+    ticket_unlock_irqrestore(&pmm_lock, flags);
+}
+
+unsigned int pmm_order_for_size(size_t bytes) {
+    unsigned int order = 0;
+    while (order < PMM_MAX_ORDER && ((size_t)PMM_PAGE_SIZE << order) < bytes) order++;
+    return order;
+}
+
+size_t pmm_get_total_pages(void) {
+    return total_pages;
+}
+
+size_t pmm_get_free_pages(void) {
+    return free_pages;
+}
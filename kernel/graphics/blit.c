@@ -0,0 +1,298 @@
+#include "../include/blit.h"
+#include "../include/string.h"
+
+/* --- Row kernels --- */
+//
+// Each takes a destination already offset to the first pixel and a pixel
+// count. A scalar head brings the destination to vector alignment so the
+// loops can use aligned or non-temporal stores; the tail is scalar again.
+// Streaming kernels leave ordering to the caller, which fences once per call.
+// The kernel is built without optimisation, so the loops are inline assembly
+// like the memcpy/memset variants in string.c.
+
+typedef void (*fill_row_fn_t)(uint32_t *dst, uint32_t n, uint32_t color, int stream);
+typedef void (*stream_row_fn_t)(uint32_t *dst, const uint32_t *src, uint32_t n);
+
+static void fill_row_sse2(uint32_t *dst, uint32_t n, uint32_t color, int stream) {
+    while (n && ((uintptr_t)dst & 15)) {
+        *dst++ = color;
+        n--;
+    }
+
+    uint32_t blocks = n >> 4;
+    if (blocks && stream) {
+        __asm__ volatile("movd %2, %%xmm0\n\t"
+                         "pshufd $0, %%xmm0, %%xmm0\n\t"
+                         "1:\n\t"
+                         "movntdq %%xmm0,   (%0)\n\t"
+                         "movntdq %%xmm0, 16(%0)\n\t"
+                         "movntdq %%xmm0, 32(%0)\n\t"
+                         "movntdq %%xmm0, 48(%0)\n\t"
+                         "add $64, %0\n\t"
+                         "dec %1\n\t"
+                         "jnz 1b"
+                         : "+r"(dst), "+r"(blocks)
+                         : "r"(color) : "xmm0", "memory", "cc");
+    } else if (blocks) {
+        __asm__ volatile("movd %2, %%xmm0\n\t"
+                         "pshufd $0, %%xmm0, %%xmm0\n\t"
+                         "1:\n\t"
+                         "movdqa %%xmm0,   (%0)\n\t"
+                         "movdqa %%xmm0, 16(%0)\n\t"
+                         "movdqa %%xmm0, 32(%0)\n\t"
+                         "movdqa %%xmm0, 48(%0)\n\t"
+                         "add $64, %0\n\t"
+                         "dec %1\n\t"
+                         "jnz 1b"
+                         : "+r"(dst), "+r"(blocks)
+                         : "r"(color) : "xmm0", "memory", "cc");
+    }
+
+    for (n &= 15; n >= 4; n -= 4, dst += 4) {
+        __asm__ volatile("movd %1, %%xmm0\n\t"
+                         "pshufd $0, %%xmm0, %%xmm0\n\t"
+                         "movdqa %%xmm0, (%0)"
+                         : : "r"(dst), "r"(color) : "xmm0", "memory");
+    }
+    while (n--) *dst++ = color;
+}
+
+// Movdqu loads, movntdq stores: only used for destinations that stream
+static void stream_row_sse2(uint32_t *dst, const uint32_t *src, uint32_t n) {
+    while (n && ((uintptr_t)dst & 15)) {
+        *dst++ = *src++;
+        n--;
+    }
+
+    uint32_t blocks = n >> 4;
+    if (blocks) {
+        __asm__ volatile("1:\n\t"
+                         "movdqu   (%1), %%xmm0\n\t"
+                         "movdqu 16(%1), %%xmm1\n\t"
+                         "movdqu 32(%1), %%xmm2\n\t"
+                         "movdqu 48(%1), %%xmm3\n\t"
+                         "movntdq %%xmm0,   (%0)\n\t"
+                         "movntdq %%xmm1, 16(%0)\n\t"
+                         "movntdq %%xmm2, 32(%0)\n\t"
+                         "movntdq %%xmm3, 48(%0)\n\t"
+                         "add $64, %1\n\t"
+                         "add $64, %0\n\t"
+                         "dec %2\n\t"
+                         "jnz 1b"
+                         : "+r"(dst), "+r"(src), "+r"(blocks)
+                         : : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+    }
+
+    for (n &= 15; n >= 4; n -= 4, dst += 4, src += 4) {
+        __asm__ volatile("movdqu (%1), %%xmm0\n\t"
+                         "movntdq %%xmm0, (%0)"
+                         : : "r"(dst), "r"(src) : "xmm0", "memory");
+    }
+    while (n--) *dst++ = *src++;
+}
+
+// AVX2: 32-byte stores, 128 bytes per iteration. Only selected when the OS
+// has enabled YMM state in XCR0.
+static void fill_row_avx2(uint32_t *dst, uint32_t n, uint32_t color, int stream) {
+    if (n < 32) {
+        fill_row_sse2(dst, n, color, stream);
+        return;
+    }
+
+    while ((uintptr_t)dst & 31) {
+        *dst++ = color;
+        n--;
+    }
+
+    uint32_t blocks = n >> 5;
+    uint32_t chunks = (n & 31) >> 3;
+    if (stream) {
+        __asm__ volatile("vmovd %3, %%xmm0\n\t"
+                         "vpbroadcastd %%xmm0, %%ymm0\n\t"
+                         "test %1, %1\n\t"
+                         "jz 2f\n\t"
+                         "1:\n\t"
+                         "vmovntdq %%ymm0,   (%0)\n\t"
+                         "vmovntdq %%ymm0, 32(%0)\n\t"
+                         "vmovntdq %%ymm0, 64(%0)\n\t"
+                         "vmovntdq %%ymm0, 96(%0)\n\t"
+                         "add $128, %0\n\t"
+                         "dec %1\n\t"
+                         "jnz 1b\n\t"
+                         "2:\n\t"
+                         "test %2, %2\n\t"
+                         "jz 4f\n\t"
+                         "3:\n\t"
+                         "vmovntdq %%ymm0, (%0)\n\t"
+                         "add $32, %0\n\t"
+                         "dec %2\n\t"
+                         "jnz 3b\n\t"
+                         "4:\n\t"
+                         "vzeroupper"
+                         : "+r"(dst), "+r"(blocks), "+r"(chunks)
+                         : "r"(color) : "xmm0", "memory", "cc");
+    } else {
+        __asm__ volatile("vmovd %3, %%xmm0\n\t"
+                         "vpbroadcastd %%xmm0, %%ymm0\n\t"
+                         "test %1, %1\n\t"
+                         "jz 2f\n\t"
+                         "1:\n\t"
+                         "vmovdqa %%ymm0,   (%0)\n\t"
+                         "vmovdqa %%ymm0, 32(%0)\n\t"
+                         "vmovdqa %%ymm0, 64(%0)\n\t"
+                         "vmovdqa %%ymm0, 96(%0)\n\t"
+                         "add $128, %0\n\t"
+                         "dec %1\n\t"
+                         "jnz 1b\n\t"
+                         "2:\n\t"
+                         "test %2, %2\n\t"
+                         "jz 4f\n\t"
+                         "3:\n\t"
+                         "vmovdqa %%ymm0, (%0)\n\t"
+                         "add $32, %0\n\t"
+                         "dec %2\n\t"
+                         "jnz 3b\n\t"
+                         "4:\n\t"
+                         "vzeroupper"
+                         : "+r"(dst), "+r"(blocks), "+r"(chunks)
+                         : "r"(color) : "xmm0", "memory", "cc");
+    }
+
+    for (n &= 7; n; n--) *dst++ = color;
+}
+
+static void stream_row_avx2(uint32_t *dst, const uint32_t *src, uint32_t n) {
+    if (n < 32) {
+        stream_row_sse2(dst, src, n);
+        return;
+    }
+
+    while ((uintptr_t)dst & 31) {
+        *dst++ = *src++;
+        n--;
+    }
+
+    uint32_t blocks = n >> 5;
+    if (blocks) {
+        __asm__ volatile("1:\n\t"
+                         "vmovdqu   (%1), %%ymm0\n\t"
+                         "vmovdqu 32(%1), %%ymm1\n\t"
+                         "vmovdqu 64(%1), %%ymm2\n\t"
+                         "vmovdqu 96(%1), %%ymm3\n\t"
+                         "vmovntdq %%ymm0,   (%0)\n\t"
+                         "vmovntdq %%ymm1, 32(%0)\n\t"
+                         "vmovntdq %%ymm2, 64(%0)\n\t"
+                         "vmovntdq %%ymm3, 96(%0)\n\t"
+                         "add $128, %1\n\t"
+                         "add $128, %0\n\t"
+                         "dec %2\n\t"
+                         "jnz 1b\n\t"
+                         "vzeroupper"
+                         : "+r"(dst), "+r"(src), "+r"(blocks)
+                         : : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+    }
+
+    stream_row_sse2(dst, src, n & 31);
+}
+
+/* --- Dispatch --- */
+
+static fill_row_fn_t fill_row = fill_row_sse2;
+static stream_row_fn_t stream_row = stream_row_sse2;
+static const char *impl_name = "sse2";
+
+static inline void blit_cpuid(uint32_t leaf, uint32_t sub, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    __asm__ volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(sub));
+}
+
+void blit_init_dispatch(void) {
+    uint32_t a, b, c, d;
+
+    blit_cpuid(0, 0, &a, &b, &c, &d);
+    uint32_t max_leaf = a;
+
+    // Same test as mem_init_dispatch: OSXSAVE, AVX, XCR0 has XMM|YMM, AVX2
+    blit_cpuid(1, 0, &a, &b, &c, &d);
+    if (max_leaf < 7 || !(c & (1u << 27)) || !(c & (1u << 28))) return;
+
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 6) != 6) return;
+
+    blit_cpuid(7, 0, &a, &b, &c, &d);
+    if (!((b >> 5) & 1)) return;
+
+    fill_row = fill_row_avx2;
+    stream_row = stream_row_avx2;
+    impl_name = "avx2";
+}
+
+const char *blit_impl_name(void) {
+    return impl_name;
+}
+
+/* --- Fill and copy --- */
+
+static inline int blit_streams(const blit_surface_t *dst, int w, int h) {
+    return (dst->flags & BLIT_WC) || (uint64_t)w * h * sizeof(uint32_t) >= BLIT_STREAM_MIN;
+}
+
+void blit_fill(const blit_surface_t *dst, int x, int y, int w, int h, uint32_t color) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (w > (int)dst->width - x) w = (int)dst->width - x;
+    if (h > (int)dst->height - y) h = (int)dst->height - y;
+    if (w <= 0 || h <= 0) return;
+
+    int stream = blit_streams(dst, w, h);
+    uint32_t *row = dst->pixels + (size_t)y * dst->pitch + x;
+
+    if ((uint32_t)w == dst->pitch && (uint64_t)w * h <= 0xFFFFFFFFu) {
+        // Whole rows with no padding between them: one run
+        fill_row(row, (uint32_t)w * h, color, stream);
+    } else {
+        for (int i = 0; i < h; i++, row += dst->pitch) {
+            fill_row(row, w, color, stream);
+        }
+    }
+    if (stream) __asm__ volatile("sfence" : : : "memory");
+}
+
+void blit_copy(const blit_surface_t *dst, int dx, int dy,
+               const blit_surface_t *src, int sx, int sy, int w, int h) {
+    if (sx < 0) { dx -= sx; w += sx; sx = 0; }
+    if (sy < 0) { dy -= sy; h += sy; sy = 0; }
+    if (dx < 0) { sx -= dx; w += dx; dx = 0; }
+    if (dy < 0) { sy -= dy; h += dy; dy = 0; }
+    if (w > (int)src->width - sx) w = (int)src->width - sx;
+    if (h > (int)src->height - sy) h = (int)src->height - sy;
+    if (w > (int)dst->width - dx) w = (int)dst->width - dx;
+    if (h > (int)dst->height - dy) h = (int)dst->height - dy;
+    if (w <= 0 || h <= 0) return;
+
+    uint32_t *d = dst->pixels + (size_t)dy * dst->pitch + dx;
+    const uint32_t *s = src->pixels + (size_t)sy * src->pitch + sx;
+    size_t bytes = (size_t)w * sizeof(uint32_t);
+
+    if (dst->pixels == src->pixels) {
+        // One surface: rows never overlap each other, except a row onto itself
+        if (dy == sy) {
+            for (int i = 0; i < h; i++, d += dst->pitch, s += src->pitch) memmove(d, s, bytes);
+        } else if (dy > sy) {
+            // Moving down: bottom row first so no source row is overwritten unread
+            d += (size_t)(h - 1) * dst->pitch;
+            s += (size_t)(h - 1) * src->pitch;
+            for (int i = 0; i < h; i++, d -= dst->pitch, s -= src->pitch) memcpy(d, s, bytes);
+        } else {
+            for (int i = 0; i < h; i++, d += dst->pitch, s += src->pitch) memcpy(d, s, bytes);
+        }
+        return;
+    }
+
+    if (blit_streams(dst, w, h)) {
+        for (int i = 0; i < h; i++, d += dst->pitch, s += src->pitch) stream_row(d, s, w);
+        __asm__ volatile("sfence" : : : "memory");
+    } else {
+        for (int i = 0; i < h; i++, d += dst->pitch, s += src->pitch) memcpy(d, s, bytes);
+    }
+}
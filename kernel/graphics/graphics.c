@@ -2,6 +2,13 @@
 #include "../include/ttf.h"
 #include "../hal/serial.h"
 #include "../include/font.h"
+#include "../include/trace.h"
+#include "../include/spinlock.h"
+#include "../include/pmm.h"
+#include "../include/blit.h"
+#ifndef RECOVERY_KERNEL
+#include "../include/jobs.h"
+#endif
 
 // External font declaration
 extern const uint16_t* font16x16[96];
@@ -10,73 +17,214 @@ uint16_t icon_search[] = { 0x0000, 0x07E0, 0x0810, 0x1008, 0x1008, 0x1008, 0x081
 uint16_t icon_folder[] = { 0x0000, 0x0000, 0x0380, 0x0440, 0x0440, 0x3FF8, 0x2004, 0x2004, 0x2004, 0x2004, 0x2004, 0x2004, 0x3FF8, 0x0000, 0x0000, 0x0000 };
 uint16_t icon_term[]   = { 0x0000, 0x7FFE, 0x4002, 0x4002, 0x4802, 0x5402, 0x5202, 0x4102, 0x4002, 0x4002, 0x4032, 0x4032, 0x7FFE, 0x0000, 0x0000, 0x0000 };
 
-/* Double Buffering Implementation */
+// What the primitives draw into: the backbuffer, or the framebuffer without one
+static blit_surface_t draw_surface(BootInfo *info) {
+    blit_surface_t surface = { info->backbuffer ? info->backbuffer : info->framebuffer,
+                               info->width, info->height, info->pitch, 0 };
+    return surface;
+}
+
+/* Rectangle fill, split by rows across CPUs when it is big enough to pay off */
+#define PARALLEL_FILL_PIXELS (256 * 1024)
+
+typedef struct {
+    const blit_surface_t *surface;
+    int x, y, w;
+    uint32_t color;
+} fill_job_t;
+
+static void fill_rows(void *arg, int start, int end) {
+    fill_job_t *job = arg;
+    blit_fill(job->surface, job->x, job->y + start, job->w, end - start, job->color);
+}
+
+static void fill_area(const blit_surface_t *surface, int x, int y, int w, int h, uint32_t color) {
+    fill_job_t job = { surface, x, y, w, color };
+#ifndef RECOVERY_KERNEL
+    if ((uint64_t)w * h >= PARALLEL_FILL_PIXELS) {
+        parallel_for(h, 0, fill_rows, &job);
+        return;
+    }
+#endif
+    fill_rows(&job, 0, h);
+}
+
+/*
+ * Double buffering
+ * Everything draws into a backbuffer in ordinary cached memory and records
+ * the rectangle it touched with mark_dirty_rect(). flip_buffers() copies only
+ * those rectangles to the framebuffer, which is mapped write-combining, with
+ * blit_copy() streaming stores so the copy neither reads video memory nor
+ * evicts the caller's working set. Overlapping and adjacent rectangles are merged as they
+ * are recorded, so a line of text becomes one copy rather than one per glyph.
+ * Only the display's own backbuffer is tracked; other BootInfo surfaces (the
+ * benchmarks', the hosted build's) draw straight into their framebuffer.
+ * With the compositor running, its window surfaces report damage through a
+ * hook and each dirty rectangle is rebuilt from the windows before the copy.
+ */
+#define DIRTY_MAX_RECTS     32
+#define DIRTY_MERGE_SLACK   1024    // Pixels a merge may add beyond the two areas
+
+typedef struct {
+    int x0, y0, x1, y1;             // [x0, x1) x [y0, y1)
+} dirty_rect_t;
+
+static uint32_t *display_backbuffer = NULL;
+static dirty_rect_t dirty_rects[DIRTY_MAX_RECTS];
+static int dirty_count = 0;
+static spinlock_t dirty_lock = SPINLOCK_INIT;
+
+static void (*damage_hook)(BootInfo *surface, int x, int y, int w, int h) = NULL;
+static void (*compose_hook)(BootInfo *display, int x0, int y0, int x1, int y1) = NULL;
+
+void set_compositor_hooks(void (*damage)(BootInfo *surface, int x, int y, int w, int h),
+                          void (*compose)(BootInfo *display, int x0, int y0, int x1, int y1)) {
+    damage_hook = damage;
+    compose_hook = compose;
+}
+
 void init_double_buffer(BootInfo *info) {
-    // For now, disable double buffering to avoid memory allocation issues
-    // during early boot phases and recovery kernel
-    info->backbuffer = info->framebuffer; // Direct rendering fallback
-
-    // TODO: Enable double buffering after memory manager is stable
-    /*
-    // Allocate backbuffer (same size as framebuffer)
-    size_t buffer_size = info->height * info->pitch * sizeof(uint32_t);
-    info->backbuffer = kmalloc(buffer_size);
-
-    if (!info->backbuffer) {
-        // Fallback to direct rendering if allocation fails
-        info->backbuffer = info->framebuffer;
+    info->backbuffer = info->framebuffer;   // Direct rendering fallback
+
+    size_t buffer_size = (size_t)info->height * info->pitch * sizeof(uint32_t);
+    uint32_t *back = pmm_alloc_pages(pmm_order_for_size(buffer_size));
+    if (!back) {
+        serial_write_string("[GFX] No memory for a backbuffer, drawing directly\n");
+        return;
+    }
+
+    blit_surface_t surface = { back, info->width, info->height, info->pitch, 0 };
+    fill_area(&surface, 0, 0, info->width, info->height, 0xFF000000);
+    display_backbuffer = back;
+    info->backbuffer = back;
+    mark_dirty_rect(info, 0, 0, info->width, info->height);
+}
+
+static uint64_t rect_area(const dirty_rect_t *r) {
+    return (uint64_t)(r->x1 - r->x0) * (uint64_t)(r->y1 - r->y0);
+}
+
+static dirty_rect_t rect_union(const dirty_rect_t *a, const dirty_rect_t *b) {
+    dirty_rect_t u;
+    u.x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+    u.y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+    u.x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+    u.y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+    return u;
+}
+
+void mark_dirty_rect(BootInfo *info, int x, int y, int w, int h) {
+    if (!display_backbuffer) return;
+    if (info->backbuffer != display_backbuffer) {
+        if (damage_hook) damage_hook(info, x, y, w, h);
         return;
     }
 
-    // Clear backbuffer
-    for (size_t i = 0; i < info->height * info->pitch; i++) {
-        info->backbuffer[i] = 0xFF000000; // Black background
+    dirty_rect_t r = { x, y, x + w, y + h };
+    if (r.x0 < 0) r.x0 = 0;
+    if (r.y0 < 0) r.y0 = 0;
+    if (r.x1 > (int)info->width) r.x1 = info->width;
+    if (r.y1 > (int)info->height) r.y1 = info->height;
+    if (r.x0 >= r.x1 || r.y0 >= r.y1) return;
+
+    uint64_t flags = spin_lock_irqsave(&dirty_lock);
+
+    // Absorb every rectangle that merges cheaply; the grown rectangle can
+    // then reach others, so rescan until nothing changes
+    for (int i = 0; i < dirty_count; ) {
+        dirty_rect_t u = rect_union(&r, &dirty_rects[i]);
+        if (rect_area(&u) <= rect_area(&r) + rect_area(&dirty_rects[i]) + DIRTY_MERGE_SLACK) {
+            r = u;
+            dirty_rects[i] = dirty_rects[--dirty_count];
+            i = 0;
+        } else {
+            i++;
+        }
     }
-    */
+
+    // Full: fold into whichever rectangle grows least
+    if (dirty_count == DIRTY_MAX_RECTS) {
+        int best = 0;
+        uint64_t best_growth = ~0ULL;
+        for (int i = 0; i < dirty_count; i++) {
+            dirty_rect_t u = rect_union(&r, &dirty_rects[i]);
+            uint64_t growth = rect_area(&u) - rect_area(&dirty_rects[i]);
+            if (growth < best_growth) {
+                best_growth = growth;
+                best = i;
+            }
+        }
+        dirty_rects[best] = rect_union(&r, &dirty_rects[best]);
+    } else {
+        dirty_rects[dirty_count++] = r;
+    }
+
+    spin_unlock_irqrestore(&dirty_lock, flags);
 }
 
 void flip_buffers(BootInfo *info) {
-    // Currently disabled - direct rendering only
-    // When double buffering is enabled, this will copy backbuffer to framebuffer
-    return;
+    TRACE_BEGIN("flip_buffers");
+    if (!display_backbuffer || info->backbuffer != display_backbuffer) {
+        TRACE_END("flip_buffers");
+        return;
+    }
+
+    // Take the list and copy outside the lock; rectangles marked meanwhile
+    // go out with the next flip
+    dirty_rect_t rects[DIRTY_MAX_RECTS];
+    uint64_t flags = spin_lock_irqsave(&dirty_lock);
+    int count = dirty_count;
+    for (int i = 0; i < count; i++) rects[i] = dirty_rects[i];
+    dirty_count = 0;
+    spin_unlock_irqrestore(&dirty_lock, flags);
+
+    blit_surface_t front = { info->framebuffer, info->width, info->height, info->pitch, BLIT_WC };
+    blit_surface_t back = { display_backbuffer, info->width, info->height, info->pitch, 0 };
+    uint64_t pixels = 0;
+    for (int i = 0; i < count; i++) {
+        int w = rects[i].x1 - rects[i].x0;
+        int h = rects[i].y1 - rects[i].y0;
+        if (compose_hook) compose_hook(info, rects[i].x0, rects[i].y0, rects[i].x1, rects[i].y1);
+        blit_copy(&front, rects[i].x0, rects[i].y0, &back, rects[i].x0, rects[i].y0, w, h);
+        pixels += (uint64_t)w * h;
+    }
+
+    TRACE_COUNTER("flip bytes", pixels * sizeof(uint32_t));
+    TRACE_END("flip_buffers");
 }
 
 void clear_backbuffer(BootInfo *info, uint32_t color) {
     if (!info->backbuffer) return;
 
-    for (size_t i = 0; i < info->height * info->pitch; i++) {
-        info->backbuffer[i] = color;
-    }
+    blit_surface_t surface = draw_surface(info);
+    fill_area(&surface, 0, 0, info->width, info->height, color);
+    mark_dirty_rect(info, 0, 0, info->width, info->height);
 }
 void fill_rect(BootInfo *info, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color) {
-    uint32_t *fb = info->backbuffer ? info->backbuffer : info->framebuffer;
-    for (uint32_t dy = 0; dy < h; dy++) {
-        if (y + dy >= info->height) break;
-        uint32_t *row = fb + (y + dy) * info->pitch;
-        for (uint32_t dx = 0; dx < w; dx++) {
-            if (x + dx >= info->width) break;
-            row[x + dx] = color;
-        }
-    }
+    if (x >= info->width || y >= info->height) return;
+    if (w > info->width - x) w = info->width - x;
+    if (h > info->height - y) h = info->height - y;
+    blit_surface_t surface = draw_surface(info);
+    fill_area(&surface, x, y, w, h, color);
+    mark_dirty_rect(info, x, y, w, h);
 }
 
 void draw_rect(BootInfo *info, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color) {
     // Alias for fill_rect - draws a filled rectangle
     fill_rect(info, x, y, w, h, color);
 }
+// One span per row: the half-width shrinks as |y| grows, so it is walked down
+// from the radius instead of testing every pixel of the bounding square
 void fill_circle(BootInfo *info, int cx, int cy, int radius, uint32_t color) {
-    uint32_t *fb = info->backbuffer ? info->backbuffer : info->framebuffer;
-    for (int y = -radius; y <= radius; y++) {
-        for (int x = -radius; x <= radius; x++) {
-            if (x*x + y*y <= radius*radius) {
-                int px = cx + x;
-                int py = cy + y;
-                if (px >= 0 && px < (int)info->width && py >= 0 && py < (int)info->height) {
-                    fb[py * info->pitch + px] = color;
-                }
-            }
-        }
+    if (radius < 0) return;
+    blit_surface_t surface = draw_surface(info);
+    int half = radius;
+    for (int y = 0; y <= radius; y++) {
+        while (half > 0 && half * half + y * y > radius * radius) half--;
+        blit_fill(&surface, cx - half, cy + y, 2 * half + 1, 1, color);
+        if (y > 0) blit_fill(&surface, cx - half, cy - y, 2 * half + 1, 1, color);
     }
+    mark_dirty_rect(info, cx - radius, cy - radius, 2 * radius + 1, 2 * radius + 1);
 }
 void draw_bitmap(BootInfo *info, uint16_t *bitmap, int x, int y, int scale, uint32_t color) {
     for (int row = 0; row < 16; row++) {
@@ -99,79 +247,214 @@ void draw_char(BootInfo *info, char c, int x, int y, uint32_t color) {
 
 void draw_char_terminal(BootInfo *info, char c, int x, int y, uint32_t color) {
     if (c < 32 || c > 126) return;
-    uint32_t *fb = info->backbuffer ? info->backbuffer : info->framebuffer;
+    blit_surface_t surface = draw_surface(info);
     const uint16_t *glyph = font16x16[c - 32];
 
+    // Clip once: rows off the surface are skipped, columns masked out of the
+    // glyph bits (column 0 is bit 15)
+    int row0 = y < 0 ? -y : 0;
+    int row1 = (int)surface.height - y < 16 ? (int)surface.height - y : 16;
+    int keep_left = x < 0 ? -x : 0;
+    int keep_right = (int)surface.width - x;
+    uint16_t mask = 0xFFFF;
+    if (keep_left >= 16 || keep_right <= 0) return;
+    if (keep_left > 0) mask >>= keep_left;
+    if (keep_right < 16) mask &= (uint16_t)(0xFFFF << (16 - keep_right));
+
     // Compact 1x scale rendering with better contrast for terminal
-    for (int row = 0; row < 16; row++) {
-        uint16_t row_data = glyph[row];
-        for (int col = 0; col < 16; col++) {
-            if ((row_data >> (15 - col)) & 1) {
-                int px = x + col;
-                int py = y + row;
-                if (px >= 0 && px < (int)info->width && py >= 0 && py < (int)info->height) {
-                    uint32_t index = py * info->pitch + px;
-                    if (index < info->width * info->height) {
-                        fb[index] = color; // Full color for character pixels
+    for (int row = row0; row < row1; row++) {
+        uint32_t *line = surface.pixels + (size_t)(y + row) * surface.pitch;
+        uint32_t bits = glyph[row] & mask;
+        while (bits) {
+            int col = __builtin_clz(bits << 16);
+            line[x + col] = color;      // Full color for character pixels
+            bits &= ~(0x8000u >> col);
+        }
+    }
+    mark_dirty_rect(info, x, y, 16, 16);
+}
+
+/*
+ * Glyph atlas for draw_char_scaled()
+ * A glyph at a given scale is drawn as a list of rectangles in glyph
+ * pixels: solid runs of set bits, merged down the rows they repeat on, and
+ * the edge-softening border of every unset block next to a set one. The
+ * list depends only on the glyph and the scale, so it is built the first
+ * time the pair is drawn and kept; drawing is then one clipped blit_fill()
+ * per solid rectangle and a blend over each edge rectangle. Scales above
+ * GLYPH_ATLAS_MAX_SCALE are rare and walk the same generator uncached.
+ */
+#define GLYPH_ATLAS_MAX_SCALE   8
+#define GLYPH_COUNT             95      // ' ' to '~'
+
+typedef struct {
+    int16_t x, y, w, h;
+    uint8_t blend;                      // 1/8 toward the color instead of solid
+} glyph_rect_t;
+
+typedef struct {
+    int count;
+    glyph_rect_t rects[];
+} glyph_entry_t;
+
+static glyph_entry_t *glyph_atlas[GLYPH_ATLAS_MAX_SCALE][GLYPH_COUNT];
+
+typedef void (*glyph_emit_t)(void *ctx, int x, int y, int w, int h, int blend);
+
+static int glyph_bit(const uint16_t *glyph, int row, int col) {
+    if (row < 0 || row >= 16 || col < 0 || col >= 16) return 0;
+    return (glyph[row] >> (15 - col)) & 1;
+}
+
+// Unset, with a set neighbour: its border is softened at scales above 1
+static int glyph_edge(const uint16_t *glyph, int row, int col) {
+    return !glyph_bit(glyph, row, col) &&
+           (glyph_bit(glyph, row, col - 1) || glyph_bit(glyph, row, col + 1) ||
+            glyph_bit(glyph, row - 1, col) || glyph_bit(glyph, row + 1, col));
+}
+
+// The same run of blocks [c0, c1), with nothing either side, on this row
+static int glyph_run_on_row(const uint16_t *glyph, int row, int c0, int c1, int edge) {
+    if (row < 0 || row >= 16) return 0;
+    for (int col = c0 - 1; col <= c1; col++) {
+        int in = col >= c0 && col < c1;
+        int hit = edge ? glyph_edge(glyph, row, col) : glyph_bit(glyph, row, col);
+        if (hit != in) return 0;
+    }
+    return 1;
+}
+
+static void glyph_generate(const uint16_t *glyph, int scale, glyph_emit_t emit, void *ctx) {
+    for (int edge = 0; edge <= (scale > 1); edge++) {
+        for (int row = 0; row < 16; row++) {
+            for (int c0 = 0; c0 < 16; ) {
+                if (!(edge ? glyph_edge(glyph, row, c0) : glyph_bit(glyph, row, c0))) {
+                    c0++;
+                    continue;
+                }
+                int c1 = c0;
+                while (c1 < 16 && (edge ? glyph_edge(glyph, row, c1) : glyph_bit(glyph, row, c1))) c1++;
+
+                int x = c0 * scale, y = row * scale, w = (c1 - c0) * scale;
+                if (!edge || scale == 2) {
+                    // Whole blocks (every pixel of a 2x2 block is border):
+                    // one rectangle down all the rows the run repeats on
+                    if (!glyph_run_on_row(glyph, row - 1, c0, c1, edge)) {
+                        int rows = 1;
+                        while (glyph_run_on_row(glyph, row + rows, c0, c1, edge)) rows++;
+                        emit(ctx, x, y, w, rows * scale, edge);
                     }
+                } else {
+                    // Block borders: top and bottom lines across the run,
+                    // then the columns between blocks, two pixels wide
+                    // where neighbours meet
+                    emit(ctx, x, y, w, 1, 1);
+                    emit(ctx, x, y + scale - 1, w, 1, 1);
+                    emit(ctx, x, y + 1, 1, scale - 2, 1);
+                    for (int col = c0 + 1; col < c1; col++) {
+                        emit(ctx, col * scale - 1, y + 1, 2, scale - 2, 1);
+                    }
+                    emit(ctx, c1 * scale - 1, y + 1, 1, scale - 2, 1);
                 }
+                c0 = c1;
             }
         }
     }
 }
 
-void draw_char_scaled(BootInfo *info, char c, int x, int y, uint32_t color, int scale) {
-    if (c < 32 || c > 126) return;
-    uint32_t *fb = info->backbuffer ? info->backbuffer : info->framebuffer;
+static void glyph_count_rect(void *ctx, int x, int y, int w, int h, int blend) {
+    (void)x; (void)y; (void)w; (void)h; (void)blend;
+    (*(int *)ctx)++;
+}
+
+static void glyph_store_rect(void *ctx, int x, int y, int w, int h, int blend) {
+    glyph_entry_t *entry = ctx;
+    glyph_rect_t *r = &entry->rects[entry->count++];
+    r->x = x;
+    r->y = y;
+    r->w = w;
+    r->h = h;
+    r->blend = blend;
+}
+
+// The cached list for (c, scale), built on first use; NULL when uncached
+static const glyph_entry_t *glyph_lookup(char c, int scale) {
+    if (scale > GLYPH_ATLAS_MAX_SCALE) return NULL;
+
+    glyph_entry_t **slot = &glyph_atlas[scale - 1][c - 32];
+    glyph_entry_t *entry = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (entry) return entry;
+
     const uint16_t *glyph = font16x16[c - 32];
+    int count = 0;
+    glyph_generate(glyph, scale, glyph_count_rect, &count);
+    entry = kmalloc(sizeof(glyph_entry_t) + count * sizeof(glyph_rect_t));
+    if (!entry) return NULL;
+    entry->count = 0;
+    glyph_generate(glyph, scale, glyph_store_rect, entry);
 
-    // Enhanced bitmap font rendering with subtle anti-aliasing
-    for (int row = 0; row < 16; row++) {
-        uint16_t row_data = glyph[row];
-        for (int col = 0; col < 16; col++) {
-            int bit = (row_data >> (15 - col)) & 1;
-            int px = x + col * scale;
-            int py = y + row * scale;
-
-            // Fill a scale x scale block for each pixel with improved rendering
-            for (int sy = 0; sy < scale; sy++) {
-                for (int sx = 0; sx < scale; sx++) {
-                    int px_scaled = px + sx;
-                    int py_scaled = py + sy;
-
-                    if (px_scaled >= 0 && px_scaled < (int)info->width &&
-                        py_scaled >= 0 && py_scaled < (int)info->height) {
-
-                        uint32_t index = py_scaled * info->pitch + px_scaled;
-                        if (index >= info->width * info->height) continue;
-
-                        if (bit) {
-                            // Solid color for main pixels
-                            fb[index] = color;
-                        } else if (scale > 1) {
-                            // Subtle edge softening for scaled fonts
-                            // Check if adjacent pixels are set for anti-aliasing
-                            int has_adjacent = 0;
-                            if (col > 0 && ((glyph[row] >> (15 - (col-1))) & 1)) has_adjacent = 1;
-                            if (col < 15 && ((glyph[row] >> (15 - (col+1))) & 1)) has_adjacent = 1;
-                            if (row > 0 && ((glyph[row-1] >> (15 - col)) & 1)) has_adjacent = 1;
-                            if (row < 15 && ((glyph[row+1] >> (15 - col)) & 1)) has_adjacent = 1;
-
-                            if (has_adjacent && (sx == 0 || sx == scale-1 || sy == 0 || sy == scale-1)) {
-                                // Edge pixel near a set pixel - blend for anti-aliasing
-                                uint32_t existing = fb[index];
-                                uint8_t r = ((existing >> 16) & 0xFF) * 7 / 8 + ((color >> 16) & 0xFF) / 8;
-                                uint8_t g = ((existing >> 8) & 0xFF) * 7 / 8 + ((color >> 8) & 0xFF) / 8;
-                                uint8_t b = (existing & 0xFF) * 7 / 8 + (color & 0xFF) / 8;
-                                fb[index] = (r << 16) | (g << 8) | b;
-                            }
-                        }
-                    }
-                }
-            }
+    // Two CPUs may build the same entry; the first one published is kept
+    glyph_entry_t *expected = NULL;
+    if (!__atomic_compare_exchange_n(slot, &expected, entry, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        kfree(entry);
+        return expected;
+    }
+    return entry;
+}
+
+typedef struct {
+    const blit_surface_t *surface;
+    int x, y;
+    uint32_t color;
+} glyph_draw_t;
+
+static void glyph_draw_rect(void *ctx, int x, int y, int w, int h, int blend) {
+    glyph_draw_t *d = ctx;
+    const blit_surface_t *surface = d->surface;
+    x += d->x;
+    y += d->y;
+    if (!blend) {
+        blit_fill(surface, x, y, w, h, d->color);
+        return;
+    }
+
+    // Edge softening: 1/8 toward the color
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + w < (int)surface->width ? x + w : (int)surface->width;
+    int y1 = y + h < (int)surface->height ? y + h : (int)surface->height;
+    uint32_t cr = ((d->color >> 16) & 0xFF) / 8;
+    uint32_t cg = ((d->color >> 8) & 0xFF) / 8;
+    uint32_t cb = (d->color & 0xFF) / 8;
+    for (int py = y0; py < y1; py++) {
+        uint32_t *line = surface->pixels + (size_t)py * surface->pitch;
+        for (int px = x0; px < x1; px++) {
+            uint32_t existing = line[px];
+            uint32_t r = ((existing >> 16) & 0xFF) * 7 / 8 + cr;
+            uint32_t g = ((existing >> 8) & 0xFF) * 7 / 8 + cg;
+            uint32_t b = (existing & 0xFF) * 7 / 8 + cb;
+            line[px] = (r << 16) | (g << 8) | b;
+        }
+    }
+}
+
+void draw_char_scaled(BootInfo *info, char c, int x, int y, uint32_t color, int scale) {
+    if (c < 32 || c > 126 || scale < 1) return;
+    blit_surface_t surface = draw_surface(info);
+    glyph_draw_t draw = { &surface, x, y, color };
+
+    const glyph_entry_t *entry = glyph_lookup(c, scale);
+    if (entry) {
+        for (int i = 0; i < entry->count; i++) {
+            const glyph_rect_t *r = &entry->rects[i];
+            glyph_draw_rect(&draw, r->x, r->y, r->w, r->h, r->blend);
         }
+    } else {
+        glyph_generate(font16x16[c - 32], scale, glyph_draw_rect, &draw);
     }
+    mark_dirty_rect(info, x, y, 16 * scale, 16 * scale);
 }
+
 void kprint(BootInfo *info, const char *str, int x, int y, uint32_t color) {
     // Also output to serial console
     serial_write_string(str);
@@ -200,8 +483,7 @@ void kprint(BootInfo *info, const char *str, int x, int y, uint32_t color) {
 
 #ifndef RECOVERY_KERNEL
 void kprint_ttf(BootInfo *info, const char *str, int x, int y, uint32_t color, void *ttf_font_ptr) {
-    ttf_font_t *font = (ttf_font_t*)ttf_font_ptr;
-    if (!font) {
+    if (!ttf_font_ptr) {
         // Fall back to regular kprint
         kprint(info, str, x, y, color);
         return;
@@ -209,6 +491,12 @@ void kprint_ttf(BootInfo *info, const char *str, int x, int y, uint32_t color, v
 
     // Also output to serial console
     serial_write_string(str);
+    draw_string_ttf(info, str, x, y, color, ttf_font_ptr);
+}
+
+void draw_string_ttf(BootInfo *info, const char *str, int x, int y, uint32_t color, void *ttf_font_ptr) {
+    ttf_font_t *font = (ttf_font_t*)ttf_font_ptr;
+    if (!font) return;
 
     // Draw the text using TTF font
     int current_x = x;
@@ -227,23 +515,34 @@ void kprint_ttf(BootInfo *info, const char *str, int x, int y, uint32_t color, v
         } else if (*c >= 32 && *c <= 126) {
             // Render printable ASCII characters
             int glyph_index = ttf_get_glyph_index(font, (uint32_t)*c);
-            uint8_t glyph_bitmap[64]; // 8x8 bitmap
-
-            if (ttf_render_glyph(font, glyph_index, glyph_bitmap, 8, 8, 0, 0, 1) == 0) {
-                // Render the glyph bitmap to screen
-                for (int gy = 0; gy < 8; gy++) {
-                    for (int gx = 0; gx < 8; gx++) {
-                        if (glyph_bitmap[gy * 8 + gx] > 128) {  // Threshold for visibility
-                            int screen_x = current_x + gx;
-                            int screen_y = y + gy;
-                            if (screen_x >= 0 && screen_x < info->width &&
-                                screen_y >= 0 && screen_y < info->height) {
-                                uint32_t *fb = info->backbuffer ? info->backbuffer : info->framebuffer;
-                                fb[screen_y * info->pitch + screen_x] = color;
+            const ttf_glyph_bitmap_t *glyph = ttf_get_glyph(font, glyph_index, char_width, char_height, 0);
+
+            if (glyph) {
+                // Render the glyph bitmap to screen, blending by coverage
+                for (int gy = 0; gy < glyph->height; gy++) {
+                    for (int gx = 0; gx < glyph->width; gx++) {
+                        uint32_t a = glyph->pixels[gy * glyph->width + gx];
+                        if (!a) continue;
+                        int screen_x = current_x + gx;
+                        int screen_y = y + gy;
+                        if (screen_x >= 0 && screen_x < info->width &&
+                            screen_y >= 0 && screen_y < info->height) {
+                            uint32_t *fb = info->backbuffer ? info->backbuffer : info->framebuffer;
+                            uint32_t *pixel = &fb[screen_y * info->pitch + screen_x];
+                            if (a == 255) {
+                                *pixel = color;
+                                continue;
                             }
+                            uint32_t existing = *pixel;
+                            uint32_t r = (((color >> 16) & 0xFF) * a + ((existing >> 16) & 0xFF) * (255 - a)) / 255;
+                            uint32_t g = (((color >> 8) & 0xFF) * a + ((existing >> 8) & 0xFF) * (255 - a)) / 255;
+                            uint32_t b = ((color & 0xFF) * a + (existing & 0xFF) * (255 - a)) / 255;
+                            *pixel = 0xFF000000 | (r << 16) | (g << 8) | b;
                         }
                     }
                 }
+                mark_dirty_rect(info, current_x, y, glyph->width, glyph->height);
+                ttf_release_glyph(glyph);
             }
             current_x += char_width;
         }
@@ -3,6 +3,9 @@
 #include "../include/string.h"
 #include "../include/ttf.h"
 #include "../hal/serial.h"
+#include "../include/spinlock.h"
+#include "../include/metrics.h"
+#include "../include/sched.h"
 
 // Helper functions for big-endian reading
 static uint16_t read_uint16_be(const uint8_t *data) {
@@ -247,9 +250,13 @@ int ttf_parse_font(ttf_font_t *font) {
                         data_offset += 2;
                     }
 
-                    uint16_t glyph_array_size = (length - data_offset) / 2;
-                    font->cmap_format4->glyph_id_array = kmalloc(glyph_array_size * sizeof(uint16_t));
-                    if (!font->cmap_format4->glyph_id_array) goto error;
+                    // Fonts that map every segment by delta have no glyph array
+                    uint16_t glyph_array_size = length > data_offset ? (length - data_offset) / 2 : 0;
+                    font->cmap_format4->glyph_id_array = NULL;
+                    if (glyph_array_size) {
+                        font->cmap_format4->glyph_id_array = kmalloc(glyph_array_size * sizeof(uint16_t));
+                        if (!font->cmap_format4->glyph_id_array) goto error;
+                    }
                     for (uint16_t j = 0; j < glyph_array_size; j++) {
                         font->cmap_format4->glyph_id_array[j] = read_uint16_be(subtable + data_offset);
                         data_offset += 2;
@@ -350,8 +357,8 @@ int ttf_parse_font(ttf_font_t *font) {
     serial_write_string(upem_str);
     serial_write_string("\n");
 
-    // Initialize glyph cache
-    memset(font->glyph_cache, 0, sizeof(font->glyph_cache));
+    // A font reloaded at the same address must not hit the old one's glyphs
+    ttf_cache_flush(font);
 
     return 0;
 
@@ -423,6 +430,7 @@ void ttf_free_font(ttf_font_t *font) {
     if (font->head_table) kfree(font->head_table);
     if (font->table_directory) kfree(font->table_directory);
     if (font->font_data) kfree(font->font_data);
+    ttf_cache_flush(font);
 
     memset(font, 0, sizeof(ttf_font_t));
 }
@@ -589,8 +597,9 @@ static int ttf_parse_glyph_outline(ttf_font_t *font, uint16_t glyph_index, ttf_g
         }
     }
 
-    // Read y coordinates
+    // Read y coordinates, walking the flags again from the start
     point_index = 0;
+    flags_offset = 10 + num_contours * 2 + 2 + num_instructions;
     int32_t y = 0;
     while (point_index < outline->num_points) {
         uint8_t flag = glyf_data[flags_offset++];
@@ -632,118 +641,293 @@ static void ttf_free_outline(ttf_glyph_outline_t *outline) {
     outline->num_contours = 0;
 }
 
-// Scanline rasterizer - convert outline to bitmap
-static void ttf_rasterize_outline(ttf_glyph_outline_t *outline, uint8_t *bitmap, int width, int height, int32_t x_offset, int32_t y_offset, float scale) {
-    if (!outline || !bitmap || outline->num_points == 0 || outline->num_contours == 0) {
-        return;
+/*
+ * Scanline rasterizer
+ * Points are mapped to 16.16 fixed-point pixels (y down) and each contour
+ * is walked once: on-curve points join with lines, off-curve points are
+ * quadratic controls (two in a row imply an on-curve midpoint), and curves
+ * are flattened into lines by forward evaluation, with a step count that
+ * keeps the chord within 1/8 pixel. Every non-horizontal line becomes an
+ * edge in a table bucketed by its first sub-scanline. The sweep runs
+ * TTF_SUBSAMPLES sub-scanlines per pixel row: edges enter the active list
+ * from their bucket and leave at their last sub-scanline, the active list
+ * is kept sorted by x, and the spans between crossings with a nonzero
+ * winding sum add their exact horizontal coverage to the row. Each row of
+ * the bitmap is the sum over its sub-scanlines.
+ *
+ * Edges, buckets, the active list and the row accumulator live in one
+ * scratch arena that grows to the largest glyph seen and is then reused,
+ * under ttf_scratch_lock. A big glyph takes a while, so the lock only
+ * disables preemption and interrupts keep being serviced; nothing draws
+ * text from an IRQ handler.
+ */
+#define TTF_FIX_SHIFT       16
+#define TTF_FIX_ONE         (1 << TTF_FIX_SHIFT)
+#define TTF_SUBSAMPLES      16          // Sub-scanlines per pixel row
+#define TTF_MAX_CURVE_STEPS 16          // Lines per quadratic, at most
+
+typedef struct {
+    int32_t x;                          // At the current sub-scanline, 16.16
+    int32_t dxdy;                       // Per sub-scanline, 16.16
+    int32_t y_end;                      // First sub-scanline past the edge
+    int32_t next;                       // Next edge in the same bucket, -1 ends
+    int32_t dir;                        // +1 downward, -1 upward
+} ttf_edge_t;
+
+typedef struct {
+    ttf_edge_t *edges;
+    int num_edges, max_edges;
+    int32_t *buckets;                   // First edge per sub-scanline
+    int rows;                           // Sub-scanlines
+} ttf_edge_table_t;
+
+static struct {
+    uint8_t *base;
+    size_t size;
+} ttf_scratch;
+static spinlock_t ttf_scratch_lock = SPINLOCK_INIT;
+
+// Carve the arena; grows (and drops the old contents) when too small
+static void *ttf_scratch_reserve(size_t size) {
+    if (size > ttf_scratch.size) {
+        size_t grown = ttf_scratch.size ? ttf_scratch.size : 4096;
+        while (grown < size) grown *= 2;
+        uint8_t *base = kmalloc(grown);
+        if (!base) return NULL;
+        if (ttf_scratch.base) kfree(ttf_scratch.base);
+        ttf_scratch.base = base;
+        ttf_scratch.size = grown;
     }
+    return ttf_scratch.base;
+}
 
-    // Clear bitmap
-    memset(bitmap, 0, width * height);
+static void ttf_add_line(ttf_edge_table_t *table, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+    int32_t dir = 1;
+    if (y0 > y1) {
+        int32_t t;
+        t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+        dir = -1;
+    }
 
-    // Scale and translate points
-    ttf_point_t *scaled_points = kmalloc(outline->num_points * sizeof(ttf_point_t));
-    if (!scaled_points) return;
+    // Sub-scanline s samples y = (s + 1/2) / TTF_SUBSAMPLES; the edge covers
+    // the samples in [y0, y1)
+    int64_t sub_half = TTF_FIX_ONE / 2;
+    int32_t s0 = (int32_t)(((int64_t)y0 * TTF_SUBSAMPLES - sub_half + TTF_FIX_ONE - 1) >> TTF_FIX_SHIFT);
+    int32_t s1 = (int32_t)(((int64_t)y1 * TTF_SUBSAMPLES - sub_half + TTF_FIX_ONE - 1) >> TTF_FIX_SHIFT);
+    if (s0 < 0) s0 = 0;
+    if (s1 > table->rows) s1 = table->rows;
+    if (s0 >= s1 || table->num_edges >= table->max_edges) return;
+
+    // dx per sub-scanline, and x at the centre of sub-scanline s0
+    int64_t dxdy = (int64_t)(x1 - x0) * TTF_FIX_ONE / ((int64_t)(y1 - y0) * TTF_SUBSAMPLES);
+    int64_t y_first = (((int64_t)s0 << TTF_FIX_SHIFT) + sub_half) / TTF_SUBSAMPLES;
+
+    ttf_edge_t *e = &table->edges[table->num_edges];
+    e->x = x0 + (int32_t)(((y_first - y0) * (x1 - x0)) / (y1 - y0));
+    e->dxdy = (int32_t)dxdy;
+    e->y_end = s1;
+    e->dir = dir;
+    e->next = table->buckets[s0];
+    table->buckets[s0] = table->num_edges++;
+}
 
-    for (int i = 0; i < outline->num_points; i++) {
-        scaled_points[i].x = (int32_t)(outline->points[i].x * scale) + x_offset;
-        scaled_points[i].y = (int32_t)(outline->points[i].y * scale) + y_offset;
-        scaled_points[i].on_curve = outline->points[i].on_curve;
+static void ttf_add_curve(ttf_edge_table_t *table, int32_t x0, int32_t y0, int32_t cx, int32_t cy,
+                          int32_t x1, int32_t y1) {
+    // The curve strays at most |p0 - 2c + p1| / 4 from its chord, and n lines
+    // divide that by n^2
+    int32_t ddx = x0 - 2 * cx + x1;
+    int32_t ddy = y0 - 2 * cy + y1;
+    int64_t dev = (ddx < 0 ? -(int64_t)ddx : ddx) + (ddy < 0 ? -(int64_t)ddy : ddy);
+    int n = 1;
+    while (n < TTF_MAX_CURVE_STEPS && (int64_t)n * n * TTF_FIX_ONE < dev * 2) n++;
+
+    int32_t px = x0, py = y0;
+    for (int i = 1; i <= n; i++) {
+        int64_t a = (int64_t)(n - i) * (n - i), b = 2 * (int64_t)i * (n - i), c = (int64_t)i * i;
+        int64_t nn = (int64_t)n * n;
+        int32_t qx = (int32_t)((a * x0 + b * cx + c * x1) / nn);
+        int32_t qy = (int32_t)((a * y0 + b * cy + c * y1) / nn);
+        ttf_add_line(table, px, py, qx, qy);
+        px = qx;
+        py = qy;
     }
+}
 
-    // Process each contour
-    int point_start = 0;
+static void ttf_build_edges(ttf_glyph_outline_t *outline, ttf_edge_table_t *table,
+                            int32_t scale, int32_t x_offset, int32_t y_offset, int height) {
+    int start = 0;
     for (int c = 0; c < outline->num_contours; c++) {
-        int point_end = outline->contours[c];
-        int num_points = point_end - point_start + 1;
-
-        // Draw edges between consecutive points
-        for (int i = 0; i < num_points; i++) {
-            int p1_idx = point_start + i;
-            int p2_idx = point_start + ((i + 1) % num_points);
-
-            ttf_point_t p1 = scaled_points[p1_idx];
-            ttf_point_t p2 = scaled_points[p2_idx];
-
-            // Bresenham line algorithm
-            int dx = abs(p2.x - p1.x);
-            int dy = abs(p2.y - p1.y);
-            int sx = (p1.x < p2.x) ? 1 : -1;
-            int sy = (p1.y < p2.y) ? 1 : -1;
-            int err = dx - dy;
-
-            int x = p1.x;
-            int y = p1.y;
-
-            while (1) {
-                if (x >= 0 && x < width && y >= 0 && y < height) {
-                    bitmap[y * width + x] = 255;
-                }
+        int end = outline->contours[c];
+        int count = end - start + 1;
+        if (count < 2 || end >= outline->num_points) {
+            start = end + 1;
+            continue;
+        }
 
-                if (x == p2.x && y == p2.y) break;
+        // Font units to 16.16 pixels, flipping y so row 0 is the top
+        #define TTF_PX(i) (int32_t)((int64_t)outline->points[start + (i)].x * scale + x_offset)
+        #define TTF_PY(i) (int32_t)(((int64_t)height << TTF_FIX_SHIFT) - \
+                                    ((int64_t)outline->points[start + (i)].y * scale + y_offset))
+        #define TTF_ON(i) outline->points[start + (i)].on_curve
+
+        // Start from an on-curve point, or the midpoint of two controls
+        int first = 0;
+        while (first < count && !TTF_ON(first)) first++;
+        int32_t sx, sy;
+        if (first < count) {
+            sx = TTF_PX(first);
+            sy = TTF_PY(first);
+        } else {
+            first = 0;
+            sx = (TTF_PX(0) + TTF_PX(1)) / 2;
+            sy = (TTF_PY(0) + TTF_PY(1)) / 2;
+        }
 
-                int e2 = 2 * err;
-                if (e2 > -dy) { err -= dy; x += sx; }
-                if (e2 < dx) { err += dx; y += sy; }
+        int32_t px = sx, py = sy;           // Last on-curve point
+        int have_control = 0;
+        int32_t cx = 0, cy = 0;
+        for (int k = 1; k <= count; k++) {
+            int i = (first + k) % count;
+            int32_t x = TTF_PX(i), y = TTF_PY(i);
+            if (TTF_ON(i)) {
+                if (have_control) ttf_add_curve(table, px, py, cx, cy, x, y);
+                else ttf_add_line(table, px, py, x, y);
+                px = x;
+                py = y;
+                have_control = 0;
+            } else if (have_control) {
+                int32_t mx = (cx + x) / 2, my = (cy + y) / 2;
+                ttf_add_curve(table, px, py, cx, cy, mx, my);
+                px = mx;
+                py = my;
+                cx = x;
+                cy = y;
+            } else {
+                cx = x;
+                cy = y;
+                have_control = 1;
             }
         }
+        // A contour of controls only closes through its starting midpoint
+        if (have_control) ttf_add_curve(table, px, py, cx, cy, sx, sy);
 
-        point_start = point_end + 1;
+        #undef TTF_PX
+        #undef TTF_PY
+        #undef TTF_ON
+        start = end + 1;
     }
+}
 
-    kfree(scaled_points);
+// Add the coverage of [x0, x1) on one sub-scanline to the row
+static void ttf_accumulate_span(uint32_t *accum, int width, int32_t x0, int32_t x1) {
+    const int32_t limit = width << TTF_FIX_SHIFT;
+    if (x0 < 0) x0 = 0;
+    if (x1 > limit) x1 = limit;
+    if (x0 >= x1) return;
+
+    // A fully covered pixel gets TTF_FIX_ONE per sub-scanline
+    int p0 = x0 >> TTF_FIX_SHIFT;
+    int p1 = x1 >> TTF_FIX_SHIFT;
+    if (p0 == p1) {
+        accum[p0] += x1 - x0;
+        return;
+    }
+    accum[p0] += ((p0 + 1) << TTF_FIX_SHIFT) - x0;
+    for (int p = p0 + 1; p < p1; p++) accum[p] += TTF_FIX_ONE;
+    if (p1 < width) accum[p1] += x1 - (p1 << TTF_FIX_SHIFT);
 }
 
-// Simple fill algorithm for glyph bitmap
-static void ttf_fill_glyph(uint8_t *bitmap, int width, int height) {
-    // Scanline fill - for each row, fill between leftmost and rightmost set pixels
-    for (int y = 0; y < height; y++) {
-        int left = -1;
-        int right = -1;
+static void ttf_rasterize_outline(ttf_glyph_outline_t *outline, uint8_t *bitmap, int width, int height,
+                                  int32_t x_offset, int32_t y_offset, int32_t scale) {
+    memset(bitmap, 0, width * height);
+    if (!outline || outline->num_points == 0 || outline->num_contours == 0) {
+        return;
+    }
 
-        // Find leftmost and rightmost pixels
-        for (int x = 0; x < width; x++) {
-            if (bitmap[y * width + x]) {
-                if (left == -1) left = x;
-                right = x;
-            }
+    // Each point starts at most one line or one flattened curve
+    ttf_edge_table_t table;
+    table.rows = height * TTF_SUBSAMPLES;
+    table.max_edges = outline->num_points * TTF_MAX_CURVE_STEPS + outline->num_contours;
+    table.num_edges = 0;
+
+    size_t edges_size = table.max_edges * sizeof(ttf_edge_t);
+    size_t buckets_size = table.rows * sizeof(int32_t);
+    size_t active_size = table.max_edges * sizeof(int32_t);
+    size_t accum_size = width * sizeof(uint32_t);
+
+    sched_preempt_disable();
+    spin_lock(&ttf_scratch_lock);
+    uint8_t *arena = ttf_scratch_reserve(edges_size + buckets_size + active_size + accum_size);
+    if (!arena) {
+        spin_unlock(&ttf_scratch_lock);
+        sched_preempt_enable();
+        return;
+    }
+    table.edges = (ttf_edge_t *)arena;
+    table.buckets = (int32_t *)(arena + edges_size);
+    int32_t *active = (int32_t *)(arena + edges_size + buckets_size);
+    uint32_t *accum = (uint32_t *)(arena + edges_size + buckets_size + active_size);
+    for (int s = 0; s < table.rows; s++) table.buckets[s] = -1;
+    memset(accum, 0, accum_size);
+
+    ttf_build_edges(outline, &table, scale, x_offset, y_offset, height);
+
+    int num_active = 0;
+    for (int s = 0; s < table.rows; s++) {
+        // Retire finished edges, step the rest
+        int kept = 0;
+        for (int i = 0; i < num_active; i++) {
+            ttf_edge_t *e = &table.edges[active[i]];
+            if (e->y_end <= s) continue;
+            e->x += e->dxdy;
+            active[kept++] = active[i];
         }
+        num_active = kept;
 
-        // Fill between them
-        if (left != -1 && right != -1) {
-            for (int x = left; x <= right; x++) {
-                bitmap[y * width + x] = 255;
-            }
+        // Enter new edges; x is already at this sub-scanline
+        for (int i = table.buckets[s]; i >= 0; i = table.edges[i].next) {
+            active[num_active++] = i;
         }
-    }
-}
 
-// Simple hash function for glyph cache
-static uint32_t glyph_hash(uint16_t glyph_index) {
-    return glyph_index % GLYPH_CACHE_SIZE;
-}
+        // Insertion sort by x: the order barely changes between sub-scanlines
+        for (int i = 1; i < num_active; i++) {
+            int32_t idx = active[i];
+            int32_t x = table.edges[idx].x;
+            int j = i - 1;
+            while (j >= 0 && table.edges[active[j]].x > x) {
+                active[j + 1] = active[j];
+                j--;
+            }
+            active[j + 1] = idx;
+        }
 
-int ttf_render_glyph(ttf_font_t *font, uint16_t glyph_index, uint8_t *bitmap, int width, int height, int x, int y, int pixel_size) {
-    if (!font || !bitmap || width <= 0 || height <= 0) {
-        return -1;
-    }
+        // Nonzero winding: fill wherever the running sum is not zero
+        int winding = 0;
+        for (int i = 0; i < num_active; i++) {
+            ttf_edge_t *e = &table.edges[active[i]];
+            if (winding != 0) ttf_accumulate_span(accum, width, table.edges[active[i - 1]].x, e->x);
+            winding += e->dir;
+        }
 
-    // Validate glyph index
-    if (glyph_index >= font->num_glyphs) {
-        glyph_index = 0; // Use missing glyph
+        // Last sub-scanline of a pixel row: resolve and clear the row
+        if ((s + 1) % TTF_SUBSAMPLES == 0) {
+            uint8_t *row = bitmap + (s / TTF_SUBSAMPLES) * width;
+            for (int x = 0; x < width; x++) {
+                uint32_t coverage = (accum[x] / TTF_SUBSAMPLES) >> (TTF_FIX_SHIFT - 8);
+                row[x] = coverage > 255 ? 255 : coverage;
+                accum[x] = 0;
+            }
+        }
     }
 
-    // Check cache first
-    uint32_t cache_index = glyph_hash(glyph_index);
-    if (font->glyph_cache[cache_index].valid &&
-        font->glyph_cache[cache_index].glyph_index == glyph_index &&
-        font->glyph_cache[cache_index].width == width &&
-        font->glyph_cache[cache_index].height == height) {
-        // Copy from cache
-        memcpy(bitmap, font->glyph_cache[cache_index].bitmap, width * height);
-        return 0;
-    }
+    spin_unlock(&ttf_scratch_lock);
+    sched_preempt_enable();
+}
 
+// Render the glyph fitted to the bitmap, bypassing the cache
+static void ttf_draw_glyph(ttf_font_t *font, uint16_t glyph_index, uint8_t *bitmap, int width, int height,
+                           int subpixel) {
     // Clear the bitmap area
     memset(bitmap, 0, width * height);
 
@@ -756,13 +940,13 @@ int ttf_render_glyph(ttf_font_t *font, uint16_t glyph_index, uint8_t *bitmap, in
         for (int i = 1; i < height - 1; i++) {
             bitmap[i * width + center_x] = 255;
         }
-        return 0;
+        return;
     }
 
     if (outline.num_points == 0) {
         // Empty glyph (whitespace)
         ttf_free_outline(&outline);
-        return 0;
+        return;
     }
 
     // Calculate scale to fit glyph in bitmap
@@ -782,35 +966,354 @@ int ttf_render_glyph(ttf_font_t *font, uint16_t glyph_index, uint8_t *bitmap, in
     int glyph_width = max_x - min_x;
     int glyph_height = max_y - min_y;
 
-    // Calculate scale
-    float scale_x = (float)(width - 2) / (float)(glyph_width + 1);
-    float scale_y = (float)(height - 2) / (float)(glyph_height + 1);
-    float scale = (scale_x < scale_y) ? scale_x : scale_y;
+    // Calculate scale, in 16.16 pixels per font unit
+    int32_t scale_x = (int32_t)((int64_t)(width - 2) * TTF_FIX_ONE / (glyph_width + 1));
+    int32_t scale_y = (int32_t)((int64_t)(height - 2) * TTF_FIX_ONE / (glyph_height + 1));
+    int32_t scale = (scale_x < scale_y) ? scale_x : scale_y;
 
-    if (scale < 0.1f) scale = 0.1f;
-    if (scale > 10.0f) scale = 10.0f;
+    if (scale < 1) scale = 1;
+    if (scale > TTF_FIX_ONE * 10) scale = TTF_FIX_ONE * 10;
 
     // Center the glyph
-    int32_t scaled_width = (int32_t)(glyph_width * scale);
-    int32_t scaled_height = (int32_t)(glyph_height * scale);
-    int32_t x_offset = (width - scaled_width) / 2 - (int32_t)(min_x * scale);
-    int32_t y_offset = (height - scaled_height) / 2 - (int32_t)(min_y * scale);
+    int64_t scaled_width = (int64_t)glyph_width * scale;
+    int64_t scaled_height = (int64_t)glyph_height * scale;
+    int32_t x_offset = (int32_t)((((int64_t)width << TTF_FIX_SHIFT) - scaled_width) / 2 - (int64_t)min_x * scale);
+    int32_t y_offset = (int32_t)((((int64_t)height << TTF_FIX_SHIFT) - scaled_height) / 2 - (int64_t)min_y * scale);
+    x_offset += subpixel * (TTF_FIX_ONE / TTF_SUBPIXEL_STEPS);
 
     // Rasterize outline
     ttf_rasterize_outline(&outline, bitmap, width, height, x_offset, y_offset, scale);
 
-    // Fill the glyph
-    ttf_fill_glyph(bitmap, width, height);
-
     // Free outline
     ttf_free_outline(&outline);
+}
 
-    // Cache the rendered glyph
-    font->glyph_cache[cache_index].glyph_index = glyph_index;
-    font->glyph_cache[cache_index].width = width;
-    font->glyph_cache[cache_index].height = height;
-    font->glyph_cache[cache_index].valid = 1;
-    memcpy(font->glyph_cache[cache_index].bitmap, bitmap, width * height);
+/*
+ * Glyph cache
+ * Entries are found through a hash table of chains and kept on one LRU
+ * list, most recent first. The arena is split into TTF_CACHE_PAGE pages
+ * that are handed out on demand, each to one size class (64 bytes doubling
+ * up to the page size); a page's free slots are threaded through their own
+ * first bytes. A miss takes a free slot of its class, then an unassigned
+ * page, then the slot of its class's least recently used entry, and as a
+ * last resort empties the page of the least recently used entry overall
+ * and re-carves it. Pinned entries are never evicted; one flushed while
+ * pinned leaves the hash table and waits at the LRU tail to be evicted.
+ * Pins are only taken under the lock and an entry is only evicted under it
+ * once unpinned, so a release is a bare atomic decrement.
+ *
+ * A miss reserves its slot and entry under ttf_cache_lock, marked loading
+ * and pinned, and renders after dropping the lock so interrupts stay on.
+ * Anyone else missing on a glyph that is still loading renders a private
+ * copy into an entry kept out of the hash table, like a flushed one,
+ * instead of waiting for a thread that may not get the CPU back.
+ */
+#define TTF_CACHE_MIN_SLOT  64
+#define TTF_CACHE_CLASSES   7           // 64 bytes to TTF_CACHE_PAGE
+#define TTF_CACHE_PAGES     (TTF_CACHE_ARENA / TTF_CACHE_PAGE)
+#define TTF_CACHE_ENTRIES   (TTF_CACHE_ARENA / TTF_CACHE_MIN_SLOT)   // One per smallest slot
+#define TTF_CACHE_BUCKETS   256
+#define TTF_CACHE_NONE      (-1)
+
+typedef struct {
+    ttf_glyph_bitmap_t bitmap;          // First, so a caller's pointer leads back here
+    ttf_font_t *font;                   // NULL once flushed: out of the hash table
+    int32_t offset;                     // Slot in the arena
+    uint16_t glyph_index;
+    uint8_t subpixel;
+    uint8_t cls;
+    uint8_t in_use;
+    uint8_t loading;                    // Slot reserved, pixels not rendered yet
+    int16_t pins;
+    int16_t hash_next;                  // Chain, or the free entry list
+    int16_t lru_prev, lru_next;
+} ttf_cache_entry_t;
+
+static struct {
+    uint8_t *arena;
+    ttf_cache_entry_t *entries;
+    int16_t buckets[TTF_CACHE_BUCKETS];
+    int16_t lru_head, lru_tail;
+    int16_t free_entries;
+    int32_t free_slots[TTF_CACHE_CLASSES];      // First free slot's offset per class
+    int8_t page_class[TTF_CACHE_PAGES];         // TTF_CACHE_NONE while unassigned
+} ttf_cache;
+static spinlock_t ttf_cache_lock = SPINLOCK_INIT;
+
+static int ttf_cache_init(void) {
+    ttf_cache.arena = kmalloc(TTF_CACHE_ARENA);
+    ttf_cache.entries = kmalloc(TTF_CACHE_ENTRIES * sizeof(ttf_cache_entry_t));
+    if (!ttf_cache.arena || !ttf_cache.entries) {
+        if (ttf_cache.arena) kfree(ttf_cache.arena);
+        if (ttf_cache.entries) kfree(ttf_cache.entries);
+        ttf_cache.arena = NULL;
+        ttf_cache.entries = NULL;
+        return -1;
+    }
 
+    for (int i = 0; i < TTF_CACHE_BUCKETS; i++) ttf_cache.buckets[i] = TTF_CACHE_NONE;
+    for (int i = 0; i < TTF_CACHE_ENTRIES; i++) {
+        ttf_cache.entries[i].in_use = 0;
+        ttf_cache.entries[i].hash_next = (i + 1 < TTF_CACHE_ENTRIES) ? i + 1 : TTF_CACHE_NONE;
+    }
+    for (int c = 0; c < TTF_CACHE_CLASSES; c++) ttf_cache.free_slots[c] = TTF_CACHE_NONE;
+    for (int p = 0; p < TTF_CACHE_PAGES; p++) ttf_cache.page_class[p] = TTF_CACHE_NONE;
+    ttf_cache.lru_head = TTF_CACHE_NONE;
+    ttf_cache.lru_tail = TTF_CACHE_NONE;
+    ttf_cache.free_entries = 0;
     return 0;
-}
\ No newline at end of file
+}
+
+static uint32_t ttf_cache_hash(ttf_font_t *font, uint16_t glyph_index, int width, int height, int subpixel) {
+    uint32_t h = (uint32_t)((uintptr_t)font >> 4);
+    h = h * 31 + glyph_index;
+    h = h * 31 + (uint32_t)((width << 16) | (height << 4) | subpixel);
+    h *= 2654435761u;
+    return (h >> 16) & (TTF_CACHE_BUCKETS - 1);
+}
+
+static int32_t *ttf_slot_next(int32_t offset) {
+    return (int32_t *)(ttf_cache.arena + offset);
+}
+
+static void ttf_lru_remove(int i) {
+    ttf_cache_entry_t *e = &ttf_cache.entries[i];
+    if (e->lru_prev != TTF_CACHE_NONE) ttf_cache.entries[e->lru_prev].lru_next = e->lru_next;
+    else ttf_cache.lru_head = e->lru_next;
+    if (e->lru_next != TTF_CACHE_NONE) ttf_cache.entries[e->lru_next].lru_prev = e->lru_prev;
+    else ttf_cache.lru_tail = e->lru_prev;
+}
+
+static void ttf_lru_push_tail(int i) {
+    ttf_cache_entry_t *e = &ttf_cache.entries[i];
+    e->lru_next = TTF_CACHE_NONE;
+    e->lru_prev = ttf_cache.lru_tail;
+    if (ttf_cache.lru_tail != TTF_CACHE_NONE) ttf_cache.entries[ttf_cache.lru_tail].lru_next = i;
+    else ttf_cache.lru_head = i;
+    ttf_cache.lru_tail = i;
+}
+
+static void ttf_lru_push(int i) {
+    ttf_cache_entry_t *e = &ttf_cache.entries[i];
+    e->lru_prev = TTF_CACHE_NONE;
+    e->lru_next = ttf_cache.lru_head;
+    if (ttf_cache.lru_head != TTF_CACHE_NONE) ttf_cache.entries[ttf_cache.lru_head].lru_prev = i;
+    else ttf_cache.lru_tail = i;
+    ttf_cache.lru_head = i;
+}
+
+static void ttf_hash_remove(int i) {
+    ttf_cache_entry_t *e = &ttf_cache.entries[i];
+    int16_t *link = &ttf_cache.buckets[ttf_cache_hash(e->font, e->glyph_index, e->bitmap.width,
+                                                      e->bitmap.height, e->subpixel)];
+    while (*link != i) link = &ttf_cache.entries[*link].hash_next;
+    *link = e->hash_next;
+}
+
+static int ttf_cache_pinned(int i) {
+    return __atomic_load_n(&ttf_cache.entries[i].pins, __ATOMIC_ACQUIRE) != 0;
+}
+
+// Take the entry out of its chain and off the LRU list
+static void ttf_cache_unhook(int i) {
+    if (ttf_cache.entries[i].font) ttf_hash_remove(i);
+    ttf_lru_remove(i);
+}
+
+// Return an unhooked entry and its slot to the free lists
+static void ttf_cache_free(int i) {
+    ttf_cache_entry_t *e = &ttf_cache.entries[i];
+    *ttf_slot_next(e->offset) = ttf_cache.free_slots[e->cls];
+    ttf_cache.free_slots[e->cls] = e->offset;
+    e->in_use = 0;
+    e->hash_next = ttf_cache.free_entries;
+    ttf_cache.free_entries = i;
+}
+
+static void ttf_cache_carve(int page, int cls) {
+    int32_t size = TTF_CACHE_MIN_SLOT << cls;
+    ttf_cache.page_class[page] = cls;
+    for (int32_t offset = (page + 1) * TTF_CACHE_PAGE - size; offset >= page * TTF_CACHE_PAGE; offset -= size) {
+        *ttf_slot_next(offset) = ttf_cache.free_slots[cls];
+        ttf_cache.free_slots[cls] = offset;
+    }
+}
+
+// Empty the page and hand it back unassigned; -1 if anything on it is pinned
+static int ttf_cache_reclaim_page(int page) {
+    for (int i = 0; i < TTF_CACHE_ENTRIES; i++) {
+        ttf_cache_entry_t *e = &ttf_cache.entries[i];
+        if (e->in_use && e->offset / TTF_CACHE_PAGE == page && ttf_cache_pinned(i)) return -1;
+    }
+    for (int i = 0; i < TTF_CACHE_ENTRIES; i++) {
+        ttf_cache_entry_t *e = &ttf_cache.entries[i];
+        if (!e->in_use || e->offset / TTF_CACHE_PAGE != page) continue;
+        ttf_cache_unhook(i);
+        ttf_cache_free(i);
+        metric_inc(METRIC_GLYPH_CACHE_EVICTIONS);
+    }
+
+    // Drop the page's slots from its class's free list
+    int32_t *link = &ttf_cache.free_slots[ttf_cache.page_class[page]];
+    while (*link != TTF_CACHE_NONE) {
+        if (*link / TTF_CACHE_PAGE == page) *link = *ttf_slot_next(*link);
+        else link = ttf_slot_next(*link);
+    }
+    ttf_cache.page_class[page] = TTF_CACHE_NONE;
+    return 0;
+}
+
+static int32_t ttf_cache_alloc_slot(int cls) {
+    if (ttf_cache.free_slots[cls] == TTF_CACHE_NONE) {
+        int page = 0;
+        while (page < TTF_CACHE_PAGES && ttf_cache.page_class[page] != TTF_CACHE_NONE) page++;
+
+        if (page == TTF_CACHE_PAGES) {
+            // Full: the least recently used entry of this class gives up its slot
+            for (int i = ttf_cache.lru_tail; i != TTF_CACHE_NONE; i = ttf_cache.entries[i].lru_prev) {
+                if (ttf_cache.entries[i].cls != cls || ttf_cache_pinned(i)) continue;
+                ttf_cache_unhook(i);
+                ttf_cache_free(i);
+                metric_inc(METRIC_GLYPH_CACHE_EVICTIONS);
+                break;
+            }
+        }
+        if (page == TTF_CACHE_PAGES && ttf_cache.free_slots[cls] == TTF_CACHE_NONE) {
+            // None in this class: empty the page of the oldest entry that allows it
+            for (int i = ttf_cache.lru_tail; i != TTF_CACHE_NONE; i = ttf_cache.entries[i].lru_prev) {
+                int candidate = ttf_cache.entries[i].offset / TTF_CACHE_PAGE;
+                if (ttf_cache_reclaim_page(candidate) == 0) {
+                    page = candidate;
+                    break;
+                }
+            }
+        }
+        if (page < TTF_CACHE_PAGES) ttf_cache_carve(page, cls);
+    }
+
+    int32_t offset = ttf_cache.free_slots[cls];
+    if (offset != TTF_CACHE_NONE) ttf_cache.free_slots[cls] = *ttf_slot_next(offset);
+    return offset;
+}
+
+const ttf_glyph_bitmap_t *ttf_get_glyph(ttf_font_t *font, uint16_t glyph_index, int width, int height, int subpixel) {
+    if (!font || width <= 0 || height <= 0 || width * height > TTF_CACHE_PAGE) {
+        return NULL;
+    }
+    if (subpixel < 0 || subpixel >= TTF_SUBPIXEL_STEPS) subpixel = 0;
+
+    // Validate glyph index
+    if (glyph_index >= font->num_glyphs) {
+        glyph_index = 0; // Use missing glyph
+    }
+
+    uint64_t flags = spin_lock_irqsave(&ttf_cache_lock);
+    if (!ttf_cache.arena && ttf_cache_init() != 0) {
+        spin_unlock_irqrestore(&ttf_cache_lock, flags);
+        return NULL;
+    }
+
+    uint32_t bucket = ttf_cache_hash(font, glyph_index, width, height, subpixel);
+    int shared = 1;
+    for (int i = ttf_cache.buckets[bucket]; i != TTF_CACHE_NONE; i = ttf_cache.entries[i].hash_next) {
+        ttf_cache_entry_t *e = &ttf_cache.entries[i];
+        if (e->font != font || e->glyph_index != glyph_index || e->bitmap.width != width ||
+            e->bitmap.height != height || e->subpixel != subpixel) {
+            continue;
+        }
+        if (__atomic_load_n(&e->loading, __ATOMIC_ACQUIRE)) {
+            shared = 0;
+            break;
+        }
+        if (ttf_cache.lru_head != i) {
+            ttf_lru_remove(i);
+            ttf_lru_push(i);
+        }
+        __atomic_add_fetch(&e->pins, 1, __ATOMIC_RELAXED);
+        spin_unlock_irqrestore(&ttf_cache_lock, flags);
+        metric_inc(METRIC_GLYPH_CACHE_HITS);
+        return &e->bitmap;
+    }
+    metric_inc(METRIC_GLYPH_CACHE_MISSES);
+
+    int cls = 0;
+    while ((TTF_CACHE_MIN_SLOT << cls) < width * height) cls++;
+    int32_t offset = ttf_cache_alloc_slot(cls);
+    if (offset == TTF_CACHE_NONE) {
+        spin_unlock_irqrestore(&ttf_cache_lock, flags);
+        return NULL;
+    }
+
+    // There are as many entries as smallest slots, so one is always free
+    int i = ttf_cache.free_entries;
+    ttf_cache_entry_t *e = &ttf_cache.entries[i];
+    ttf_cache.free_entries = e->hash_next;
+
+    uint8_t *pixels = ttf_cache.arena + offset;
+    e->bitmap.pixels = pixels;
+    e->bitmap.width = width;
+    e->bitmap.height = height;
+    e->offset = offset;
+    e->glyph_index = glyph_index;
+    e->subpixel = subpixel;
+    e->cls = cls;
+    e->in_use = 1;
+    e->loading = 1;
+    e->pins = 1;
+    if (shared) {
+        e->font = font;
+        e->hash_next = ttf_cache.buckets[bucket];
+        ttf_cache.buckets[bucket] = i;
+        ttf_lru_push(i);
+    } else {
+        e->font = NULL;
+        ttf_lru_push_tail(i);
+    }
+    spin_unlock_irqrestore(&ttf_cache_lock, flags);
+
+    ttf_draw_glyph(font, glyph_index, pixels, width, height, subpixel);
+    __atomic_store_n(&e->loading, 0, __ATOMIC_RELEASE);
+    return &e->bitmap;
+}
+
+void ttf_release_glyph(const ttf_glyph_bitmap_t *glyph) {
+    if (!glyph) return;
+    __atomic_sub_fetch(&((ttf_cache_entry_t *)glyph)->pins, 1, __ATOMIC_RELEASE);
+}
+
+void ttf_cache_flush(ttf_font_t *font) {
+    uint64_t flags = spin_lock_irqsave(&ttf_cache_lock);
+    if (ttf_cache.entries) {
+        for (int i = 0; i < TTF_CACHE_ENTRIES; i++) {
+            ttf_cache_entry_t *e = &ttf_cache.entries[i];
+            if (!e->in_use || !e->font || (font && e->font != font)) continue;
+            if (ttf_cache_pinned(i)) {
+                ttf_hash_remove(i);
+                e->font = NULL;
+                ttf_lru_remove(i);
+                ttf_lru_push_tail(i);
+                continue;
+            }
+            ttf_cache_unhook(i);
+            ttf_cache_free(i);
+        }
+    }
+    spin_unlock_irqrestore(&ttf_cache_lock, flags);
+}
+
+// Copy of the cached glyph; boxes too large to cache are rendered directly
+int ttf_render_glyph(ttf_font_t *font, uint16_t glyph_index, uint8_t *bitmap, int width, int height, int x, int y, int pixel_size) {
+    if (!font || !bitmap || width <= 0 || height <= 0) {
+        return -1;
+    }
+
+    const ttf_glyph_bitmap_t *glyph = ttf_get_glyph(font, glyph_index, width, height, 0);
+    if (!glyph) {
+        if (glyph_index >= font->num_glyphs) glyph_index = 0;
+        ttf_draw_glyph(font, glyph_index, bitmap, width, height, 0);
+        return 0;
+    }
+    memcpy(bitmap, glyph->pixels, width * height);
+    ttf_release_glyph(glyph);
+    return 0;
+}
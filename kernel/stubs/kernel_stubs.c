@@ -62,17 +62,6 @@ char *strrchr(const char *s, int c) {
     return (char *)(last ? last : NULL);
 }
 
-void *memmove(void *dest, const void *src, size_t n) {
-    unsigned char *d = dest;
-    const unsigned char *s = src;
-    if (d < s) {
-        for (size_t i = 0; i < n; i++) d[i] = s[i];
-    } else if (d > s) {
-        for (size_t i = n; i > 0; i--) d[i-1] = s[i-1];
-    }
-    return dest;
-}
-
 char *strstr(const char *haystack, const char *needle) {
     size_t nlen = strlen(needle);
     if (!nlen) return (char *)haystack;
@@ -1,30 +1,425 @@
 #include "../include/string.h"
 
-// Memory functions
-void* memset(void* dest, int c, size_t n) {
-    unsigned char* ptr = (unsigned char*)dest;
-    for (size_t i = 0; i < n; i++) {
-        ptr[i] = (unsigned char)c;
+/* --- Memory functions --- */
+//
+// memcpy/memset are dispatched at boot (mem_init_dispatch) to the fastest
+// variant the CPU supports. The kernel is built without optimisation, so the
+// hot loops are written as inline assembly rather than left to the compiler.
+// Until dispatch runs, the portable rep movsq/stosq versions are used.
+
+#define MEM_SMALL       16      // Below this, copy with scalar moves
+#define MEM_ERMS_MIN    2048    // rep movsb/stosb wins above this with ERMS
+
+typedef uint64_t __attribute__((may_alias, aligned(1))) u64_unaligned;
+typedef uint32_t __attribute__((may_alias, aligned(1))) u32_unaligned;
+
+typedef void *(*memcpy_fn_t)(void *dest, const void *src, size_t n);
+typedef void *(*memset_fn_t)(void *dest, int c, size_t n);
+
+// Copy n < 16 bytes with at most two overlapping moves per width
+static inline void copy_small(uint8_t *d, const uint8_t *s, size_t n) {
+    if (n >= 8) {
+        uint64_t a = *(const u64_unaligned *)s, b = *(const u64_unaligned *)(s + n - 8);
+        *(u64_unaligned *)d = a;
+        *(u64_unaligned *)(d + n - 8) = b;
+    } else if (n >= 4) {
+        uint32_t a = *(const u32_unaligned *)s, b = *(const u32_unaligned *)(s + n - 4);
+        *(u32_unaligned *)d = a;
+        *(u32_unaligned *)(d + n - 4) = b;
+    } else if (n) {
+        uint8_t a = s[0], b = s[n / 2], c = s[n - 1];
+        d[0] = a;
+        d[n / 2] = b;
+        d[n - 1] = c;
     }
+}
+
+static inline void set_small(uint8_t *d, uint64_t pattern, size_t n) {
+    if (n >= 8) {
+        *(u64_unaligned *)d = pattern;
+        *(u64_unaligned *)(d + n - 8) = pattern;
+    } else if (n >= 4) {
+        *(u32_unaligned *)d = (uint32_t)pattern;
+        *(u32_unaligned *)(d + n - 4) = (uint32_t)pattern;
+    } else if (n) {
+        d[0] = d[n / 2] = d[n - 1] = (uint8_t)pattern;
+    }
+}
+
+// Portable: 8 bytes per iteration via rep movsq
+static void *memcpy_movsq(void *dest, const void *src, size_t n) {
+    void *d = dest;
+    size_t qwords = n >> 3, bytes = n & 7;
+    __asm__ volatile("rep movsq" : "+D"(d), "+S"(src), "+c"(qwords) : : "memory");
+    __asm__ volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(bytes) : : "memory");
+    return dest;
+}
+
+static void *memset_stosq(void *dest, int c, size_t n) {
+    void *d = dest;
+    uint64_t pattern = 0x0101010101010101ULL * (uint8_t)c;
+    size_t qwords = n >> 3, bytes = n & 7;
+    __asm__ volatile("rep stosq" : "+D"(d), "+c"(qwords) : "a"(pattern) : "memory");
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(bytes) : "a"(pattern) : "memory");
     return dest;
 }
 
+// Enhanced REP MOVSB/STOSB: microcode picks the copy width itself
+static void *memcpy_erms(void *dest, const void *src, size_t n) {
+    void *d = dest;
+    __asm__ volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(n) : : "memory");
+    return dest;
+}
+
+static void *memset_erms(void *dest, int c, size_t n) {
+    void *d = dest;
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
+    return dest;
+}
+
+// SSE2: one unaligned head store, 64-byte aligned-store loop, overlapping tail
+static void *memcpy_sse2(void *dest, const void *src, size_t n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+
+    if (n < MEM_SMALL) {
+        copy_small(d, s, n);
+        return dest;
+    }
+
+    const uint8_t *s_end = s + n;
+    uint8_t *d_end = d + n;
+
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    __asm__ volatile("movdqu (%1), %%xmm0\n\t"
+                     "movdqu %%xmm0, (%0)"
+                     : : "r"(d), "r"(s) : "xmm0", "memory");
+    d += head;
+    s += head;
+    n -= head;
+
+    size_t blocks = n >> 6;
+    if (blocks) {
+        __asm__ volatile("1:\n\t"
+                         "movdqu   (%1), %%xmm0\n\t"
+                         "movdqu 16(%1), %%xmm1\n\t"
+                         "movdqu 32(%1), %%xmm2\n\t"
+                         "movdqu 48(%1), %%xmm3\n\t"
+                         "movdqa %%xmm0,   (%0)\n\t"
+                         "movdqa %%xmm1, 16(%0)\n\t"
+                         "movdqa %%xmm2, 32(%0)\n\t"
+                         "movdqa %%xmm3, 48(%0)\n\t"
+                         "add $64, %1\n\t"
+                         "add $64, %0\n\t"
+                         "dec %2\n\t"
+                         "jnz 1b"
+                         : "+r"(d), "+r"(s), "+r"(blocks)
+                         : : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+    }
+
+    n &= 63;
+    while (n > 16) {
+        __asm__ volatile("movdqu (%1), %%xmm0\n\t"
+                         "movdqa %%xmm0, (%0)"
+                         : : "r"(d), "r"(s) : "xmm0", "memory");
+        d += 16;
+        s += 16;
+        n -= 16;
+    }
+
+    // Last 16 bytes, possibly overlapping what was already copied
+    __asm__ volatile("movdqu (%1), %%xmm0\n\t"
+                     "movdqu %%xmm0, (%0)"
+                     : : "r"(d_end - 16), "r"(s_end - 16) : "xmm0", "memory");
+    return dest;
+}
+
+static void *memset_sse2(void *dest, int c, size_t n) {
+    uint8_t *d = dest;
+    uint64_t pattern = 0x0101010101010101ULL * (uint8_t)c;
+
+    if (n < MEM_SMALL) {
+        set_small(d, pattern, n);
+        return dest;
+    }
+
+    uint8_t *d_end = d + n;
+    __asm__ volatile("movq %0, %%xmm0\n\t"
+                     "punpcklqdq %%xmm0, %%xmm0\n\t"
+                     "movdqu %%xmm0, (%1)\n\t"
+                     "movdqu %%xmm0, -16(%2)"
+                     : : "r"(pattern), "r"(d), "r"(d_end) : "xmm0", "memory");
+
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    d += head;
+    n -= head;
+
+    size_t blocks = n >> 6;
+    if (blocks) {
+        __asm__ volatile("movq %2, %%xmm0\n\t"
+                         "punpcklqdq %%xmm0, %%xmm0\n\t"
+                         "1:\n\t"
+                         "movdqa %%xmm0,   (%0)\n\t"
+                         "movdqa %%xmm0, 16(%0)\n\t"
+                         "movdqa %%xmm0, 32(%0)\n\t"
+                         "movdqa %%xmm0, 48(%0)\n\t"
+                         "add $64, %0\n\t"
+                         "dec %1\n\t"
+                         "jnz 1b"
+                         : "+r"(d), "+r"(blocks)
+                         : "r"(pattern) : "xmm0", "memory", "cc");
+    }
+
+    // Remaining < 64 bytes: aligned 16-byte stores, the tail store above covers the rest
+    for (n &= 63; n >= 16; n -= 16, d += 16) {
+        __asm__ volatile("movq %1, %%xmm0\n\t"
+                         "punpcklqdq %%xmm0, %%xmm0\n\t"
+                         "movdqa %%xmm0, (%0)"
+                         : : "r"(d), "r"(pattern) : "xmm0", "memory");
+    }
+    return dest;
+}
+
+// AVX2: 32-byte registers, 128 bytes per iteration. Only selected when the
+// OS has enabled YMM state in XCR0.
+static void *memcpy_avx2(void *dest, const void *src, size_t n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+
+    if (n < 64) {
+        return memcpy_sse2(dest, src, n);
+    }
+
+    const uint8_t *s_end = s + n;
+    uint8_t *d_end = d + n;
+
+    size_t head = (32 - ((uintptr_t)d & 31)) & 31;
+    __asm__ volatile("vmovdqu (%1), %%ymm0\n\t"
+                     "vmovdqu %%ymm0, (%0)"
+                     : : "r"(d), "r"(s) : "xmm0", "memory");
+    d += head;
+    s += head;
+    n -= head;
+
+    size_t blocks = n >> 7;
+    if (blocks) {
+        __asm__ volatile("1:\n\t"
+                         "vmovdqu   (%1), %%ymm0\n\t"
+                         "vmovdqu 32(%1), %%ymm1\n\t"
+                         "vmovdqu 64(%1), %%ymm2\n\t"
+                         "vmovdqu 96(%1), %%ymm3\n\t"
+                         "vmovdqa %%ymm0,   (%0)\n\t"
+                         "vmovdqa %%ymm1, 32(%0)\n\t"
+                         "vmovdqa %%ymm2, 64(%0)\n\t"
+                         "vmovdqa %%ymm3, 96(%0)\n\t"
+                         "add $128, %1\n\t"
+                         "add $128, %0\n\t"
+                         "dec %2\n\t"
+                         "jnz 1b"
+                         : "+r"(d), "+r"(s), "+r"(blocks)
+                         : : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+    }
+
+    for (n &= 127; n > 32; n -= 32, d += 32, s += 32) {
+        __asm__ volatile("vmovdqu (%1), %%ymm0\n\t"
+                         "vmovdqa %%ymm0, (%0)"
+                         : : "r"(d), "r"(s) : "xmm0", "memory");
+    }
+
+    __asm__ volatile("vmovdqu (%1), %%ymm0\n\t"
+                     "vmovdqu %%ymm0, (%0)\n\t"
+                     "vzeroupper"
+                     : : "r"(d_end - 32), "r"(s_end - 32) : "xmm0", "memory");
+    return dest;
+}
+
+static void *memset_avx2(void *dest, int c, size_t n) {
+    uint8_t *d = dest;
+    uint64_t pattern = 0x0101010101010101ULL * (uint8_t)c;
+
+    if (n < 64) {
+        return memset_sse2(dest, c, n);
+    }
+
+    uint8_t *d_end = d + n;
+    __asm__ volatile("vmovq %0, %%xmm0\n\t"
+                     "vpbroadcastq %%xmm0, %%ymm0\n\t"
+                     "vmovdqu %%ymm0, (%1)\n\t"
+                     "vmovdqu %%ymm0, -32(%2)"
+                     : : "r"(pattern), "r"(d), "r"(d_end) : "xmm0", "memory");
+
+    size_t head = (32 - ((uintptr_t)d & 31)) & 31;
+    d += head;
+    n -= head;
+
+    size_t blocks = n >> 7;
+    size_t tail = (n & 127) >> 5;
+    __asm__ volatile("vmovq %3, %%xmm0\n\t"
+                     "vpbroadcastq %%xmm0, %%ymm0\n\t"
+                     "test %1, %1\n\t"
+                     "jz 2f\n\t"
+                     "1:\n\t"
+                     "vmovdqa %%ymm0,   (%0)\n\t"
+                     "vmovdqa %%ymm0, 32(%0)\n\t"
+                     "vmovdqa %%ymm0, 64(%0)\n\t"
+                     "vmovdqa %%ymm0, 96(%0)\n\t"
+                     "add $128, %0\n\t"
+                     "dec %1\n\t"
+                     "jnz 1b\n\t"
+                     "2:\n\t"
+                     "test %2, %2\n\t"
+                     "jz 4f\n\t"
+                     "3:\n\t"
+                     "vmovdqa %%ymm0, (%0)\n\t"
+                     "add $32, %0\n\t"
+                     "dec %2\n\t"
+                     "jnz 3b\n\t"
+                     "4:\n\t"
+                     "vzeroupper"
+                     : "+r"(d), "+r"(blocks), "+r"(tail)
+                     : "r"(pattern) : "xmm0", "memory", "cc");
+    return dest;
+}
+
+static mem_impl_t mem_impls[] = {
+    { "movsq", memcpy_movsq, memset_stosq, 1 },
+    { "erms",  memcpy_erms,  memset_erms,  0 },
+    { "sse2",  memcpy_sse2,  memset_sse2,  1 },
+    { "avx2",  memcpy_avx2,  memset_avx2,  0 },
+};
+
+#define MEM_IMPL_COUNT (int)(sizeof(mem_impls) / sizeof(mem_impls[0]))
+
+static memcpy_fn_t memcpy_impl = memcpy_movsq;
+static memset_fn_t memset_impl = memset_stosq;
+static const char *mem_impl_selected = "movsq";
+static int mem_has_erms = 0;
+
+static inline void mem_cpuid(uint32_t leaf, uint32_t sub, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    __asm__ volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(sub));
+}
+
+void mem_init_dispatch(void) {
+    uint32_t a, b, c, d;
+    int avx_os = 0;
+
+    mem_cpuid(0, 0, &a, &b, &c, &d);
+    uint32_t max_leaf = a;
+
+    // AVX needs the OS to have enabled XMM|YMM state (CPUID.1:ECX.OSXSAVE + XCR0)
+    mem_cpuid(1, 0, &a, &b, &c, &d);
+    if ((c & (1u << 27)) && (c & (1u << 28))) {
+        uint32_t xcr0_lo, xcr0_hi;
+        __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        avx_os = (xcr0_lo & 6) == 6;
+    }
+
+    if (max_leaf >= 7) {
+        mem_cpuid(7, 0, &a, &b, &c, &d);
+        mem_has_erms = (b >> 9) & 1;
+        mem_impls[1].available = mem_has_erms;
+        mem_impls[3].available = avx_os && ((b >> 5) & 1);
+    }
+
+    // Vector loops for small/medium sizes, rep movsb/stosb for large ones with ERMS
+    int avx2 = mem_impls[3].available;
+    memcpy_impl = avx2 ? memcpy_avx2 : memcpy_sse2;
+    memset_impl = avx2 ? memset_avx2 : memset_sse2;
+    if (mem_has_erms) {
+        mem_impl_selected = avx2 ? "avx2+erms" : "sse2+erms";
+    } else {
+        mem_impl_selected = avx2 ? "avx2" : "sse2";
+    }
+}
+
+const char *mem_impl_name(void) {
+    return mem_impl_selected;
+}
+
+int mem_get_impls(const mem_impl_t **impls) {
+    *impls = mem_impls;
+    return MEM_IMPL_COUNT;
+}
+
 void* memcpy(void* dest, const void* src, size_t n) {
-    unsigned char* d = (unsigned char*)dest;
-    const unsigned char* s = (const unsigned char*)src;
-    for (size_t i = 0; i < n; i++) {
-        d[i] = s[i];
+    if (n < MEM_SMALL) {
+        copy_small(dest, src, n);
+        return dest;
+    }
+    if (mem_has_erms && n >= MEM_ERMS_MIN) {
+        return memcpy_erms(dest, src, n);
+    }
+    return memcpy_impl(dest, src, n);
+}
+
+void* memset(void* dest, int c, size_t n) {
+    if (mem_has_erms && n >= MEM_ERMS_MIN) {
+        return memset_erms(dest, c, n);
+    }
+    return memset_impl(dest, c, n);
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+
+    if (d == s || n == 0) return dest;
+
+    // No overlap: any copy direction is fine
+    if (d + n <= s || s + n <= d) {
+        return memcpy(dest, src, n);
+    }
+
+    if (d < s) {
+        // Forward byte copy never reads a byte it has already overwritten
+        __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+        return dest;
+    }
+
+    // Backward: load each 64-byte block before storing it, top down
+    while (n >= 64) {
+        n -= 64;
+        __asm__ volatile("movdqu   (%1), %%xmm0\n\t"
+                         "movdqu 16(%1), %%xmm1\n\t"
+                         "movdqu 32(%1), %%xmm2\n\t"
+                         "movdqu 48(%1), %%xmm3\n\t"
+                         "movdqu %%xmm0,   (%0)\n\t"
+                         "movdqu %%xmm1, 16(%0)\n\t"
+                         "movdqu %%xmm2, 32(%0)\n\t"
+                         "movdqu %%xmm3, 48(%0)"
+                         : : "r"(d + n), "r"(s + n) : "xmm0", "xmm1", "xmm2", "xmm3", "memory");
+    }
+    while (n > 0) {
+        n--;
+        d[n] = s[n];
     }
     return dest;
 }
 
 // String functions
 size_t strlen(const char* str) {
-    size_t len = 0;
-    while (str[len] != '\0') {
-        len++;
+    // Aligned 16-byte loads never cross a page, so reading past the
+    // terminator is safe. Bytes before 'str' are masked off.
+    const char *p = (const char *)((uintptr_t)str & ~(uintptr_t)15);
+    uint32_t mask;
+
+    __asm__ volatile("pxor %%xmm0, %%xmm0\n\t"
+                     "movdqa (%1), %%xmm1\n\t"
+                     "pcmpeqb %%xmm0, %%xmm1\n\t"
+                     "pmovmskb %%xmm1, %0"
+                     : "=r"(mask) : "r"(p) : "xmm0", "xmm1");
+    mask >>= (uintptr_t)str & 15;
+    if (mask) return __builtin_ctz(mask);
+
+    for (;;) {
+        p += 16;
+        __asm__ volatile("pxor %%xmm0, %%xmm0\n\t"
+                         "movdqa (%1), %%xmm1\n\t"
+                         "pcmpeqb %%xmm0, %%xmm1\n\t"
+                         "pmovmskb %%xmm1, %0"
+                         : "=r"(mask) : "r"(p) : "xmm0", "xmm1");
+        if (mask) return (size_t)(p - str) + __builtin_ctz(mask);
     }
-    return len;
 }
 
 int strcmp(const char* str1, const char* str2) {
@@ -2,11 +2,11 @@
 #include <stddef.h>
 #include "../include/apps.h"
 
+#include "../hal/clock.h"
+
 // Timer functions
 uint64_t timer_ms() {
-    static uint64_t fake = 0;
-    fake += 16;
-    return fake;
+    return clock_ms();
 }
 
 // Standard C time functions
@@ -22,20 +22,33 @@ struct tm {
 };
 
 time_t time(time_t* t) {
-    static time_t fake = 1736800000;
-    fake += 1;
-    if (t) *t = fake;
-    return fake;
+    time_t now = (time_t)clock_wall_seconds();
+    if (t) *t = now;
+    return now;
 }
 
 struct tm* localtime(const time_t* t) {
     static struct tm tm;
-    tm.tm_sec = (*t % 60);
-    tm.tm_min = (*t / 60) % 60;
-    tm.tm_hour = (*t / 3600) % 24;
-    tm.tm_mday = 1;
-    tm.tm_mon = 0;
-    tm.tm_year = 125;
+    long days = *t / 86400;
+    long secs = *t % 86400;
+
+    tm.tm_sec = secs % 60;
+    tm.tm_min = (secs / 60) % 60;
+    tm.tm_hour = secs / 3600;
+
+    // Civil date from days since 1970-01-01
+    long z = days + 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned long doe = (unsigned long)(z - era * 146097);
+    unsigned long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned long mp = (5 * doy + 2) / 153;
+    unsigned long month = mp < 10 ? mp + 3 : mp - 9;
+    long year = (long)yoe + era * 400 + (month <= 2);
+
+    tm.tm_mday = (int)(doy - (153 * mp + 2) / 5 + 1);
+    tm.tm_mon = (int)month - 1;
+    tm.tm_year = (int)(year - 1900);
     return &tm;
 }
 
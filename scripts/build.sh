@@ -243,7 +243,7 @@ x86_64-w64-mingw32-gcc -I. -ffreestanding -mno-red-zone -nostdlib -Wall \
 update_build_progress
 
 echo "[2] Kernel"
-GCC_FLAGS="-I$SRC_INCLUDE -I$SRC_HAL -I$SRC_DRIVERS -ffreestanding -mno-red-zone -fno-stack-protector -fno-pie -msse2 -c"
+GCC_FLAGS="-I$SRC_INCLUDE -I$SRC_HAL -I$SRC_DRIVERS -ffreestanding -mno-red-zone -fno-stack-protector -fno-pie -msse2 -fno-omit-frame-pointer -c"
 OBJ_FILES=()
 PIDS=()
 
@@ -440,6 +440,8 @@ wait_for_recovery_jobs() {
 
 OBJ_RECOVERY+=("$ENTRY_OBJ")
 
+# All of hal/ links into the recovery kernel as well, so anything the shared
+# drivers call (klog, trace, metrics) lives in hal/ rather than kernel/
 for src in $(find "$SRC_HAL" -maxdepth 1 -type f \( -name "*.c" -o -name "*.S" -o -name "*.s" \) | sort); do
     [[ "$(basename "$src")" == "serial.c" ]] && continue
     obj="$BIN/recovery_$(basename "$src" | sed 's/\.\w\+$/.o/')"
@@ -470,6 +472,10 @@ FONT_OBJ="$BIN/recovery_font.o"
 compile_recovery_parallel "$SRC_GRAPHICS/font.c" "$FONT_OBJ" "$GCC_FLAGS"
 OBJ_RECOVERY+=("$FONT_OBJ")
 
+BLIT_OBJ="$BIN/recovery_blit.o"
+compile_recovery_parallel "$SRC_GRAPHICS/blit.c" "$BLIT_OBJ" "$GCC_FLAGS"
+OBJ_RECOVERY+=("$BLIT_OBJ")
+
 wait_for_recovery_jobs
 
 for src in $(find "$SRC_DRIVERS" -maxdepth 1 -type f \( -name "*.c" -o -name "*.S" -o -name "*.s" \) | sort); do
@@ -495,6 +501,9 @@ wait_for_recovery_jobs
 MEMORY_RECOVERY_OBJ="$BIN/recovery_memory.o"
 compile_recovery_parallel "$SRC_FS/memory.c" "$MEMORY_RECOVERY_OBJ" "$GCC_FLAGS"
 OBJ_RECOVERY+=("$MEMORY_RECOVERY_OBJ")
+PMM_RECOVERY_OBJ="$BIN/recovery_pmm.o"
+compile_recovery_parallel "$SRC_FS/pmm.c" "$PMM_RECOVERY_OBJ" "$GCC_FLAGS"
+OBJ_RECOVERY+=("$PMM_RECOVERY_OBJ")
 
 wait_for_recovery_jobs
 
@@ -0,0 +1,80 @@
+#!/usr/bin/env bash
+# Hosted build: the graphics, font, fs and Doom code as a Linux program
+# (bin/hosted/tiny64-host), for benchmarking under perf and sanitizers
+# without booting QEMU. hosted/ stands in for the HAL.
+#
+#   scripts/build_hosted.sh                     # same optimization as the kernel (-O0)
+#   OPT=-O2 scripts/build_hosted.sh
+#   SANITIZE=address,undefined scripts/build_hosted.sh
+#
+#   bin/hosted/tiny64-host bench [prefix]
+#   bin/hosted/tiny64-host --frames 2000 doom -iwad doom1.wad -timedemo demo1
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "$SCRIPT_DIR")"
+
+SRC_KERNEL="$PROJECT_ROOT/kernel"
+SRC_HOSTED="$PROJECT_ROOT/hosted"
+OUT="$PROJECT_ROOT/bin/hosted"
+
+OPT="${OPT:--O0}"
+CC="${CC:-gcc}"
+
+CFLAGS="-DTINY64_HOSTED -I$PROJECT_ROOT/include -I$PROJECT_ROOT/hal -I$SRC_KERNEL/drivers $OPT -g -fno-omit-frame-pointer -msse2"
+LDFLAGS="-lm"
+if [ -n "$SANITIZE" ]; then
+    CFLAGS="$CFLAGS -fsanitize=$SANITIZE"
+    LDFLAGS="$LDFLAGS -fsanitize=$SANITIZE"
+fi
+
+# Everything under kernel/doom plus the kernel pieces it and the benchmarks
+# use. The libc replacements in kernel/stubs are left out except string.c,
+# so memcpy/memset are the kernel's own.
+SOURCES=(
+    "$SRC_KERNEL"/doom/*.c
+    "$SRC_KERNEL/graphics/graphics.c"
+    "$SRC_KERNEL/graphics/blit.c"
+    "$SRC_KERNEL/graphics/font.c"
+    "$SRC_KERNEL/graphics/ttf.c"
+    "$SRC_KERNEL/graphics/inter_font_data.c"
+    "$SRC_KERNEL/fs/fs.c"
+    "$SRC_KERNEL/fs/memory.c"
+    "$SRC_KERNEL/fs/pmm.c"
+    "$SRC_KERNEL/stubs/doomgeneric_stubs.c"
+    "$SRC_KERNEL/stubs/net_client_stubs.c"
+    "$SRC_KERNEL/core/bench.c"
+    "$PROJECT_ROOT/hal/metrics.c"
+    "$SRC_HOSTED"/*.c
+)
+
+mkdir -p "$OUT/obj"
+OBJS=()
+PIDS=()
+
+for src in "${SOURCES[@]}"; do
+    obj="$OUT/obj/$(basename "$src" .c).o"
+    "$CC" $CFLAGS -c "$src" -o "$obj" &
+    PIDS+=($!)
+    OBJS+=("$obj")
+done
+
+# string.c overrides the libc symbols it defines, as in the kernel; its
+# memcpy must not be compiled into a call to itself
+obj="$OUT/obj/string.o"
+"$CC" $CFLAGS -fno-builtin -fno-tree-loop-distribute-patterns -c "$SRC_KERNEL/stubs/string.c" -o "$obj" &
+PIDS+=($!)
+OBJS+=("$obj")
+
+FAILED=0
+for pid in "${PIDS[@]}"; do
+    wait "$pid" || FAILED=1
+done
+if [ "$FAILED" -ne 0 ]; then
+    echo "Hosted build failed" >&2
+    exit 1
+fi
+
+# hosted.ld brackets the .bench section the way link_kernel.ld does
+"$CC" -o "$OUT/tiny64-host" "${OBJS[@]}" -Wl,-T,"$SRC_HOSTED/hosted.ld" $LDFLAGS
+echo "Built $OUT/tiny64-host"
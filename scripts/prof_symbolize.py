@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""
+Symbolize a Tiny64 `prof dump` and fold it for flamegraphs.
+
+Capture the serial log while running `prof dump`, then:
+
+    scripts/prof_symbolize.py serial.log > kernel.folded
+    flamegraph.pl kernel.folded > kernel.svg
+
+Each output line is "frame;frame;...;leaf count" (root first), the format
+flamegraph.pl and speedscope read. The hottest functions by self samples
+are printed to stderr. Addresses are resolved with `nm` against
+bin/kernel.elf, which the kernel is linked and loaded at as-is.
+"""
+
+import argparse
+import bisect
+import collections
+import os
+import subprocess
+import sys
+
+PROJECT_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def load_symbols(elf):
+    out = subprocess.run(['nm', '-n', '--defined-only', elf],
+                         check=True, capture_output=True, text=True).stdout
+    addrs, names = [], []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 3 or parts[1] not in 'TtWw':
+            continue
+        addrs.append(int(parts[0], 16))
+        names.append(parts[2])
+    return addrs, names
+
+
+def symbolize(addrs, names, pc):
+    i = bisect.bisect_right(addrs, pc) - 1
+    return names[i] if i >= 0 else '0x%x' % pc
+
+
+def parse_dump(lines):
+    """Samples from the last complete '# prof begin' ... '# prof end' block."""
+    block, current = None, None
+    for line in lines:
+        line = line.strip()
+        if line.startswith('# prof begin'):
+            current = []
+        elif line.startswith('# prof end'):
+            if current is not None:
+                block = current
+            current = None
+        elif current is not None and line and line[0].isdigit():
+            fields = line.split()
+            if len(fields) < 3:
+                continue
+            cpu, count = int(fields[0]), int(fields[1])
+            pcs = [int(f, 16) for f in fields[2:]]
+            current.append((cpu, count, pcs))
+    return block
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('log', help='serial capture containing a prof dump ("-" for stdin)')
+    parser.add_argument('--elf', default=os.path.join(PROJECT_ROOT, 'bin', 'kernel.elf'))
+    parser.add_argument('--per-cpu', action='store_true', help='add a cpuN root frame')
+    parser.add_argument('--top', type=int, default=15, help='self-time entries to print')
+    args = parser.parse_args()
+
+    log = sys.stdin if args.log == '-' else open(args.log, errors='replace')
+    samples = parse_dump(log)
+    if samples is None:
+        sys.exit('no complete "# prof begin" ... "# prof end" block found')
+
+    addrs, names = load_symbols(args.elf)
+    folded = collections.Counter()
+    self_time = collections.Counter()
+    total = 0
+
+    for cpu, count, pcs in samples:
+        # pcs[0] is the interrupted RIP; the rest are return addresses, so
+        # step back into the call instruction before looking them up
+        frames = [symbolize(addrs, names, pc if i == 0 else pc - 1) for i, pc in enumerate(pcs)]
+        frames.reverse()
+        if args.per_cpu:
+            frames.insert(0, 'cpu%d' % cpu)
+        folded[';'.join(frames)] += count
+        self_time[frames[-1]] += count
+        total += count
+
+    for stack, count in sorted(folded.items()):
+        print('%s %d' % (stack, count))
+
+    print('%d samples, self time:' % total, file=sys.stderr)
+    for name, count in self_time.most_common(args.top):
+        print('  %6.2f%%  %6d  %s' % (100.0 * count / total, count, name), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()